@@ -0,0 +1,98 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/async_file_io.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/bind.h>
+#include <base/file_util.h>
+#include <base/location.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/sequenced_task_runner.h>
+#include <base/threading/sequenced_worker_pool.h>
+
+namespace login_manager {
+
+namespace {
+
+// Name prefix for the worker threads.
+const char kThreadNamePrefix[] = "FileIO";
+
+void WriteOnWorker(const base::FilePath& path,
+                   const std::string& data,
+                   mode_t mode,
+                   bool* result) {
+  *result = AsyncFileIo::WriteFileAtomically(path, data.data(), data.size(),
+                                             mode);
+}
+
+void ReplyStatus(const AsyncFileIo::StatusCallback& callback, bool* result) {
+  callback.Run(*result);
+}
+
+}  // namespace
+
+// static
+const size_t AsyncFileIo::kMaxThreads = 2;
+
+AsyncFileIo::AsyncFileIo() {
+}
+
+AsyncFileIo::~AsyncFileIo() {
+  if (pool_.get())
+    pool_->Shutdown();
+}
+
+void AsyncFileIo::AtomicWrite(const base::FilePath& path,
+                              const std::string& data,
+                              mode_t mode,
+                              const StatusCallback& callback) {
+  bool* result = new bool(false);
+  GetTaskRunnerForPath(path)->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&WriteOnWorker, path, data, mode, result),
+      base::Bind(&ReplyStatus, callback, base::Owned(result)));
+}
+
+scoped_refptr<base::SequencedTaskRunner> AsyncFileIo::GetTaskRunnerForPath(
+    const base::FilePath& path) {
+  if (!pool_.get())
+    pool_ = new base::SequencedWorkerPool(kMaxThreads, kThreadNamePrefix);
+  return pool_->GetSequencedTaskRunner(
+      pool_->GetNamedSequenceToken(path.value()));
+}
+
+// static
+bool AsyncFileIo::WriteFileAtomically(const base::FilePath& path,
+                                      const char* data,
+                                      int size,
+                                      mode_t mode) {
+  base::FilePath scratch;
+  if (!file_util::CreateTemporaryFileInDir(path.DirName(), &scratch)) {
+    PLOG(ERROR) << "Can't create a scratch file for " << path.value();
+    return false;
+  }
+  // Flush the data before the rename, or a crash could leave |path| empty.
+  int fd = HANDLE_EINTR(open(scratch.value().c_str(),
+                             O_WRONLY | O_TRUNC | O_CLOEXEC));
+  bool success = fd >= 0 &&
+      file_util::WriteFileDescriptor(fd, data, size) == size &&
+      HANDLE_EINTR(fdatasync(fd)) == 0;
+  if (fd >= 0 && HANDLE_EINTR(close(fd)) != 0)
+    success = false;
+  success = success &&
+      chmod(scratch.value().c_str(), mode) == 0 &&
+      file_util::ReplaceFile(scratch, path);
+  if (!success) {
+    PLOG(ERROR) << "Can't write " << path.value();
+    file_util::Delete(scratch, false);
+  }
+  return success;
+}
+
+}  // namespace login_manager
@@ -0,0 +1,71 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_ASYNC_FILE_IO_H_
+#define LOGIN_MANAGER_ASYNC_FILE_IO_H_
+
+#include <sys/types.h>
+
+#include <string>
+
+#include <base/basictypes.h>
+#include <base/callback.h>
+#include <base/file_path.h>
+#include <base/memory/ref_counted.h>
+
+namespace base {
+class SequencedTaskRunner;
+class SequencedWorkerPool;
+}  // namespace base
+
+namespace login_manager {
+
+// Runs file operations on a small pool of worker threads, so that the main
+// loop doesn't block on the disk, and reports back on the loop each operation
+// was issued from. Operations on the same path run in the order they were
+// issued, operations on different paths may run concurrently.
+//
+// Must be used from a single thread that runs a message loop. Threads are
+// only started once there is something to do.
+class AsyncFileIo {
+ public:
+  typedef base::Callback<void(bool success)> StatusCallback;
+
+  AsyncFileIo();
+  // Blocks until operations in flight are done.
+  ~AsyncFileIo();
+
+  // Replaces the contents of |path| with |data|, see WriteFileAtomically().
+  void AtomicWrite(const base::FilePath& path,
+                   const std::string& data,
+                   mode_t mode,
+                   const StatusCallback& callback);
+
+  // Returns a runner for other work on |path|, sequenced with the writes
+  // above.
+  scoped_refptr<base::SequencedTaskRunner> GetTaskRunnerForPath(
+      const base::FilePath& path);
+
+  // Writes |size| bytes of |data| to a scratch file next to |path|, flushes
+  // it to disk and renames it over |path|, so that |path| holds either its
+  // old or its new contents even if the system goes down meanwhile. The new
+  // file gets permissions |mode|. Blocks.
+  static bool WriteFileAtomically(const base::FilePath& path,
+                                  const char* data,
+                                  int size,
+                                  mode_t mode);
+
+  // Maximum number of operations that run at the same time.
+  static const size_t kMaxThreads;
+
+ private:
+  // Created on first use.
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileIo);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_ASYNC_FILE_IO_H_
@@ -0,0 +1,128 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/async_file_io.h"
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/location.h>
+#include <base/message_loop.h>
+#include <base/run_loop.h>
+#include <base/sequenced_task_runner.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+namespace {
+
+void ReadInto(const base::FilePath& path, std::string* contents) {
+  file_util::ReadFileToString(path, contents);
+}
+
+}  // namespace
+
+class AsyncFileIoTest : public ::testing::Test {
+ public:
+  AsyncFileIoTest() {}
+  virtual ~AsyncFileIoTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    path_ = tmpdir_.path().AppendASCII("file");
+  }
+
+ protected:
+  AsyncFileIo::StatusCallback StatusCallback() {
+    return base::Bind(&AsyncFileIoTest::OnStatus, base::Unretained(this));
+  }
+
+  // Runs the loop until |count| operations have reported back.
+  void WaitFor(size_t count) {
+    while (results_.size() < count) {
+      base::RunLoop run_loop;
+      quit_closure_ = run_loop.QuitClosure();
+      run_loop.Run();
+    }
+  }
+
+  MessageLoop loop_;
+  base::ScopedTempDir tmpdir_;
+  base::FilePath path_;
+  AsyncFileIo io_;
+  std::vector<bool> results_;
+
+ private:
+  void OnStatus(bool success) {
+    results_.push_back(success);
+    quit_closure_.Run();
+  }
+
+  base::Closure quit_closure_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileIoTest);
+};
+
+TEST_F(AsyncFileIoTest, WriteAtomically) {
+  const std::string data("policy");
+  ASSERT_TRUE(AsyncFileIo::WriteFileAtomically(path_, data.data(),
+                                               data.size(),
+                                               S_IRUSR | S_IWUSR | S_IROTH));
+  std::string written;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &written));
+  EXPECT_EQ(data, written);
+
+  struct stat st;
+  ASSERT_EQ(0, stat(path_.value().c_str(), &st));
+  EXPECT_EQ(static_cast<mode_t>(S_IRUSR | S_IWUSR | S_IROTH),
+            st.st_mode & 0777);
+
+  // Nothing is left behind when the target can't be replaced.
+  base::FilePath dir = tmpdir_.path().AppendASCII("dir");
+  ASSERT_TRUE(file_util::CreateDirectory(dir.AppendASCII("child")));
+  EXPECT_FALSE(AsyncFileIo::WriteFileAtomically(dir, data.data(),
+                                                data.size(),
+                                                S_IRUSR | S_IWUSR));
+  file_util::FileEnumerator files(tmpdir_.path(), false,
+                                  file_util::FileEnumerator::FILES);
+  EXPECT_EQ(path_.value(), files.Next().value());
+  EXPECT_TRUE(files.Next().empty());
+}
+
+TEST_F(AsyncFileIoTest, OperationsOnAPathRunInOrder) {
+  io_.AtomicWrite(path_, "first", S_IRUSR | S_IWUSR, StatusCallback());
+  io_.AtomicWrite(path_, "second", S_IRUSR | S_IWUSR, StatusCallback());
+  // Other work on the path runs after the writes issued before it.
+  std::string contents;
+  io_.GetTaskRunnerForPath(path_)->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&ReadInto, path_, &contents),
+      base::Bind(StatusCallback(), true));
+  WaitFor(3);
+
+  ASSERT_EQ(3U, results_.size());
+  EXPECT_TRUE(results_[0]);
+  EXPECT_TRUE(results_[1]);
+  EXPECT_EQ("second", contents);
+
+  struct stat st;
+  ASSERT_EQ(0, stat(path_.value().c_str(), &st));
+  EXPECT_EQ(static_cast<mode_t>(S_IRUSR | S_IWUSR), st.st_mode & 0777);
+}
+
+TEST_F(AsyncFileIoTest, Failure) {
+  base::FilePath missing_dir = tmpdir_.path().AppendASCII("missing");
+  io_.AtomicWrite(missing_dir.AppendASCII("file"), "data", S_IRUSR | S_IWUSR,
+                  StatusCallback());
+  WaitFor(1);
+  EXPECT_FALSE(results_[0]);
+}
+
+}  // namespace login_manager
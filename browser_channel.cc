@@ -0,0 +1,222 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/browser_channel.h"
+
+#include <dbus/dbus-glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <base/basictypes.h>
+#include <base/logging.h>
+#include <chromeos/dbus/service_constants.h>
+
+#include "login_manager/process_manager_service_interface.h"
+
+namespace login_manager {
+
+namespace {
+
+// The methods chronos may call on the system bus, per SessionManager.conf.
+const char* const kBrowserMethods[] = {
+  "EmitLoginPromptReady",
+  "EmitLoginPromptVisible",
+  "StartSession",
+  "StopSession",
+  "LockScreen",
+  "HandleLockScreenShown",
+  "HandleLockScreenDismissed",
+  "HandleLivenessConfirmed",
+  "RestartJob",
+  "RestartJobWithAuth",
+  "StorePolicy",
+  "RetrievePolicy",
+  "StorePolicyForUser",
+  "RetrievePolicyForUser",
+  "StoreDeviceLocalAccountPolicy",
+  "RetrieveDeviceLocalAccountPolicy",
+  "RetrieveSessionState",
+  "RetrieveActiveSessions",
+  "StartDeviceWipe",
+  "SetFlagsForUser",
+};
+
+}  // namespace
+
+// static
+const char BrowserChannel::kListenAddress[] = "unix:tmpdir=/tmp";
+
+BrowserChannel::BrowserChannel(ProcessManagerServiceInterface* manager,
+                               GObject* object,
+                               const std::string& path)
+    : manager_(manager),
+      object_(object),
+      path_(path),
+      server_(NULL) {
+}
+
+BrowserChannel::~BrowserChannel() {
+  std::vector<DBusConnection*> connections;
+  connections.swap(connections_);
+  for (std::vector<DBusConnection*>::iterator it = connections.begin();
+       it != connections.end(); ++it) {
+    ::dbus_connection_close(*it);
+    ::dbus_connection_unref(*it);
+  }
+  if (server_) {
+    ::dbus_server_disconnect(server_);
+    ::dbus_server_unref(server_);
+  }
+}
+
+bool BrowserChannel::Initialize() {
+  DCHECK(!server_);
+  DBusError error;
+  ::dbus_error_init(&error);
+  server_ = ::dbus_server_listen(kListenAddress, &error);
+  if (!server_) {
+    LOG(ERROR) << "Can't listen on " << kListenAddress << ": "
+               << (error.message ? error.message : "unknown error");
+    ::dbus_error_free(&error);
+    return false;
+  }
+  // The peer is checked against the socket anyway, so there's no point in
+  // offering anything but EXTERNAL.
+  const char* mechanisms[] = { "EXTERNAL", NULL };
+  ::dbus_server_set_auth_mechanisms(server_, mechanisms);
+  ::dbus_server_set_new_connection_function(server_,
+                                            &BrowserChannel::OnNewConnection,
+                                            this,
+                                            NULL);
+  ::dbus_server_setup_with_g_main(server_, NULL);
+
+  char* address = ::dbus_server_get_address(server_);
+  address_ = address;
+  ::dbus_free(address);
+  LOG(INFO) << "Browser channel listening on " << address_;
+  return true;
+}
+
+bool BrowserChannel::IsPeerAllowed(int fd) const {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+    PLOG(ERROR) << "Can't get credentials of browser channel peer";
+    return false;
+  }
+  return manager_->IsBrowser(cred.pid);
+}
+
+// static
+bool BrowserChannel::IsMethodAllowed(const char* interface,
+                                     const char* member) {
+  if (!interface || !member ||
+      strcmp(interface, kSessionManagerInterface) != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < arraysize(kBrowserMethods); ++i) {
+    if (strcmp(member, kBrowserMethods[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+// static
+void BrowserChannel::OnNewConnection(DBusServer* server,
+                                     DBusConnection* connection,
+                                     void* data) {
+  BrowserChannel* channel = static_cast<BrowserChannel*>(data);
+  if (!channel->IsConnectionAllowed(connection)) {
+    LOG(WARNING) << "Refusing browser channel connection from a process "
+                 << "that isn't the browser";
+    // libdbus closes connections that aren't referenced here.
+    return;
+  }
+  channel->Adopt(connection);
+}
+
+// static
+dbus_bool_t BrowserChannel::AllowUnixUser(DBusConnection* connection,
+                                          unsigned long uid,
+                                          void* data) {
+  // The browser may have exited and its pid been reused since it connected.
+  return static_cast<BrowserChannel*>(data)->IsConnectionAllowed(connection);
+}
+
+// static
+DBusHandlerResult BrowserChannel::FilterMessage(DBusConnection* connection,
+                                                DBusMessage* message,
+                                                void* data) {
+  if (::dbus_message_is_signal(message, DBUS_INTERFACE_LOCAL, "Disconnected"))
+    static_cast<BrowserChannel*>(data)->Drop(connection);
+
+  if (::dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL ||
+      IsMethodAllowed(::dbus_message_get_interface(message),
+                      ::dbus_message_get_member(message))) {
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+  const char* member = ::dbus_message_get_member(message);
+  LOG(WARNING) << "Refusing call to " << (member ? member : "(none)")
+               << " over browser channel";
+  if (!::dbus_message_get_no_reply(message)) {
+    DBusMessage* reply = ::dbus_message_new_error(
+        message, DBUS_ERROR_ACCESS_DENIED,
+        "Method not allowed over browser channel");
+    if (reply) {
+      ::dbus_connection_send(connection, reply, NULL);
+      ::dbus_message_unref(reply);
+    }
+  }
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+bool BrowserChannel::IsConnectionAllowed(DBusConnection* connection) const {
+  int fd = -1;
+  if (!::dbus_connection_get_unix_fd(connection, &fd))
+    return false;
+  return IsPeerAllowed(fd);
+}
+
+void BrowserChannel::Adopt(DBusConnection* connection) {
+  ::dbus_connection_ref(connection);
+  ::dbus_connection_set_exit_on_disconnect(connection, FALSE);
+  ::dbus_connection_set_unix_user_function(connection,
+                                           &BrowserChannel::AllowUnixUser,
+                                           this,
+                                           NULL);
+  if (!::dbus_connection_add_filter(connection,
+                                    &BrowserChannel::FilterMessage,
+                                    this,
+                                    NULL)) {
+    LOG(WARNING) << "Failed to add filter to browser channel connection";
+    ::dbus_connection_close(connection);
+    ::dbus_connection_unref(connection);
+    return;
+  }
+  ::dbus_connection_setup_with_g_main(connection, NULL);
+  ::dbus_g_connection_register_g_object(
+      ::dbus_connection_get_g_connection(connection), path_.c_str(), object_);
+  connections_.push_back(connection);
+  DLOG(INFO) << "Browser connected to browser channel";
+}
+
+void BrowserChannel::Drop(DBusConnection* connection) {
+  std::vector<DBusConnection*>::iterator it =
+      std::find(connections_.begin(), connections_.end(), connection);
+  if (it == connections_.end())
+    return;
+  connections_.erase(it);
+  ::dbus_connection_remove_filter(connection,
+                                  &BrowserChannel::FilterMessage,
+                                  this);
+  ::dbus_connection_unref(connection);
+  DLOG(INFO) << "Browser disconnected from browser channel";
+}
+
+}  // namespace login_manager
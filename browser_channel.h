@@ -0,0 +1,101 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_BROWSER_CHANNEL_H_
+#define LOGIN_MANAGER_BROWSER_CHANNEL_H_
+
+#include <dbus/dbus.h>
+#include <glib-object.h>
+
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+
+namespace login_manager {
+
+class ProcessManagerServiceInterface;
+
+// A private D-Bus server that the browser talks to session_manager through
+// directly, rather than through dbus-daemon. The address is handed to the
+// browser when it's started (see ChildJob::SetSessionManagerAddress()), and
+// the same object that's exported on the system bus is exported on every
+// connection the browser makes, so the method table is shared.
+//
+// Only the browser may connect: the peer's credentials are read from the
+// socket (SO_PEERCRED) when it connects and when it authenticates, and the
+// connection is dropped unless the peer is the browser. Since there's no
+// dbus-daemon to apply SessionManager.conf here, calls to methods that the
+// browser's user can't make on the system bus are refused with AccessDenied.
+// Signals still go out on the system bus only.
+class BrowserChannel {
+ public:
+  // |manager| is used to tell whether a peer is the browser. |object| is
+  // exported at |path| on each connection. Both are owned by the caller and
+  // must outlive this.
+  BrowserChannel(ProcessManagerServiceInterface* manager,
+                 GObject* object,
+                 const std::string& path);
+  ~BrowserChannel();
+
+  // Starts listening. Returns false if that fails, in which case the browser
+  // should be left to use the system bus.
+  bool Initialize();
+
+  // The address to hand to the browser. Empty if not initialized.
+  const std::string& address() const { return address_; }
+
+  // Returns true if the process on the other end of the socket |fd| is the
+  // browser.
+  bool IsPeerAllowed(int fd) const;
+
+  int connection_count() const { return connections_.size(); }
+
+  // Returns true if the browser may call |member| of |interface| over the
+  // channel. Mirrors the chronos policy in SessionManager.conf; keep the two
+  // in sync.
+  static bool IsMethodAllowed(const char* interface, const char* member);
+
+  // Where the server listens. On Linux this makes an abstract socket.
+  static const char kListenAddress[];
+
+ private:
+  // Called by libdbus for every incoming connection.
+  static void OnNewConnection(DBusServer* server,
+                              DBusConnection* connection,
+                              void* data);
+
+  // Called by libdbus while |connection| authenticates as |uid|.
+  static dbus_bool_t AllowUnixUser(DBusConnection* connection,
+                                   unsigned long uid,
+                                   void* data);
+
+  // Drops connections once they're disconnected, and refuses method calls
+  // that IsMethodAllowed() doesn't let through.
+  static DBusHandlerResult FilterMessage(DBusConnection* connection,
+                                         DBusMessage* message,
+                                         void* data);
+
+  // Returns true if the peer of |connection| is the browser.
+  bool IsConnectionAllowed(DBusConnection* connection) const;
+
+  // Exports |object_| on |connection| and starts tracking it.
+  void Adopt(DBusConnection* connection);
+
+  // Stops tracking |connection| and releases our reference to it.
+  void Drop(DBusConnection* connection);
+
+  ProcessManagerServiceInterface* manager_;  // Owned by the caller.
+  GObject* object_;  // Owned by the caller.
+  const std::string path_;
+  DBusServer* server_;
+  std::string address_;
+  std::vector<DBusConnection*> connections_;
+
+  DISALLOW_COPY_AND_ASSIGN(BrowserChannel);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_BROWSER_CHANNEL_H_
@@ -0,0 +1,168 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/browser_channel.h"
+
+#include <dbus/dbus-glib-lowlevel.h>
+#include <dbus/dbus.h>
+#include <glib-object.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/string_util.h>
+#include <chromeos/dbus/service_constants.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_process_manager_service.h"
+
+using ::testing::Return;
+using ::testing::StrictMock;
+
+namespace {
+const char kPath[] = "/test";
+}  // namespace
+
+namespace login_manager {
+
+class BrowserChannelTest : public ::testing::Test {
+ public:
+  BrowserChannelTest() : channel_(&manager_, NULL, kPath) {}
+  virtual ~BrowserChannelTest() {}
+
+  virtual void SetUp() {
+    // The peer of either end of a socketpair is this process.
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+  }
+
+  virtual void TearDown() {
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+ protected:
+  // Connects to |channel|, which must be initialized, calls |member| of
+  // |interface| and returns the name of the error that the call fails with,
+  // or an empty string if it succeeds.
+  std::string Call(BrowserChannel* channel,
+                   const char* interface,
+                   const char* member) {
+    DBusError error;
+    dbus_error_init(&error);
+    DBusConnection* connection =
+        dbus_connection_open_private(channel->address().c_str(), &error);
+    if (!connection) {
+      ADD_FAILURE() << "Can't connect: " << error.message;
+      dbus_error_free(&error);
+      return "";
+    }
+    dbus_connection_setup_with_g_main(connection, NULL);
+
+    DBusMessage* call =
+        dbus_message_new_method_call(NULL, kPath, interface, member);
+    DBusPendingCall* pending = NULL;
+    EXPECT_TRUE(dbus_connection_send_with_reply(connection, call, &pending,
+                                                -1));
+    dbus_message_unref(call);
+    std::string result;
+    if (pending) {
+      // Both ends of the connection are serviced by the default main loop.
+      while (!dbus_pending_call_get_completed(pending))
+        g_main_context_iteration(NULL, TRUE);
+      DBusMessage* reply = dbus_pending_call_steal_reply(pending);
+      if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+        result = dbus_message_get_error_name(reply);
+      dbus_message_unref(reply);
+      dbus_pending_call_unref(pending);
+    }
+    dbus_connection_close(connection);
+    dbus_connection_unref(connection);
+    return result;
+  }
+
+  StrictMock<MockProcessManagerService> manager_;
+  BrowserChannel channel_;
+  int fds_[2];
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BrowserChannelTest);
+};
+
+TEST_F(BrowserChannelTest, PeerIsBrowser) {
+  EXPECT_CALL(manager_, IsBrowser(getpid())).WillOnce(Return(true));
+  EXPECT_TRUE(channel_.IsPeerAllowed(fds_[0]));
+}
+
+TEST_F(BrowserChannelTest, PeerIsNotBrowser) {
+  EXPECT_CALL(manager_, IsBrowser(getpid())).WillOnce(Return(false));
+  EXPECT_FALSE(channel_.IsPeerAllowed(fds_[0]));
+}
+
+TEST_F(BrowserChannelTest, NotASocket) {
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+  EXPECT_FALSE(channel_.IsPeerAllowed(pipe_fds[0]));
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+TEST_F(BrowserChannelTest, Initialize) {
+  EXPECT_TRUE(channel_.address().empty());
+  ASSERT_TRUE(channel_.Initialize());
+  EXPECT_TRUE(StartsWithASCII(channel_.address(), "unix:", true));
+  EXPECT_EQ(0, channel_.connection_count());
+}
+
+TEST_F(BrowserChannelTest, IsMethodAllowed) {
+  EXPECT_TRUE(BrowserChannel::IsMethodAllowed(kSessionManagerInterface,
+                                              "StorePolicy"));
+  EXPECT_TRUE(BrowserChannel::IsMethodAllowed(kSessionManagerInterface,
+                                              "StartSession"));
+  EXPECT_FALSE(BrowserChannel::IsMethodAllowed(kSessionManagerInterface,
+                                               "SetTunable"));
+  EXPECT_FALSE(BrowserChannel::IsMethodAllowed(kSessionManagerInterface,
+                                               "StartProfiling"));
+  EXPECT_FALSE(BrowserChannel::IsMethodAllowed("org.example.Other",
+                                               "StorePolicy"));
+  EXPECT_FALSE(BrowserChannel::IsMethodAllowed(NULL, "StorePolicy"));
+  EXPECT_FALSE(BrowserChannel::IsMethodAllowed(kSessionManagerInterface,
+                                               NULL));
+}
+
+TEST_F(BrowserChannelTest, CallsThroughChannel) {
+  EXPECT_CALL(manager_, IsBrowser(getpid())).WillRepeatedly(Return(true));
+  // The object has no D-Bus methods, so calls that get through to it fail
+  // with UnknownMethod rather than AccessDenied.
+  GObject* object = static_cast<GObject*>(g_object_new(G_TYPE_OBJECT, NULL));
+  {
+    BrowserChannel channel(&manager_, object, kPath);
+    ASSERT_TRUE(channel.Initialize());
+
+    EXPECT_EQ(DBUS_ERROR_UNKNOWN_METHOD,
+              Call(&channel, kSessionManagerInterface, "RetrievePolicy"));
+    EXPECT_EQ(DBUS_ERROR_UNKNOWN_METHOD,
+              Call(&channel, kSessionManagerInterface, "StartSession"));
+
+    const char* kRootOnly[] = {
+      "SetTunable",
+      "RetrievePolicyStats",
+      "GetMemoryStats",
+      "StartProfiling",
+      "WatchDeviceSettings",
+      "UnwatchDeviceSettings",
+    };
+    for (size_t i = 0; i < arraysize(kRootOnly); ++i) {
+      EXPECT_EQ(DBUS_ERROR_ACCESS_DENIED,
+                Call(&channel, kSessionManagerInterface, kRootOnly[i]))
+          << kRootOnly[i];
+    }
+    EXPECT_EQ(DBUS_ERROR_ACCESS_DENIED,
+              Call(&channel, DBUS_INTERFACE_INTROSPECTABLE, "Introspect"));
+  }
+  g_object_unref(object);
+}
+
+}  // namespace login_manager
@@ -0,0 +1,134 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/browser_heartbeat.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace login_manager {
+
+// static
+const uint32 BrowserHeartbeat::kMagic = 0x48425254;  // "HBRT"
+// static
+const uint32 BrowserHeartbeat::kVersion = 1;
+
+// The page is shared with another process, so atomics on it have to be done
+// by the CPU rather than by libatomic's process-local locks.
+COMPILE_ASSERT(__atomic_always_lock_free(sizeof(uint64), 0),
+               heartbeat_needs_lock_free_64bit_atomics);
+
+namespace {
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+const char kMemfdName[] = "browser-heartbeat";
+const char kShmTemplate[] = "/dev/shm/browser-heartbeat.XXXXXX";
+
+// Returns a close-on-exec descriptor for an anonymous file, preferring
+// memfd_create() and falling back to an unlinked file on /dev/shm on
+// kernels that don't have it.
+int CreateAnonymousFile() {
+#if defined(__NR_memfd_create)
+  int fd = syscall(__NR_memfd_create, kMemfdName, MFD_CLOEXEC);
+  if (fd >= 0)
+    return fd;
+  PLOG(INFO) << "memfd_create() failed, falling back to /dev/shm";
+#endif
+  char path[sizeof(kShmTemplate)];
+  memcpy(path, kShmTemplate, sizeof(kShmTemplate));
+  int shm_fd = mkstemp(path);
+  if (shm_fd < 0) {
+    PLOG(ERROR) << "Can't create " << path;
+    return -1;
+  }
+  unlink(path);
+  if (fcntl(shm_fd, F_SETFD, FD_CLOEXEC) < 0)
+    PLOG(WARNING) << "Can't set FD_CLOEXEC on " << path;
+  return shm_fd;
+}
+
+}  // namespace
+
+BrowserHeartbeat::BrowserHeartbeat() : fd_(-1), page_(NULL) {
+}
+
+BrowserHeartbeat::~BrowserHeartbeat() {
+  if (page_)
+    munmap(page_, sizeof(*page_));
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool BrowserHeartbeat::Initialize() {
+  DCHECK_LT(fd_, 0);
+  int fd = CreateAnonymousFile();
+  if (fd < 0)
+    return false;
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (HANDLE_EINTR(ftruncate(fd, page_size)) != 0) {
+    PLOG(ERROR) << "Can't size heartbeat page";
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(NULL, sizeof(Page), PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Can't map heartbeat page";
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+  page_ = static_cast<Page*>(mapping);
+  page_->magic = kMagic;
+  page_->version = kVersion;
+  Reset();
+  return true;
+}
+
+void BrowserHeartbeat::Reset() {
+  if (!page_)
+    return;
+  __atomic_store_n(&page_->beats, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&page_->last_beat_us, 0, __ATOMIC_RELEASE);
+}
+
+bool BrowserHeartbeat::HasBeaten() const {
+  // Pairs with the browser storing the timestamp before bumping the count.
+  return page_ && __atomic_load_n(&page_->beats, __ATOMIC_ACQUIRE) != 0;
+}
+
+base::TimeDelta BrowserHeartbeat::GetStaleness() const {
+  if (!HasBeaten())
+    return base::TimeDelta();
+  const int64 last_beat_us =
+      __atomic_load_n(&page_->last_beat_us, __ATOMIC_RELAXED);
+  return base::TimeDelta::FromMicroseconds(NowMicroseconds() - last_beat_us);
+}
+
+void BrowserHeartbeat::BeatForTesting() {
+  DCHECK(page_);
+  __atomic_store_n(&page_->last_beat_us, NowMicroseconds(), __ATOMIC_RELAXED);
+  __atomic_fetch_add(&page_->beats, 1, __ATOMIC_RELEASE);
+}
+
+// static
+int64 BrowserHeartbeat::NowMicroseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64>(ts.tv_sec) * base::Time::kMicrosecondsPerSecond +
+      ts.tv_nsec / base::Time::kNanosecondsPerMicrosecond;
+}
+
+}  // namespace login_manager
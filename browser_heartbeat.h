@@ -0,0 +1,74 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_BROWSER_HEARTBEAT_H_
+#define LOGIN_MANAGER_BROWSER_HEARTBEAT_H_
+
+#include <base/basictypes.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+// A page of shared memory that the browser's UI thread writes a heartbeat
+// to. The page is backed by an anonymous file whose descriptor the browser
+// inherits (see ChildJob::SetHeartbeatFd()), so checking whether the browser
+// is alive is a memory read rather than a D-Bus round trip.
+//
+// The browser is expected to verify |magic| and |version|, and then, from
+// its UI thread, store CLOCK_MONOTONIC in |last_beat_us| and increment
+// |beats|, in that order. Both fields are naturally aligned 64-bit words that
+// must only be accessed atomically, e.g. with __atomic_load_n() and
+// __atomic_store_n(), so that 32-bit readers never see half of an update:
+// - |last_beat_us| is stored with at least relaxed ordering, and then
+//   |beats| with release ordering.
+// - Readers load |beats| with acquire ordering before |last_beat_us|, so a
+//   nonzero count guarantees a timestamp at least as new as that beat.
+class BrowserHeartbeat {
+ public:
+  struct Page {
+    uint32 magic;
+    uint32 version;
+    uint64 beats;
+    int64 last_beat_us;
+  };
+
+  BrowserHeartbeat();
+  virtual ~BrowserHeartbeat();
+
+  // Creates and maps the shared page. Returns false if that fails, in which
+  // case the heartbeat can't be used.
+  bool Initialize();
+
+  // The descriptor to hand to the browser, or -1 if not initialized.
+  int fd() const { return fd_; }
+
+  // Forgets beats recorded so far, e.g. by a previous browser.
+  virtual void Reset();
+
+  // Returns true if the browser has beaten since the last Reset().
+  virtual bool HasBeaten() const;
+
+  // Returns how long ago the browser last beat. Only meaningful if
+  // HasBeaten().
+  virtual base::TimeDelta GetStaleness() const;
+
+  // Records a beat the way the browser would.
+  void BeatForTesting();
+
+  static const uint32 kMagic;
+  static const uint32 kVersion;
+
+ private:
+  // Returns CLOCK_MONOTONIC in microseconds.
+  static int64 NowMicroseconds();
+
+  int fd_;
+  Page* page_;
+
+  DISALLOW_COPY_AND_ASSIGN(BrowserHeartbeat);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_BROWSER_HEARTBEAT_H_
@@ -0,0 +1,64 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/browser_heartbeat.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <base/time.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+TEST(BrowserHeartbeatTest, Uninitialized) {
+  BrowserHeartbeat heartbeat;
+  EXPECT_EQ(-1, heartbeat.fd());
+  EXPECT_FALSE(heartbeat.HasBeaten());
+  heartbeat.Reset();  // Must not crash.
+}
+
+TEST(BrowserHeartbeatTest, BeatAndReset) {
+  BrowserHeartbeat heartbeat;
+  ASSERT_TRUE(heartbeat.Initialize());
+  ASSERT_GE(heartbeat.fd(), 0);
+  // Only the browser should get the descriptor, and only deliberately.
+  EXPECT_TRUE(fcntl(heartbeat.fd(), F_GETFD) & FD_CLOEXEC);
+  EXPECT_FALSE(heartbeat.HasBeaten());
+
+  heartbeat.BeatForTesting();
+  EXPECT_TRUE(heartbeat.HasBeaten());
+  EXPECT_GE(heartbeat.GetStaleness(), base::TimeDelta());
+  EXPECT_LT(heartbeat.GetStaleness(), base::TimeDelta::FromSeconds(10));
+
+  heartbeat.Reset();
+  EXPECT_FALSE(heartbeat.HasBeaten());
+}
+
+TEST(BrowserHeartbeatTest, SharedWithBrowser) {
+  BrowserHeartbeat heartbeat;
+  ASSERT_TRUE(heartbeat.Initialize());
+
+  // Map the page the way the browser would.
+  void* mapping = mmap(NULL, sizeof(BrowserHeartbeat::Page),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, heartbeat.fd(), 0);
+  ASSERT_NE(MAP_FAILED, mapping);
+  BrowserHeartbeat::Page* page = static_cast<BrowserHeartbeat::Page*>(mapping);
+  EXPECT_EQ(BrowserHeartbeat::kMagic, page->magic);
+  EXPECT_EQ(BrowserHeartbeat::kVersion, page->version);
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  const int64 last_beat_us = static_cast<int64>(ts.tv_sec - 5) *
+      base::Time::kMicrosecondsPerSecond;
+  __atomic_store_n(&page->last_beat_us, last_beat_us, __ATOMIC_RELAXED);
+  __atomic_store_n(&page->beats, 1, __ATOMIC_RELEASE);
+  EXPECT_TRUE(heartbeat.HasBeaten());
+  EXPECT_GE(heartbeat.GetStaleness(), base::TimeDelta::FromSeconds(5));
+
+  munmap(mapping, sizeof(BrowserHeartbeat::Page));
+}
+
+}  // namespace login_manager
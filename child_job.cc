@@ -7,6 +7,7 @@
 #include "login_manager/child_job.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <grp.h>
 #include <pwd.h>
@@ -16,14 +17,13 @@
 #include <unistd.h>
 
 #include <algorithm>
-#include <deque>
 #include <string>
-#include <queue>
 #include <vector>
 
 #include <base/basictypes.h>
 #include <base/file_path.h>
 #include <base/logging.h>
+#include <base/string_number_conversions.h>
 
 #include "login_manager/system_utils.h"
 
@@ -42,20 +42,20 @@ const char ChildJob::kLoginUserFlag[] = "--login-user=";
 const char ChildJob::kLoginProfileFlag[] = "--login-profile=";
 // static
 const char ChildJob::kMultiProfileFlag[] = "--multi-profiles";
-
 // static
-const uint ChildJob::kRestartTries = 4;
+const char ChildJob::kHeartbeatFdFlag[] = "--session-manager-heartbeat-fd=";
 // static
-const time_t ChildJob::kRestartWindowSeconds = 60;
+const char ChildJob::kSessionManagerAddressFlag[] =
+    "--session-manager-address=";
 
 ChildJob::ChildJob(const std::vector<std::string>& arguments,
                    bool support_multi_profile,
                    SystemUtils* utils)
       : arguments_(arguments),
+        heartbeat_fd_(-1),
         desired_uid_(0),
         is_desired_uid_set_(false),
         system(utils),
-        start_times_(std::deque<time_t>(kRestartTries, 0)),
         removed_login_manager_flag_(false),
         session_already_started_(false),
         support_multi_profile_(support_multi_profile) {
@@ -76,16 +76,6 @@ ChildJob::ChildJob(const std::vector<std::string>& arguments,
 ChildJob::~ChildJob() {
 }
 
-bool ChildJob::ShouldStop() const {
-  return (system->time(NULL) - start_times_.front() < kRestartWindowSeconds);
-}
-
-void ChildJob::RecordTime() {
-  start_times_.push(system->time(NULL));
-  start_times_.pop();
-  DCHECK(start_times_.size() == kRestartTries);
-}
-
 void ChildJob::Run() {
   // We try to set our UID/GID to the desired UID, and then exec
   // the command passed in.
@@ -93,6 +83,13 @@ void ChildJob::Run() {
   if (exit_code)
     exit(exit_code);
 
+  // The heartbeat descriptor is close-on-exec so that no other child gets it.
+  if (heartbeat_fd_ >= 0) {
+    int flags = fcntl(heartbeat_fd_, F_GETFD);
+    if (flags < 0 || fcntl(heartbeat_fd_, F_SETFD, flags & ~FD_CLOEXEC) < 0)
+      PLOG(WARNING) << "Can't pass heartbeat descriptor to the browser";
+  }
+
   logging::CloseLogFile();  // So child does not inherit logging FD.
 
   char const** argv = CreateArgv();
@@ -181,6 +178,14 @@ void ChildJob::ClearOneTimeArguments() {
   extra_one_time_arguments_.clear();
 }
 
+void ChildJob::SetHeartbeatFd(int fd) {
+  heartbeat_fd_ = fd;
+}
+
+void ChildJob::SetSessionManagerAddress(const std::string& address) {
+  session_manager_address_ = address;
+}
+
 std::vector<std::string> ChildJob::ExportArgv() {
   std::vector<std::string> to_return;
   char const** argv = CreateArgv();
@@ -204,9 +209,19 @@ size_t ChildJob::CopyArgsToArgv(const std::vector<std::string>& arguments,
 }
 
 char const** ChildJob::CreateArgv() const {
+  std::vector<std::string> session_manager_arguments;
+  if (heartbeat_fd_ >= 0) {
+    session_manager_arguments.push_back(kHeartbeatFdFlag +
+                                        base::IntToString(heartbeat_fd_));
+  }
+  if (!session_manager_address_.empty()) {
+    session_manager_arguments.push_back(kSessionManagerAddressFlag +
+                                        session_manager_address_);
+  }
   size_t total_size = (arguments_.size() +
                        login_arguments_.size() +
-                       extra_arguments_.size());
+                       extra_arguments_.size() +
+                       session_manager_arguments.size());
   if (!extra_one_time_arguments_.empty())
     total_size += extra_one_time_arguments_.size();
 
@@ -214,6 +229,7 @@ char const** ChildJob::CreateArgv() const {
   size_t index = CopyArgsToArgv(arguments_, argv);
   index += CopyArgsToArgv(login_arguments_, argv + index);
   index += CopyArgsToArgv(extra_arguments_, argv + index);
+  index += CopyArgsToArgv(session_manager_arguments, argv + index);
   if (!extra_one_time_arguments_.empty())
     index += CopyArgsToArgv(extra_one_time_arguments_, argv + index);
   // Need to append NULL at the end.
@@ -11,7 +11,6 @@
 #include <unistd.h>
 
 #include <string>
-#include <queue>
 #include <vector>
 
 #include <base/basictypes.h>
@@ -28,13 +27,6 @@ class ChildJobInterface {
  public:
   virtual ~ChildJobInterface() {}
 
-  // If ShouldStop() returns true, this means that the parent should tear
-  // everything down.
-  virtual bool ShouldStop() const = 0;
-
-  // Stores the current time as the time when the job was started.
-  virtual void RecordTime() = 0;
-
   // Wraps up all the logic of what the job is meant to do. Should NOT return.
   virtual void Run() = 0;
 
@@ -72,6 +64,14 @@ class ChildJobInterface {
   // Clears arguments previously passed to SetOneTimeArguments().
   virtual void ClearOneTimeArguments() = 0;
 
+  // Makes the job inherit |fd| and tells it to beat on it (see
+  // BrowserHeartbeat). -1 means no heartbeat.
+  virtual void SetHeartbeatFd(int fd) = 0;
+
+  // Tells the job to reach session_manager at |address| (see BrowserChannel)
+  // rather than through the system bus. Empty means the system bus.
+  virtual void SetSessionManagerAddress(const std::string& address) = 0;
+
   // Potential exit codes for Run().
   static const int kCantSetUid;
   static const int kCantSetGid;
@@ -101,8 +101,6 @@ class ChildJob : public ChildJobInterface {
   virtual ~ChildJob();
 
   // Overridden from ChildJobInterface
-  virtual bool ShouldStop() const OVERRIDE;
-  virtual void RecordTime() OVERRIDE;
   virtual void Run() OVERRIDE;
   virtual void StartSession(const std::string& email,
                             const std::string& userhash) OVERRIDE;
@@ -117,6 +115,8 @@ class ChildJob : public ChildJobInterface {
   virtual void SetOneTimeArguments(
       const std::vector<std::string>& arguments) OVERRIDE;
   virtual void ClearOneTimeArguments() OVERRIDE;
+  virtual void SetHeartbeatFd(int fd) OVERRIDE;
+  virtual void SetSessionManagerAddress(const std::string& address) OVERRIDE;
 
   // Export a copy of the current argv.
   std::vector<std::string> ExportArgv();
@@ -134,10 +134,12 @@ class ChildJob : public ChildJobInterface {
   // sessions.
   static const char kMultiProfileFlag[];
 
-  // After kRestartTries in kRestartWindowSeconds, the ChildJob will indicate
-  // that it should be stopped.
-  static const uint kRestartTries;
-  static const time_t kRestartWindowSeconds;
+  // The flag to pass to chrome to tell it which descriptor to beat on.
+  static const char kHeartbeatFdFlag[];
+
+  // The flag to pass to chrome to tell it where to reach session_manager
+  // directly.
+  static const char kSessionManagerAddressFlag[];
 
  private:
   // Helper for CreateArgV() that copies a vector of arguments into argv.
@@ -168,6 +170,12 @@ class ChildJob : public ChildJobInterface {
   // Extra one time arguments.
   std::vector<std::string> extra_one_time_arguments_;
 
+  // Descriptor the job should beat on, or -1.
+  int heartbeat_fd_;
+
+  // Private D-Bus address of session_manager, or empty.
+  std::string session_manager_address_;
+
   // UID to set for job's process before exec is called.
   uid_t desired_uid_;
 
@@ -177,10 +185,6 @@ class ChildJob : public ChildJobInterface {
   // Wrapper for system library calls.  Owned by the owner of this object.
   SystemUtils* system;
 
-  // FIFO of job-start timestamps. Used to determine if we've restarted too many
-  // times too quickly.
-  std::queue<time_t> start_times_;
-
   // Indicates if we removed login manager flag when session started so we
   // add it back when session stops.
   bool removed_login_manager_flag_;
@@ -196,8 +200,6 @@ class ChildJob : public ChildJobInterface {
   bool support_multi_profile_;
 
   FRIEND_TEST(ChildJobTest, InitializationTest);
-  FRIEND_TEST(ChildJobTest, ShouldStopTest);
-  FRIEND_TEST(ChildJobTest, ShouldNotStopTest);
   FRIEND_TEST(ChildJobTest, CreateArgv);
   DISALLOW_COPY_AND_ASSIGN(ChildJob);
 };
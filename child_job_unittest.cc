@@ -22,7 +22,6 @@
 
 namespace login_manager {
 
-using ::testing::Return;
 using ::testing::_;
 
 class ChildJobTest : public ::testing::Test {
@@ -98,28 +97,6 @@ TEST_F(ChildJobTest, DesiredUidSetTest) {
   EXPECT_TRUE(job_->IsDesiredUidSet());
 }
 
-TEST_F(ChildJobTest, ShouldStopTest) {
-  EXPECT_CALL(utils_, time(NULL))
-      .WillRepeatedly(Return(ChildJob::kRestartWindowSeconds));
-  for (uint i = 0; i < ChildJob::kRestartTries - 1; ++i)
-    job_->RecordTime();
-  // We haven't yet saturated the list of start times, so...
-  EXPECT_FALSE(job_->ShouldStop());
-
-  // Go ahead and saturate.
-  job_->RecordTime();
-  EXPECT_NE(0, job_->start_times_.front());
-  EXPECT_TRUE(job_->ShouldStop());
-}
-
-TEST_F(ChildJobTest, ShouldNotStopTest) {
-  EXPECT_CALL(utils_, time(NULL))
-      .WillOnce(Return(ChildJob::kRestartWindowSeconds))
-      .WillOnce(Return(3 * ChildJob::kRestartWindowSeconds));
-  job_->RecordTime();
-  EXPECT_FALSE(job_->ShouldStop());
-}
-
 TEST_F(ChildJobTest, StartStopSessionTest) {
   job_->StartSession(kUser, kHash);
 
@@ -233,6 +210,30 @@ TEST_F(ChildJobTest, SetExtraOneTimeArguments) {
     ExpectArgsToContainFlag(job_args, arguments[i].c_str(), "");
 }
 
+TEST_F(ChildJobTest, SetHeartbeatFd) {
+  job_->SetHeartbeatFd(7);
+  std::vector<std::string> job_args = job_->ExportArgv();
+  ASSERT_EQ(argv_.size() + 1, job_args.size());
+  ExpectArgsToContainAll(job_args, argv_);
+  ExpectArgsToContainFlag(job_args, ChildJob::kHeartbeatFdFlag, "7");
+
+  job_->SetHeartbeatFd(-1);
+  EXPECT_EQ(argv_.size(), job_->ExportArgv().size());
+}
+
+TEST_F(ChildJobTest, SetSessionManagerAddress) {
+  const char kAddress[] = "unix:abstract=/tmp/dbus-XYZ,guid=0123";
+  job_->SetSessionManagerAddress(kAddress);
+  std::vector<std::string> job_args = job_->ExportArgv();
+  ASSERT_EQ(argv_.size() + 1, job_args.size());
+  ExpectArgsToContainAll(job_args, argv_);
+  ExpectArgsToContainFlag(job_args, ChildJob::kSessionManagerAddressFlag,
+                          kAddress);
+
+  job_->SetSessionManagerAddress("");
+  EXPECT_EQ(argv_.size(), job_->ExportArgv().size());
+}
+
 TEST_F(ChildJobTest, CreateArgv) {
   std::vector<std::string> argv(kArgv, kArgv + arraysize(kArgv));
   ChildJob job(argv, false, &utils_);
@@ -0,0 +1,366 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/child_output_logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/stringprintf.h>
+
+namespace login_manager {
+
+// static
+const char ChildOutputLogger::kLogDir[] = "/var/log/ui";
+
+namespace {
+
+const char* kStreamNames[] = { "out", "err" };
+const char kOldLogSuffix[] = ".old";
+
+// Upper bound on how much is read from a pipe per main loop iteration, so a
+// chatty child can't starve everything else.
+const size_t kMaxReadPerWakeup = 64 * 1024;
+
+}  // namespace
+
+ChildOutputLogger::Config::Config()
+    : max_file_bytes(512 * 1024),
+      lines_per_second(50),
+      burst_lines(200),
+      tail_bytes(32 * 1024),
+      max_line_bytes(4096) {
+}
+
+ChildOutputLogger::Pipe::Pipe()
+    : owner(NULL),
+      stream(STDOUT),
+      read_fd(-1),
+      write_fd(-1),
+      watch(0) {
+}
+
+ChildOutputLogger::ChildOutputLogger(const std::string& name,
+                                     const base::FilePath& log_file,
+                                     const Config& config)
+    : name_(name),
+      log_file_(log_file),
+      config_(config),
+      log_fd_(-1),
+      log_size_(0),
+      tokens_(config.burst_lines),
+      lines_written_(0),
+      pending_lines_dropped_(0),
+      total_lines_dropped_(0) {
+  wakeup_fds_[0] = wakeup_fds_[1] = -1;
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    pipes_[i].owner = this;
+    pipes_[i].stream = static_cast<Stream>(i);
+  }
+}
+
+ChildOutputLogger::~ChildOutputLogger() {
+  StopBackgroundDrain();
+  for (int i = 0; i < NUM_STREAMS; ++i)
+    ClosePipe(&pipes_[i]);
+  if (log_fd_ >= 0)
+    close(log_fd_);
+}
+
+bool ChildOutputLogger::CreatePipes() {
+  StopWatching();
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+      PLOG(ERROR) << "Can't create pipe for " << name_;
+      for (int j = 0; j < i; ++j) {
+        close(pipes_[j].read_fd);
+        close(pipes_[j].write_fd);
+        pipes_[j].read_fd = pipes_[j].write_fd = -1;
+      }
+      return false;
+    }
+    pipes_[i].read_fd = fds[0];
+    pipes_[i].write_fd = fds[1];
+  }
+  return true;
+}
+
+void ChildOutputLogger::AttachToChild() {
+  const int targets[NUM_STREAMS] = { STDOUT_FILENO, STDERR_FILENO };
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    if (pipes_[i].write_fd < 0)
+      continue;
+    // dup2() clears FD_CLOEXEC on the new descriptor; the originals are
+    // close-on-exec and go away with the exec.
+    HANDLE_EINTR(dup2(pipes_[i].write_fd, targets[i]));
+  }
+}
+
+void ChildOutputLogger::StartWatching() {
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    Pipe* pipe = &pipes_[i];
+    if (pipe->read_fd < 0)
+      continue;
+    close(pipe->write_fd);
+    pipe->write_fd = -1;
+
+    int flags = fcntl(pipe->read_fd, F_GETFL);
+    if (flags < 0 || fcntl(pipe->read_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+      PLOG(WARNING) << "Can't make " << name_ << " output non-blocking";
+
+    GIOChannel* channel = g_io_channel_unix_new(pipe->read_fd);
+    g_io_channel_set_close_on_unref(channel, FALSE);
+    pipe->watch = g_io_add_watch(channel,
+                                 GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                                 HandleReadable,
+                                 pipe);
+    g_io_channel_unref(channel);  // The watch holds a reference.
+  }
+}
+
+void ChildOutputLogger::StopWatching() {
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    Pipe* pipe = &pipes_[i];
+    if (pipe->read_fd >= 0 && pipe->write_fd < 0)
+      Drain(pipe);
+    ClosePipe(pipe);
+  }
+}
+
+void ChildOutputLogger::StartBackgroundDrain() {
+  DCHECK(!drain_thread_.get());
+  if (pipe2(wakeup_fds_, O_CLOEXEC) != 0) {
+    PLOG(ERROR) << "Can't drain " << name_ << " output in the background";
+    wakeup_fds_[0] = wakeup_fds_[1] = -1;
+    return;
+  }
+  // The thread reads the pipes from now on; the main loop must not.
+  for (int i = 0; i < NUM_STREAMS; ++i) {
+    if (pipes_[i].watch) {
+      g_source_remove(pipes_[i].watch);
+      pipes_[i].watch = 0;
+    }
+  }
+  drain_thread_.reset(
+      new base::DelegateSimpleThread(this, name_ + "OutputDrain"));
+  drain_thread_->Start();
+}
+
+void ChildOutputLogger::StopBackgroundDrain() {
+  if (!drain_thread_.get())
+    return;
+  if (HANDLE_EINTR(write(wakeup_fds_[1], "", 1)) != 1)
+    PLOG(ERROR) << "Can't stop draining " << name_ << " output";
+  drain_thread_->Join();
+  drain_thread_.reset();
+  close(wakeup_fds_[0]);
+  close(wakeup_fds_[1]);
+  wakeup_fds_[0] = wakeup_fds_[1] = -1;
+}
+
+void ChildOutputLogger::Run() {
+  // Pipes are only read while the child may still write to them.
+  bool open[NUM_STREAMS];
+  for (int i = 0; i < NUM_STREAMS; ++i)
+    open[i] = pipes_[i].read_fd >= 0 && pipes_[i].write_fd < 0;
+
+  while (true) {
+    struct pollfd fds[NUM_STREAMS + 1];
+    Pipe* polled[NUM_STREAMS + 1];
+    nfds_t count = 0;
+    fds[count].fd = wakeup_fds_[0];
+    fds[count].events = POLLIN;
+    polled[count++] = NULL;
+    for (int i = 0; i < NUM_STREAMS; ++i) {
+      if (!open[i])
+        continue;
+      fds[count].fd = pipes_[i].read_fd;
+      fds[count].events = POLLIN;
+      polled[count++] = &pipes_[i];
+    }
+    if (HANDLE_EINTR(poll(fds, count, -1)) < 0) {
+      PLOG(ERROR) << "Can't wait for " << name_ << " output";
+      return;
+    }
+    if (fds[0].revents)
+      return;
+    for (nfds_t j = 1; j < count; ++j) {
+      if (fds[j].revents && !Drain(polled[j]))
+        open[polled[j]->stream] = false;
+    }
+  }
+}
+
+void ChildOutputLogger::HandleOutput(Stream stream,
+                                     const char* data,
+                                     size_t size,
+                                     base::TimeTicks now) {
+  std::string& partial = pipes_[stream].partial_line;
+  const char* end = data + size;
+  while (data < end) {
+    const char* newline = std::find(data, end, '\n');
+    partial.append(data, newline);
+    bool split = false;
+    while (partial.size() >= config_.max_line_bytes) {
+      HandleLine(stream, partial.substr(0, config_.max_line_bytes), now);
+      partial.erase(0, config_.max_line_bytes);
+      split = true;
+    }
+    if (newline == end)
+      break;  // Wait for the rest of the line.
+    // Don't log an empty line if a long one was split right at its end.
+    if (!partial.empty() || !split)
+      HandleLine(stream, partial, now);
+    partial.clear();
+    data = newline + 1;
+  }
+}
+
+std::string ChildOutputLogger::GetTail() const {
+  if (tail_.size() <= config_.tail_bytes)
+    return tail_;
+  return tail_.substr(tail_.size() - config_.tail_bytes);
+}
+
+bool ChildOutputLogger::DumpTail(const base::FilePath& path) const {
+  const std::string tail = GetTail();
+  return file_util::WriteFile(path, tail.data(), tail.size()) ==
+      static_cast<int>(tail.size());
+}
+
+// static
+gboolean ChildOutputLogger::HandleReadable(GIOChannel* source,
+                                           GIOCondition condition,
+                                           gpointer data) {
+  Pipe* pipe = static_cast<Pipe*>(data);
+  if (pipe->owner->Drain(pipe))
+    return TRUE;
+  // Returning FALSE removes the watch.
+  pipe->watch = 0;
+  pipe->owner->ClosePipe(pipe);
+  return FALSE;
+}
+
+bool ChildOutputLogger::Drain(Pipe* pipe) {
+  char buffer[4096];
+  size_t total = 0;
+  while (total < kMaxReadPerWakeup) {
+    ssize_t count = HANDLE_EINTR(read(pipe->read_fd, buffer, sizeof(buffer)));
+    if (count > 0) {
+      HandleOutput(pipe->stream, buffer, count, base::TimeTicks::Now());
+      total += count;
+      continue;
+    }
+    if (count < 0 && errno == EAGAIN)
+      return true;
+    if (count < 0)
+      PLOG(WARNING) << "Can't read " << name_ << " output";
+    // EOF: flush any unterminated line.
+    if (!pipe->partial_line.empty()) {
+      HandleLine(pipe->stream, pipe->partial_line, base::TimeTicks::Now());
+      pipe->partial_line.clear();
+    }
+    return false;
+  }
+  return true;
+}
+
+void ChildOutputLogger::ClosePipe(Pipe* pipe) {
+  if (pipe->watch) {
+    g_source_remove(pipe->watch);
+    pipe->watch = 0;
+  }
+  if (pipe->read_fd >= 0) {
+    close(pipe->read_fd);
+    pipe->read_fd = -1;
+  }
+  if (pipe->write_fd >= 0) {
+    close(pipe->write_fd);
+    pipe->write_fd = -1;
+  }
+  pipe->partial_line.clear();
+}
+
+void ChildOutputLogger::HandleLine(Stream stream,
+                                   const std::string& line,
+                                   base::TimeTicks now) {
+  const std::string text =
+      StringPrintf("%s: %s\n", kStreamNames[stream], line.c_str());
+  AppendToTail(text);
+
+  if (!AdmitLine(now)) {
+    ++pending_lines_dropped_;
+    ++total_lines_dropped_;
+    return;
+  }
+  if (pending_lines_dropped_) {
+    WriteToFile(StringPrintf("[%llu lines dropped]\n",
+                             static_cast<unsigned long long>(
+                                 pending_lines_dropped_)));
+    pending_lines_dropped_ = 0;
+  }
+  WriteToFile(text);
+  ++lines_written_;
+}
+
+bool ChildOutputLogger::AdmitLine(base::TimeTicks now) {
+  if (!last_refill_.is_null()) {
+    const double elapsed = (now - last_refill_).InSecondsF();
+    if (elapsed > 0) {
+      tokens_ = std::min<double>(config_.burst_lines,
+                                 tokens_ + elapsed * config_.lines_per_second);
+    }
+  }
+  last_refill_ = now;
+  if (tokens_ < 1)
+    return false;
+  tokens_ -= 1;
+  return true;
+}
+
+void ChildOutputLogger::WriteToFile(const std::string& text) {
+  if (log_fd_ >= 0 &&
+      log_size_ + static_cast<int64>(text.size()) > config_.max_file_bytes) {
+    close(log_fd_);
+    log_fd_ = -1;
+    base::FilePath old_file(log_file_.value() + kOldLogSuffix);
+    if (rename(log_file_.value().c_str(), old_file.value().c_str()) != 0)
+      PLOG(WARNING) << "Can't move " << log_file_.value() << " aside";
+  }
+  if (log_fd_ < 0) {
+    log_fd_ = HANDLE_EINTR(open(log_file_.value().c_str(),
+                                O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                                S_IRUSR | S_IWUSR | S_IRGRP));
+    if (log_fd_ < 0) {
+      PLOG(WARNING) << "Can't open " << log_file_.value();
+      return;
+    }
+    struct stat st;
+    log_size_ = fstat(log_fd_, &st) == 0 ? st.st_size : 0;
+  }
+  if (file_util::WriteFileDescriptor(log_fd_, text.data(), text.size()) !=
+      static_cast<int>(text.size())) {
+    PLOG(WARNING) << "Can't write to " << log_file_.value();
+    return;
+  }
+  log_size_ += text.size();
+}
+
+void ChildOutputLogger::AppendToTail(const std::string& text) {
+  tail_.append(text);
+  if (tail_.size() > 2 * config_.tail_bytes)
+    tail_.erase(0, tail_.size() - config_.tail_bytes);
+}
+
+}  // namespace login_manager
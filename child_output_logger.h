@@ -0,0 +1,174 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_CHILD_OUTPUT_LOGGER_H_
+#define LOGIN_MANAGER_CHILD_OUTPUT_LOGGER_H_
+
+#include <glib.h>
+
+#include <string>
+
+#include <base/basictypes.h>
+#include <base/compiler_specific.h>
+#include <base/file_path.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/threading/simple_thread.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+// Captures a child's stdout and stderr through pipes that are drained on the
+// main loop without blocking.
+//
+// Complete lines are appended to a size-bounded log file: once the file
+// reaches its limit it's moved aside to "<file>.old" and a new one is
+// started. Lines are rate limited with a token bucket, and the number of
+// lines dropped is noted in the file once output slows down again. The most
+// recent output, dropped lines included, is also kept in memory so that it
+// can be attached to crash and hang reports.
+//
+// Usage, for each run of the child:
+//   CreatePipes() before forking,
+//   AttachToChild() in the child, before exec,
+//   StartWatching() in the parent.
+//
+// While the main loop isn't running, e.g. when waiting for the child to exit
+// during shutdown, StartBackgroundDrain() keeps the pipes from filling up
+// and blocking the child.
+class ChildOutputLogger : public base::DelegateSimpleThread::Delegate {
+ public:
+  enum Stream {
+    STDOUT = 0,
+    STDERR,
+    NUM_STREAMS,
+  };
+
+  struct Config {
+    Config();
+    // Size at which the log file is moved aside.
+    int64 max_file_bytes;
+    // Sustained number of lines per second that are written to the file.
+    double lines_per_second;
+    // Number of lines that may be written in a burst.
+    int burst_lines;
+    // Amount of recent output kept in memory.
+    size_t tail_bytes;
+    // Lines longer than this are split.
+    size_t max_line_bytes;
+  };
+
+  ChildOutputLogger(const std::string& name,
+                    const base::FilePath& log_file,
+                    const Config& config);
+  virtual ~ChildOutputLogger();
+
+  // Replaces the pipes used by the previous run of the child, draining what
+  // is left in them. Returns false if no pipes could be created, in which
+  // case the child should keep session_manager's stdio.
+  bool CreatePipes();
+
+  // Called in the child after fork(): makes the pipes its stdout and stderr.
+  // Does nothing if there are no pipes.
+  void AttachToChild();
+
+  // Called in the parent after fork(): closes the child's ends of the pipes
+  // and starts draining them on the main loop.
+  void StartWatching();
+
+  // Stops draining, after consuming whatever is available right now.
+  void StopWatching();
+
+  // Drains the pipes on a thread of its own instead of the main loop, until
+  // StopBackgroundDrain(). Nothing else may be called in between, and the
+  // main loop doesn't watch the pipes anymore afterwards; StopWatching()
+  // takes care of what is left.
+  void StartBackgroundDrain();
+  void StopBackgroundDrain();
+
+  // Consumes output of the child. |now| is used for rate limiting.
+  void HandleOutput(Stream stream,
+                    const char* data,
+                    size_t size,
+                    base::TimeTicks now);
+
+  // Returns up to the last |config.tail_bytes| of output.
+  std::string GetTail() const;
+
+  // Writes GetTail() to |path|. Returns false on failure.
+  bool DumpTail(const base::FilePath& path) const;
+
+  uint64 lines_written() const { return lines_written_; }
+  uint64 lines_dropped() const { return total_lines_dropped_; }
+
+  // base::DelegateSimpleThread::Delegate implementation, for the background
+  // drain:
+  virtual void Run() OVERRIDE;
+
+  // Directory the log files of supervised children go into.
+  static const char kLogDir[];
+
+ private:
+  struct Pipe {
+    Pipe();
+    ChildOutputLogger* owner;
+    Stream stream;
+    int read_fd;
+    int write_fd;
+    guint watch;
+    // Output that isn't terminated by a newline yet.
+    std::string partial_line;
+  };
+
+  // GLib IO watch callback; |data| is a Pipe*.
+  static gboolean HandleReadable(GIOChannel* source,
+                                 GIOCondition condition,
+                                 gpointer data);
+
+  // Reads what's available from |pipe|. Returns false on EOF or error.
+  bool Drain(Pipe* pipe);
+
+  // Closes |pipe| and stops watching it.
+  void ClosePipe(Pipe* pipe);
+
+  // Handles one complete |line| from |stream|.
+  void HandleLine(Stream stream, const std::string& line, base::TimeTicks now);
+
+  // Returns true if the token bucket allows another line.
+  bool AdmitLine(base::TimeTicks now);
+
+  // Appends |text| to the log file, moving it aside first if it's full.
+  void WriteToFile(const std::string& text);
+
+  // Appends |text| to the in-memory tail.
+  void AppendToTail(const std::string& text);
+
+  const std::string name_;
+  const base::FilePath log_file_;
+  const Config config_;
+
+  Pipe pipes_[NUM_STREAMS];
+
+  int log_fd_;
+  int64 log_size_;
+
+  double tokens_;
+  base::TimeTicks last_refill_;
+  uint64 lines_written_;
+  uint64 pending_lines_dropped_;
+  uint64 total_lines_dropped_;
+
+  // Holds between |config_.tail_bytes| and twice that, so that it doesn't
+  // have to be trimmed on every line.
+  std::string tail_;
+
+  // For the background drain; writing to |wakeup_fds_[1]| makes it stop.
+  scoped_ptr<base::DelegateSimpleThread> drain_thread_;
+  int wakeup_fds_[2];
+
+  DISALLOW_COPY_AND_ASSIGN(ChildOutputLogger);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_CHILD_OUTPUT_LOGGER_H_
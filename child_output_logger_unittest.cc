@@ -0,0 +1,181 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/child_output_logger.h"
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/string_util.h>
+#include <base/time.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+class ChildOutputLoggerTest : public ::testing::Test {
+ public:
+  ChildOutputLoggerTest() {}
+  virtual ~ChildOutputLoggerTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    log_file_ = tmpdir_.path().AppendASCII("job.out");
+    config_.lines_per_second = 1;
+    config_.burst_lines = 2;
+    config_.max_file_bytes = 1024;
+    config_.tail_bytes = 64;
+    config_.max_line_bytes = 16;
+    start_ = base::TimeTicks::Now();
+  }
+
+ protected:
+  void CreateLogger() {
+    logger_.reset(new ChildOutputLogger("job", log_file_, config_));
+  }
+
+  void Output(const std::string& text, int seconds_since_start) {
+    logger_->HandleOutput(
+        ChildOutputLogger::STDOUT, text.data(), text.size(),
+        start_ + base::TimeDelta::FromSeconds(seconds_since_start));
+  }
+
+  std::string ReadLog() {
+    std::string contents;
+    file_util::ReadFileToString(log_file_, &contents);
+    return contents;
+  }
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath log_file_;
+  ChildOutputLogger::Config config_;
+  base::TimeTicks start_;
+  scoped_ptr<ChildOutputLogger> logger_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ChildOutputLoggerTest);
+};
+
+TEST_F(ChildOutputLoggerTest, SplitsLines) {
+  CreateLogger();
+  Output("one\ntw", 0);
+  EXPECT_EQ("out: one\n", ReadLog());
+  Output("o\n", 0);
+  EXPECT_EQ("out: one\nout: two\n", ReadLog());
+  EXPECT_EQ(2U, logger_->lines_written());
+}
+
+TEST_F(ChildOutputLoggerTest, SplitsLongLines) {
+  config_.burst_lines = 10;
+  CreateLogger();
+  Output(std::string(20, 'a') + "\n", 0);
+  EXPECT_EQ("out: " + std::string(16, 'a') + "\nout: aaaa\n", ReadLog());
+
+  // A line that's exactly the maximum length doesn't leave an empty line.
+  Output(std::string(16, 'b') + "\n", 0);
+  EXPECT_EQ(3U, logger_->lines_written());
+}
+
+TEST_F(ChildOutputLoggerTest, RateLimits) {
+  CreateLogger();
+  Output("1\n2\n3\n4\n", 0);
+  EXPECT_EQ("out: 1\nout: 2\n", ReadLog());
+  EXPECT_EQ(2U, logger_->lines_written());
+  EXPECT_EQ(2U, logger_->lines_dropped());
+
+  // One more token a second later; the drop is noted first.
+  Output("5\n", 1);
+  EXPECT_EQ("out: 1\nout: 2\n[2 lines dropped]\nout: 5\n", ReadLog());
+
+  // Dropped lines still make it to the tail.
+  EXPECT_NE(std::string::npos, logger_->GetTail().find("out: 3\n"));
+}
+
+TEST_F(ChildOutputLoggerTest, TailIsBounded) {
+  CreateLogger();
+  for (int i = 0; i < 100; ++i)
+    Output("0123456789\n", 0);
+  std::string tail = logger_->GetTail();
+  EXPECT_EQ(config_.tail_bytes, tail.size());
+  EXPECT_TRUE(EndsWith(tail, "out: 0123456789\n", true));
+
+  base::FilePath dump = tmpdir_.path().AppendASCII("tail");
+  ASSERT_TRUE(logger_->DumpTail(dump));
+  std::string dumped;
+  ASSERT_TRUE(file_util::ReadFileToString(dump, &dumped));
+  EXPECT_EQ(tail, dumped);
+}
+
+TEST_F(ChildOutputLoggerTest, FileIsBounded) {
+  config_.lines_per_second = 1000;
+  config_.burst_lines = 1000;
+  CreateLogger();
+  for (int i = 0; i < 200; ++i)
+    Output("0123456789\n", 0);
+
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(log_file_, &size));
+  EXPECT_LE(size, config_.max_file_bytes);
+  base::FilePath old_file(log_file_.value() + ".old");
+  ASSERT_TRUE(file_util::GetFileSize(old_file, &size));
+  EXPECT_LE(size, config_.max_file_bytes);
+  EXPECT_GT(size, 0);
+}
+
+TEST_F(ChildOutputLoggerTest, CapturesChild) {
+  config_.burst_lines = 10;
+  CreateLogger();
+  ASSERT_TRUE(logger_->CreatePipes());
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    logger_->AttachToChild();
+    fprintf(stdout, "hello\n");
+    fprintf(stderr, "world");
+    fflush(stdout);
+    _exit(0);
+  }
+  logger_->StartWatching();
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+
+  // Drains what the child left behind, including the unterminated line.
+  logger_->StopWatching();
+  std::string log = ReadLog();
+  EXPECT_NE(std::string::npos, log.find("out: hello\n"));
+  EXPECT_NE(std::string::npos, log.find("err: world\n"));
+}
+
+TEST_F(ChildOutputLoggerTest, BackgroundDrainUnblocksChild) {
+  CreateLogger();
+  ASSERT_TRUE(logger_->CreatePipes());
+  // Much more than fits in a pipe.
+  const int kLines = 20000;
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    logger_->AttachToChild();
+    for (int i = 0; i < kLines; ++i)
+      fprintf(stdout, "0123456789abcde\n");
+    fflush(stdout);
+    _exit(0);
+  }
+  logger_->StartWatching();
+  // Nothing runs the main loop; the child can only exit if output is drained.
+  logger_->StartBackgroundDrain();
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  logger_->StopBackgroundDrain();
+  logger_->StopWatching();
+  EXPECT_EQ(static_cast<uint64>(kLines),
+            logger_->lines_written() + logger_->lines_dropped());
+}
+
+}  // namespace login_manager
@@ -0,0 +1,162 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/crash_collection_watcher.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/string_number_conversions.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+
+namespace login_manager {
+
+// static
+const int CrashCollectionWatcher::kQuietPeriodMs = 1000;
+
+namespace {
+
+// Where crash_reporter puts system and user crashes, respectively.
+const char* kSpoolDirs[] = {
+  "/var/spool/crash",
+  "/home/chronos/crash",
+  "/home/chronos/user/crash",
+};
+const char kProcDir[] = "/proc";
+
+const char kCrashReporterName[] = "crash_reporter";
+// The kernel runs crash_reporter with --user=<pid>:<signal>:..., and the
+// browser's crash handler with --pid=<pid>.
+const char kUserCrashFlag[] = "--user=";
+const char kChromeCrashPidFlag[] = "--pid=";
+// Set in /proc/<pid>/status while the kernel is writing out a core dump.
+const char kCoreDumpingLine[] = "CoreDumping:\t1";
+
+const uint32 kWatchMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO;
+
+}  // namespace
+
+CrashCollectionWatcher::CrashCollectionWatcher(
+    const std::vector<base::FilePath>& spool_dirs,
+    const base::FilePath& proc_dir)
+    : spool_dirs_(spool_dirs),
+      proc_dir_(proc_dir),
+      inotify_fd_(-1) {
+}
+
+CrashCollectionWatcher::~CrashCollectionWatcher() {
+  if (inotify_fd_ >= 0)
+    HANDLE_EINTR(close(inotify_fd_));
+}
+
+// static
+CrashCollectionWatcher* CrashCollectionWatcher::CreateDefault() {
+  std::vector<base::FilePath> spool_dirs;
+  for (size_t i = 0; i < arraysize(kSpoolDirs); ++i)
+    spool_dirs.push_back(base::FilePath(kSpoolDirs[i]));
+  return new CrashCollectionWatcher(spool_dirs, base::FilePath(kProcDir));
+}
+
+bool CrashCollectionWatcher::Initialize() {
+  DCHECK_LT(inotify_fd_, 0);
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    PLOG(ERROR) << "Can't watch crash spool directories";
+    return false;
+  }
+  for (std::vector<base::FilePath>::const_iterator it = spool_dirs_.begin();
+       it != spool_dirs_.end(); ++it) {
+    // Missing directories are fine, crash_reporter creates them on demand.
+    if (inotify_add_watch(inotify_fd_, it->value().c_str(), kWatchMask) < 0 &&
+        errno != ENOENT) {
+      PLOG(WARNING) << "Can't watch " << it->value();
+    }
+  }
+  return true;
+}
+
+bool CrashCollectionWatcher::IsCollecting(pid_t pid) {
+  DrainEvents();
+  if (!last_activity_.is_null() &&
+      base::TimeTicks::Now() - last_activity_ <
+      base::TimeDelta::FromMilliseconds(kQuietPeriodMs)) {
+    return true;
+  }
+  return IsDumpingCore(pid) || IsCrashReporterRunning(pid);
+}
+
+void CrashCollectionWatcher::DrainEvents() {
+  if (inotify_fd_ < 0)
+    return;
+  // Only the fact that something happened matters, not what it was.
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool saw_events = false;
+  while (HANDLE_EINTR(read(inotify_fd_, buf, sizeof(buf))) > 0)
+    saw_events = true;
+  if (saw_events)
+    last_activity_ = base::TimeTicks::Now();
+}
+
+bool CrashCollectionWatcher::IsDumpingCore(pid_t pid) const {
+  std::string status;
+  if (!file_util::ReadFileToString(
+          proc_dir_.Append(base::IntToString(pid)).Append("status"),
+          &status)) {
+    return false;
+  }
+  return status.find(kCoreDumpingLine) != std::string::npos;
+}
+
+bool CrashCollectionWatcher::IsCrashReporterRunning(pid_t pid) const {
+  file_util::FileEnumerator enumerator(proc_dir_, false,
+                                       file_util::FileEnumerator::DIRECTORIES);
+  base::FilePath dir;
+  while (!(dir = enumerator.Next()).empty()) {
+    int unused_pid;
+    if (!base::StringToInt(dir.BaseName().value(), &unused_pid))
+      continue;
+    std::string cmdline;
+    if (!file_util::ReadFileToString(dir.Append("cmdline"), &cmdline))
+      continue;
+    if (IsCrashReporterFor(cmdline, pid))
+      return true;
+  }
+  return false;
+}
+
+// static
+bool CrashCollectionWatcher::IsCrashReporterFor(const std::string& cmdline,
+                                                pid_t pid) {
+  std::vector<std::string> argv;
+  base::SplitString(cmdline, '\0', &argv);
+  if (argv.empty() ||
+      base::FilePath(argv[0]).BaseName().value() != kCrashReporterName) {
+    return false;
+  }
+  const std::string pid_string = base::IntToString(pid);
+  for (size_t i = 1; i < argv.size(); ++i) {
+    const std::string& arg = argv[i];
+    if (StartsWithASCII(arg, kUserCrashFlag, true)) {
+      // --user=<pid>:<signal>:<uid>:<gid>:<exe>
+      const std::string value = arg.substr(strlen(kUserCrashFlag));
+      if (value.substr(0, value.find(':')) == pid_string)
+        return true;
+    } else if (StartsWithASCII(arg, kChromeCrashPidFlag, true) &&
+               arg.substr(strlen(kChromeCrashPidFlag)) == pid_string) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace login_manager
@@ -0,0 +1,74 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_CRASH_COLLECTION_WATCHER_H_
+#define LOGIN_MANAGER_CRASH_COLLECTION_WATCHER_H_
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+// Tells whether a crash of a child process is still being collected, so that
+// shutdown can give the crash reporter time to finish instead of aborting the
+// child in the middle of a core dump.
+//
+// Collection is considered to be in progress while the kernel is dumping core
+// for the child, while crash_reporter is collecting it, or while files in one
+// of
+// the crash spool directories have changed recently. The latter is noticed
+// through inotify.
+class CrashCollectionWatcher {
+ public:
+  // Watches |spool_dirs|, which need not all exist, and looks for processes
+  // under |proc_dir|.
+  CrashCollectionWatcher(const std::vector<base::FilePath>& spool_dirs,
+                         const base::FilePath& proc_dir);
+  virtual ~CrashCollectionWatcher();
+
+  // Creates a watcher for the system's crash spool directories.
+  static CrashCollectionWatcher* CreateDefault();
+
+  // Starts watching the spool directories. Without this, only the state of
+  // processes is taken into account.
+  bool Initialize();
+
+  // Returns true if a crash of |pid| appears to be being collected.
+  virtual bool IsCollecting(pid_t pid);
+
+  // How long the spool directories have to be left alone before collection is
+  // considered to be done.
+  static const int kQuietPeriodMs;
+
+ private:
+  // Reads pending inotify events, noting the time if there were any.
+  void DrainEvents();
+
+  // Returns true if the kernel is dumping core for |pid|.
+  bool IsDumpingCore(pid_t pid) const;
+
+  // Returns true if a crash_reporter process is collecting a crash of |pid|.
+  bool IsCrashReporterRunning(pid_t pid) const;
+
+  // Returns true if |cmdline|, as found in /proc/<pid>/cmdline, is that of a
+  // crash_reporter collecting a crash of |pid|.
+  static bool IsCrashReporterFor(const std::string& cmdline, pid_t pid);
+
+  const std::vector<base::FilePath> spool_dirs_;
+  const base::FilePath proc_dir_;
+  int inotify_fd_;
+  base::TimeTicks last_activity_;
+
+  DISALLOW_COPY_AND_ASSIGN(CrashCollectionWatcher);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_CRASH_COLLECTION_WATCHER_H_
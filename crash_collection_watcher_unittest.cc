@@ -0,0 +1,105 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/crash_collection_watcher.h"
+
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+class CrashCollectionWatcherTest : public ::testing::Test {
+ public:
+  CrashCollectionWatcherTest() {}
+  virtual ~CrashCollectionWatcherTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    spool_dir_ = tmpdir_.path().AppendASCII("spool");
+    proc_dir_ = tmpdir_.path().AppendASCII("proc");
+    ASSERT_TRUE(file_util::CreateDirectory(spool_dir_));
+    ASSERT_TRUE(file_util::CreateDirectory(proc_dir_));
+
+    std::vector<base::FilePath> spool_dirs;
+    spool_dirs.push_back(spool_dir_);
+    spool_dirs.push_back(tmpdir_.path().AppendASCII("missing"));
+    watcher_.reset(new CrashCollectionWatcher(spool_dirs, proc_dir_));
+    ASSERT_TRUE(watcher_->Initialize());
+  }
+
+ protected:
+  // Fakes up /proc/<pid>/|name| with |contents|.
+  void WriteProcFile(const std::string& pid,
+                     const std::string& name,
+                     const std::string& contents) {
+    base::FilePath dir = proc_dir_.AppendASCII(pid);
+    ASSERT_TRUE(file_util::CreateDirectory(dir));
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(dir.AppendASCII(name), contents.data(),
+                                   contents.size()));
+  }
+
+  static const pid_t kPid;
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath spool_dir_;
+  base::FilePath proc_dir_;
+  scoped_ptr<CrashCollectionWatcher> watcher_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CrashCollectionWatcherTest);
+};
+
+const pid_t CrashCollectionWatcherTest::kPid = 42;
+
+TEST_F(CrashCollectionWatcherTest, Idle) {
+  WriteProcFile("42", "status", "Name:\tchrome\nCoreDumping:\t0\n");
+  WriteProcFile("42", "comm", "chrome\n");
+  EXPECT_FALSE(watcher_->IsCollecting(kPid));
+}
+
+TEST_F(CrashCollectionWatcherTest, DumpingCore) {
+  WriteProcFile("42", "status", "Name:\tchrome\nCoreDumping:\t1\n");
+  EXPECT_TRUE(watcher_->IsCollecting(kPid));
+  EXPECT_FALSE(watcher_->IsCollecting(kPid + 1));
+}
+
+TEST_F(CrashCollectionWatcherTest, CrashReporterRunning) {
+  const char kCmdline[] = "/sbin/crash_reporter\0--user=42:11:1000:1000:chrome";
+  WriteProcFile("7", "cmdline", std::string(kCmdline, sizeof(kCmdline)));
+  EXPECT_TRUE(watcher_->IsCollecting(kPid));
+  // Crashes of other processes don't hold up the browser.
+  EXPECT_FALSE(watcher_->IsCollecting(kPid + 1));
+  EXPECT_FALSE(watcher_->IsCollecting(4));
+}
+
+TEST_F(CrashCollectionWatcherTest, CrashReporterForChrome) {
+  const char kCmdline[] =
+      "/sbin/crash_reporter\0--chrome=/tmp/dump\0--pid=42\0--uid=1000";
+  WriteProcFile("7", "cmdline", std::string(kCmdline, sizeof(kCmdline)));
+  EXPECT_TRUE(watcher_->IsCollecting(kPid));
+  EXPECT_FALSE(watcher_->IsCollecting(kPid * 10));
+}
+
+TEST_F(CrashCollectionWatcherTest, OtherProcessMentioningPid) {
+  const char kCmdline[] = "/bin/sh\0--user=42:11";
+  WriteProcFile("7", "cmdline", std::string(kCmdline, sizeof(kCmdline)));
+  EXPECT_FALSE(watcher_->IsCollecting(kPid));
+}
+
+TEST_F(CrashCollectionWatcherTest, SpoolActivity) {
+  const std::string dump("MDMP");
+  ASSERT_EQ(static_cast<int>(dump.size()),
+            file_util::WriteFile(spool_dir_.AppendASCII("chrome.dmp"),
+                                 dump.data(), dump.size()));
+  EXPECT_TRUE(watcher_->IsCollecting(kPid));
+}
+
+}  // namespace login_manager
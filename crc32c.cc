@@ -0,0 +1,126 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/crc32c.h"
+
+#include <string.h>
+
+#include <base/lazy_instance.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace login_manager {
+
+namespace {
+
+// Reversed Castagnoli polynomial.
+const uint32 kPolynomial = 0x82f63b78;
+
+// Tables for processing four bytes at a time ("slicing by 4").
+struct Crc32cTables {
+  Crc32cTables() {
+    for (uint32 i = 0; i < 256; ++i) {
+      uint32 crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+      table[0][i] = crc;
+    }
+    for (uint32 i = 0; i < 256; ++i) {
+      for (int k = 1; k < 4; ++k)
+        table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+    }
+  }
+  uint32 table[4][256];
+};
+
+base::LazyInstance<Crc32cTables>::Leaky g_tables = LAZY_INSTANCE_INITIALIZER;
+
+uint32 ExtendPortable(uint32 crc, const uint8* data, size_t size) {
+  const uint32 (*table)[256] = g_tables.Get().table;
+  while (size >= 4) {
+    crc ^= data[0] | (data[1] << 8) | (data[2] << 16) |
+        (static_cast<uint32>(data[3]) << 24);
+    crc = table[3][crc & 0xff] ^ table[2][(crc >> 8) & 0xff] ^
+        table[1][(crc >> 16) & 0xff] ^ table[0][crc >> 24];
+    data += 4;
+    size -= 4;
+  }
+  while (size--)
+    crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+uint32 ExtendHardware(uint32 crc, const uint8* data, size_t size) {
+#if defined(__x86_64__)
+  uint64 crc64 = crc;
+  while (size >= 8) {
+    uint64 word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = __builtin_ia32_crc32di(crc64, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<uint32>(crc64);
+#endif
+  while (size >= 4) {
+    uint32 word;
+    memcpy(&word, data, sizeof(word));
+    crc = __builtin_ia32_crc32si(crc, word);
+    data += 4;
+    size -= 4;
+  }
+  while (size--)
+    crc = __builtin_ia32_crc32qi(crc, *data++);
+  return crc;
+}
+
+bool HaveHardwareSupport() {
+  return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__ARM_FEATURE_CRC32)
+uint32 ExtendHardware(uint32 crc, const uint8* data, size_t size) {
+  while (size >= 8) {
+    uint64 word;
+    memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    size -= 8;
+  }
+  while (size--)
+    crc = __crc32cb(crc, *data++);
+  return crc;
+}
+
+bool HaveHardwareSupport() {
+  return true;
+}
+#else
+uint32 ExtendHardware(uint32 crc, const uint8* data, size_t size) {
+  return ExtendPortable(crc, data, size);
+}
+
+bool HaveHardwareSupport() {
+  return false;
+}
+#endif
+
+}  // namespace
+
+uint32 Crc32c(const void* data, size_t size) {
+  static const bool use_hardware = HaveHardwareSupport();
+  const uint8* bytes = static_cast<const uint8*>(data);
+  uint32 crc = use_hardware ? ExtendHardware(~0U, bytes, size)
+                            : ExtendPortable(~0U, bytes, size);
+  return ~crc;
+}
+
+uint32 Crc32cPortableForTesting(const void* data, size_t size) {
+  return ~ExtendPortable(~0U, static_cast<const uint8*>(data), size);
+}
+
+}  // namespace login_manager
@@ -0,0 +1,24 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_CRC32C_H_
+#define LOGIN_MANAGER_CRC32C_H_
+
+#include <stddef.h>
+
+#include <base/basictypes.h>
+
+namespace login_manager {
+
+// Returns the CRC32C (Castagnoli) checksum of the |size| bytes at |data|.
+// Uses the CPU's CRC32 instructions where there are any, and a table driven
+// implementation otherwise.
+uint32 Crc32c(const void* data, size_t size);
+
+// Same, but always uses the table driven implementation.
+uint32 Crc32cPortableForTesting(const void* data, size_t size);
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_CRC32C_H_
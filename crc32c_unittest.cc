@@ -0,0 +1,42 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/crc32c.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+TEST(Crc32cTest, KnownValues) {
+  // From RFC 3720, section B.4.
+  std::string zeros(32, '\0');
+  std::string ones(32, '\xff');
+  std::string ascending;
+  for (int i = 0; i < 32; ++i)
+    ascending.push_back(static_cast<char>(i));
+
+  EXPECT_EQ(0x8a9136aaU, Crc32c(zeros.data(), zeros.size()));
+  EXPECT_EQ(0x62a8ab43U, Crc32c(ones.data(), ones.size()));
+  EXPECT_EQ(0x46dd794eU, Crc32c(ascending.data(), ascending.size()));
+  EXPECT_EQ(0xe3069283U, Crc32c("123456789", 9));
+  EXPECT_EQ(0U, Crc32c("", 0));
+}
+
+TEST(Crc32cTest, MatchesPortable) {
+  std::string data;
+  for (int i = 0; i < 1031; ++i)
+    data.push_back(static_cast<char>(i * 37 + 11));
+  // Cover every alignment and tail length.
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t size = 0; size + offset <= data.size(); size += 13) {
+      EXPECT_EQ(Crc32cPortableForTesting(data.data() + offset, size),
+                Crc32c(data.data() + offset, size))
+          << offset << " " << size;
+    }
+  }
+}
+
+}  // namespace login_manager
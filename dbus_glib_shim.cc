@@ -138,6 +138,55 @@ gboolean session_manager_retrieve_session_state(SessionManager *self,
 GHashTable* session_manager_retrieve_active_sessions(SessionManager *self) {
   SESSION_MANAGER_WRAP_METHOD(RetrieveActiveSessions);
 }
+gboolean session_manager_retrieve_policy_stats(SessionManager *self,
+                                               gchar** OUT_stats) {
+  SESSION_MANAGER_WRAP_METHOD(RetrievePolicyStats, OUT_stats);
+}
+gboolean session_manager_get_device_setting_values(SessionManager *self,
+                                                   const gchar** field_paths,
+                                                   GHashTable** OUT_values,
+                                                   GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(GetDeviceSettingValues, field_paths, OUT_values,
+                              error);
+}
+gboolean session_manager_watch_device_settings(SessionManager *self,
+                                               const gchar** field_paths,
+                                               DBusGMethodInvocation* context) {
+  SESSION_MANAGER_WRAP_METHOD(WatchDeviceSettings, field_paths, context);
+}
+gboolean session_manager_unwatch_device_settings(
+    SessionManager *self,
+    guint watch_id,
+    DBusGMethodInvocation* context) {
+  SESSION_MANAGER_WRAP_METHOD(UnwatchDeviceSettings, watch_id, context);
+}
+gboolean session_manager_get_tunables(SessionManager *self,
+                                      GHashTable** OUT_values,
+                                      GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(GetTunables, OUT_values, error);
+}
+gboolean session_manager_set_tunable(SessionManager *self,
+                                     gchar* name,
+                                     gint64 value,
+                                     GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(SetTunable, name, value, error);
+}
+gboolean session_manager_reload_tunables(SessionManager *self,
+                                         GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(ReloadTunables, error);
+}
+gboolean session_manager_get_memory_stats(SessionManager *self,
+                                          GHashTable** OUT_values,
+                                          GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(GetMemoryStats, OUT_values, error);
+}
+gboolean session_manager_start_profiling(SessionManager *self,
+                                         gint duration_seconds,
+                                         gchar** OUT_profile_path,
+                                         GError **error) {
+  SESSION_MANAGER_WRAP_METHOD(StartProfiling, duration_seconds,
+                              OUT_profile_path, error);
+}
 gboolean session_manager_lock_screen(SessionManager *self,
                                      GError **error) {
   SESSION_MANAGER_WRAP_METHOD(LockScreen, error);
@@ -80,6 +80,35 @@ gboolean session_manager_retrieve_device_local_account_policy(
 gboolean session_manager_retrieve_session_state(SessionManager *self,
                                                 gchar** OUT_state);
 GHashTable* session_manager_retrieve_active_sessions(SessionManager *self);
+gboolean session_manager_retrieve_policy_stats(SessionManager *self,
+                                               gchar** OUT_stats);
+gboolean session_manager_get_device_setting_values(SessionManager *self,
+                                                   const gchar** field_paths,
+                                                   GHashTable** OUT_values,
+                                                   GError **error);
+gboolean session_manager_watch_device_settings(SessionManager *self,
+                                               const gchar** field_paths,
+                                               DBusGMethodInvocation* context);
+gboolean session_manager_unwatch_device_settings(
+    SessionManager *self,
+    guint watch_id,
+    DBusGMethodInvocation* context);
+gboolean session_manager_get_tunables(SessionManager *self,
+                                      GHashTable** OUT_values,
+                                      GError **error);
+gboolean session_manager_set_tunable(SessionManager *self,
+                                     gchar* name,
+                                     gint64 value,
+                                     GError **error);
+gboolean session_manager_reload_tunables(SessionManager *self,
+                                         GError **error);
+gboolean session_manager_get_memory_stats(SessionManager *self,
+                                          GHashTable** OUT_values,
+                                          GError **error);
+gboolean session_manager_start_profiling(SessionManager *self,
+                                         gint duration_seconds,
+                                         gchar** OUT_profile_path,
+                                         GError **error);
 
 gboolean session_manager_handle_lock_screen_dismissed(SessionManager *self,
                                                       GError **error);
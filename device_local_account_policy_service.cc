@@ -33,7 +33,9 @@ DeviceLocalAccountPolicyService::DeviceLocalAccountPolicyService(
     const scoped_refptr<base::MessageLoopProxy>& main_loop)
     : device_local_account_dir_(device_local_account_dir),
       owner_key_(owner_key),
-      main_loop_(main_loop) {
+      main_loop_(main_loop),
+      use_policy_container_(false),
+      metrics_(NULL) {
 }
 
 DeviceLocalAccountPolicyService::~DeviceLocalAccountPolicyService() {
@@ -104,6 +106,42 @@ void DeviceLocalAccountPolicyService::UpdateDeviceSettings(
   }
 }
 
+void DeviceLocalAccountPolicyService::AppendStats(std::string* out) const {
+  for (std::map<std::string, scoped_refptr<PolicyService> >::const_iterator it =
+           policy_map_.begin();
+       it != policy_map_.end(); ++it) {
+    if (!it->second.get())
+      continue;
+    out->append("device-local account " + it->first + ": " +
+                it->second->stats()->ToString() + "\n");
+  }
+}
+
+int DeviceLocalAccountPolicyService::LoadedServiceCount() const {
+  int count = 0;
+  for (std::map<std::string, scoped_refptr<PolicyService> >::const_iterator it =
+           policy_map_.begin();
+       it != policy_map_.end(); ++it) {
+    if (it->second.get())
+      ++count;
+  }
+  return count;
+}
+
+int DeviceLocalAccountPolicyService::DropIdleServices() {
+  int dropped = 0;
+  for (std::map<std::string, scoped_refptr<PolicyService> >::iterator it =
+           policy_map_.begin();
+       it != policy_map_.end(); ++it) {
+    // Pending stores and persists hold a reference of their own.
+    if (it->second.get() && it->second->HasOneRef()) {
+      it->second = NULL;
+      ++dropped;
+    }
+  }
+  return dropped;
+}
+
 bool DeviceLocalAccountPolicyService::MigrateUppercaseDirs(void) {
   file_util::FileEnumerator enumerator(device_local_account_dir_, false,
                                        file_util::FileEnumerator::DIRECTORIES);
@@ -144,6 +182,7 @@ PolicyService* DeviceLocalAccountPolicyService::GetPolicyService(
     }
 
     scoped_ptr<PolicyStore> store(new PolicyStore(policy_path));
+    store->set_use_container(use_policy_container_);
     if (!store->LoadOrCreate()) {
       // This is non-fatal, the policy may not have been stored yet.
       LOG(WARNING) << "Failed to load policy for device-local account "
@@ -151,6 +190,7 @@ PolicyService* DeviceLocalAccountPolicyService::GetPolicyService(
     }
     entry->second =
         new PolicyService(store.Pass(), owner_key_, main_loop_);
+    entry->second->stats()->set_metrics(metrics_);
   }
 
   return entry->second.get();
@@ -26,6 +26,7 @@ class ChromeDeviceSettingsProto;
 
 namespace login_manager {
 
+class LoginMetrics;
 class PolicyKey;
 
 // Manages policy blobs for device-local accounts, loading/storing them from/to
@@ -44,6 +45,14 @@ class DeviceLocalAccountPolicyService {
       const scoped_refptr<base::MessageLoopProxy>& main_loop);
   ~DeviceLocalAccountPolicyService();
 
+  // Makes policy for accounts get written in a checksummed container, see
+  // PolicyStore::set_use_container().
+  void set_use_policy_container(bool use) { use_policy_container_ = use; }
+
+  // Makes the policy services for accounts send their stats to UMA, see
+  // PolicyStats::set_metrics(). Not owned.
+  void set_metrics(LoginMetrics* metrics) { metrics_ = metrics; }
+
   // Store policy for |account_id|, return false if the device-local account is
   // not defined in device policy.
   bool Store(const std::string& account_id,
@@ -65,6 +74,18 @@ class DeviceLocalAccountPolicyService {
   void UpdateDeviceSettings(
       const enterprise_management::ChromeDeviceSettingsProto& device_settings);
 
+  // Appends a line to |out| with the stats of each account whose policy has
+  // been loaded, see PolicyStats::ToString().
+  void AppendStats(std::string* out) const;
+
+  // Returns how many accounts have their policy loaded.
+  int LoadedServiceCount() const;
+
+  // Forgets the loaded policy of accounts that have no operations in flight,
+  // to be read from disk again the next time it is asked for. Returns how many
+  // were dropped.
+  int DropIdleServices();
+
  private:
   // Migrate uppercase local-account directories to their lowercase variants.
   // This is to repair the damage caused by http://crbug.com/225472.
@@ -91,6 +112,8 @@ class DeviceLocalAccountPolicyService {
 
   // Main loop for the policy service to use.
   scoped_refptr<base::MessageLoopProxy> main_loop_;
+  bool use_policy_container_;
+  LoginMetrics* metrics_;  // Owned by the caller.
 
   // Keeps lazily-created instances of the device-local account policy services.
   // The keys present in this map are kept in sync with device policy. Entries
@@ -208,6 +208,27 @@ TEST_F(DeviceLocalAccountPolicyServiceTest, RetrieveSuccess) {
   EXPECT_FALSE(policy_data.empty());
 }
 
+TEST_F(DeviceLocalAccountPolicyServiceTest, DropIdleServices) {
+  SetupAccount();
+  SetupKey();
+
+  ASSERT_TRUE(file_util::CreateDirectory(fake_account_policy_path_.DirName()));
+  ASSERT_EQ(policy_blob_.size(),
+            file_util::WriteFile(fake_account_policy_path_,
+                                 policy_blob_.c_str(), policy_blob_.size()));
+
+  std::vector<uint8> policy_data;
+  EXPECT_TRUE(service_->Retrieve(fake_account_, &policy_data));
+  EXPECT_EQ(1, service_->LoadedServiceCount());
+  EXPECT_EQ(1, service_->DropIdleServices());
+  EXPECT_EQ(0, service_->LoadedServiceCount());
+
+  // Policy is read from disk again.
+  policy_data.clear();
+  EXPECT_TRUE(service_->Retrieve(fake_account_, &policy_data));
+  EXPECT_FALSE(policy_data.empty());
+}
+
 TEST_F(DeviceLocalAccountPolicyServiceTest, PurgeStaleAccounts) {
   SetupKey();
 
@@ -6,10 +6,12 @@
 
 #include <secmodt.h>
 
+#include <base/bind.h>
 #include <base/file_path.h>
 #include <base/file_util.h>
 #include <base/logging.h>
 #include <base/message_loop_proxy.h>
+#include <base/sequenced_task_runner.h>
 #include <chromeos/switches/chrome_switches.h>
 #include <crypto/rsa_private_key.h>
 #include <crypto/scoped_nss_types.h>
@@ -35,8 +37,24 @@ const char DevicePolicyService::kPolicyPath[] = "/var/lib/whitelist/policy";
 const char DevicePolicyService::kSerialRecoveryFlagFile[] =
     "/var/lib/enterprise_serial_number_recovery";
 // static
+const char DevicePolicyService::kInstallAttributesFile[] =
+    "/home/.shadow/install_attributes.pb";
+// static
 const char DevicePolicyService::kDevicePolicyType[] = "google/chromeos/device";
 
+// Owner properties being signed by StoreOwnerPropertiesAsync().
+struct DevicePolicyService::OwnerPropertiesUpdate {
+  OwnerPropertiesUpdate() : signed_ok(false) {}
+
+  std::string current_user;
+  scoped_ptr<RSAPrivateKey> signing_key;
+  // The policy data the update was made from, and the updated one.
+  std::string base_policy_data;
+  std::string new_data;
+  std::vector<uint8> signature;
+  bool signed_ok;
+};
+
 DevicePolicyService::~DevicePolicyService() {
 }
 
@@ -64,19 +82,22 @@ bool DevicePolicyService::CheckAndHandleOwnerLogin(
     bool* is_owner,
     Error* error) {
   // If the current user is the owner, and isn't whitelisted or set as the owner
-  // in the settings blob, then do so.
+  // in the settings blob, then do so. That is done in the background, so that
+  // the session can start meanwhile; once it is, policy names her the owner
+  // unless the device is enterprise managed.
   scoped_ptr<RSAPrivateKey> signing_key(
       GetOwnerKeyForGivenUser(key()->public_key_der(), slot, error));
   if (signing_key.get()) {
-    if (!StoreOwnerProperties(current_user, signing_key.get(), error))
-      return false;
+    *is_owner = !IsEnterpriseManaged();
+    StoreOwnerPropertiesAsync(current_user, signing_key.Pass());
+    return true;
   }
 
   // Now, the flip side...if we believe the current user to be the owner based
   // on the user field in policy, and she DOESN'T have the private half of the
   // public key, we must mitigate.
   *is_owner = GivenUserIsOwner(current_user);
-  if (*is_owner && !signing_key.get()) {
+  if (*is_owner) {
     if (!mitigator_->Mitigate(current_user))
       return false;
   }
@@ -99,14 +120,18 @@ bool DevicePolicyService::ValidateAndStoreOwnerKey(
   if (mitigator_->Mitigating()) {
     // Mitigating: Depending on whether the public key is still present, either
     // clobber or populate regularly.
-    if (!(key()->IsPopulated() ? key()->ClobberCompromisedKey(pub_key)
-                               : key()->PopulateFromBuffer(pub_key))) {
+    const bool clobber = key()->IsPopulated();
+    if (!(clobber ? key()->ClobberCompromisedKey(pub_key)
+                  : key()->PopulateFromBuffer(pub_key))) {
       return false;
     }
+    stats()->Increment(clobber ? PolicyStats::KEY_CLOBBER
+                               : PolicyStats::KEY_INSTALL);
   } else {
     // Not mitigating, so regular key population should work.
     if (!key()->PopulateFromBuffer(pub_key))
       return false;
+    stats()->Increment(PolicyStats::KEY_INSTALL);
     // Clear policy in case we're re-establishing ownership.
     store()->Set(em::PolicyFetchResponse());
   }
@@ -132,9 +157,13 @@ DevicePolicyService::DevicePolicyService(
     : PolicyService(policy_store.Pass(), policy_key, main_loop),
       serial_recovery_flag_file_(serial_recovery_flag_file),
       policy_file_(policy_file),
+      install_attributes_file_(kInstallAttributesFile),
       metrics_(metrics),
       mitigator_(mitigator.Pass()),
-      nss_(nss) {
+      nss_(nss),
+      serial_recovery_needed_(false) {
+  stats()->set_kind(PolicyStats::DEVICE);
+  stats()->set_metrics(metrics);
 }
 
 bool DevicePolicyService::KeyMissing() {
@@ -191,17 +220,21 @@ void DevicePolicyService::ReportPolicyFileMetrics(bool key_success,
     }
   }
 
-  if (!policy_success) {
-    status.policy_file_state = LoginMetrics::MALFORMED;
-  } else {
-    std::string serialized;
-    if (!store()->Get().SerializeToString(&serialized))
-      status.policy_file_state = LoginMetrics::MALFORMED;
-    else if (serialized == "")
+  switch (store()->GetFileState()) {
+    case PolicyStore::FILE_NOT_PRESENT:
       status.policy_file_state = LoginMetrics::NOT_PRESENT;
-    else
+      break;
+    case PolicyStore::FILE_GOOD:
       status.policy_file_state = LoginMetrics::GOOD;
+      break;
+    case PolicyStore::FILE_TORN:
+      status.policy_file_state = LoginMetrics::TORN;
+      break;
+    default:
+      status.policy_file_state = LoginMetrics::MALFORMED;
   }
+  DCHECK(policy_success || status.policy_file_state == LoginMetrics::TORN ||
+         status.policy_file_state == LoginMetrics::MALFORMED);
 
   if (store()->DefunctPrefsFilePresent())
     status.defunct_prefs_file_state = LoginMetrics::GOOD;
@@ -248,10 +281,69 @@ const em::ChromeDeviceSettingsProto& DevicePolicyService::GetSettings() {
   return *settings_;
 }
 
+bool DevicePolicyService::MachineInfoNeeded() {
+  if (serial_recovery_needed_)
+    return true;
+
+  // Old versions of Chromium OS (11 and earlier) didn't have cryptohome create
+  // the install attributes when claiming the device, so also check for the
+  // owner key to catch devices that were set up on these versions.
+  return !key()->IsPopulated() &&
+      !file_util::PathExists(install_attributes_file_);
+}
+
 bool DevicePolicyService::StoreOwnerProperties(const std::string& current_user,
                                                RSAPrivateKey* signing_key,
                                                Error* error) {
   CHECK(signing_key);
+  std::string new_data;
+  if (!BuildOwnerProperties(current_user, &new_data))
+    return true;  // No changes are needed.
+
+  std::vector<uint8> sig;
+  const uint8* data = reinterpret_cast<const uint8*>(new_data.c_str());
+  if (!nss_->Sign(data, new_data.length(), &sig, signing_key)) {
+    const char err_msg[] = "Could not sign policy containing new owner data.";
+    if (error) {
+      LOG(WARNING) << err_msg;
+      error->Set(CHROMEOS_LOGIN_ERROR_ILLEGAL_PUBKEY, err_msg);
+    } else {
+      LOG(ERROR) << err_msg;
+    }
+    return false;
+  }
+  InstallOwnerProperties(new_data, sig);
+  return true;
+}
+
+void DevicePolicyService::StoreOwnerPropertiesAsync(
+    const std::string& current_user,
+    scoped_ptr<RSAPrivateKey> signing_key) {
+  scoped_ptr<OwnerPropertiesUpdate> update(new OwnerPropertiesUpdate);
+  if (!BuildOwnerProperties(current_user, &update->new_data))
+    return;  // No changes are needed.
+  update->current_user = current_user;
+  update->base_policy_data = store()->Get().policy_data();
+  update->signing_key = signing_key.Pass();
+
+  // Signing is the slow part, so it is done on |io_runner()| when there is
+  // one; the policy write that follows is queued there anyway.
+  OwnerPropertiesUpdate* raw_update = update.get();
+  const scoped_refptr<base::TaskRunner> runner =
+      io_runner().get() ? static_cast<base::TaskRunner*>(io_runner().get())
+                        : main_loop().get();
+  if (!runner->PostTaskAndReply(
+          FROM_HERE,
+          base::Bind(&DevicePolicyService::SignOwnerProperties, nss_,
+                     raw_update),
+          base::Bind(&DevicePolicyService::OnOwnerPropertiesSigned, this,
+                     base::Owned(update.release())))) {
+    LOG(ERROR) << "Can't schedule signing of new owner data.";
+  }
+}
+
+bool DevicePolicyService::BuildOwnerProperties(const std::string& current_user,
+                                               std::string* new_data) {
   const em::PolicyFetchResponse& policy(store()->Get());
   em::PolicyData poldata;
   if (policy.has_policy_data())
@@ -281,7 +373,7 @@ bool DevicePolicyService::StoreOwnerProperties(const std::string& current_user,
   if (poldata.has_username() && poldata.username() == current_user &&
       on_list &&
       key()->Equals(policy.new_public_key())) {
-    return true;  // No changes are needed.
+    return false;
   }
   if (!on_list) {
     // Add owner to the whitelist and turn off whitelist enforcement if it is
@@ -293,23 +385,53 @@ bool DevicePolicyService::StoreOwnerProperties(const std::string& current_user,
   poldata.set_username(current_user);
 
   // We have now updated the whitelist and owner setting in |polval|.
-  // We need to put it into |poldata|, serialize that, sign it, and
-  // write it back.
+  // We need to put it into |poldata| and serialize that, to be signed and
+  // written back.
   poldata.set_policy_value(polval.SerializeAsString());
-  std::string new_data = poldata.SerializeAsString();
-  std::vector<uint8> sig;
-  const uint8* data = reinterpret_cast<const uint8*>(new_data.c_str());
-  if (!nss_->Sign(data, new_data.length(), &sig, signing_key)) {
-    const char err_msg[] = "Could not sign policy containing new owner data.";
-    if (error) {
-      LOG(WARNING) << err_msg;
-      error->Set(CHROMEOS_LOGIN_ERROR_ILLEGAL_PUBKEY, err_msg);
-    } else {
-      LOG(ERROR) << err_msg;
+  *new_data = poldata.SerializeAsString();
+  return true;
+}
+
+// static
+void DevicePolicyService::SignOwnerProperties(NssUtil* nss,
+                                              OwnerPropertiesUpdate* update) {
+  const uint8* data = reinterpret_cast<const uint8*>(update->new_data.c_str());
+  update->signed_ok = nss->Sign(data, update->new_data.length(),
+                                &update->signature, update->signing_key.get());
+}
+
+void DevicePolicyService::OnOwnerPropertiesSigned(
+    OwnerPropertiesUpdate* update) {
+  DCHECK(main_loop()->BelongsToCurrentThread());
+  if (!update->signed_ok) {
+    LOG(ERROR) << "Could not sign policy containing new owner data.";
+    stats()->Increment(PolicyStats::OWNER_SIGN_FAILURE);
+    if (delegate())
+      delegate()->OnPolicyPersisted(false);
+    return;
+  }
+  if (store()->Get().policy_data() != update->base_policy_data) {
+    // Policy was stored while signing; redo the update on top of it, unless
+    // that policy came with a new owner key, which |signing_key| isn't.
+    std::vector<uint8> signing_key_der;
+    if (!update->signing_key->ExportPublicKey(&signing_key_der) ||
+        signing_key_der != key()->public_key_der()) {
+      LOG(WARNING) << "Owner key changed while signing; dropping new owner "
+                   << "data.";
+      return;
     }
-    return false;
+    StoreOwnerPropertiesAsync(update->current_user,
+                              update->signing_key.Pass());
+    return;
   }
+  InstallOwnerProperties(update->new_data, update->signature);
+  PersistPolicy();
+}
 
+void DevicePolicyService::InstallOwnerProperties(
+    const std::string& new_data,
+    const std::vector<uint8>& sig) {
+  const em::PolicyFetchResponse& policy(store()->Get());
   em::PolicyFetchResponse new_policy;
   new_policy.CheckTypeAndMergeFrom(policy);
   new_policy.set_policy_data(new_data);
@@ -319,7 +441,8 @@ bool DevicePolicyService::StoreOwnerProperties(const std::string& current_user,
   new_policy.set_new_public_key(
       std::string(reinterpret_cast<const char*>(&key_der[0]), key_der.size()));
   store()->Set(new_policy);
-  return true;
+  // The whitelist and allow_new_users may have changed.
+  settings_.reset();
 }
 
 RSAPrivateKey* DevicePolicyService::GetOwnerKeyForGivenUser(
@@ -350,6 +473,14 @@ bool DevicePolicyService::GivenUserIsOwner(const std::string& current_user) {
   return false;
 }
 
+bool DevicePolicyService::IsEnterpriseManaged() {
+  const em::PolicyFetchResponse& policy(store()->Get());
+  em::PolicyData poldata;
+  return policy.has_policy_data() &&
+         poldata.ParseFromString(policy.policy_data()) &&
+         poldata.has_request_token();
+}
+
 void DevicePolicyService::UpdateSerialNumberRecoveryFlagFile() {
   const em::PolicyFetchResponse& policy(store()->Get());
   em::PolicyData policy_data;
@@ -372,6 +503,7 @@ void DevicePolicyService::UpdateSerialNumberRecoveryFlagFile() {
   // TODO(pastarmovj,wad): Only check if file is missing if enterprise enrolled.
   // To check that we need to access the install attributes here.
   // For more info see: http://crosbug.com/31537
+  serial_recovery_needed_ = recovery_needed;
   if (recovery_needed) {
     if (file_util::WriteFile(serial_recovery_flag_file_, NULL, 0) != 0) {
       PLOG(WARNING) << "Failed to write "
@@ -6,6 +6,7 @@
 #define LOGIN_MANAGER_DEVICE_POLICY_SERVICE_H_
 
 #include <string>
+#include <vector>
 
 #include <dbus/dbus-glib-lowlevel.h>
 
@@ -52,6 +53,7 @@ class DevicePolicyService : public PolicyService {
   // the check is returned in |is_owner|. If so, it is validated that the device
   // policy settings are set up appropriately:
   // - If |current_user| has the owner key, put her on the login white list.
+  //   This is signed and persisted in the background, after this returns.
   // - If policy claims |current_user| is the device owner but she doesn't
   //   appear to have the owner key, run key mitigation.
   // Returns true on success. Fills in |error| upon encountering an error.
@@ -92,6 +94,11 @@ class DevicePolicyService : public PolicyService {
   virtual const enterprise_management::ChromeDeviceSettingsProto&
       GetSettings();
 
+  // Returns true if OOBE or enterprise enrollment may need the machine info,
+  // i.e. if serial number recovery is needed or the device hasn't been claimed
+  // yet. Only meaningful after Initialize().
+  virtual bool MachineInfoNeeded();
+
   // PolicyService:
   virtual bool Store(const uint8* policy_blob,
                      uint32 len,
@@ -101,6 +108,10 @@ class DevicePolicyService : public PolicyService {
   static const char kPolicyPath[];
   static const char kSerialRecoveryFlagFile[];
 
+  // Created by cryptohome once the device has been enterprise-enrolled or
+  // claimed by a local user.
+  static const char kInstallAttributesFile[];
+
   // Format of this string is documented in device_management_backend.proto.
   static const char kDevicePolicyType[];
 
@@ -118,16 +129,42 @@ class DevicePolicyService : public PolicyService {
                       scoped_ptr<OwnerKeyLossMitigator> mitigator,
                       NssUtil* nss);
 
+  struct OwnerPropertiesUpdate;
+
   // Given the private half of the owner keypair, this call whitelists
   // |current_user| and sets a property indicating
-  // |current_user| is the owner in the current policy and schedules a
-  // PersistPolicy().
+  // |current_user| is the owner in the current policy.
   // Returns false on failure, with |error| set appropriately. |error| can be
   // NULL, should you wish to ignore the particulars.
   bool StoreOwnerProperties(const std::string& current_user,
                             crypto::RSAPrivateKey* signing_key,
                             Error* error);
 
+  // Same, but signs off the main loop and persists the policy once done. The
+  // outcome is reported to the delegate's OnPolicyPersisted(); signing
+  // failures are also counted in stats().
+  void StoreOwnerPropertiesAsync(
+      const std::string& current_user,
+      scoped_ptr<crypto::RSAPrivateKey> signing_key);
+
+  // Puts |current_user| on the whitelist and in the owner field of a copy of
+  // the current policy data, serialized into |new_data|. Returns false if the
+  // policy already has both, and the current key.
+  bool BuildOwnerProperties(const std::string& current_user,
+                            std::string* new_data);
+
+  // Signs |update| with its key, on any thread.
+  static void SignOwnerProperties(NssUtil* nss, OwnerPropertiesUpdate* update);
+
+  // Installs and persists |update| once signed, unless policy has been stored
+  // in the meantime, in which case it is built anew; or dropped, if the owner
+  // key is no longer the one |update| was signed with.
+  void OnOwnerPropertiesSigned(OwnerPropertiesUpdate* update);
+
+  // Stores |new_data| with its signature |sig| and the current key as policy.
+  void InstallOwnerProperties(const std::string& new_data,
+                              const std::vector<uint8>& sig);
+
   // Checks the user's NSS database to see if she has the private key.
   // Returns a pointer to it if so.
   crypto::RSAPrivateKey* GetOwnerKeyForGivenUser(
@@ -139,12 +176,16 @@ class DevicePolicyService : public PolicyService {
   // device owner.  Returns false if not, or if that cannot be determined.
   bool GivenUserIsOwner(const std::string& current_user);
 
+  // Returns true if |policy_| came from enterprise enrollment.
+  bool IsEnterpriseManaged();
+
   // Checks the serial number recovery flag and updates the flag file.
   // TODO(mnissler): Remove once bogus enterprise serials are fixed.
   void UpdateSerialNumberRecoveryFlagFile();
 
   const FilePath serial_recovery_flag_file_;
   const FilePath policy_file_;
+  FilePath install_attributes_file_;
   LoginMetrics* metrics_;
   scoped_ptr<OwnerKeyLossMitigator> mitigator_;
   NssUtil* nss_;
@@ -154,6 +195,9 @@ class DevicePolicyService : public PolicyService {
   // Store().
   scoped_ptr<enterprise_management::ChromeDeviceSettingsProto> settings_;
 
+  // Result of the last serial number recovery check.
+  bool serial_recovery_needed_;
+
   DISALLOW_COPY_AND_ASSIGN(DevicePolicyService);
 };
 
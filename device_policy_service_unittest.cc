@@ -35,6 +35,7 @@ namespace em = enterprise_management;
 using google::protobuf::RepeatedPtrField;
 
 using testing::AnyNumber;
+using testing::Assign;
 using testing::AtLeast;
 using testing::DoAll;
 using testing::Expectation;
@@ -73,6 +74,8 @@ class DevicePolicyServiceTest : public ::testing::Test {
         tmpdir_.path().AppendASCII("serial_recovery_flag");
     policy_file_ =
         tmpdir_.path().AppendASCII("policy");
+    install_attributes_file_ =
+        tmpdir_.path().AppendASCII("install_attributes.pb");
   }
 
   void InitPolicy(const em::ChromeDeviceSettingsProto& settings,
@@ -111,6 +114,9 @@ class DevicePolicyServiceTest : public ::testing::Test {
   void InitService(NssUtil* nss) {
     store_ = new StrictMock<MockPolicyStore>;
     metrics_.reset(new MockMetrics);
+    // Operational stats, see PolicyStats.
+    EXPECT_CALL(*metrics_, SendEnum(_, _, _)).Times(AnyNumber());
+    EXPECT_CALL(*metrics_, SendHistogram(_, _, _, _, _)).Times(AnyNumber());
     mitigator_ = new StrictMock<MockMitigator>;
     scoped_refptr<base::MessageLoopProxy> message_loop(
         base::MessageLoopProxy::current());
@@ -123,6 +129,7 @@ class DevicePolicyServiceTest : public ::testing::Test {
         metrics_.get(),
         scoped_ptr<OwnerKeyLossMitigator>(mitigator_),
         nss);
+    service_->install_attributes_file_ = install_attributes_file_;
 
     // Allow the key to be read any time.
     EXPECT_CALL(key_, public_key_der())
@@ -253,15 +260,26 @@ class DevicePolicyServiceTest : public ::testing::Test {
   LoginMetrics::PolicyFileState SimulateNullPolicy() {
     EXPECT_CALL(*store_, Get())
         .WillRepeatedly(ReturnRef(new_policy_proto_));
+    EXPECT_CALL(*store_, GetFileState())
+        .WillRepeatedly(Return(PolicyStore::FILE_NOT_PRESENT));
     return LoginMetrics::NOT_PRESENT;
   }
 
   LoginMetrics::PolicyFileState SimulateGoodPolicy() {
     InitEmptyPolicy(owner_, fake_sig_, "");
     EXPECT_CALL(*store_, Get()).WillRepeatedly(ReturnRef(policy_proto_));
+    EXPECT_CALL(*store_, GetFileState())
+        .WillRepeatedly(Return(PolicyStore::FILE_GOOD));
     return LoginMetrics::GOOD;
   }
 
+  LoginMetrics::PolicyFileState SimulateUnloadablePolicy(
+      PolicyStore::FileState state) {
+    EXPECT_CALL(*store_, GetFileState()).WillRepeatedly(Return(state));
+    return state == PolicyStore::FILE_TORN ? LoginMetrics::TORN
+                                           : LoginMetrics::MALFORMED;
+  }
+
   LoginMetrics::PolicyFileState SimulateNullPrefs() {
     EXPECT_CALL(*store_, DefunctPrefsFilePresent()).WillOnce(Return(false));
     return LoginMetrics::NOT_PRESENT;
@@ -307,6 +325,7 @@ class DevicePolicyServiceTest : public ::testing::Test {
   base::ScopedTempDir tmpdir_;
   FilePath serial_recovery_flag_file_;
   FilePath policy_file_;
+  FilePath install_attributes_file_;
 
   // Use StrictMock to make sure that no unexpected policy or key mutations can
   // occur without the test failing.
@@ -340,6 +359,11 @@ TEST_F(DevicePolicyServiceTest, CheckAndHandleOwnerLogin_SuccessEmptyPolicy) {
                                                  &is_owner,
                                                  &error));
   EXPECT_TRUE(is_owner);
+
+  // Owner properties are signed and persisted in the background.
+  EXPECT_CALL(*store_, Persist())
+      .WillOnce(Return(true));
+  base::RunLoop().RunUntilIdle();
   EXPECT_NO_FATAL_FAILURE(CheckNewOwnerSettings(settings));
 }
 
@@ -366,6 +390,11 @@ TEST_F(DevicePolicyServiceTest, CheckAndHandleOwnerLogin_SuccessAddOwner) {
                                                  &is_owner,
                                                  &error));
   EXPECT_TRUE(is_owner);
+
+  // Owner properties are signed and persisted in the background.
+  EXPECT_CALL(*store_, Persist())
+      .WillOnce(Return(true));
+  base::RunLoop().RunUntilIdle();
   EXPECT_NO_FATAL_FAILURE(CheckNewOwnerSettings(settings));
 }
 
@@ -394,6 +423,11 @@ TEST_F(DevicePolicyServiceTest, CheckAndHandleOwnerLogin_SuccessOwnerPresent) {
                                                  &is_owner,
                                                  &error));
   EXPECT_TRUE(is_owner);
+
+  // Owner properties are signed and persisted in the background.
+  EXPECT_CALL(*store_, Persist())
+      .WillOnce(Return(true));
+  base::RunLoop().RunUntilIdle();
   EXPECT_NO_FATAL_FAILURE(CheckNewOwnerSettings(settings));
 }
 
@@ -547,10 +581,56 @@ TEST_F(DevicePolicyServiceTest, CheckAndHandleOwnerLogin_SigningFailure) {
 
   PolicyService::Error error;
   bool is_owner = false;
-  EXPECT_FALSE(service_->CheckAndHandleOwnerLogin(owner_,
-                                                  nss.GetSlot(),
-                                                  &is_owner,
-                                                  &error));
+  EXPECT_TRUE(service_->CheckAndHandleOwnerLogin(owner_,
+                                                 nss.GetSlot(),
+                                                 &is_owner,
+                                                 &error));
+  EXPECT_TRUE(is_owner);
+
+  // The failure shows up once signing has been attempted, and leaves policy
+  // as it was.
+  EXPECT_CALL(*store_, Set(_)).Times(0);
+  EXPECT_CALL(*store_, Persist()).Times(0);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::OWNER_SIGN_FAILURE));
+}
+
+TEST_F(DevicePolicyServiceTest,
+       CheckAndHandleOwnerLogin_KeyRotatedWhileSigning) {
+  KeyCheckUtil nss;
+  InitService(&nss);
+  em::ChromeDeviceSettingsProto settings;
+  ASSERT_NO_FATAL_FAILURE(InitPolicy(settings, owner_, fake_sig_, "", false));
+
+  // Policy carrying a new owner key is stored while the owner data is being
+  // signed. |key_| doesn't match the signing key, so the update is dropped
+  // rather than redone with the stale key.
+  em::PolicyFetchResponse rotated_policy(policy_proto_);
+  rotated_policy.set_policy_data("rotated");
+  EXPECT_CALL(*store_, Get())
+      .WillRepeatedly(ReturnRef(policy_proto_));
+  EXPECT_CALL(key_, Equals(_))
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(nss, Sign(_, _, _, _))
+      .WillOnce(DoAll(Assign(&policy_proto_, rotated_policy),
+                      WithArg<2>(AssignVector(new_fake_sig_)),
+                      Return(true)));
+  EXPECT_CALL(*mitigator_, Mitigate(_))
+      .Times(0);
+  ExpectKeyPopulated(true);
+
+  PolicyService::Error error;
+  bool is_owner = false;
+  EXPECT_TRUE(service_->CheckAndHandleOwnerLogin(owner_,
+                                                 nss.GetSlot(),
+                                                 &is_owner,
+                                                 &error));
+  EXPECT_TRUE(is_owner);
+
+  EXPECT_CALL(*store_, Set(_)).Times(0);
+  EXPECT_CALL(*store_, Persist()).Times(0);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ("rotated", policy_proto_.policy_data());
 }
 
 TEST_F(DevicePolicyServiceTest, ValidateAndStoreOwnerKey_SuccessNewKey) {
@@ -770,7 +850,22 @@ TEST_F(DevicePolicyServiceTest, Metrics_GoodKeyUnloadablePolicyNoPrefs) {
 
   LoginMetrics::PolicyFilesStatus status;
   status.owner_key_file_state = SimulateGoodOwnerKey(&nss);
-  status.policy_file_state = LoginMetrics::MALFORMED;
+  status.policy_file_state =
+      SimulateUnloadablePolicy(PolicyStore::FILE_MALFORMED);
+  status.defunct_prefs_file_state = SimulateNullPrefs();
+
+  EXPECT_CALL(*metrics_.get(), SendPolicyFilesStatus(StatusEq(status)))
+      .Times(1);
+  service_->ReportPolicyFileMetrics(true, false);
+}
+
+TEST_F(DevicePolicyServiceTest, Metrics_GoodKeyTornPolicyNoPrefs) {
+  MockNssUtil nss;
+  InitService(&nss);
+
+  LoginMetrics::PolicyFilesStatus status;
+  status.owner_key_file_state = SimulateGoodOwnerKey(&nss);
+  status.policy_file_state = SimulateUnloadablePolicy(PolicyStore::FILE_TORN);
   status.defunct_prefs_file_state = SimulateNullPrefs();
 
   EXPECT_CALL(*metrics_.get(), SendPolicyFilesStatus(StatusEq(status)))
@@ -821,6 +916,8 @@ TEST_F(DevicePolicyServiceTest, SerialRecoveryFlagFileInitialization) {
       .WillRepeatedly(Return(true));
   EXPECT_CALL(*store_, LoadOrCreate())
       .WillRepeatedly(Return(true));
+  EXPECT_CALL(*store_, GetFileState())
+      .WillRepeatedly(Return(PolicyStore::FILE_GOOD));
   EXPECT_CALL(*store_, Get())
       .WillRepeatedly(ReturnRef(policy_proto_));
   EXPECT_CALL(*store_, DefunctPrefsFilePresent())
@@ -859,6 +956,7 @@ TEST_F(DevicePolicyServiceTest, SerialRecoveryFlagFileUpdating) {
   EXPECT_CALL(key_, Verify(_, _, _, _))
       .WillRepeatedly(Return(true));
   EXPECT_CALL(*store_, Set(_)).Times(AnyNumber());
+  EXPECT_CALL(*store_, Swap(_)).Times(AnyNumber());
   EXPECT_CALL(*store_, Get())
       .WillRepeatedly(ReturnRef(policy_proto_));
   EXPECT_CALL(completion_, Success()).Times(AnyNumber());
@@ -896,6 +994,58 @@ TEST_F(DevicePolicyServiceTest, SerialRecoveryFlagFileUpdating) {
   EXPECT_FALSE(file_util::PathExists(serial_recovery_flag_file_));
 }
 
+TEST_F(DevicePolicyServiceTest, MachineInfoNeeded) {
+  // Fake the policy file existence.
+  file_util::WriteFile(policy_file_, ".", 1);
+
+  MockNssUtil nss;
+  InitService(&nss);
+
+  EXPECT_CALL(nss, CheckPublicKeyBlob(fake_key_vector_))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(key_, PopulateFromDiskIfPossible())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*store_, LoadOrCreate())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*store_, GetFileState())
+      .WillRepeatedly(Return(PolicyStore::FILE_GOOD));
+  EXPECT_CALL(*store_, Get())
+      .WillRepeatedly(ReturnRef(policy_proto_));
+  EXPECT_CALL(*store_, DefunctPrefsFilePresent())
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*metrics_.get(), SendPolicyFilesStatus(_))
+      .Times(AnyNumber());
+
+  // An owned device with consumer policy doesn't need machine info.
+  EXPECT_CALL(key_, IsPopulated())
+      .WillRepeatedly(Return(true));
+  em::ChromeDeviceSettingsProto settings;
+  ASSERT_NO_FATAL_FAILURE(InitPolicy(settings, owner_, fake_sig_, "", false));
+  EXPECT_TRUE(service_->Initialize());
+  EXPECT_FALSE(service_->MachineInfoNeeded());
+
+  // Serial number recovery requires it.
+  ASSERT_NO_FATAL_FAILURE(InitPolicy(settings, owner_, fake_sig_, "t", true));
+  EXPECT_TRUE(service_->Initialize());
+  EXPECT_TRUE(service_->MachineInfoNeeded());
+  Mock::VerifyAndClearExpectations(&key_);
+
+  // So does an unowned device...
+  EXPECT_CALL(key_, public_key_der())
+      .WillRepeatedly(ReturnRef(fake_key_vector_));
+  EXPECT_CALL(key_, PopulateFromDiskIfPossible())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(key_, IsPopulated())
+      .WillRepeatedly(Return(false));
+  ASSERT_NO_FATAL_FAILURE(InitPolicy(settings, "", fake_sig_, "", false));
+  EXPECT_TRUE(service_->Initialize());
+  EXPECT_TRUE(service_->MachineInfoNeeded());
+
+  // ...unless cryptohome has already recorded the install attributes.
+  file_util::WriteFile(install_attributes_file_, ".", 1);
+  EXPECT_FALSE(service_->MachineInfoNeeded());
+}
+
 TEST_F(DevicePolicyServiceTest, GetSettings) {
   MockNssUtil nss;
   InitService(&nss);
@@ -915,6 +1065,7 @@ TEST_F(DevicePolicyServiceTest, GetSettings) {
   EXPECT_CALL(*store_, Persist())
       .WillRepeatedly(Return(true));
   EXPECT_CALL(*store_, Set(_)).Times(AnyNumber());
+  EXPECT_CALL(*store_, Swap(_)).Times(AnyNumber());
   EXPECT_CALL(*store_, Get())
       .WillRepeatedly(ReturnRef(policy_proto_));
   EXPECT_CALL(completion_, Success()).Times(AnyNumber());
@@ -948,6 +1099,7 @@ TEST_F(DevicePolicyServiceTest, StartUpFlagsSanitizer) {
   EXPECT_CALL(*store_, Persist())
       .WillRepeatedly(Return(true));
   EXPECT_CALL(*store_, Set(_)).Times(AnyNumber());
+  EXPECT_CALL(*store_, Swap(_)).Times(AnyNumber());
   EXPECT_CALL(*store_, Get())
       .WillRepeatedly(ReturnRef(policy_proto_));
   EXPECT_CALL(completion_, Success()).Times(AnyNumber());
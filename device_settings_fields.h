@@ -0,0 +1,31 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_DEVICE_SETTINGS_FIELDS_H_
+#define LOGIN_MANAGER_DEVICE_SETTINGS_FIELDS_H_
+
+// The device settings that system daemons can read without parsing the policy
+// blob, as X(message, field) for ChromeDeviceSettingsProto.message().field().
+// The settings proto is built for the lite runtime, which has no reflection,
+// so everything that needs to know about fields is generated from this list.
+//
+// The position of a field in the list is its id in device settings snapshots,
+// see DeviceSettingsSnapshot, so new fields must be added at the end.
+#define DEVICE_SETTINGS_FIELDS(X)                                    \
+  X(allow_new_users, allow_new_users)                                \
+  X(auto_update_settings, scatter_factor_in_seconds)                 \
+  X(auto_update_settings, target_version_prefix)                     \
+  X(auto_update_settings, update_disabled)                           \
+  X(camera_enabled, camera_enabled)                                  \
+  X(data_roaming_enabled, data_roaming_enabled)                      \
+  X(device_policy_refresh_rate, device_policy_refresh_rate)          \
+  X(ephemeral_users_enabled, ephemeral_users_enabled)                \
+  X(guest_mode_enabled, guest_mode_enabled)                          \
+  X(metrics_enabled, metrics_enabled)                                \
+  X(release_channel, release_channel)                                \
+  X(release_channel, release_channel_delegated)                      \
+  X(show_user_names, show_user_names)                                \
+  X(system_timezone, timezone)
+
+#endif  // LOGIN_MANAGER_DEVICE_SETTINGS_FIELDS_H_
@@ -0,0 +1,139 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/device_settings_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace login_manager {
+
+// Readers built against another version of this file rely on these.
+COMPILE_ASSERT(sizeof(DeviceSettingsSnapshot::Header) == 16,
+               snapshot_header_layout_changed);
+COMPILE_ASSERT(sizeof(DeviceSettingsSnapshot::Entry) == 16,
+               snapshot_entry_layout_changed);
+
+// static
+const uint32 DeviceSettingsSnapshot::kMagic = 0x53534544;  // "DESS"
+// static
+const uint32 DeviceSettingsSnapshot::kVersion = 1;
+// static
+const char DeviceSettingsSnapshot::kPath[] =
+    "/var/run/session_manager/device_settings";
+
+DeviceSettingsSnapshot::DeviceSettingsSnapshot()
+    : data_(NULL),
+      header_(NULL),
+      mapping_(NULL),
+      mapping_size_(0) {
+}
+
+DeviceSettingsSnapshot::~DeviceSettingsSnapshot() {
+  Reset();
+}
+
+bool DeviceSettingsSnapshot::Open(const base::FilePath& path) {
+  Reset();
+  int fd = HANDLE_EINTR(open(path.value().c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    PLOG(ERROR) << "Can't open " << path.value();
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+    LOG(ERROR) << path.value() << " is too short";
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Can't map " << path.value();
+    return false;
+  }
+  if (!Init(mapping, st.st_size)) {
+    LOG(ERROR) << path.value() << " isn't a valid snapshot";
+    munmap(mapping, st.st_size);
+    return false;
+  }
+  mapping_ = mapping;
+  mapping_size_ = st.st_size;
+  return true;
+}
+
+bool DeviceSettingsSnapshot::Init(const void* data, size_t size) {
+  Reset();
+  if (reinterpret_cast<uintptr_t>(data) % sizeof(int64) != 0 ||
+      size < sizeof(Header)) {
+    return false;
+  }
+  const Header* header = static_cast<const Header*>(data);
+  // Checked one at a time, so that a huge field count can't overflow.
+  if (header->magic != kMagic || header->version != kVersion ||
+      header->size != size ||
+      header->field_count > (size - sizeof(Header)) / sizeof(Entry)) {
+    return false;
+  }
+  data_ = static_cast<const char*>(data);
+  header_ = header;
+  return true;
+}
+
+bool DeviceSettingsSnapshot::GetBool(FieldId id, bool* value) const {
+  const Entry* entry = GetEntry(id, TYPE_BOOL);
+  if (!entry)
+    return false;
+  *value = entry->value != 0;
+  return true;
+}
+
+bool DeviceSettingsSnapshot::GetInt64(FieldId id, int64* value) const {
+  const Entry* entry = GetEntry(id, TYPE_INT64);
+  if (!entry)
+    return false;
+  *value = entry->value;
+  return true;
+}
+
+bool DeviceSettingsSnapshot::GetString(FieldId id,
+                                       base::StringPiece* value) const {
+  const Entry* entry = GetEntry(id, TYPE_STRING);
+  if (!entry)
+    return false;
+  // The string and its NUL must lie past the entries, within the snapshot.
+  const uint64 start = sizeof(Header) + header_->field_count * sizeof(Entry);
+  if (entry->value < static_cast<int64>(start) ||
+      static_cast<uint64>(entry->value) + entry->length >= header_->size) {
+    return false;
+  }
+  value->set(data_ + entry->value, entry->length);
+  return true;
+}
+
+const DeviceSettingsSnapshot::Entry* DeviceSettingsSnapshot::GetEntry(
+    FieldId id,
+    Type type) const {
+  if (!header_ || id < 0 || static_cast<uint32>(id) >= header_->field_count)
+    return NULL;
+  const Entry* entry =
+      reinterpret_cast<const Entry*>(data_ + sizeof(Header)) + id;
+  return entry->type == static_cast<uint32>(type) ? entry : NULL;
+}
+
+void DeviceSettingsSnapshot::Reset() {
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+  data_ = NULL;
+  header_ = NULL;
+  mapping_ = NULL;
+  mapping_size_ = 0;
+}
+
+}  // namespace login_manager
@@ -0,0 +1,101 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_H_
+#define LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_H_
+
+#include <stddef.h>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/string_piece.h>
+
+#include "login_manager/device_settings_fields.h"
+
+namespace login_manager {
+
+// Reads device settings out of the flat snapshot the session_manager
+// publishes at kPath whenever device policy is stored, so that system daemons
+// can get at a setting without decoding PolicyFetchResponse, PolicyData and
+// ChromeDeviceSettingsProto in turn. Doesn't depend on protobuf, or on the
+// rest of login_manager; it is built into libdevice_settings_snapshot.a,
+// which is installed along with this header and device_settings_fields.h.
+//
+// A snapshot is a Header, followed by Header::field_count Entries indexed by
+// FieldId, followed by the string values, each NUL-terminated. All integers
+// are in host byte order. The file is replaced with rename(), so a reader
+// that has it open keeps seeing the snapshot it opened.
+class DeviceSettingsSnapshot {
+ public:
+  // Ids of the fields in DEVICE_SETTINGS_FIELDS, e.g.
+  // FIELD_release_channel_release_channel.
+  enum FieldId {
+#define DEVICE_SETTINGS_FIELD_ID(message, field) FIELD_##message##_##field,
+    DEVICE_SETTINGS_FIELDS(DEVICE_SETTINGS_FIELD_ID)
+#undef DEVICE_SETTINGS_FIELD_ID
+    FIELD_COUNT
+  };
+
+  enum Type {
+    TYPE_UNSET = 0,
+    TYPE_BOOL = 1,
+    TYPE_INT64 = 2,
+    TYPE_STRING = 3,
+  };
+
+  struct Header {
+    uint32 magic;
+    uint32 version;
+    uint32 size;  // Of the whole snapshot, in bytes.
+    uint32 field_count;  // Older snapshots may have fewer than FIELD_COUNT.
+  };
+
+  struct Entry {
+    uint32 type;  // A Type.
+    uint32 length;  // Of string values, without the NUL.
+    int64 value;  // Offset from the start of the snapshot for strings.
+  };
+
+  DeviceSettingsSnapshot();
+  ~DeviceSettingsSnapshot();
+
+  // Maps the snapshot at |path|. Returns false if it can't be read or isn't a
+  // valid snapshot.
+  bool Open(const base::FilePath& path);
+
+  // Uses the |size| bytes at |data|, which must be 8-byte aligned and outlive
+  // this object. Returns false if they aren't a valid snapshot.
+  bool Init(const void* data, size_t size);
+
+  // Set |value| to the value of field |id|. Return false if there is no
+  // snapshot, the field isn't set, or it is of another type.
+  bool GetBool(FieldId id, bool* value) const;
+  bool GetInt64(FieldId id, int64* value) const;
+  bool GetString(FieldId id, base::StringPiece* value) const;
+
+  // Identifies a snapshot, and the version of its layout.
+  static const uint32 kMagic;
+  static const uint32 kVersion;
+
+  // Where the session_manager publishes the snapshot.
+  static const char kPath[];
+
+ private:
+  // Returns the entry for |id| if it is of |type|, or NULL.
+  const Entry* GetEntry(FieldId id, Type type) const;
+
+  // Forgets the snapshot, unmapping it if need be.
+  void Reset();
+
+  const char* data_;
+  const Header* header_;
+  void* mapping_;
+  size_t mapping_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeviceSettingsSnapshot);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_H_
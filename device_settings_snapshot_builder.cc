@@ -0,0 +1,76 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/device_settings_snapshot_builder.h"
+
+#include <vector>
+
+#include <base/stl_util.h>
+
+#include "login_manager/chrome_device_policy.pb.h"
+#include "login_manager/device_settings_fields.h"
+#include "login_manager/device_settings_snapshot.h"
+
+namespace em = enterprise_management;
+
+namespace login_manager {
+
+namespace {
+
+typedef DeviceSettingsSnapshot::Entry Entry;
+
+// Offset of the string values from the start of a snapshot.
+const size_t kStringsOffset = sizeof(DeviceSettingsSnapshot::Header) +
+    DeviceSettingsSnapshot::FIELD_COUNT * sizeof(Entry);
+
+void Store(bool value, Entry* entry, std::string* strings) {
+  entry->type = DeviceSettingsSnapshot::TYPE_BOOL;
+  entry->value = value;
+}
+
+void Store(int64 value, Entry* entry, std::string* strings) {
+  entry->type = DeviceSettingsSnapshot::TYPE_INT64;
+  entry->value = value;
+}
+
+void Store(const std::string& value, Entry* entry, std::string* strings) {
+  entry->type = DeviceSettingsSnapshot::TYPE_STRING;
+  entry->length = value.size();
+  entry->value = kStringsOffset + strings->size();
+  strings->append(value);
+  strings->push_back('\0');
+}
+
+}  // namespace
+
+std::string BuildDeviceSettingsSnapshot(
+    const em::ChromeDeviceSettingsProto& settings) {
+  // Value-initialized, so unset fields are TYPE_UNSET.
+  std::vector<Entry> entries(DeviceSettingsSnapshot::FIELD_COUNT);
+  std::string strings;
+#define DEVICE_SETTING_STORE(message, field)                           \
+  if (settings.has_##message() && settings.message().has_##field()) {  \
+    Store(settings.message().field(),                                  \
+          &entries[DeviceSettingsSnapshot::FIELD_##message##_##field], \
+          &strings);                                                   \
+  }
+  DEVICE_SETTINGS_FIELDS(DEVICE_SETTING_STORE)
+#undef DEVICE_SETTING_STORE
+
+  DeviceSettingsSnapshot::Header header;
+  header.magic = DeviceSettingsSnapshot::kMagic;
+  header.version = DeviceSettingsSnapshot::kVersion;
+  header.size = kStringsOffset + strings.size();
+  header.field_count = entries.size();
+
+  std::string snapshot;
+  snapshot.reserve(header.size);
+  snapshot.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  snapshot.append(reinterpret_cast<const char*>(vector_as_array(&entries)),
+                  entries.size() * sizeof(Entry));
+  snapshot.append(strings);
+  return snapshot;
+}
+
+}  // namespace login_manager
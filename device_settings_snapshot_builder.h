@@ -0,0 +1,23 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_BUILDER_H_
+#define LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_BUILDER_H_
+
+#include <string>
+
+namespace enterprise_management {
+class ChromeDeviceSettingsProto;
+}
+
+namespace login_manager {
+
+// Returns a DeviceSettingsSnapshot of the fields of |settings| listed in
+// device_settings_fields.h.
+std::string BuildDeviceSettingsSnapshot(
+    const enterprise_management::ChromeDeviceSettingsProto& settings);
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_DEVICE_SETTINGS_SNAPSHOT_BUILDER_H_
@@ -0,0 +1,190 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/device_settings_snapshot.h"
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/time.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/chrome_device_policy.pb.h"
+#include "login_manager/device_management_backend.pb.h"
+#include "login_manager/device_settings_snapshot_builder.h"
+
+namespace em = enterprise_management;
+
+namespace login_manager {
+
+class DeviceSettingsSnapshotTest : public ::testing::Test {
+ public:
+  DeviceSettingsSnapshotTest() {}
+  virtual ~DeviceSettingsSnapshotTest() {}
+
+  virtual void SetUp() {
+    settings_.mutable_allow_new_users()->set_allow_new_users(false);
+    settings_.mutable_device_policy_refresh_rate()->
+        set_device_policy_refresh_rate(3600000);
+    settings_.mutable_release_channel()->set_release_channel("beta-channel");
+    settings_.mutable_system_timezone()->set_timezone("Europe/Berlin");
+    snapshot_ = BuildDeviceSettingsSnapshot(settings_);
+  }
+
+ protected:
+  em::ChromeDeviceSettingsProto settings_;
+  std::string snapshot_;
+  DeviceSettingsSnapshot reader_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DeviceSettingsSnapshotTest);
+};
+
+TEST_F(DeviceSettingsSnapshotTest, RoundTrip) {
+  ASSERT_TRUE(reader_.Init(snapshot_.data(), snapshot_.size()));
+
+  bool bool_value = true;
+  EXPECT_TRUE(reader_.GetBool(
+      DeviceSettingsSnapshot::FIELD_allow_new_users_allow_new_users,
+      &bool_value));
+  EXPECT_FALSE(bool_value);
+
+  int64 int_value = 0;
+  EXPECT_TRUE(reader_.GetInt64(
+      DeviceSettingsSnapshot::
+          FIELD_device_policy_refresh_rate_device_policy_refresh_rate,
+      &int_value));
+  EXPECT_EQ(3600000, int_value);
+
+  base::StringPiece string_value;
+  EXPECT_TRUE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+      &string_value));
+  EXPECT_EQ("beta-channel", string_value.as_string());
+  EXPECT_TRUE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_system_timezone_timezone,
+      &string_value));
+  EXPECT_EQ("Europe/Berlin", string_value.as_string());
+  // Strings are NUL-terminated for C readers.
+  EXPECT_EQ('\0', string_value.data()[string_value.size()]);
+}
+
+TEST_F(DeviceSettingsSnapshotTest, UnsetAndMismatchedFields) {
+  ASSERT_TRUE(reader_.Init(snapshot_.data(), snapshot_.size()));
+  bool bool_value;
+  EXPECT_FALSE(reader_.GetBool(
+      DeviceSettingsSnapshot::FIELD_guest_mode_enabled_guest_mode_enabled,
+      &bool_value));
+  base::StringPiece string_value;
+  EXPECT_FALSE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_allow_new_users_allow_new_users,
+      &string_value));
+  EXPECT_FALSE(reader_.GetString(DeviceSettingsSnapshot::FIELD_COUNT,
+                                 &string_value));
+}
+
+TEST_F(DeviceSettingsSnapshotTest, Invalid) {
+  // Copy into an int64 array to keep it aligned.
+  std::vector<int64> buffer(snapshot_.size() / sizeof(int64) + 1);
+  char* data = reinterpret_cast<char*>(&buffer[0]);
+  memcpy(data, snapshot_.data(), snapshot_.size());
+  ASSERT_TRUE(reader_.Init(data, snapshot_.size()));
+
+  EXPECT_FALSE(reader_.Init(data, snapshot_.size() - 1));
+  EXPECT_FALSE(reader_.Init(data + 1, snapshot_.size()));
+  EXPECT_FALSE(reader_.Init(data, sizeof(DeviceSettingsSnapshot::Header) - 1));
+  base::StringPiece string_value;
+  EXPECT_FALSE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+      &string_value));
+
+  DeviceSettingsSnapshot::Header* header =
+      reinterpret_cast<DeviceSettingsSnapshot::Header*>(data);
+  header->version++;
+  EXPECT_FALSE(reader_.Init(data, snapshot_.size()));
+  header->version--;
+  header->field_count = 0xffffffff;
+  EXPECT_FALSE(reader_.Init(data, snapshot_.size()));
+
+  // A string pointing outside the snapshot is ignored.
+  header->field_count = DeviceSettingsSnapshot::FIELD_COUNT;
+  DeviceSettingsSnapshot::Entry* entries =
+      reinterpret_cast<DeviceSettingsSnapshot::Entry*>(header + 1);
+  entries[DeviceSettingsSnapshot::FIELD_release_channel_release_channel]
+      .value = snapshot_.size();
+  ASSERT_TRUE(reader_.Init(data, snapshot_.size()));
+  EXPECT_FALSE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+      &string_value));
+}
+
+TEST_F(DeviceSettingsSnapshotTest, Open) {
+  base::ScopedTempDir tmpdir;
+  ASSERT_TRUE(tmpdir.CreateUniqueTempDir());
+  base::FilePath path = tmpdir.path().AppendASCII("device_settings");
+  EXPECT_FALSE(reader_.Open(path));
+
+  ASSERT_EQ(static_cast<int>(snapshot_.size()),
+            file_util::WriteFile(path, snapshot_.data(), snapshot_.size()));
+  ASSERT_TRUE(reader_.Open(path));
+  // The mapping outlives the file.
+  ASSERT_TRUE(file_util::Delete(path, false));
+  base::StringPiece string_value;
+  EXPECT_TRUE(reader_.GetString(
+      DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+      &string_value));
+  EXPECT_EQ("beta-channel", string_value.as_string());
+}
+
+// Compares reading a setting out of a snapshot with decoding it out of the
+// policy blob. Run with --gtest_also_run_disabled_tests.
+TEST_F(DeviceSettingsSnapshotTest, DISABLED_ReadBenchmark) {
+  const int kReads = 100000;
+  em::PolicyData policy_data;
+  policy_data.set_policy_type("google/chromeos/device");
+  policy_data.set_policy_value(settings_.SerializeAsString());
+  em::PolicyFetchResponse response;
+  response.set_policy_data(policy_data.SerializeAsString());
+  response.set_policy_data_signature(std::string(256, 's'));
+  const std::string blob = response.SerializeAsString();
+
+  size_t total = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kReads; ++i) {
+    em::PolicyFetchResponse decoded_response;
+    em::PolicyData decoded_data;
+    em::ChromeDeviceSettingsProto decoded_settings;
+    ASSERT_TRUE(decoded_response.ParseFromString(blob));
+    ASSERT_TRUE(decoded_data.ParseFromString(decoded_response.policy_data()));
+    ASSERT_TRUE(
+        decoded_settings.ParseFromString(decoded_data.policy_value()));
+    total += decoded_settings.release_channel().release_channel().size();
+  }
+  const base::TimeDelta protobuf = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kReads; ++i) {
+    DeviceSettingsSnapshot reader;
+    base::StringPiece channel;
+    ASSERT_TRUE(reader.Init(snapshot_.data(), snapshot_.size()));
+    ASSERT_TRUE(reader.GetString(
+        DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+        &channel));
+    total += channel.size();
+  }
+  const base::TimeDelta snapshot = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(2U * kReads * strlen("beta-channel"), total);
+  LOG(INFO) << "protobuf: " << protobuf.InMicroseconds() * 1000.0 / kReads
+            << "ns/read, snapshot: "
+            << snapshot.InMicroseconds() * 1000.0 / kReads << "ns/read";
+}
+
+}  // namespace login_manager
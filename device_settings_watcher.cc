@@ -0,0 +1,215 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/device_settings_watcher.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/string_number_conversions.h>
+
+#include "login_manager/chrome_device_policy.pb.h"
+#include "login_manager/device_settings_fields.h"
+
+namespace em = enterprise_management;
+
+namespace login_manager {
+
+// static
+const int DeviceSettingsWatcher::kMaxWatches = 64;
+
+namespace {
+
+std::string Render(bool value) {
+  return value ? "true" : "false";
+}
+
+std::string Render(int64 value) {
+  return base::Int64ToString(value);
+}
+
+std::string Render(const std::string& value) {
+  return value;
+}
+
+typedef bool (*FieldGetter)(const em::ChromeDeviceSettingsProto& settings,
+                            std::string* value);
+
+// Defines Get_<message>_<field>(), which renders the value of
+// |settings.message().field()| if it's set.
+#define DEVICE_SETTING_GETTER(message, field)                          \
+  bool Get_##message##_##field(                                        \
+      const em::ChromeDeviceSettingsProto& settings,                   \
+      std::string* value) {                                            \
+    if (!settings.has_##message() ||                                   \
+        !settings.message().has_##field()) {                           \
+      return false;                                                    \
+    }                                                                  \
+    *value = Render(settings.message().field());                       \
+    return true;                                                       \
+  }
+
+DEVICE_SETTINGS_FIELDS(DEVICE_SETTING_GETTER)
+
+#undef DEVICE_SETTING_GETTER
+
+struct FieldInfo {
+  const char* path;
+  FieldGetter getter;
+};
+
+#define DEVICE_SETTING(message, field) \
+  { #message "." #field, &Get_##message##_##field },
+
+const FieldInfo kFields[] = {
+  DEVICE_SETTINGS_FIELDS(DEVICE_SETTING)
+};
+
+#undef DEVICE_SETTING
+
+// Returns the getter for |path|, or NULL if there's none.
+FieldGetter FindGetter(const std::string& path) {
+  for (size_t i = 0; i < arraysize(kFields); ++i) {
+    if (path == kFields[i].path)
+      return kFields[i].getter;
+  }
+  return NULL;
+}
+
+}  // namespace
+
+DeviceSettingsWatcher::Field::Field()
+    : watchers(0),
+      is_set(false) {
+}
+
+DeviceSettingsWatcher::DeviceSettingsWatcher() : next_id_(1) {
+}
+
+DeviceSettingsWatcher::~DeviceSettingsWatcher() {
+}
+
+// static
+bool DeviceSettingsWatcher::IsKnownField(const std::string& path) {
+  return FindGetter(path) != NULL;
+}
+
+// static
+bool DeviceSettingsWatcher::GetFieldValue(
+    const em::ChromeDeviceSettingsProto& settings,
+    const std::string& path,
+    std::string* value) {
+  FieldGetter getter = FindGetter(path);
+  return getter && getter(settings, value);
+}
+
+int DeviceSettingsWatcher::AddWatch(
+    const std::string& owner,
+    const std::vector<std::string>& paths,
+    const em::ChromeDeviceSettingsProto& settings) {
+  if (watch_count() >= kMaxWatches) {
+    LOG(WARNING) << "Too many device settings watches.";
+    return 0;
+  }
+  for (std::vector<std::string>::const_iterator it = paths.begin();
+       it != paths.end(); ++it) {
+    if (!IsKnownField(*it)) {
+      LOG(WARNING) << "Can't watch unknown device setting " << *it;
+      return 0;
+    }
+  }
+
+  const int id = next_id_++;
+  Watch& watch = watches_[id];
+  watch.owner = owner;
+  watch.paths = paths;
+  std::sort(watch.paths.begin(), watch.paths.end());
+  watch.paths.erase(std::unique(watch.paths.begin(), watch.paths.end()),
+                    watch.paths.end());
+  for (std::vector<std::string>::const_iterator it = watch.paths.begin();
+       it != watch.paths.end(); ++it) {
+    Field& field = fields_[*it];
+    if (!field.watchers++)
+      field.is_set = GetFieldValue(settings, *it, &field.value);
+  }
+  return id;
+}
+
+bool DeviceSettingsWatcher::RemoveWatch(int id) {
+  std::map<int, Watch>::iterator watch = watches_.find(id);
+  if (watch == watches_.end())
+    return false;
+  EraseWatch(watch);
+  return true;
+}
+
+bool DeviceSettingsWatcher::GetOwner(int id, std::string* owner) const {
+  std::map<int, Watch>::const_iterator watch = watches_.find(id);
+  if (watch == watches_.end())
+    return false;
+  *owner = watch->second.owner;
+  return true;
+}
+
+int DeviceSettingsWatcher::RemoveWatchesOf(const std::string& owner) {
+  int removed = 0;
+  std::map<int, Watch>::iterator it = watches_.begin();
+  while (it != watches_.end()) {
+    if (it->second.owner == owner) {
+      EraseWatch(it++);
+      ++removed;
+    } else {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+DeviceSettingsWatcher::Changes DeviceSettingsWatcher::Update(
+    const em::ChromeDeviceSettingsProto& settings) {
+  // Sorted, since |fields_| is.
+  std::vector<std::string> changed;
+  for (std::map<std::string, Field>::iterator it = fields_.begin();
+       it != fields_.end(); ++it) {
+    std::string value;
+    const bool is_set = GetFieldValue(settings, it->first, &value);
+    Field& field = it->second;
+    if (is_set == field.is_set && value == field.value)
+      continue;
+    field.is_set = is_set;
+    field.value = value;
+    changed.push_back(it->first);
+  }
+
+  Changes changes;
+  if (changed.empty())
+    return changes;
+  for (std::map<int, Watch>::const_iterator watch = watches_.begin();
+       watch != watches_.end(); ++watch) {
+    std::vector<std::string> watched;
+    for (std::vector<std::string>::const_iterator it =
+             watch->second.paths.begin();
+         it != watch->second.paths.end(); ++it) {
+      if (std::binary_search(changed.begin(), changed.end(), *it))
+        watched.push_back(*it);
+    }
+    if (!watched.empty())
+      changes[watch->first].swap(watched);
+  }
+  return changes;
+}
+
+void DeviceSettingsWatcher::EraseWatch(std::map<int, Watch>::iterator watch) {
+  const std::vector<std::string>& paths = watch->second.paths;
+  for (std::vector<std::string>::const_iterator it = paths.begin();
+       it != paths.end(); ++it) {
+    std::map<std::string, Field>::iterator field = fields_.find(*it);
+    DCHECK(field != fields_.end());
+    if (!--field->second.watchers)
+      fields_.erase(field);
+  }
+  watches_.erase(watch);
+}
+
+}  // namespace login_manager
@@ -0,0 +1,104 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_DEVICE_SETTINGS_WATCHER_H_
+#define LOGIN_MANAGER_DEVICE_SETTINGS_WATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+
+namespace enterprise_management {
+class ChromeDeviceSettingsProto;
+}
+
+namespace login_manager {
+
+// Reads single fields out of the decoded device settings, addressed by path,
+// e.g. "release_channel.release_channel", so that system daemons that need a
+// single setting don't have to fetch and parse the whole policy blob. Also
+// keeps track of which fields callers are watching, and which of them changed
+// when new settings come in. Each watch belongs to the bus name that added
+// it, so that it can be dropped when that name goes away.
+//
+// The fields that can be read are listed in device_settings_fields.h. Values
+// are rendered as text: "true" or "false" for bools, decimal for integers.
+class DeviceSettingsWatcher {
+ public:
+  // Maps the id of each watch to the fields it watches that changed.
+  typedef std::map<int, std::vector<std::string> > Changes;
+
+  DeviceSettingsWatcher();
+  ~DeviceSettingsWatcher();
+
+  // Returns true if |path| names a field that can be read.
+  static bool IsKnownField(const std::string& path);
+
+  // Sets |value| to the value of the field at |path| in |settings|. Returns
+  // false if the field is unknown or not set.
+  static bool GetFieldValue(
+      const enterprise_management::ChromeDeviceSettingsProto& settings,
+      const std::string& path,
+      std::string* value);
+
+  // Starts watching the fields at |paths| on behalf of |owner|, as they
+  // currently are in |settings|. Returns an id for RemoveWatch(), or 0 if a
+  // path is unknown or there are kMaxWatches already.
+  int AddWatch(
+      const std::string& owner,
+      const std::vector<std::string>& paths,
+      const enterprise_management::ChromeDeviceSettingsProto& settings);
+
+  // Stops the watch with |id|. Returns false if there's no such watch.
+  bool RemoveWatch(int id);
+
+  // Sets |owner| to the owner of the watch with |id|. Returns false if
+  // there's no such watch.
+  bool GetOwner(int id, std::string* owner) const;
+
+  // Stops all watches added by |owner|. Returns how many there were.
+  int RemoveWatchesOf(const std::string& owner);
+
+  // Returns, for each watch, the watched fields whose value in |settings|
+  // differs from the one last seen, and remembers the new values. Watches
+  // none of whose fields changed are left out.
+  Changes Update(
+      const enterprise_management::ChromeDeviceSettingsProto& settings);
+
+  int watch_count() const { return watches_.size(); }
+
+  // A client that leaks watches without leaving the bus could otherwise make
+  // every update arbitrarily expensive.
+  static const int kMaxWatches;
+
+ private:
+  // The last seen state of a watched field.
+  struct Field {
+    Field();
+
+    int watchers;
+    bool is_set;
+    std::string value;
+  };
+
+  struct Watch {
+    std::string owner;
+    std::vector<std::string> paths;
+  };
+
+  // Drops |watch| and the fields only it was watching.
+  void EraseWatch(std::map<int, Watch>::iterator watch);
+
+  std::map<std::string, Field> fields_;
+  std::map<int, Watch> watches_;
+  int next_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeviceSettingsWatcher);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_DEVICE_SETTINGS_WATCHER_H_
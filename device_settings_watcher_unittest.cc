@@ -0,0 +1,162 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/device_settings_watcher.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/chrome_device_policy.pb.h"
+
+namespace em = enterprise_management;
+
+using ::testing::ElementsAre;
+
+namespace login_manager {
+
+namespace {
+const char kAllowNewUsers[] = "allow_new_users.allow_new_users";
+const char kChannel[] = "release_channel.release_channel";
+const char kRefreshRate[] =
+    "device_policy_refresh_rate.device_policy_refresh_rate";
+const char kOwner[] = ":1.42";
+const char kOtherOwner[] = ":1.43";
+}  // namespace
+
+TEST(DeviceSettingsWatcherTest, GetFieldValue) {
+  em::ChromeDeviceSettingsProto settings;
+  std::string value;
+  EXPECT_FALSE(DeviceSettingsWatcher::GetFieldValue(settings, kChannel,
+                                                    &value));
+
+  settings.mutable_allow_new_users()->set_allow_new_users(true);
+  settings.mutable_release_channel()->set_release_channel("dev-channel");
+  settings.mutable_device_policy_refresh_rate()->
+      set_device_policy_refresh_rate(3600000);
+  EXPECT_TRUE(DeviceSettingsWatcher::GetFieldValue(settings, kAllowNewUsers,
+                                                   &value));
+  EXPECT_EQ("true", value);
+  EXPECT_TRUE(DeviceSettingsWatcher::GetFieldValue(settings, kChannel,
+                                                   &value));
+  EXPECT_EQ("dev-channel", value);
+  EXPECT_TRUE(DeviceSettingsWatcher::GetFieldValue(settings, kRefreshRate,
+                                                   &value));
+  EXPECT_EQ("3600000", value);
+
+  EXPECT_FALSE(DeviceSettingsWatcher::IsKnownField("release_channel"));
+  EXPECT_FALSE(DeviceSettingsWatcher::GetFieldValue(settings,
+                                                    "release_channel",
+                                                    &value));
+}
+
+TEST(DeviceSettingsWatcherTest, UnknownField) {
+  em::ChromeDeviceSettingsProto settings;
+  DeviceSettingsWatcher watcher;
+  std::vector<std::string> paths;
+  paths.push_back(kChannel);
+  paths.push_back("user_whitelist");
+  EXPECT_EQ(0, watcher.AddWatch(kOwner, paths, settings));
+  EXPECT_EQ(0, watcher.watch_count());
+}
+
+TEST(DeviceSettingsWatcherTest, Update) {
+  em::ChromeDeviceSettingsProto settings;
+  DeviceSettingsWatcher watcher;
+  const int channel_watch = watcher.AddWatch(
+      kOwner, std::vector<std::string>(1, kChannel), settings);
+  ASSERT_NE(0, channel_watch);
+  std::vector<std::string> both;
+  both.push_back(kChannel);
+  both.push_back(kAllowNewUsers);
+  const int both_watch = watcher.AddWatch(kOtherOwner, both, settings);
+  ASSERT_NE(0, both_watch);
+  EXPECT_TRUE(watcher.Update(settings).empty());
+
+  // Unwatched fields don't count.
+  settings.mutable_show_user_names()->set_show_user_names(true);
+  EXPECT_TRUE(watcher.Update(settings).empty());
+
+  // Each watch gets the changes to its own fields only.
+  settings.mutable_allow_new_users()->set_allow_new_users(false);
+  DeviceSettingsWatcher::Changes changes = watcher.Update(settings);
+  EXPECT_EQ(1U, changes.size());
+  EXPECT_THAT(changes[both_watch], ElementsAre(kAllowNewUsers));
+
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  settings.mutable_allow_new_users()->set_allow_new_users(true);
+  changes = watcher.Update(settings);
+  EXPECT_EQ(2U, changes.size());
+  EXPECT_THAT(changes[channel_watch], ElementsAre(kChannel));
+  EXPECT_THAT(changes[both_watch], ElementsAre(kAllowNewUsers, kChannel));
+  EXPECT_TRUE(watcher.Update(settings).empty());
+
+  // Clearing a field is a change, too.
+  EXPECT_TRUE(watcher.RemoveWatch(both_watch));
+  EXPECT_FALSE(watcher.RemoveWatch(both_watch));
+  settings.clear_release_channel();
+  settings.clear_allow_new_users();
+  changes = watcher.Update(settings);
+  EXPECT_EQ(1U, changes.size());
+  EXPECT_THAT(changes[channel_watch], ElementsAre(kChannel));
+
+  EXPECT_TRUE(watcher.RemoveWatch(channel_watch));
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  EXPECT_TRUE(watcher.Update(settings).empty());
+}
+
+TEST(DeviceSettingsWatcherTest, TooManyWatches) {
+  em::ChromeDeviceSettingsProto settings;
+  DeviceSettingsWatcher watcher;
+  const std::vector<std::string> paths(1, kChannel);
+  for (int i = 0; i < DeviceSettingsWatcher::kMaxWatches; ++i)
+    ASSERT_NE(0, watcher.AddWatch(kOwner, paths, settings));
+  EXPECT_EQ(0, watcher.AddWatch(kOtherOwner, paths, settings));
+
+  // Watches go away with their owner.
+  EXPECT_EQ(DeviceSettingsWatcher::kMaxWatches,
+            watcher.RemoveWatchesOf(kOwner));
+  EXPECT_EQ(0, watcher.watch_count());
+  EXPECT_NE(0, watcher.AddWatch(kOtherOwner, paths, settings));
+}
+
+TEST(DeviceSettingsWatcherTest, RemoveWatchesOf) {
+  em::ChromeDeviceSettingsProto settings;
+  DeviceSettingsWatcher watcher;
+  const std::vector<std::string> paths(1, kChannel);
+  ASSERT_NE(0, watcher.AddWatch(kOwner, paths, settings));
+  ASSERT_NE(0, watcher.AddWatch(kOwner, paths, settings));
+  const int other_watch = watcher.AddWatch(kOtherOwner, paths, settings);
+  ASSERT_NE(0, other_watch);
+  std::string owner;
+  EXPECT_TRUE(watcher.GetOwner(other_watch, &owner));
+  EXPECT_EQ(kOtherOwner, owner);
+
+  EXPECT_EQ(2, watcher.RemoveWatchesOf(kOwner));
+  EXPECT_EQ(0, watcher.RemoveWatchesOf(kOwner));
+  EXPECT_EQ(1, watcher.watch_count());
+  EXPECT_FALSE(watcher.GetOwner(other_watch + 1, &owner));
+
+  // The remaining watch still sees changes.
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  DeviceSettingsWatcher::Changes changes = watcher.Update(settings);
+  EXPECT_EQ(1U, changes.size());
+  EXPECT_THAT(changes[other_watch], ElementsAre(kChannel));
+}
+
+TEST(DeviceSettingsWatcherTest, DuplicatePaths) {
+  em::ChromeDeviceSettingsProto settings;
+  DeviceSettingsWatcher watcher;
+  std::vector<std::string> paths(2, kChannel);
+  const int watch = watcher.AddWatch(kOwner, paths, settings);
+  ASSERT_NE(0, watch);
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  DeviceSettingsWatcher::Changes changes = watcher.Update(settings);
+  EXPECT_THAT(changes[watch], ElementsAre(kChannel));
+  EXPECT_TRUE(watcher.RemoveWatch(watch));
+}
+
+}  // namespace login_manager
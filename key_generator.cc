@@ -13,6 +13,7 @@
 #include <chromeos/cryptohome.h>
 
 #include "login_manager/child_job.h"
+#include "login_manager/child_output_logger.h"
 #include "login_manager/process_manager_service_interface.h"
 #include "login_manager/system_utils.h"
 
@@ -31,6 +32,7 @@ KeyGenerator::KeyGenerator(SystemUtils *utils,
                            ProcessManagerServiceInterface* manager)
     : utils_(utils),
       manager_(manager),
+      output_logger_(NULL),
       generating_(false) {
 }
 
@@ -100,11 +102,17 @@ void KeyGenerator::Reset() {
 }
 
 int KeyGenerator::RunJob(ChildJobInterface* job) {
+  const bool capture_output =
+      output_logger_ && output_logger_->CreatePipes();
   pid_t pid = utils_->fork();
   if (pid == 0) {
+    if (capture_output)
+      output_logger_->AttachToChild();
     job->Run();
     exit(1);  // Run() is not supposed to return.
   }
+  if (capture_output)
+    output_logger_->StartWatching();
   return pid;
 }
 
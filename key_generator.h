@@ -16,6 +16,7 @@
 namespace login_manager {
 
 class ChildJobInterface;
+class ChildOutputLogger;
 class MockChildJob;
 class ProcessManagerServiceInterface;
 class SystemUtils;
@@ -34,6 +35,9 @@ class KeyGenerator {
 
   void InjectMockKeygenJob(MockChildJob* keygen);  // Takes ownership.
 
+  // Captures keygen's output with |logger|, which is owned by the caller.
+  void set_output_logger(ChildOutputLogger* logger) { output_logger_ = logger; }
+
  private:
   FRIEND_TEST(KeyGeneratorTest, KeygenEndToEndTest);
   static const char kKeygenExecutable[];
@@ -50,6 +54,7 @@ class KeyGenerator {
 
   SystemUtils *utils_;
   ProcessManagerServiceInterface* manager_;
+  ChildOutputLogger* output_logger_;
 
   scoped_ptr<ChildJobInterface> keygen_job_;
   bool generating_;
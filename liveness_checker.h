@@ -9,6 +9,7 @@
 #include <base/cancelable_callback.h>
 #include <base/memory/ref_counted.h>
 #include <base/message_loop_proxy.h>
+#include <base/time.h>
 
 namespace login_manager {
 
@@ -29,6 +30,10 @@ class LivenessChecker {
   // Returns true if this instance has been started and not yet stopped.
   virtual bool IsRunning() = 0;
 
+  // Changes how often the browser is checked on. If running, checking starts
+  // over with the new interval.
+  virtual void SetInterval(base::TimeDelta interval) = 0;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(LivenessChecker);
 };
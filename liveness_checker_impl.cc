@@ -19,6 +19,7 @@
 #include <chromeos/dbus/service_constants.h>
 #include <dbus/dbus.h>
 
+#include "login_manager/browser_heartbeat.h"
 #include "login_manager/scoped_dbus_pending_call.h"
 #include "login_manager/process_manager_service_interface.h"
 #include "login_manager/system_utils.h"
@@ -36,6 +37,7 @@ LivenessCheckerImpl::LivenessCheckerImpl(
       loop_proxy_(loop),
       enable_aborting_(enable_aborting),
       interval_(interval),
+      heartbeat_(NULL),
       ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
 }
 
@@ -46,6 +48,8 @@ LivenessCheckerImpl::~LivenessCheckerImpl() {
 void LivenessCheckerImpl::Start() {
   Stop();  // To be certain.
   outstanding_liveness_ping_.reset();
+  if (heartbeat_)
+    heartbeat_->Reset();
   liveness_check_.Reset(
       base::Bind(&LivenessCheckerImpl::CheckAndSendLivenessPing,
                  weak_ptr_factory_.GetWeakPtr(),
@@ -69,25 +73,62 @@ bool LivenessCheckerImpl::IsRunning() {
   return !liveness_check_.IsCancelled();
 }
 
+void LivenessCheckerImpl::SetInterval(base::TimeDelta interval) {
+  interval_ = interval;
+  if (IsRunning())
+    Start();
+}
+
 void LivenessCheckerImpl::CheckAndSendLivenessPing(base::TimeDelta interval) {
+  if (heartbeat_ && heartbeat_->HasBeaten()) {
+    CheckHeartbeat(interval);
+    return;
+  }
+
   // If there's an un-acked ping, the browser needs to be taken down.
   if (outstanding_liveness_ping_.get() &&
       !system_->CheckAsyncMethodSuccess(outstanding_liveness_ping_->Get())) {
     LOG(WARNING) << "Browser hang detected!";
-    if (enable_aborting_) {
-      // Note: If this log message is changed, the desktopui_HangDetector
-      // autotest must be updated.
-      LOG(WARNING) << "Aborting browser process.";
-      manager_->AbortBrowser(SIGFPE);
-      // HandleChildExit() will reap the process and restart if needed.
-      Stop();
+    if (HandleHang())
       return;
-    }
   }
 
   DLOG(INFO) << "Sending a liveness ping to the browser.";
   outstanding_liveness_ping_ =
       system_->CallAsyncMethodOnChromium(chromeos::kCheckLiveness);
+  ScheduleCheck(interval);
+}
+
+void LivenessCheckerImpl::CheckHeartbeat(base::TimeDelta interval) {
+  // The browser has started beating, so any ping sent before that is moot.
+  if (outstanding_liveness_ping_.get()) {
+    system_->CancelAsyncMethodCall(outstanding_liveness_ping_->Get());
+    outstanding_liveness_ping_.reset();
+  }
+
+  const base::TimeDelta staleness = heartbeat_->GetStaleness();
+  if (staleness > interval) {
+    LOG(WARNING) << "Browser hang detected! Last heartbeat was "
+                 << staleness.InMilliseconds() << "ms ago.";
+    if (HandleHang())
+      return;
+  }
+  ScheduleCheck(interval);
+}
+
+bool LivenessCheckerImpl::HandleHang() {
+  if (!enable_aborting_)
+    return false;
+  // Note: If this log message is changed, the desktopui_HangDetector
+  // autotest must be updated.
+  LOG(WARNING) << "Aborting browser process.";
+  manager_->AbortBrowser(SIGFPE);
+  // HandleChildExit() will reap the process and restart if needed.
+  Stop();
+  return true;
+}
+
+void LivenessCheckerImpl::ScheduleCheck(base::TimeDelta interval) {
   DLOG(INFO) << "Scheduling liveness check in " << interval.InSeconds() << "s.";
   liveness_check_.Reset(
       base::Bind(&LivenessCheckerImpl::CheckAndSendLivenessPing,
@@ -18,6 +18,7 @@ class MessageLoopProxy;
 }  // namespace base
 
 namespace login_manager {
+class BrowserHeartbeat;
 class ScopedDBusPendingCall;
 class ProcessManagerServiceInterface;
 class SystemUtils;
@@ -27,6 +28,10 @@ class SystemUtils;
 // ping is sent.  If not, it may ask |manager| to abort the browser process.
 //
 // Actual aborting behavior is controlled by the enable_aborting flag.
+//
+// If given a BrowserHeartbeat, and the browser beats on it, liveness is
+// judged by the age of the last beat instead, without any D-Bus traffic.
+// Browsers that don't beat keep getting pinged.
 class LivenessCheckerImpl : public LivenessChecker {
  public:
   LivenessCheckerImpl(ProcessManagerServiceInterface* manager,
@@ -40,6 +45,10 @@ class LivenessCheckerImpl : public LivenessChecker {
   void Start();
   void Stop();
   bool IsRunning();
+  void SetInterval(base::TimeDelta interval);
+
+  // |heartbeat| is owned by the caller, and may be NULL.
+  void set_heartbeat(BrowserHeartbeat* heartbeat) { heartbeat_ = heartbeat; }
 
   // If a liveness check is outstanding, kills the browser and clears liveness
   // tracking state.  This instance will be stopped at that point in time.
@@ -48,12 +57,24 @@ class LivenessCheckerImpl : public LivenessChecker {
   void CheckAndSendLivenessPing(base::TimeDelta interval);
 
  private:
+  // Aborts the browser if it hasn't beaten within |interval|, otherwise
+  // reschedules itself.
+  void CheckHeartbeat(base::TimeDelta interval);
+
+  // Kills the browser, if aborting is enabled, and stops checking.
+  // Returns true if the browser was aborted.
+  bool HandleHang();
+
+  // Schedules the next run through CheckAndSendLivenessPing().
+  void ScheduleCheck(base::TimeDelta interval);
+
   ProcessManagerServiceInterface* manager_;
   SystemUtils* system_;
   scoped_refptr<base::MessageLoopProxy> loop_proxy_;
 
   const bool enable_aborting_;
-  const base::TimeDelta interval_;
+  base::TimeDelta interval_;
+  BrowserHeartbeat* heartbeat_;
   scoped_ptr<ScopedDBusPendingCall> outstanding_liveness_ping_;
   base::CancelableClosure liveness_check_;
   base::WeakPtrFactory<LivenessCheckerImpl> weak_ptr_factory_;
@@ -16,6 +16,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "login_manager/mock_browser_heartbeat.h"
 #include "login_manager/mock_process_manager_service.h"
 #include "login_manager/mock_system_utils.h"
 #include "login_manager/scoped_dbus_pending_call.h"
@@ -137,6 +138,71 @@ TEST_F(LivenessCheckerImplTest, CheckAndSendAckedThenOutstandingPingNeutered) {
   base::RunLoop().RunUntilIdle();
 }
 
+TEST_F(LivenessCheckerImplTest, FreshHeartbeatSendsNoPing) {
+  StrictMock<MockBrowserHeartbeat> heartbeat;
+  checker_->set_heartbeat(&heartbeat);
+  EXPECT_CALL(heartbeat, HasBeaten()).WillRepeatedly(Return(true));
+  EXPECT_CALL(heartbeat, GetStaleness())
+      .WillOnce(Return(TimeDelta::FromMilliseconds(5)));
+  // No D-Bus traffic, and no abort.
+  checker_->CheckAndSendLivenessPing(TimeDelta::FromSeconds(1));
+  EXPECT_TRUE(checker_->IsRunning());
+  checker_->Stop();
+}
+
+TEST_F(LivenessCheckerImplTest, StaleHeartbeat) {
+  StrictMock<MockBrowserHeartbeat> heartbeat;
+  checker_->set_heartbeat(&heartbeat);
+  EXPECT_CALL(heartbeat, HasBeaten()).WillRepeatedly(Return(true));
+  EXPECT_CALL(heartbeat, GetStaleness())
+      .WillOnce(Return(TimeDelta::FromMilliseconds(1001)));
+  EXPECT_CALL(*manager_.get(), AbortBrowser(SIGFPE)).Times(1);
+  checker_->CheckAndSendLivenessPing(TimeDelta::FromSeconds(1));
+  EXPECT_FALSE(checker_->IsRunning());
+}
+
+TEST_F(LivenessCheckerImplTest, SetInterval) {
+  // Doesn't start a stopped checker.
+  checker_->SetInterval(TimeDelta::FromSeconds(1));
+  EXPECT_FALSE(checker_->IsRunning());
+
+  checker_->Start();
+  checker_->SetInterval(TimeDelta::FromSeconds(2));
+  EXPECT_TRUE(checker_->IsRunning());
+  checker_->Stop();
+}
+
+TEST_F(LivenessCheckerImplTest, HeartbeatCancelsOutstandingPing) {
+  StrictMock<MockBrowserHeartbeat> heartbeat;
+  checker_->set_heartbeat(&heartbeat);
+  scoped_ptr<ScopedDBusPendingCall> call =
+      ScopedDBusPendingCall::CreateForTesting();
+  EXPECT_CALL(system_, CancelAsyncMethodCall(call->Get())).Times(1);
+  system_.EnqueueFakePendingCall(call.Pass());
+
+  // The browser hasn't beaten yet, so it gets pinged...
+  EXPECT_CALL(heartbeat, HasBeaten())
+      .WillOnce(Return(false))
+      .WillRepeatedly(Return(true));
+  checker_->CheckAndSendLivenessPing(TimeDelta::FromSeconds(1));
+
+  // ...and once it has, the ping is dropped.
+  EXPECT_CALL(heartbeat, GetStaleness())
+      .WillOnce(Return(TimeDelta::FromMilliseconds(5)));
+  checker_->CheckAndSendLivenessPing(TimeDelta::FromSeconds(1));
+  checker_->Stop();
+}
+
+TEST_F(LivenessCheckerImplTest, SilentHeartbeatFallsBackToPing) {
+  StrictMock<MockBrowserHeartbeat> heartbeat;
+  checker_->set_heartbeat(&heartbeat);
+  EXPECT_CALL(heartbeat, HasBeaten()).WillRepeatedly(Return(false));
+  ExpectUnAckedLivenessPing();
+  EXPECT_CALL(*manager_.get(), AbortBrowser(SIGFPE)).Times(1);
+  checker_->CheckAndSendLivenessPing(TimeDelta());
+  base::RunLoop().RunUntilIdle();
+}
+
 TEST_F(LivenessCheckerImplTest, StartStop) {
   checker_->Start();
   EXPECT_TRUE(checker_->IsRunning());
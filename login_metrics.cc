@@ -6,14 +6,22 @@
 
 #include "login_manager/login_metrics.h"
 
+#include <string.h>
+
 #include <base/file_util.h>
-#include <metrics/bootstat.h>
 #include <metrics/metrics_library.h>
 
+#include "login_manager/metrics_sink.h"
+#include "login_manager/per_boot_state.h"
+
 namespace login_manager {
 
+// static
+const char LoginMetrics::kChromeExecTag[] = "chrome-exec";
 // static
 const char LoginMetrics::kChromeUptimeFile[] = "/tmp/uptime-chrome-exec";
+// static
+const char LoginMetrics::kBootstatDir[] = "/tmp";
 
 //static
 const char LoginMetrics::kLoginUserTypeMetric[] = "Login.UserType";
@@ -23,9 +31,6 @@ const char LoginMetrics::kLoginPolicyFilesMetric[] =
 //static
 const int LoginMetrics::kMaxPolicyFilesValue = 64;
 
-// static
-const char LoginMetrics::kLoginMetricsFlagFile[] = "per_boot_flag";
-
 // static
 int LoginMetrics::PolicyFilesStatusCode(const PolicyFilesStatus& status) {
   return (status.owner_key_file_state * 16      /* 4^2 */ +
@@ -33,36 +38,60 @@ int LoginMetrics::PolicyFilesStatusCode(const PolicyFilesStatus& status) {
           status.defunct_prefs_file_state * 1   /* 4^0 */);
 }
 
-LoginMetrics::LoginMetrics(const FilePath& per_boot_flag_dir)
-    : per_boot_flag_file_(per_boot_flag_dir.Append(kLoginMetricsFlagFile)) {
-  metrics_lib_.Init();
+LoginMetrics::LoginMetrics(PerBootState* per_boot_state)
+    : per_boot_state_(per_boot_state) {
+  scoped_ptr<MetricsLibrary> metrics_lib(new MetricsLibrary);
+  metrics_lib->Init();
+  sink_.reset(new MetricsSink(FilePath(kBootstatDir),
+                              metrics_lib.PassAs<MetricsLibraryInterface>()));
 }
 LoginMetrics::~LoginMetrics() {}
 
 void LoginMetrics::SendLoginUserType(bool dev_mode, bool incognito,
                                      bool owner) {
   int uma_code = LoginUserTypeCode(dev_mode, incognito, owner);
-  metrics_lib_.SendEnumToUMA(kLoginUserTypeMetric, uma_code, NUM_TYPES - 1);
+  sink_->SendEnumToUMA(kLoginUserTypeMetric, uma_code, NUM_TYPES - 1);
 }
 
 bool LoginMetrics::SendPolicyFilesStatus(const PolicyFilesStatus& status) {
-  if (!file_util::PathExists(per_boot_flag_file_)) {
-    metrics_lib_.SendEnumToUMA(kLoginPolicyFilesMetric,
-                               LoginMetrics::PolicyFilesStatusCode(status),
-                               kMaxPolicyFilesValue);
-    bool created = file_util::WriteFile(per_boot_flag_file_, "", 0) == 0;
-    PLOG_IF(WARNING, !created) << "Can't touch " << per_boot_flag_file_.value();
-    return true;
-  }
-  return false;
+  if (per_boot_state_->IsSet(PerBootState::POLICY_FILES_STATUS_SENT))
+    return false;
+  sink_->SendEnumToUMA(kLoginPolicyFilesMetric,
+                       LoginMetrics::PolicyFilesStatusCode(status),
+                       kMaxPolicyFilesValue);
+  per_boot_state_->Set(PerBootState::POLICY_FILES_STATUS_SENT);
+  return true;
 }
 
 void LoginMetrics::RecordStats(const char* tag) {
-  bootstat_log(tag);
+  sink_->RecordBootstat(tag);
+  // The uptime file shows up asynchronously now, so remember the exec here.
+  if (strcmp(tag, kChromeExecTag) == 0)
+    per_boot_state_->Set(PerBootState::CHROME_EXEC_RECORDED);
 }
 
 bool LoginMetrics::HasRecordedChromeExec() {
-  return file_util::PathExists(FilePath(LoginMetrics::kChromeUptimeFile));
+  if (per_boot_state_->IsSet(PerBootState::CHROME_EXEC_RECORDED))
+    return true;
+  // Fall back to the uptime file in case the exec was recorded by a
+  // session_manager that didn't know about PerBootState.
+  if (!file_util::PathExists(FilePath(LoginMetrics::kChromeUptimeFile)))
+    return false;
+  per_boot_state_->Set(PerBootState::CHROME_EXEC_RECORDED);
+  return true;
+}
+
+void LoginMetrics::SendEnum(const std::string& name, int sample, int max) {
+  sink_->SendEnumToUMA(name, sample, max);
+}
+
+void LoginMetrics::SendHistogram(const std::string& name, int sample, int min,
+                                 int max, int nbuckets) {
+  sink_->SendToUMA(name, sample, min, max, nbuckets);
+}
+
+void LoginMetrics::Flush() {
+  sink_->Flush();
 }
 
 // static
@@ -5,18 +5,24 @@
 #ifndef LOGIN_MANAGER_LOGIN_METRICS_H_
 #define LOGIN_MANAGER_LOGIN_METRICS_H_
 
+#include <string>
+
 #include <base/basictypes.h>
 #include <base/file_path.h>
-#include <metrics/metrics_library.h>
+#include <base/memory/scoped_ptr.h>
 
 namespace login_manager {
+class MetricsSink;
+class PerBootState;
+
 class LoginMetrics {
  public:
   enum PolicyFileState {
     GOOD = 0,
     MALFORMED = 1,
     NOT_PRESENT = 2,
-    NUM_STATES = 3
+    TORN = 3,  // Incomplete or corrupted on disk, rather than bad data.
+    NUM_STATES = 4
   };
   enum UserType {
     GUEST = 0,
@@ -59,7 +65,8 @@ class LoginMetrics {
     PolicyFileState defunct_prefs_file_state;
   };
 
-  explicit LoginMetrics(const FilePath& per_boot_flag_dir);
+  // |per_boot_state| is owned by the caller and may be NULL for mocks.
+  explicit LoginMetrics(PerBootState* per_boot_state);
   virtual ~LoginMetrics();
 
   // Sends the type of user that logs in (guest, owner or other) and the mode
@@ -67,16 +74,32 @@ class LoginMetrics {
   virtual void SendLoginUserType(bool dev_mode, bool guest, bool owner);
 
   // Sends info about the state of the Owner key, device policy, and legacy
-  // prefs file to UMA using the metrics library.
+  // prefs file to UMA using the metrics library, once per boot.
   // Returns true if stats are sent.
   virtual bool SendPolicyFilesStatus(const PolicyFilesStatus& status);
 
-  // Record a stat called |tag| via the bootstat library.
+  // Record a stat called |tag| in the same way the bootstat library does.
+  // The timestamp is taken immediately, but the write happens later.
   virtual void RecordStats(const char* tag);
 
   // Return true if we have already recorded that Chrome has exec'd.
   virtual bool HasRecordedChromeExec();
 
+  // Sends |sample| of the enum |name| to UMA, see
+  // MetricsLibrary::SendEnumToUMA().
+  virtual void SendEnum(const std::string& name, int sample, int max);
+
+  // Sends |sample| of the histogram |name| to UMA, see
+  // MetricsLibrary::SendToUMA().
+  virtual void SendHistogram(const std::string& name, int sample, int min,
+                             int max, int nbuckets);
+
+  // Blocks until all stats recorded so far have been written out.
+  virtual void Flush();
+
+  // Tag recorded when session_manager executes Chrome.
+  static const char kChromeExecTag[];
+
  private:
   friend class LoginMetricsTest;
   friend class UserTypeTest;
@@ -85,13 +108,14 @@ class LoginMetrics {
   static const char kLoginPolicyFilesMetric[];
   static const int kMaxPolicyFilesValue;
 
-  static const char kLoginMetricsFlagFile[];
-
   // Uptime stats file created when session_manager executes Chrome.
   // For any case of reload after crash no stats are recorded.
   // For any signout stats are recorded.
   static const char kChromeUptimeFile[];
 
+  // Directory that bootstat writes its stats to.
+  static const char kBootstatDir[];
+
   // Returns code to send to the metrics library based on the state of
   // several policy-related files on disk.
   // As each file has three possible states, treat as a base-3 number and
@@ -102,8 +126,8 @@ class LoginMetrics {
   // (owner, guest or other) and the mode (normal or developer).
   static int LoginUserTypeCode(bool dev_mode, bool guest, bool owner);
 
-  const FilePath per_boot_flag_file_;
-  MetricsLibrary metrics_lib_;
+  PerBootState* per_boot_state_;  // Owned by the caller.
+  scoped_ptr<MetricsSink> sink_;
 
   DISALLOW_COPY_AND_ASSIGN(LoginMetrics);
 };
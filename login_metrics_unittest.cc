@@ -9,6 +9,8 @@
 #include <base/memory/scoped_ptr.h>
 #include <gtest/gtest.h>
 
+#include "login_manager/per_boot_state.h"
+
 namespace login_manager {
 
 struct UserTypeTestParams {
@@ -31,7 +33,10 @@ class LoginMetricsTest : public testing::Test {
 
   virtual void SetUp() {
     ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
-    metrics_.reset(new LoginMetrics(tmpdir_.path()));
+    per_boot_state_.reset(new PerBootState(
+        tmpdir_.path().AppendASCII(PerBootState::kStateFileName)));
+    ASSERT_TRUE(per_boot_state_->Initialize());
+    metrics_.reset(new LoginMetrics(per_boot_state_.get()));
   }
 
   int PolicyFilesStatusCode(LoginMetrics::PolicyFilesStatus status) {
@@ -40,6 +45,7 @@ class LoginMetricsTest : public testing::Test {
 
  protected:
   base::ScopedTempDir tmpdir_;
+  scoped_ptr<PerBootState> per_boot_state_;
   scoped_ptr<LoginMetrics> metrics_;
 
  private:
@@ -79,6 +85,8 @@ TEST_F(LoginMetricsTest, SendStatus) {
   LoginMetrics::PolicyFilesStatus status;
   EXPECT_TRUE(metrics_->SendPolicyFilesStatus(status));
   EXPECT_FALSE(metrics_->SendPolicyFilesStatus(status));
+  EXPECT_TRUE(
+      per_boot_state_->IsSet(PerBootState::POLICY_FILES_STATUS_SENT));
 }
 
 class UserTypeTest : public ::testing::TestWithParam<UserTypeTestParams> {
@@ -0,0 +1,146 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/machine_info.h"
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/command_line.h>
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/process_util.h>
+#include <base/stringprintf.h>
+#include <base/threading/worker_pool.h>
+#include <base/time.h>
+#include <chromeos/process.h>
+
+namespace login_manager {
+
+// static
+const char MachineInfo::kMachineInfoFile[] = "/tmp/machine-info";
+
+namespace {
+
+const char kCrossystemPath[] = "/usr/bin/crossystem";
+const char kDumpVpdLogPath[] = "/usr/sbin/dump_vpd_log";
+
+// Returns true if the device runs non-Chrome OS firmware, i.e. there is no
+// VPD to dump.
+bool IsNonChromeFirmware() {
+  chromeos::ProcessImpl crossystem;
+  crossystem.AddArg(kCrossystemPath);
+  crossystem.AddArg("mainfw_type?nonchrome");
+  return crossystem.Run() == 0;
+}
+
+}  // namespace
+
+MachineInfo::MachineInfo(const base::FilePath& path)
+    : path_(path),
+      gather_(base::Bind(&MachineInfo::GatherInfo)),
+      generation_requested_(false),
+      generation_done_(false),
+      removed_(false),
+      weak_ptr_factory_(this) {
+}
+
+MachineInfo::~MachineInfo() {}
+
+void MachineInfo::GenerateAsync(const base::Closure& done) {
+  if (generation_done_ || removed_) {
+    done.Run();
+    return;
+  }
+  pending_done_.push_back(done);
+  if (generation_requested_)
+    return;
+  generation_requested_ = true;
+
+  bool* success = new bool(false);
+  base::WorkerPool::PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&MachineInfo::Generate, gather_, path_, success),
+      base::Bind(&MachineInfo::OnGenerated,
+                 weak_ptr_factory_.GetWeakPtr(),
+                 base::Owned(success)),
+      true /* task_is_slow */);
+}
+
+void MachineInfo::Remove() {
+  removed_ = true;
+  if (!file_util::Delete(path_, false))
+    PLOG(WARNING) << "Failed to delete " << path_.value();
+}
+
+// static
+bool MachineInfo::GatherInfo(std::string* info) {
+  if (IsNonChromeFirmware()) {
+    *info = StringPrintf("serial_number=\"nonchrome-%ld\"\n",
+                         static_cast<long>(base::Time::Now().ToTimeT()));
+    return true;
+  }
+  // Dump full information in the VPD, including the serial number.
+  std::vector<std::string> argv;
+  argv.push_back(kDumpVpdLogPath);
+  argv.push_back("--full");
+  argv.push_back("--stdout");
+  if (!base::GetAppOutput(CommandLine(argv), info)) {
+    LOG(ERROR) << "Failed to run " << kDumpVpdLogPath;
+    return false;
+  }
+  return true;
+}
+
+// static
+void MachineInfo::Generate(const Gatherer& gather,
+                           const base::FilePath& path,
+                           bool* success) {
+  std::string info;
+  *success = gather.Run(&info) && WriteInfo(path, info);
+}
+
+// static
+bool MachineInfo::WriteInfo(const base::FilePath& path,
+                            const std::string& info) {
+  base::FilePath scratch;
+  if (!file_util::CreateTemporaryFileInDir(path.DirName(), &scratch)) {
+    PLOG(ERROR) << "Failed to create a file next to " << path.value();
+    return false;
+  }
+  if (file_util::WriteFile(scratch, info.data(), info.size()) !=
+      static_cast<int>(info.size())) {
+    PLOG(ERROR) << "Failed to write " << scratch.value();
+    file_util::Delete(scratch, false);
+    return false;
+  }
+  if (chmod(scratch.value().c_str(),
+            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0 ||
+      !file_util::ReplaceFile(scratch, path)) {
+    PLOG(ERROR) << "Failed to put " << path.value() << " in place";
+    file_util::Delete(scratch, false);
+    return false;
+  }
+  return true;
+}
+
+void MachineInfo::OnGenerated(bool* success) {
+  generation_done_ = true;
+  // A session may have started while the data was being gathered; in that
+  // case the file must not stick around.
+  if (removed_)
+    file_util::Delete(path_, false);
+  else if (*success)
+    DLOG(INFO) << "Wrote machine info to " << path_.value();
+
+  std::vector<base::Closure> done;
+  done.swap(pending_done_);
+  for (size_t i = 0; i < done.size(); ++i)
+    done[i].Run();
+}
+
+}  // namespace login_manager
@@ -0,0 +1,80 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MACHINE_INFO_H_
+#define LOGIN_MANAGER_MACHINE_INFO_H_
+
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/callback.h>
+#include <base/file_path.h>
+#include <base/memory/weak_ptr.h>
+
+namespace login_manager {
+
+// Produces the machine info file, which contains the serial number and other
+// VPD data that OOBE and enterprise enrollment need. For privacy reasons, the
+// file should only be around while enrollment might happen, so it is removed
+// as soon as a user session starts.
+//
+// The data is gathered by running crossystem and dump_vpd_log, which is slow,
+// so it happens on a worker thread and never blocks the caller. Readers don't
+// poll for the file, so whoever needs it must wait for GenerateAsync() to
+// call back; the file then either is complete or doesn't exist.
+class MachineInfo {
+ public:
+  // Fills in the machine info, returning false on failure.
+  typedef base::Callback<bool(std::string*)> Gatherer;
+
+  explicit MachineInfo(const base::FilePath& path);
+  virtual ~MachineInfo();
+
+  // Gathers machine info on a worker thread and writes it to |path_|, then
+  // runs |done|, whether that worked or not. If generation is in progress
+  // already, |done| runs along with the earlier callbacks; if it's over or
+  // the file has been removed, |done| runs right away.
+  virtual void GenerateAsync(const base::Closure& done);
+
+  // Deletes |path_|. A generation that is still in flight will have its
+  // output deleted as soon as it completes.
+  virtual void Remove();
+
+  static const char kMachineInfoFile[];
+
+ private:
+  friend class MachineInfoTest;
+
+  // Runs crossystem and dump_vpd_log.
+  static bool GatherInfo(std::string* info);
+
+  // Runs on a worker thread. Dumps the machine info from |gather| into
+  // |path|, and sets |*success| accordingly.
+  static void Generate(const Gatherer& gather,
+                       const base::FilePath& path,
+                       bool* success);
+
+  // Puts |info| in place at |path|, readable by everyone. The file shows up
+  // complete and with its final mode, or not at all.
+  static bool WriteInfo(const base::FilePath& path, const std::string& info);
+
+  // Called back on the originating thread once Generate() is done.
+  void OnGenerated(bool* success);
+
+  const base::FilePath path_;
+  Gatherer gather_;
+  bool generation_requested_;
+  bool generation_done_;
+  bool removed_;
+  // Callbacks waiting for the generation in flight.
+  std::vector<base::Closure> pending_done_;
+  base::WeakPtrFactory<MachineInfo> weak_ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(MachineInfo);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MACHINE_INFO_H_
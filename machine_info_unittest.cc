@@ -0,0 +1,136 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/machine_info.h"
+
+#include <sys/stat.h>
+
+#include <string>
+
+#include <base/bind.h>
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/message_loop.h>
+#include <base/run_loop.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+namespace {
+
+const char kInfo[] = "serial_number=\"123\"\n";
+
+bool GatherFakeInfo(std::string* info) {
+  *info = kInfo;
+  return true;
+}
+
+bool FailToGatherInfo(std::string* info) {
+  return false;
+}
+
+void Count(int* count) {
+  ++*count;
+}
+
+}  // namespace
+
+class MachineInfoTest : public ::testing::Test {
+ public:
+  MachineInfoTest() {}
+  virtual ~MachineInfoTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    path_ = tmpdir_.path().AppendASCII("machine-info");
+    info_.reset(new MachineInfo(path_));
+    info_->gather_ = base::Bind(&GatherFakeInfo);
+  }
+
+ protected:
+  void SetGatherer(const MachineInfo::Gatherer& gather) {
+    info_->gather_ = gather;
+  }
+
+  static bool WriteInfo(const base::FilePath& path, const std::string& info) {
+    return MachineInfo::WriteInfo(path, info);
+  }
+
+  // Returns the permission bits of |path_|.
+  mode_t Mode() {
+    struct stat st;
+    EXPECT_EQ(0, stat(path_.value().c_str(), &st));
+    return st.st_mode & 0777;
+  }
+
+  MessageLoop loop_;
+  base::ScopedTempDir tmpdir_;
+  base::FilePath path_;
+  scoped_ptr<MachineInfo> info_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MachineInfoTest);
+};
+
+TEST_F(MachineInfoTest, WriteInfo) {
+  ASSERT_EQ(3, file_util::WriteFile(path_, "old", 3));
+  ASSERT_TRUE(WriteInfo(path_, kInfo));
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  EXPECT_EQ(kInfo, contents);
+  EXPECT_EQ(static_cast<mode_t>(0644), Mode());
+
+  // Nothing but the file itself is left behind.
+  file_util::FileEnumerator files(tmpdir_.path(), false,
+                                  file_util::FileEnumerator::FILES);
+  EXPECT_EQ(path_.value(), files.Next().value());
+  EXPECT_TRUE(files.Next().empty());
+}
+
+TEST_F(MachineInfoTest, WriteInfoNoDir) {
+  EXPECT_FALSE(WriteInfo(tmpdir_.path().Append("nope").Append("info"), kInfo));
+}
+
+TEST_F(MachineInfoTest, Generate) {
+  int done = 0;
+  base::RunLoop run_loop;
+  info_->GenerateAsync(base::Bind(&Count, &done));
+  info_->GenerateAsync(run_loop.QuitClosure());
+  EXPECT_EQ(0, done);
+  run_loop.Run();
+  EXPECT_EQ(1, done);
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  EXPECT_EQ(kInfo, contents);
+  EXPECT_EQ(static_cast<mode_t>(0644), Mode());
+
+  // Once done, later callers don't wait.
+  info_->GenerateAsync(base::Bind(&Count, &done));
+  EXPECT_EQ(2, done);
+}
+
+TEST_F(MachineInfoTest, GenerateFails) {
+  SetGatherer(base::Bind(&FailToGatherInfo));
+  base::RunLoop run_loop;
+  info_->GenerateAsync(run_loop.QuitClosure());
+  run_loop.Run();
+  EXPECT_FALSE(file_util::PathExists(path_));
+}
+
+TEST_F(MachineInfoTest, RemoveWhileGenerating) {
+  base::RunLoop run_loop;
+  info_->GenerateAsync(run_loop.QuitClosure());
+  info_->Remove();
+  run_loop.Run();
+  EXPECT_FALSE(file_util::PathExists(path_));
+
+  int done = 0;
+  info_->GenerateAsync(base::Bind(&Count, &done));
+  EXPECT_EQ(1, done);
+  EXPECT_FALSE(file_util::PathExists(path_));
+}
+
+}  // namespace login_manager
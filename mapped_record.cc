@@ -0,0 +1,87 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/mapped_record.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+
+namespace login_manager {
+
+MappedRecord::MappedRecord(const base::FilePath& path,
+                           size_t size,
+                           uint32 magic,
+                           uint32 version)
+    : path_(path),
+      size_(size),
+      magic_(magic),
+      version_(version),
+      fallback_(new char[size]),
+      data_(fallback_.get()),
+      mapped_(false) {
+  DCHECK_GE(size, sizeof(Header));
+  memset(fallback_.get(), 0, size_);
+  Header* header = static_cast<Header*>(data_);
+  header->magic = magic_;
+  header->version = version_;
+  header->size = size_;
+}
+
+MappedRecord::~MappedRecord() {
+  if (mapped_) {
+    Sync();
+    munmap(data_, size_);
+  }
+}
+
+bool MappedRecord::Initialize() {
+  DCHECK(!mapped_);
+  int fd = HANDLE_EINTR(open(path_.value().c_str(),
+                             O_RDWR | O_CREAT | O_CLOEXEC,
+                             S_IRUSR | S_IWUSR));
+  if (fd < 0) {
+    PLOG(ERROR) << "Can't open " << path_.value();
+    return false;
+  }
+
+  struct stat st;
+  bool fresh = fstat(fd, &st) != 0 || st.st_size != static_cast<off_t>(size_);
+  if (fresh && HANDLE_EINTR(ftruncate(fd, size_)) != 0) {
+    PLOG(ERROR) << "Can't size " << path_.value();
+    close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Can't map " << path_.value();
+    return false;
+  }
+
+  const Header* header = static_cast<const Header*>(mapping);
+  if (fresh || header->magic != magic_ || header->version != version_ ||
+      header->size != size_) {
+    LOG_IF(WARNING, !fresh) << "Discarding unknown contents of "
+                            << path_.value();
+    memcpy(mapping, fallback_.get(), size_);
+  }
+  data_ = mapping;
+  mapped_ = true;
+  Sync();
+  return true;
+}
+
+void MappedRecord::Sync() {
+  if (mapped_ && msync(data_, size_, MS_ASYNC) != 0)
+    PLOG(WARNING) << "msync of " << path_.value() << " failed";
+}
+
+}  // namespace login_manager
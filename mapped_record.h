@@ -0,0 +1,69 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MAPPED_RECORD_H_
+#define LOGIN_MANAGER_MAPPED_RECORD_H_
+
+#include <stddef.h>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/memory/scoped_ptr.h>
+
+namespace login_manager {
+
+// A small fixed-size record that lives in a file and is mmap'd, so that reads
+// never touch the file system and writes are just a store plus an
+// asynchronous msync(). The record starts with a Header, which is how
+// contents left behind by another version, or garbage, are recognized.
+//
+// Until the record is mapped, or if it can't be, it is kept in memory only.
+// Anything written to it meanwhile is what a fresh record starts out as.
+class MappedRecord {
+ public:
+  struct Header {
+    uint32 magic;
+    uint32 version;
+    uint32 size;
+  };
+
+  // The record at |path| is |size| bytes long, Header included. It is zeroed
+  // apart from the header until something is stored in it.
+  MappedRecord(const base::FilePath& path,
+               size_t size,
+               uint32 magic,
+               uint32 version);
+  ~MappedRecord();
+
+  // Maps the record at |path_|, creating the file if needed. An existing
+  // record that isn't understood is replaced with the in-memory one. Returns
+  // false, leaving the record in memory, if it can't be mapped.
+  bool Initialize();
+
+  // Returns the record, either mapped or in memory.
+  void* data() { return data_; }
+  const void* data() const { return data_; }
+
+  // Flushes the record to the backing file, if any.
+  void Sync();
+
+  const base::FilePath& path() const { return path_; }
+
+ private:
+  const base::FilePath path_;
+  const size_t size_;
+  const uint32 magic_;
+  const uint32 version_;
+
+  scoped_array<char> fallback_;
+  // Points either into the mapping or at |fallback_|.
+  void* data_;
+  bool mapped_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedRecord);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MAPPED_RECORD_H_
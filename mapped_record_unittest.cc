@@ -0,0 +1,95 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/mapped_record.h"
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+namespace {
+
+struct TestRecord {
+  MappedRecord::Header header;
+  uint32 value;
+};
+
+const uint32 kMagic = 0x54455354;  // "TEST"
+
+}  // namespace
+
+class MappedRecordTest : public ::testing::Test {
+ public:
+  MappedRecordTest() {}
+  virtual ~MappedRecordTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    path_ = tmpdir_.path().AppendASCII("record");
+  }
+
+ protected:
+  scoped_ptr<MappedRecord> CreateRecord(uint32 version) {
+    scoped_ptr<MappedRecord> record(
+        new MappedRecord(path_, sizeof(TestRecord), kMagic, version));
+    EXPECT_TRUE(record->Initialize());
+    return record.Pass();
+  }
+
+  static TestRecord* Get(MappedRecord* record) {
+    return static_cast<TestRecord*>(record->data());
+  }
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath path_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MappedRecordTest);
+};
+
+TEST_F(MappedRecordTest, SurvivesRestart) {
+  scoped_ptr<MappedRecord> record(CreateRecord(1));
+  EXPECT_EQ(0U, Get(record.get())->value);
+  Get(record.get())->value = 42;
+  record.reset();
+
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &size));
+  EXPECT_EQ(static_cast<int64>(sizeof(TestRecord)), size);
+  record = CreateRecord(1);
+  EXPECT_EQ(42U, Get(record.get())->value);
+}
+
+TEST_F(MappedRecordTest, DiscardsOtherVersions) {
+  scoped_ptr<MappedRecord> record(CreateRecord(1));
+  Get(record.get())->value = 42;
+  record.reset();
+
+  record = CreateRecord(2);
+  EXPECT_EQ(0U, Get(record.get())->value);
+  EXPECT_EQ(2U, Get(record.get())->header.version);
+}
+
+TEST_F(MappedRecordTest, StartsFromMemory) {
+  MappedRecord record(path_, sizeof(TestRecord), kMagic, 1);
+  Get(&record)->value = 7;
+  ASSERT_TRUE(record.Initialize());
+
+  scoped_ptr<MappedRecord> other(CreateRecord(1));
+  EXPECT_EQ(7U, Get(other.get())->value);
+}
+
+TEST_F(MappedRecordTest, InMemoryFallback) {
+  MappedRecord record(tmpdir_.path().AppendASCII("missing/dir/record"),
+                      sizeof(TestRecord), kMagic, 1);
+  EXPECT_FALSE(record.Initialize());
+  Get(&record)->value = 7;
+  EXPECT_EQ(7U, Get(&record)->value);
+}
+
+}  // namespace login_manager
@@ -0,0 +1,99 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/memory_stats.h"
+
+#include <malloc.h>
+
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/string_number_conversions.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+
+namespace login_manager {
+
+namespace {
+
+struct SmapsField {
+  const char* smaps_name;
+  const char* name;
+};
+
+const SmapsField kSmapsFields[] = {
+  { "Rss", "rss_kb" },
+  { "Pss", "pss_kb" },
+  { "Pss_Anon", "pss_anon_kb" },
+  { "Pss_File", "pss_file_kb" },
+  { "Swap", "swap_kb" },
+};
+
+}  // namespace
+
+// static
+const char MemoryStats::kSmapsRollupPath[] = "/proc/self/smaps_rollup";
+// static
+const char MemoryStats::kSmapsPath[] = "/proc/self/smaps";
+
+// static
+void MemoryStats::Collect(Values* values) {
+  std::string contents;
+  if (!file_util::ReadFileToString(base::FilePath(kSmapsRollupPath),
+                                   &contents) &&
+      !file_util::ReadFileToString(base::FilePath(kSmapsPath), &contents)) {
+    PLOG(WARNING) << "Can't read " << kSmapsPath;
+  }
+  if (!contents.empty() && !ParseSmaps(contents, values))
+    LOG(WARNING) << "No memory use in " << kSmapsPath;
+
+  struct mallinfo info = mallinfo();
+  (*values)["heap_in_use_bytes"] = info.uordblks;
+  (*values)["heap_free_bytes"] = info.fordblks;
+  (*values)["heap_mmap_bytes"] = info.hblkhd;
+}
+
+// static
+bool MemoryStats::ParseSmaps(const std::string& contents, Values* values) {
+  Values sums;
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    // Fields look like "Pss:        1234 kB"; mapping headers don't have a
+    // colon right after the first word.
+    const std::string& line = lines[i];
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos || line.find(' ') < colon)
+      continue;
+    for (size_t f = 0; f < arraysize(kSmapsFields); ++f) {
+      if (line.compare(0, colon, kSmapsFields[f].smaps_name) != 0)
+        continue;
+      std::string value;
+      TrimWhitespaceASCII(line.substr(colon + 1), TRIM_ALL, &value);
+      if (EndsWith(value, " kB", true))
+        value.resize(value.size() - 3);
+      int64 kb = 0;
+      if (base::StringToInt64(value, &kb))
+        sums[kSmapsFields[f].name] += kb;
+      break;
+    }
+  }
+  if (sums.find("rss_kb") == sums.end())
+    return false;
+  for (Values::const_iterator it = sums.begin(); it != sums.end(); ++it)
+    (*values)[it->first] = it->second;
+  return true;
+}
+
+// static
+int64 MemoryStats::TrimHeap() {
+  const int64 before = mallinfo().fordblks;
+  malloc_trim(0);
+  const int64 after = mallinfo().fordblks;
+  return before > after ? before - after : 0;
+}
+
+}  // namespace login_manager
@@ -0,0 +1,47 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MEMORY_STATS_H_
+#define LOGIN_MANAGER_MEMORY_STATS_H_
+
+#include <map>
+#include <string>
+
+#include <base/basictypes.h>
+
+namespace login_manager {
+
+// How much memory the session_manager uses, as the kernel and malloc see it,
+// and a way to give back what malloc holds on to without using.
+class MemoryStats {
+ public:
+  typedef std::map<std::string, int64> Values;
+
+  // Adds the memory use of this process to |values|: "rss_kb", "pss_kb",
+  // "pss_anon_kb", "pss_file_kb" and "swap_kb" from smaps, and
+  // "heap_in_use_bytes", "heap_free_bytes" and "heap_mmap_bytes" from malloc.
+  // The smaps values are missing if smaps can't be read.
+  static void Collect(Values* values);
+
+  // Adds up the smaps fields above across the mappings in |contents|, which
+  // may be a whole smaps file or an smaps_rollup one. Returns false if there
+  // is no Rss field at all.
+  static bool ParseSmaps(const std::string& contents, Values* values);
+
+  // Gives free heap memory back to the system. Returns how many bytes of it
+  // malloc no longer holds.
+  static int64 TrimHeap();
+
+  // Where the smaps values are read from; the rollup is a lot cheaper, but
+  // only newer kernels have it.
+  static const char kSmapsRollupPath[];
+  static const char kSmapsPath[];
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(MemoryStats);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MEMORY_STATS_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/memory_stats.h"
+
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+TEST(MemoryStatsTest, ParseSmaps) {
+  const char kSmaps[] =
+      "00400000-0048a000 r-xp 00000000 fd:03 960637       /bin/session\n"
+      "Size:                552 kB\n"
+      "Rss:                 460 kB\n"
+      "Pss:                 230 kB\n"
+      "Swap:                  0 kB\n"
+      "VmFlags: rd ex mr mw me dw\n"
+      "0068a000-0068b000 rw-p 0008a000 fd:03 960637       /bin/session\n"
+      "Rss:                   4 kB\n"
+      "Pss:                   4 kB\n"
+      "Swap:                  8 kB\n";
+  MemoryStats::Values values;
+  values["user_sessions"] = 1;
+  ASSERT_TRUE(MemoryStats::ParseSmaps(kSmaps, &values));
+  EXPECT_EQ(464, values["rss_kb"]);
+  EXPECT_EQ(234, values["pss_kb"]);
+  EXPECT_EQ(8, values["swap_kb"]);
+  EXPECT_EQ(0U, values.count("pss_anon_kb"));
+  EXPECT_EQ(1, values["user_sessions"]);
+}
+
+TEST(MemoryStatsTest, ParseSmapsRollup) {
+  const char kRollup[] =
+      "00400000-7ffe6a5fe000 ---p 00000000 00:00 0    [rollup]\n"
+      "Rss:                2844 kB\n"
+      "Pss:                1190 kB\n"
+      "Pss_Anon:            700 kB\n"
+      "Pss_File:            490 kB\n"
+      "Swap:                  0 kB\n";
+  MemoryStats::Values values;
+  ASSERT_TRUE(MemoryStats::ParseSmaps(kRollup, &values));
+  EXPECT_EQ(2844, values["rss_kb"]);
+  EXPECT_EQ(1190, values["pss_kb"]);
+  EXPECT_EQ(700, values["pss_anon_kb"]);
+  EXPECT_EQ(490, values["pss_file_kb"]);
+}
+
+TEST(MemoryStatsTest, ParseSmapsGarbage) {
+  MemoryStats::Values values;
+  EXPECT_FALSE(MemoryStats::ParseSmaps("", &values));
+  EXPECT_FALSE(MemoryStats::ParseSmaps("Pss: lots\nRss kB\n", &values));
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(MemoryStatsTest, Collect) {
+  MemoryStats::Values values;
+  MemoryStats::Collect(&values);
+  EXPECT_GT(values["rss_kb"], 0);
+  EXPECT_GT(values["heap_in_use_bytes"], 0);
+}
+
+}  // namespace login_manager
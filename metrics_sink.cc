@@ -0,0 +1,288 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/metrics_sink.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/stringprintf.h>
+#include <metrics/metrics_library.h>
+
+extern "C" {
+#include <rootdev/rootdev.h>
+}
+
+#ifndef CLOCK_BOOTTIME
+#define CLOCK_BOOTTIME 7
+#endif
+
+namespace login_manager {
+
+// static
+const int MetricsSink::kBatchDelayMs = 1000;
+
+namespace {
+
+const char kUptimeFile[] = "/proc/uptime";
+const char kSysBlockDir[] = "/sys/block";
+const char kBootstatUptimePrefix[] = "uptime-";
+const char kBootstatDiskPrefix[] = "disk-";
+
+// Returns the idle time field of /proc/uptime, or "0.00".
+std::string ReadIdleTime() {
+  std::string uptime;
+  if (file_util::ReadFileToString(base::FilePath(kUptimeFile), &uptime)) {
+    size_t space = uptime.find(' ');
+    size_t newline = uptime.find('\n');
+    if (space != std::string::npos && newline != std::string::npos &&
+        newline > space) {
+      return uptime.substr(space + 1, newline - space - 1);
+    }
+  }
+  return "0.00";
+}
+
+}  // namespace
+
+MetricsSink::MetricsSink(const base::FilePath& bootstat_dir,
+                         scoped_ptr<MetricsLibraryInterface> metrics_lib)
+    : bootstat_dir_(bootstat_dir),
+      metrics_lib_(metrics_lib.Pass()),
+      work_available_(&lock_),
+      batch_written_(&lock_),
+      sampled_(0),
+      entries_queued_(0),
+      entries_written_(0),
+      flush_requested_(false),
+      stopping_(false) {
+}
+
+MetricsSink::~MetricsSink() {
+  Stop();
+}
+
+void MetricsSink::RecordBootstat(const char* tag) {
+  Entry entry;
+  entry.type = Entry::BOOTSTAT;
+  entry.name = tag;
+  clock_gettime(CLOCK_BOOTTIME, &entry.uptime);
+  entry.sampled = false;
+  entry.sample = entry.max = entry.min = entry.nbuckets = 0;
+  if (!Enqueue(entry)) {
+    entry.idle_time = ReadIdleTime();
+    entry.disk_stats = ReadDiskStats();
+    entry.sampled = true;
+    WriteBatch(std::vector<Entry>(1, entry));
+  }
+}
+
+void MetricsSink::SendEnumToUMA(const std::string& name, int sample, int max) {
+  Entry entry;
+  entry.type = Entry::UMA_ENUM;
+  entry.name = name;
+  entry.uptime.tv_sec = entry.uptime.tv_nsec = 0;
+  entry.sampled = true;
+  entry.sample = sample;
+  entry.max = max;
+  entry.min = entry.nbuckets = 0;
+  if (!Enqueue(entry))
+    WriteBatch(std::vector<Entry>(1, entry));
+}
+
+void MetricsSink::SendToUMA(const std::string& name, int sample, int min,
+                            int max, int nbuckets) {
+  Entry entry;
+  entry.type = Entry::UMA_HISTOGRAM;
+  entry.name = name;
+  entry.uptime.tv_sec = entry.uptime.tv_nsec = 0;
+  entry.sampled = true;
+  entry.sample = sample;
+  entry.min = min;
+  entry.max = max;
+  entry.nbuckets = nbuckets;
+  if (!Enqueue(entry))
+    WriteBatch(std::vector<Entry>(1, entry));
+}
+
+void MetricsSink::Flush() {
+  base::AutoLock lock(lock_);
+  if (!thread_.get())
+    return;  // Nothing has been queued yet.
+  const uint64 target = entries_queued_;
+  flush_requested_ = true;
+  work_available_.Signal();
+  while (entries_written_ < target)
+    batch_written_.Wait();
+}
+
+void MetricsSink::Stop() {
+  {
+    base::AutoLock lock(lock_);
+    if (stopping_)
+      return;
+    stopping_ = true;
+    work_available_.Signal();
+  }
+  // Run() drains |pending_| before it returns.
+  if (thread_.get())
+    thread_->Join();
+}
+
+void MetricsSink::Run() {
+  base::AutoLock lock(lock_);
+  while (true) {
+    while (pending_.empty() && !stopping_)
+      work_available_.Wait();
+
+    // Give the batch a chance to fill up, unless somebody is waiting for it.
+    SampleBootstats();
+    WaitForBatch(base::TimeDelta::FromMilliseconds(kBatchDelayMs));
+
+    std::vector<Entry> batch;
+    batch.swap(pending_);
+    sampled_ = 0;
+    flush_requested_ = false;
+    {
+      base::AutoUnlock unlock(lock_);
+      WriteBatch(batch);
+    }
+    entries_written_ += batch.size();
+    batch_written_.Broadcast();
+
+    if (stopping_ && pending_.empty())
+      return;
+  }
+}
+
+void MetricsSink::SampleBootstats() {
+  lock_.AssertAcquired();
+  // Only Run() removes entries, so indices into |pending_| stay valid while
+  // |lock_| is released.
+  while (sampled_ < pending_.size()) {
+    const size_t end = pending_.size();
+    bool needed = false;
+    for (size_t i = sampled_; i < end; ++i)
+      needed |= !pending_[i].sampled;
+    std::string idle_time, disk_stats;
+    if (needed) {
+      base::AutoUnlock unlock(lock_);
+      idle_time = ReadIdleTime();
+      disk_stats = ReadDiskStats();
+    }
+    for (size_t i = sampled_; i < end; ++i) {
+      Entry& entry = pending_[i];
+      if (!entry.sampled) {
+        entry.idle_time = idle_time;
+        entry.disk_stats = disk_stats;
+        entry.sampled = true;
+      }
+    }
+    sampled_ = end;
+  }
+}
+
+void MetricsSink::WaitForBatch(base::TimeDelta delay) {
+  lock_.AssertAcquired();
+  const base::TimeTicks deadline = base::TimeTicks::Now() + delay;
+  while (!flush_requested_ && !stopping_) {
+    const base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+    if (remaining <= base::TimeDelta())
+      break;
+    work_available_.TimedWait(remaining);
+    SampleBootstats();
+  }
+  SampleBootstats();
+}
+
+bool MetricsSink::Enqueue(const Entry& entry) {
+  base::AutoLock lock(lock_);
+  if (stopping_)
+    return false;
+  if (!thread_.get()) {
+    thread_.reset(new base::DelegateSimpleThread(this, "MetricsSink"));
+    thread_->Start();
+  }
+  pending_.push_back(entry);
+  ++entries_queued_;
+  // Boot stats wake the thread up so that it samples them right away.
+  if (pending_.size() == 1 || !entry.sampled)
+    work_available_.Signal();
+  return true;
+}
+
+void MetricsSink::WriteBatch(const std::vector<Entry>& batch) {
+  for (std::vector<Entry>::const_iterator it = batch.begin();
+       it != batch.end(); ++it) {
+    switch (it->type) {
+      case Entry::BOOTSTAT: {
+        // Same format as /proc/uptime, which is what bootstat records.
+        AppendToFile(bootstat_dir_.Append(kBootstatUptimePrefix + it->name),
+                     StringPrintf("%ld.%02ld %s\n",
+                                  static_cast<long>(it->uptime.tv_sec),
+                                  it->uptime.tv_nsec / 10000000,
+                                  it->idle_time.c_str()));
+        if (!it->disk_stats.empty()) {
+          AppendToFile(bootstat_dir_.Append(kBootstatDiskPrefix + it->name),
+                       it->disk_stats);
+        }
+        break;
+      }
+      case Entry::UMA_ENUM:
+        if (metrics_lib_.get())
+          metrics_lib_->SendEnumToUMA(it->name, it->sample, it->max);
+        break;
+      case Entry::UMA_HISTOGRAM:
+        if (metrics_lib_.get()) {
+          metrics_lib_->SendToUMA(it->name, it->sample, it->min, it->max,
+                                  it->nbuckets);
+        }
+        break;
+      default:
+        NOTREACHED();
+    }
+  }
+}
+
+// static
+void MetricsSink::AppendToFile(const base::FilePath& file,
+                               const std::string& data) {
+  int fd = HANDLE_EINTR(open(file.value().c_str(),
+                             O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+  if (fd < 0) {
+    PLOG(WARNING) << "Can't open " << file.value();
+    return;
+  }
+  if (file_util::WriteFileDescriptor(fd, data.data(), data.size()) !=
+      static_cast<int>(data.size())) {
+    PLOG(WARNING) << "Can't append to " << file.value();
+  }
+  if (HANDLE_EINTR(close(fd)) != 0)
+    PLOG(WARNING) << "Can't close " << file.value();
+}
+
+std::string MetricsSink::ReadDiskStats() {
+  if (disk_stat_file_.empty()) {
+    char root_disk[PATH_MAX];
+    if (rootdev(root_disk, sizeof(root_disk), true, true) != 0) {
+      LOG(WARNING) << "Can't determine the root disk, not recording disk stats";
+      return std::string();
+    }
+    disk_stat_file_ = base::FilePath(kSysBlockDir)
+        .Append(base::FilePath(root_disk).BaseName())
+        .Append("stat");
+  }
+  std::string stats;
+  if (!file_util::ReadFileToString(disk_stat_file_, &stats))
+    return std::string();
+  return stats;
+}
+
+}  // namespace login_manager
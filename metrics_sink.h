@@ -0,0 +1,139 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_METRICS_SINK_H_
+#define LOGIN_MANAGER_METRICS_SINK_H_
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+#include <base/threading/simple_thread.h>
+#include <base/time.h>
+
+class MetricsLibraryInterface;
+
+namespace login_manager {
+
+// Sits in front of bootstat and the metrics library so that recording a stat
+// on a latency-sensitive path (e.g. right before launching the browser) costs
+// a clock_gettime() and a queue insertion, instead of reading /proc and /sys
+// and opening, appending to and closing files in the bootstat directory.
+//
+// The uptime is taken when the stat is recorded. The idle time and disk stats
+// are read by a background thread, started on first use, as soon as it wakes
+// up for the entry, so they may lag slightly behind. The files are written in
+// the same format bootstat uses, in batches, on that same thread.
+class MetricsSink : public base::DelegateSimpleThread::Delegate {
+ public:
+  // Boot stats end up in |bootstat_dir|. Takes ownership of |metrics_lib|.
+  MetricsSink(const base::FilePath& bootstat_dir,
+              scoped_ptr<MetricsLibraryInterface> metrics_lib);
+  virtual ~MetricsSink();
+
+  // Records boot stat |tag|, like bootstat_log() would.
+  void RecordBootstat(const char* tag);
+
+  // Queues an enum sample for UMA, see MetricsLibrary::SendEnumToUMA().
+  void SendEnumToUMA(const std::string& name, int sample, int max);
+
+  // Queues a histogram sample for UMA, see MetricsLibrary::SendToUMA().
+  void SendToUMA(const std::string& name, int sample, int min, int max,
+                 int nbuckets);
+
+  // Blocks until everything queued so far has been written out.
+  void Flush();
+
+  // Flushes and stops the background thread. Anything recorded after this
+  // is written synchronously.
+  void Stop();
+
+  // base::DelegateSimpleThread::Delegate implementation:
+  virtual void Run() OVERRIDE;
+
+  // How long the background thread waits for more entries before writing
+  // out a batch.
+  static const int kBatchDelayMs;
+
+ private:
+  struct Entry {
+    enum Type {
+      BOOTSTAT,
+      UMA_ENUM,
+      UMA_HISTOGRAM,
+    };
+    Type type;
+    std::string name;
+    // For BOOTSTAT.
+    struct timespec uptime;
+    // Filled in by SampleBootstats().
+    bool sampled;
+    std::string idle_time;
+    std::string disk_stats;
+    // For UMA_ENUM and UMA_HISTOGRAM.
+    int sample;
+    int max;
+    // For UMA_HISTOGRAM.
+    int min;
+    int nbuckets;
+  };
+
+  // Adds |entry| to |pending_|, starting the background thread if needed.
+  // Returns false if the sink has been stopped, in which case the caller
+  // must write |entry| itself.
+  bool Enqueue(const Entry& entry);
+
+  // Reads the idle time and disk stats for the boot stats in |pending_| that
+  // don't have them yet. Called with |lock_| held, which is released while
+  // reading.
+  void SampleBootstats();
+
+  // Waits on |work_available_| for up to |delay|, or until a flush is
+  // requested or the sink is stopping, sampling boot stats as they come in.
+  void WaitForBatch(base::TimeDelta delay);
+
+  // Writes out |batch|. Only ever runs on one thread at a time.
+  void WriteBatch(const std::vector<Entry>& batch);
+
+  // Appends |data| to |file|, creating it if necessary.
+  static void AppendToFile(const base::FilePath& file, const std::string& data);
+
+  // Returns the contents of the stat file for the root disk, or an empty
+  // string if it can't be determined.
+  std::string ReadDiskStats();
+
+  const base::FilePath bootstat_dir_;
+  scoped_ptr<MetricsLibraryInterface> metrics_lib_;
+  // Resolved on first use, by the background thread, or by the thread
+  // recording boot stats once the sink has been stopped.
+  base::FilePath disk_stat_file_;
+
+  // Protects everything below.
+  base::Lock lock_;
+  // Signaled when there is work for the background thread.
+  base::ConditionVariable work_available_;
+  // Signaled whenever a batch has been written.
+  base::ConditionVariable batch_written_;
+  std::vector<Entry> pending_;
+  // Entries of |pending_| before this one have been through
+  // SampleBootstats().
+  size_t sampled_;
+  uint64 entries_queued_;
+  uint64 entries_written_;
+  bool flush_requested_;
+  bool stopping_;
+  scoped_ptr<base::DelegateSimpleThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsSink);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_METRICS_SINK_H_
@@ -0,0 +1,99 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/metrics_sink.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/string_split.h>
+#include <gtest/gtest.h>
+#include <metrics/metrics_library.h>
+
+namespace login_manager {
+
+class MetricsSinkTest : public ::testing::Test {
+ public:
+  MetricsSinkTest() {}
+  virtual ~MetricsSinkTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    sink_.reset(new MetricsSink(tmpdir_.path(),
+                                scoped_ptr<MetricsLibraryInterface>()));
+  }
+
+ protected:
+  base::FilePath UptimeFile(const std::string& tag) {
+    return tmpdir_.path().AppendASCII("uptime-" + tag);
+  }
+
+  // Returns the lines recorded for |tag|.
+  std::vector<std::string> ReadUptimes(const std::string& tag) {
+    std::string contents;
+    std::vector<std::string> lines;
+    if (file_util::ReadFileToString(UptimeFile(tag), &contents))
+      base::SplitString(contents, '\n', &lines);
+    // Drop the empty string following the final newline.
+    if (!lines.empty() && lines.back().empty())
+      lines.pop_back();
+    return lines;
+  }
+
+  base::ScopedTempDir tmpdir_;
+  scoped_ptr<MetricsSink> sink_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MetricsSinkTest);
+};
+
+TEST_F(MetricsSinkTest, FlushWritesBootstats) {
+  sink_->RecordBootstat("foo");
+  sink_->RecordBootstat("bar");
+  sink_->RecordBootstat("foo");
+  sink_->Flush();
+
+  std::vector<std::string> foo = ReadUptimes("foo");
+  ASSERT_EQ(2U, foo.size());
+  EXPECT_EQ(1U, ReadUptimes("bar").size());
+
+  // Each line is "<uptime> <idle>", and uptimes don't go backwards.
+  std::vector<std::string> fields;
+  base::SplitString(foo[0], ' ', &fields);
+  ASSERT_EQ(2U, fields.size());
+  double first = 0, second = 0;
+  ASSERT_EQ(1, sscanf(foo[0].c_str(), "%lf", &first));
+  ASSERT_EQ(1, sscanf(foo[1].c_str(), "%lf", &second));
+  EXPECT_GT(first, 0);
+  EXPECT_LE(first, second);
+}
+
+TEST_F(MetricsSinkTest, FlushWithoutEntries) {
+  sink_->Flush();
+  EXPECT_FALSE(file_util::PathExists(UptimeFile("foo")));
+}
+
+TEST_F(MetricsSinkTest, StopDrainsQueue) {
+  sink_->RecordBootstat("foo");
+  sink_->Stop();
+  EXPECT_EQ(1U, ReadUptimes("foo").size());
+
+  // After stopping, stats are written synchronously.
+  sink_->RecordBootstat("foo");
+  EXPECT_EQ(2U, ReadUptimes("foo").size());
+}
+
+TEST_F(MetricsSinkTest, DestructionDrainsQueue) {
+  sink_->RecordBootstat("foo");
+  sink_.reset();
+  EXPECT_EQ(1U, ReadUptimes("foo").size());
+}
+
+}  // namespace login_manager
@@ -0,0 +1,30 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MOCK_BROWSER_HEARTBEAT_H_
+#define LOGIN_MANAGER_MOCK_BROWSER_HEARTBEAT_H_
+
+#include "login_manager/browser_heartbeat.h"
+
+#include <base/basictypes.h>
+#include <gmock/gmock.h>
+
+namespace login_manager {
+
+class MockBrowserHeartbeat : public BrowserHeartbeat {
+ public:
+  MockBrowserHeartbeat();
+  virtual ~MockBrowserHeartbeat();
+
+  MOCK_METHOD0(Reset, void());
+  MOCK_CONST_METHOD0(HasBeaten, bool());
+  MOCK_CONST_METHOD0(GetStaleness, base::TimeDelta());
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockBrowserHeartbeat);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MOCK_BROWSER_HEARTBEAT_H_
@@ -16,8 +16,6 @@ class MockChildJob : public ChildJobInterface {
  public:
   MockChildJob();
   virtual ~MockChildJob();
-  MOCK_CONST_METHOD0(ShouldStop, bool());
-  MOCK_METHOD0(RecordTime, void());
   MOCK_METHOD0(Run, void());
   MOCK_METHOD2(StartSession, void(const std::string&, const std::string&));
   MOCK_METHOD0(StopSession, void());
@@ -29,6 +27,8 @@ class MockChildJob : public ChildJobInterface {
   MOCK_METHOD1(SetExtraArguments, void(const std::vector<std::string>&));
   MOCK_METHOD1(SetOneTimeArguments, void(const std::vector<std::string>&));
   MOCK_METHOD0(ClearOneTimeArguments, void());
+  MOCK_METHOD1(SetHeartbeatFd, void(int));
+  MOCK_METHOD1(SetSessionManagerAddress, void(const std::string&));
 };
 }  // namespace login_manager
 
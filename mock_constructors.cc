@@ -5,7 +5,9 @@
 #include <base/message_loop_proxy.h>
 #include <base/time.h>
 
+#include "login_manager/mock_browser_heartbeat.h"
 #include "login_manager/mock_child_job.h"
+#include "login_manager/mock_crash_collection_watcher.h"
 #include "login_manager/mock_device_policy_service.h"
 #include "login_manager/mock_file_checker.h"
 #include "login_manager/mock_key_generator.h"
@@ -16,6 +18,8 @@
 #include "login_manager/mock_policy_service.h"
 #include "login_manager/mock_policy_store.h"
 #include "login_manager/mock_process_manager_service.h"
+#include "login_manager/mock_respawn_governor.h"
+#include "login_manager/mock_restart_policy.h"
 #include "login_manager/mock_session_manager.h"
 #include "login_manager/mock_system_utils.h"
 #include "login_manager/mock_user_policy_service_factory.h"
@@ -33,9 +37,16 @@
 // mock I define, I will simply collect the constructors all here.
 
 namespace login_manager {
+MockBrowserHeartbeat::MockBrowserHeartbeat() {}
+MockBrowserHeartbeat::~MockBrowserHeartbeat() {}
+
 MockChildJob::MockChildJob() {}
 MockChildJob::~MockChildJob() {}
 
+MockCrashCollectionWatcher::MockCrashCollectionWatcher()
+    : CrashCollectionWatcher(std::vector<FilePath>(), FilePath("")) {}
+MockCrashCollectionWatcher::~MockCrashCollectionWatcher() {}
+
 MockDevicePolicyService::MockDevicePolicyService()
     : DevicePolicyService(FilePath(""), FilePath(""),
                           scoped_ptr<PolicyStore>(),
@@ -54,7 +65,7 @@ MockKeyGenerator::~MockKeyGenerator() {}
 MockLivenessChecker::MockLivenessChecker() {}
 MockLivenessChecker::~MockLivenessChecker() {}
 
-MockMetrics::MockMetrics() : LoginMetrics(FilePath("")) {}
+MockMetrics::MockMetrics() : LoginMetrics(NULL) {}
 MockMetrics::~MockMetrics() {}
 
 MockMitigator::MockMitigator() {}
@@ -76,6 +87,14 @@ MockPolicyServiceDelegate::~MockPolicyServiceDelegate() {}
 MockPolicyStore::MockPolicyStore() : PolicyStore(FilePath("")) {}
 MockPolicyStore::~MockPolicyStore() {}
 
+MockRespawnGovernor::MockRespawnGovernor()
+    : RespawnGovernor(FilePath(""), RespawnGovernor::Config(), NULL) {}
+MockRespawnGovernor::~MockRespawnGovernor() {}
+
+MockRestartPolicy::MockRestartPolicy()
+    : RestartPolicy(RestartPolicy::Config(), NULL) {}
+MockRestartPolicy::~MockRestartPolicy() {}
+
 MockSessionManager::MockSessionManager() {}
 MockSessionManager::~MockSessionManager() {}
 
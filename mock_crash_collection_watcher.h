@@ -0,0 +1,28 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MOCK_CRASH_COLLECTION_WATCHER_H_
+#define LOGIN_MANAGER_MOCK_CRASH_COLLECTION_WATCHER_H_
+
+#include "login_manager/crash_collection_watcher.h"
+
+#include <base/basictypes.h>
+#include <gmock/gmock.h>
+
+namespace login_manager {
+
+class MockCrashCollectionWatcher : public CrashCollectionWatcher {
+ public:
+  MockCrashCollectionWatcher();
+  virtual ~MockCrashCollectionWatcher();
+
+  MOCK_METHOD1(IsCollecting, bool(pid_t));
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockCrashCollectionWatcher);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MOCK_CRASH_COLLECTION_WATCHER_H_
@@ -37,6 +37,7 @@ class MockDevicePolicyService : public DevicePolicyService {
   MOCK_METHOD2(ReportPolicyFileMetrics, void(bool, bool));
   MOCK_METHOD0(GetSettings,
                const enterprise_management::ChromeDeviceSettingsProto&(void));
+  MOCK_METHOD0(MachineInfoNeeded, bool(void));
 };
 }  // namespace login_manager
 
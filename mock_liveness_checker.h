@@ -20,6 +20,7 @@ class MockLivenessChecker : public LivenessChecker {
   MOCK_METHOD0(Start, void());
   MOCK_METHOD0(Stop, void());
   MOCK_METHOD0(IsRunning, bool());
+  MOCK_METHOD1(SetInterval, void(base::TimeDelta));
 
  private:
   DISALLOW_COPY_AND_ASSIGN(MockLivenessChecker);
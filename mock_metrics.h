@@ -22,6 +22,10 @@ class MockMetrics : public LoginMetrics {
   MOCK_METHOD1(SendPolicyFilesStatus, bool(const PolicyFilesStatus&));
   MOCK_METHOD1(RecordStats, void(const char*));
   MOCK_METHOD0(HasRecordedChromeExec, bool());
+  MOCK_METHOD3(SendEnum, void(const std::string&, int, int));
+  MOCK_METHOD5(SendHistogram,
+               void(const std::string&, int, int, int, int));
+  MOCK_METHOD0(Flush, void());
  private:
   DISALLOW_COPY_AND_ASSIGN(MockMetrics);
 };
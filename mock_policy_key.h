@@ -32,6 +32,8 @@ class MockPolicyKey : public PolicyKey {
                             const std::vector<uint8>&));
   MOCK_METHOD1(ClobberCompromisedKey, bool(const std::vector<uint8>&));
   MOCK_METHOD4(Verify, bool(const uint8*, uint32, const uint8*, uint32));
+  MOCK_METHOD2(VerifyBatch, void(const std::vector<NssUtil::VerifyItem>&,
+                                 std::vector<bool>*));
   MOCK_METHOD3(Sign, bool(const uint8*, uint32, std::vector<uint8>*));
   MOCK_CONST_METHOD0(public_key_der, const std::vector<uint8>&());
 };
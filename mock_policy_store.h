@@ -17,7 +17,10 @@ class MockPolicyStore : public PolicyStore {
   MOCK_CONST_METHOD0(Get,
                      const enterprise_management::PolicyFetchResponse&(void));
   MOCK_METHOD0(Persist, bool(void));
+  MOCK_METHOD1(PersistBlob, bool(const std::string&));
+  MOCK_CONST_METHOD0(GetFileState, FileState());
   MOCK_METHOD1(Set, void(const enterprise_management::PolicyFetchResponse&));
+  MOCK_METHOD1(Swap, void(enterprise_management::PolicyFetchResponse*));
 };
 }  // namespace login_manager
 
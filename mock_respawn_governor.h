@@ -0,0 +1,30 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MOCK_RESPAWN_GOVERNOR_H_
+#define LOGIN_MANAGER_MOCK_RESPAWN_GOVERNOR_H_
+
+#include "login_manager/respawn_governor.h"
+
+#include <base/basictypes.h>
+#include <gmock/gmock.h>
+
+namespace login_manager {
+
+class MockRespawnGovernor : public RespawnGovernor {
+ public:
+  MockRespawnGovernor();
+  virtual ~MockRespawnGovernor();
+
+  MOCK_METHOD0(OnStartup, bool());
+  MOCK_METHOD0(OnBrowserExitingTooFast, Action());
+  MOCK_METHOD1(OnExit, void(bool));
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockRespawnGovernor);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MOCK_RESPAWN_GOVERNOR_H_
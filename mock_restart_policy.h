@@ -0,0 +1,32 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_MOCK_RESTART_POLICY_H_
+#define LOGIN_MANAGER_MOCK_RESTART_POLICY_H_
+
+#include "login_manager/restart_policy.h"
+
+#include <base/basictypes.h>
+#include <gmock/gmock.h>
+
+namespace login_manager {
+
+class MockRestartPolicy : public RestartPolicy {
+ public:
+  MockRestartPolicy();
+  virtual ~MockRestartPolicy();
+
+  MOCK_METHOD0(RecordStart, void());
+  MOCK_METHOD0(OnExit, Decision());
+  MOCK_METHOD0(Reset, void());
+  MOCK_METHOD2(SetRestartLimit, void(uint, time_t));
+  MOCK_CONST_METHOD0(GetDegradedFlags, Flags());
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockRestartPolicy);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_MOCK_RESTART_POLICY_H_
@@ -22,6 +22,10 @@ class MockSessionManager : public SessionManagerInterface {
   MOCK_METHOD2(ImportValidateAndStoreGeneratedKey, void(const std::string&,
                                                         const base::FilePath&));
   MOCK_METHOD0(ScreenIsLocked, bool());
+  MOCK_METHOD0(StartLockedRecovery, void());
+  MOCK_METHOD0(IsRecoveringLock, bool());
+  MOCK_METHOD0(TrimMemory, void());
+  MOCK_METHOD1(OnNameLost, void(const std::string&));
   MOCK_METHOD0(Initialize, bool());
   MOCK_METHOD0(Finalize, void());
   MOCK_METHOD2(EmitLoginPromptReady, gboolean(gboolean*, GError**));
@@ -44,6 +48,18 @@ class MockSessionManager : public SessionManagerInterface {
                gboolean(gchar*, GArray**, GError**));
   MOCK_METHOD1(RetrieveSessionState, gboolean(gchar**));
   MOCK_METHOD0(RetrieveActiveSessions, GHashTable*(void));
+  MOCK_METHOD1(RetrievePolicyStats, gboolean(gchar**));
+  MOCK_METHOD3(GetDeviceSettingValues,
+               gboolean(const gchar**, GHashTable**, GError**));
+  MOCK_METHOD2(WatchDeviceSettings,
+               gboolean(const gchar**, DBusGMethodInvocation*));
+  MOCK_METHOD2(UnwatchDeviceSettings,
+               gboolean(guint, DBusGMethodInvocation*));
+  MOCK_METHOD2(GetTunables, gboolean(GHashTable**, GError**));
+  MOCK_METHOD3(SetTunable, gboolean(gchar*, gint64, GError**));
+  MOCK_METHOD1(ReloadTunables, gboolean(GError**));
+  MOCK_METHOD2(GetMemoryStats, gboolean(GHashTable**, GError**));
+  MOCK_METHOD3(StartProfiling, gboolean(gint, gchar**, GError**));
   MOCK_METHOD1(LockScreen, gboolean(GError**));
   MOCK_METHOD1(HandleLockScreenShown, gboolean(GError**));
 
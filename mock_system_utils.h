@@ -33,6 +33,9 @@ class MockSystemUtils : public SystemUtils {
   MOCK_METHOD0(IsDevMode, int(void));
   MOCK_METHOD1(Exists, bool(const FilePath&));
   MOCK_METHOD3(AtomicFileWrite, bool(const FilePath&, const char*, int));
+  MOCK_METHOD4(AtomicFileWriteAsync,
+               void(const FilePath&, const std::string&, mode_t,
+                    const AsyncFileIo::StatusCallback&));
   MOCK_METHOD2(ChildIsGone, bool(pid_t child_spec, int timeout));
   MOCK_METHOD2(EnsureAndReturnSafeFileSize,
                bool(const FilePath& file, int32* file_size_32));
@@ -49,6 +52,8 @@ class MockSystemUtils : public SystemUtils {
   MOCK_METHOD2(EmitSignalWithStringArgs, void(const char*,
                                               const std::vector<std::string>&));
   MOCK_METHOD2(EmitStatusSignal, void(const char*, bool));
+  MOCK_METHOD3(EmitStatusSignalWithStringArgs,
+               void(const char*, bool, const std::vector<std::string>&));
   MOCK_METHOD1(CallMethodOnPowerManager, void(const char*));
 
   // gmock can't handle methods that return scoped_ptrs.
@@ -14,6 +14,7 @@ class MockUserPolicyServiceFactory : public UserPolicyServiceFactory {
   MockUserPolicyServiceFactory();
   virtual ~MockUserPolicyServiceFactory();
   MOCK_METHOD1(Create, PolicyService*(const std::string&));
+  MOCK_METHOD1(CreateEphemeral, PolicyService*(const std::string&));
 };
 
 }  // namespace login_manager
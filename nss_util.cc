@@ -4,25 +4,32 @@
 
 #include "login_manager/nss_util.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
+#include <base/atomic_sequence_num.h>
 #include <base/basictypes.h>
 #include <base/file_path.h>
 #include <base/file_util.h>
 #include <base/logging.h>
 #include <base/memory/scoped_ptr.h>
 #include <base/stringprintf.h>
+#include <base/threading/simple_thread.h>
 #include <crypto/nss_util.h>
 #include <crypto/nss_util_internal.h>
 #include <crypto/rsa_private_key.h>
 #include <crypto/scoped_nss_types.h>
 #include <crypto/signature_creator.h>
 #include <crypto/signature_verifier.h>
+#include <cryptohi.h>
 #include <keyhi.h>
 #include <pk11pub.h>
 #include <prerror.h>
+#include <secasn1.h>
+#include <secder.h>
 #include <secmod.h>
+#include <secoid.h>
 #include <secmodt.h>
 
 using crypto::RSAPrivateKey;
@@ -41,10 +48,130 @@ namespace login_manager {
 ///////////////////////////////////////////////////////////////////////////
 // NssUtil
 
-NssUtil::NssUtil() {}
+// static
+const int NssUtil::kDefaultVerifyThreads = 4;
+
+NssUtil::VerifyItem::VerifyItem(const uint8* signature, int signature_len,
+                                const uint8* data, int data_len)
+    : signature(signature),
+      signature_len(signature_len),
+      data(data),
+      data_len(data_len) {
+}
+
+NssUtil::NssUtil() : verify_threads_(kDefaultVerifyThreads) {}
 
 NssUtil::~NssUtil() {}
 
+void NssUtil::VerifyBatch(const uint8* algorithm, int algorithm_len,
+                          const uint8* public_key, int public_key_len,
+                          const std::vector<VerifyItem>& items,
+                          std::vector<bool>* OUT_results) {
+  OUT_results->clear();
+  for (std::vector<VerifyItem>::const_iterator it = items.begin();
+       it != items.end(); ++it) {
+    OUT_results->push_back(Verify(algorithm, algorithm_len,
+                                  it->signature, it->signature_len,
+                                  it->data, it->data_len,
+                                  public_key, public_key_len));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// BatchVerifier
+
+namespace {
+
+// Checks a batch of signatures made with the same key and algorithm, which
+// are decoded only once. Run() may be called on several threads at once, each
+// of which takes items off the batch until there are none left. NSS keeps
+// per-key state, e.g. the PKCS#11 object a key gets imported as, that isn't
+// safe to share, so each thread verifies with its own copy of the key.
+class BatchVerifier : public base::DelegateSimpleThread::Delegate {
+ public:
+  BatchVerifier(const std::vector<NssUtil::VerifyItem>& items,
+                std::vector<char>* results)
+      : items_(items),
+        results_(results),
+        arena_(NULL),
+        public_key_(NULL) {
+    results_->assign(items_.size(), false);
+  }
+
+  virtual ~BatchVerifier() {
+    if (public_key_)
+      SECKEY_DestroyPublicKey(public_key_);
+    if (arena_)
+      PORT_FreeArena(arena_, PR_FALSE);
+  }
+
+  // Decodes |algorithm| and |public_key|. Returns false if either is bad.
+  bool Initialize(const uint8* algorithm, int algorithm_len,
+                  const uint8* public_key, int public_key_len) {
+    SECItem spki_der;
+    spki_der.type = siBuffer;
+    spki_der.data = const_cast<uint8*>(public_key);
+    spki_der.len = public_key_len;
+    CERTSubjectPublicKeyInfo* spki =
+        SECKEY_DecodeDERSubjectPublicKeyInfo(&spki_der);
+    if (!spki)
+      return false;
+    public_key_ = SECKEY_ExtractPublicKey(spki);
+    SECKEY_DestroySubjectPublicKeyInfo(spki);
+    if (!public_key_)
+      return false;
+
+    arena_ = PORT_NewArena(DER_DEFAULT_CHUNKSIZE);
+    if (!arena_)
+      return false;
+    SECItem algorithm_der;
+    algorithm_der.type = siBuffer;
+    algorithm_der.data = const_cast<uint8*>(algorithm);
+    algorithm_der.len = algorithm_len;
+    return SEC_QuickDERDecodeItem(arena_, &algorithm_,
+                                  SEC_ASN1_GET(SECOID_AlgorithmIDTemplate),
+                                  &algorithm_der) == SECSuccess;
+  }
+
+  // base::DelegateSimpleThread::Delegate implementation:
+  virtual void Run() OVERRIDE {
+    // |public_key_| is only read from here on.
+    SECKEYPublicKey* key = SECKEY_CopyPublicKey(public_key_);
+    if (!key) {
+      LOG(ERROR) << "Could not copy public key";
+      return;
+    }
+    const int count = items_.size();
+    for (int i = next_.GetNext(); i < count; i = next_.GetNext())
+      (*results_)[i] = Check(items_[i], key);
+    SECKEY_DestroyPublicKey(key);
+  }
+
+ private:
+  bool Check(const NssUtil::VerifyItem& item, SECKEYPublicKey* key) const {
+    SECItem signature;
+    signature.type = siBuffer;
+    signature.data = const_cast<uint8*>(item.signature);
+    signature.len = item.signature_len;
+    return VFY_VerifyDataWithAlgorithmID(item.data, item.data_len,
+                                         key, &signature, &algorithm_,
+                                         NULL, NULL) == SECSuccess;
+  }
+
+  const std::vector<NssUtil::VerifyItem>& items_;
+  // Not a vector<bool>, whose elements can't be written from several threads.
+  std::vector<char>* results_;
+  base::AtomicSequenceNumber next_;
+
+  PLArenaPool* arena_;
+  SECAlgorithmID algorithm_;  // Allocated in |arena_|.
+  SECKEYPublicKey* public_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchVerifier);
+};
+
+}  // namespace
+
 ///////////////////////////////////////////////////////////////////////////
 // NssUtilImpl
 
@@ -74,6 +201,11 @@ class NssUtilImpl : public NssUtil {
                       const uint8* data, int data_len,
                       const uint8* public_key, int public_key_len) OVERRIDE;
 
+  virtual void VerifyBatch(const uint8* algorithm, int algorithm_len,
+                           const uint8* public_key, int public_key_len,
+                           const std::vector<VerifyItem>& items,
+                           std::vector<bool>* OUT_results) OVERRIDE;
+
   virtual bool Sign(const uint8* data, int data_len,
                     std::vector<uint8>* OUT_signature,
                     RSAPrivateKey* key) OVERRIDE;
@@ -249,6 +381,32 @@ bool NssUtilImpl::Verify(const uint8* algorithm, int algorithm_len,
   return (verifier_.VerifyFinal());
 }
 
+void NssUtilImpl::VerifyBatch(const uint8* algorithm, int algorithm_len,
+                              const uint8* public_key, int public_key_len,
+                              const std::vector<VerifyItem>& items,
+                              std::vector<bool>* OUT_results) {
+  std::vector<char> results;
+  BatchVerifier verifier(items, &results);
+  if (!verifier.Initialize(algorithm, algorithm_len,
+                           public_key, public_key_len)) {
+    LOG(ERROR) << "Could not initialize batch verifier";
+    OUT_results->assign(items.size(), false);
+    return;
+  }
+
+  const int threads =
+      std::min(verify_threads(), static_cast<int>(items.size()));
+  if (threads <= 1) {
+    verifier.Run();
+  } else {
+    base::DelegateSimpleThreadPool pool("NssVerify", threads);
+    pool.AddWork(&verifier, threads);
+    pool.Start();
+    pool.JoinAll();
+  }
+  OUT_results->assign(results.begin(), results.end());
+}
+
 // This is pretty much just a blind passthrough, so I won't test it
 // in the NssUtil unit tests.  I'll test it from a class that uses this API.
 bool NssUtilImpl::Sign(const uint8* data, int data_len,
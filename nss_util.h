@@ -26,6 +26,17 @@ typedef struct PK11SlotInfoStr PK11SlotInfo;
 // An interface to wrap the usage of crypto/nss_util.h and allow for mocking.
 class NssUtil {
  public:
+  // A signature to check with VerifyBatch(). Doesn't own the buffers.
+  struct VerifyItem {
+    VerifyItem(const uint8* signature, int signature_len,
+               const uint8* data, int data_len);
+
+    const uint8* signature;
+    int signature_len;
+    const uint8* data;
+    int data_len;
+  };
+
   NssUtil();
   virtual ~NssUtil();
 
@@ -62,11 +73,27 @@ class NssUtil {
                       const uint8* data, int data_len,
                       const uint8* public_key, int public_key_len) = 0;
 
+  // Checks each of |items| against |public_key| with |algorithm|, and sets
+  // |OUT_results| to whether each one is valid, in order. This base version
+  // just calls Verify() for every item.
+  virtual void VerifyBatch(const uint8* algorithm, int algorithm_len,
+                           const uint8* public_key, int public_key_len,
+                           const std::vector<VerifyItem>& items,
+                           std::vector<bool>* OUT_results);
+
+  // How many threads VerifyBatch() may spread its work over.
+  void set_verify_threads(int threads) { verify_threads_ = threads; }
+  int verify_threads() const { return verify_threads_; }
+
   virtual bool Sign(const uint8* data, int data_len,
                     std::vector<uint8>* OUT_signature,
                     crypto::RSAPrivateKey* key) = 0;
 
  private:
+  static const int kDefaultVerifyThreads;
+
+  int verify_threads_;
+
   DISALLOW_COPY_AND_ASSIGN(NssUtil);
 };
 }  // namespace login_manager
@@ -4,9 +4,15 @@
 
 #include "login_manager/nss_util.h"
 
+#include <string>
+#include <vector>
+
 #include <base/file_util.h>
 #include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
 #include <base/memory/scoped_ptr.h>
+#include <base/string_number_conversions.h>
+#include <base/time.h>
 #include <crypto/nss_util.h>
 #include <crypto/rsa_private_key.h>
 #include <crypto/scoped_nss_types.h>
@@ -40,6 +46,45 @@ class NssUtilTest : public ::testing::Test {
 
 const char NssUtilTest::kUsername[] = "some.guy@nowhere.com";
 
+namespace {
+
+// sha1WithRSAEncryption, as used for policy.
+const uint8 kAlgorithm[] = {
+  0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+  0xf7, 0x0d, 0x01, 0x01, 0x05, 0x05, 0x00
+};
+
+// Signs |count| different messages with |key|, for VerifyBatch().
+void SignMessages(NssUtil* util,
+                  RSAPrivateKey* key,
+                  int count,
+                  std::vector<std::string>* messages,
+                  std::vector<std::vector<uint8> >* signatures) {
+  messages->resize(count);
+  signatures->resize(count);
+  for (int i = 0; i < count; ++i) {
+    (*messages)[i] = "message " + base::IntToString(i);
+    ASSERT_TRUE(util->Sign(
+        reinterpret_cast<const uint8*>((*messages)[i].data()),
+        (*messages)[i].size(), &(*signatures)[i], key));
+  }
+}
+
+std::vector<NssUtil::VerifyItem> MakeItems(
+    const std::vector<std::string>& messages,
+    const std::vector<std::vector<uint8> >& signatures) {
+  std::vector<NssUtil::VerifyItem> items;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    items.push_back(NssUtil::VerifyItem(
+        &signatures[i][0], signatures[i].size(),
+        reinterpret_cast<const uint8*>(messages[i].data()),
+        messages[i].size()));
+  }
+  return items;
+}
+
+}  // namespace
+
 TEST_F(NssUtilTest, FindFromPublicKey) {
   // Create a keypair, which will put the keys in the user's NSSDB.
   scoped_ptr<RSAPrivateKey> pair(util_->GenerateKeyPairForUser(slot_.get()));
@@ -59,4 +104,64 @@ TEST_F(NssUtilTest, RejectBadPublicKey) {
   EXPECT_FALSE(util_->CheckPublicKeyBlob(public_key));
 }
 
+TEST_F(NssUtilTest, VerifyBatch) {
+  scoped_ptr<RSAPrivateKey> pair(RSAPrivateKey::Create(512));
+  ASSERT_TRUE(pair.get());
+  std::vector<uint8> public_key;
+  ASSERT_TRUE(pair->ExportPublicKey(&public_key));
+
+  std::vector<std::string> messages;
+  std::vector<std::vector<uint8> > signatures;
+  SignMessages(util_.get(), pair.get(), 9, &messages, &signatures);
+  // Swapping signatures makes both invalid.
+  signatures[3].swap(signatures[4]);
+  const std::vector<NssUtil::VerifyItem> items =
+      MakeItems(messages, signatures);
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    util_->set_verify_threads(threads);
+    std::vector<bool> results;
+    util_->VerifyBatch(kAlgorithm, sizeof(kAlgorithm),
+                       &public_key[0], public_key.size(), items, &results);
+    ASSERT_EQ(items.size(), results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+      EXPECT_EQ(i != 3 && i != 4, results[i]) << i << ", " << threads;
+  }
+
+  // A bad key fails everything.
+  std::vector<uint8> bad_key(10, 'a');
+  std::vector<bool> results;
+  util_->VerifyBatch(kAlgorithm, sizeof(kAlgorithm),
+                     &bad_key[0], bad_key.size(), items, &results);
+  EXPECT_EQ(std::vector<bool>(items.size(), false), results);
+}
+
+// Measures VerifyBatch() throughput with an owner-sized key on 1, 2 and 4
+// threads. Run with --gtest_also_run_disabled_tests.
+TEST_F(NssUtilTest, DISABLED_VerifyBatchBenchmark) {
+  const int kItems = 512;
+  scoped_ptr<RSAPrivateKey> pair(RSAPrivateKey::Create(2048));
+  ASSERT_TRUE(pair.get());
+  std::vector<uint8> public_key;
+  ASSERT_TRUE(pair->ExportPublicKey(&public_key));
+  std::vector<std::string> messages;
+  std::vector<std::vector<uint8> > signatures;
+  SignMessages(util_.get(), pair.get(), kItems, &messages, &signatures);
+  const std::vector<NssUtil::VerifyItem> items =
+      MakeItems(messages, signatures);
+
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    util_->set_verify_threads(threads);
+    std::vector<bool> results;
+    const base::TimeTicks start = base::TimeTicks::Now();
+    util_->VerifyBatch(kAlgorithm, sizeof(kAlgorithm),
+                       &public_key[0], public_key.size(), items, &results);
+    const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    EXPECT_EQ(std::vector<bool>(kItems, true), results);
+    LOG(INFO) << threads << " threads: "
+              << kItems * 1000.0 / elapsed.InMillisecondsF()
+              << " verifications/s";
+  }
+}
+
 }  // namespace login_manager
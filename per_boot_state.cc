@@ -0,0 +1,44 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/per_boot_state.h"
+
+namespace login_manager {
+
+// static
+const char PerBootState::kStateFileName[] = "per_boot_state";
+// static
+const uint32 PerBootState::kMagic = 0x50425354;  // "PBST"
+// static
+const uint32 PerBootState::kVersion = 1;
+
+PerBootState::PerBootState(const base::FilePath& path)
+    : mapped_record_(path, sizeof(Record), kMagic, kVersion) {
+}
+
+PerBootState::~PerBootState() {
+}
+
+bool PerBootState::Initialize() {
+  // Carry over anything recorded before the file could be mapped.
+  const uint32 early_flags = record()->flags;
+  if (!mapped_record_.Initialize())
+    return false;
+  record()->flags |= early_flags;
+  mapped_record_.Sync();
+  return true;
+}
+
+bool PerBootState::IsSet(Flag flag) const {
+  return (record()->flags & flag) != 0;
+}
+
+void PerBootState::Set(Flag flag) {
+  if (IsSet(flag))
+    return;
+  record()->flags |= flag;
+  mapped_record_.Sync();
+}
+
+}  // namespace login_manager
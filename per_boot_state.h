@@ -0,0 +1,69 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_PER_BOOT_STATE_H_
+#define LOGIN_MANAGER_PER_BOOT_STATE_H_
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+
+#include "login_manager/mapped_record.h"
+
+namespace login_manager {
+
+// Holds state that has to survive session_manager restarts, but not reboots,
+// in a single small MappedRecord that lives on tmpfs.
+//
+// If the backing file can't be mapped, state is kept in memory only, which
+// means it'll be lost if session_manager restarts.
+class PerBootState {
+ public:
+  enum Flag {
+    // A user has successfully logged in.
+    LOGGED_IN = 1 << 0,
+    // LoginMetrics has reported the state of the policy files to UMA.
+    POLICY_FILES_STATUS_SENT = 1 << 1,
+    // The browser has been executed at least once.
+    CHROME_EXEC_RECORDED = 1 << 2,
+  };
+
+  explicit PerBootState(const base::FilePath& path);
+  virtual ~PerBootState();
+
+  // Maps the record at |path_|, creating it or starting over if the existing
+  // one is not understood. Returns false if the record can't be mapped.
+  bool Initialize();
+
+  virtual bool IsSet(Flag flag) const;
+  virtual void Set(Flag flag);
+
+  // Name of the record within the per-boot flag file directory.
+  static const char kStateFileName[];
+
+ private:
+  friend class PerBootStateTest;
+
+  // On-disk layout. Only ever append fields, and bump |kVersion| if the
+  // meaning of an existing field changes.
+  struct Record {
+    MappedRecord::Header header;
+    uint32 flags;
+  };
+
+  static const uint32 kMagic;
+  static const uint32 kVersion;
+
+  Record* record() { return static_cast<Record*>(mapped_record_.data()); }
+  const Record* record() const {
+    return static_cast<const Record*>(mapped_record_.data());
+  }
+
+  MappedRecord mapped_record_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerBootState);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_PER_BOOT_STATE_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/per_boot_state.h"
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+class PerBootStateTest : public ::testing::Test {
+ public:
+  PerBootStateTest() {}
+  virtual ~PerBootStateTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    state_file_ = tmpdir_.path().AppendASCII(PerBootState::kStateFileName);
+  }
+
+ protected:
+  scoped_ptr<PerBootState> CreateState() {
+    scoped_ptr<PerBootState> state(new PerBootState(state_file_));
+    EXPECT_TRUE(state->Initialize());
+    return state.Pass();
+  }
+
+  static int RecordSize() { return sizeof(PerBootState::Record); }
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath state_file_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PerBootStateTest);
+};
+
+TEST_F(PerBootStateTest, Fresh) {
+  scoped_ptr<PerBootState> state(CreateState());
+  EXPECT_FALSE(state->IsSet(PerBootState::LOGGED_IN));
+  EXPECT_FALSE(state->IsSet(PerBootState::POLICY_FILES_STATUS_SENT));
+  EXPECT_FALSE(state->IsSet(PerBootState::CHROME_EXEC_RECORDED));
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(state_file_, &size));
+  EXPECT_EQ(RecordSize(), size);
+}
+
+TEST_F(PerBootStateTest, SurvivesRestart) {
+  scoped_ptr<PerBootState> state(CreateState());
+  state->Set(PerBootState::LOGGED_IN);
+  state.reset();
+
+  state = CreateState();
+  EXPECT_TRUE(state->IsSet(PerBootState::LOGGED_IN));
+  EXPECT_FALSE(state->IsSet(PerBootState::CHROME_EXEC_RECORDED));
+}
+
+TEST_F(PerBootStateTest, SharedBetweenInstances) {
+  scoped_ptr<PerBootState> first(CreateState());
+  scoped_ptr<PerBootState> second(CreateState());
+  first->Set(PerBootState::CHROME_EXEC_RECORDED);
+  EXPECT_TRUE(second->IsSet(PerBootState::CHROME_EXEC_RECORDED));
+}
+
+TEST_F(PerBootStateTest, DiscardsGarbage) {
+  const char garbage[] = "0123456789abcdef";
+  ASSERT_EQ(RecordSize(),
+            file_util::WriteFile(state_file_, garbage, RecordSize()));
+  scoped_ptr<PerBootState> state(CreateState());
+  EXPECT_FALSE(state->IsSet(PerBootState::LOGGED_IN));
+  EXPECT_FALSE(state->IsSet(PerBootState::POLICY_FILES_STATUS_SENT));
+  EXPECT_FALSE(state->IsSet(PerBootState::CHROME_EXEC_RECORDED));
+}
+
+TEST_F(PerBootStateTest, InMemoryFallback) {
+  PerBootState state(tmpdir_.path().AppendASCII("missing/dir/state"));
+  EXPECT_FALSE(state.Initialize());
+  state.Set(PerBootState::LOGGED_IN);
+  EXPECT_TRUE(state.IsSet(PerBootState::LOGGED_IN));
+}
+
+TEST_F(PerBootStateTest, KeepsStateSetBeforeMapping) {
+  PerBootState state(state_file_);
+  state.Set(PerBootState::POLICY_FILES_STATUS_SENT);
+  EXPECT_TRUE(state.Initialize());
+  EXPECT_TRUE(state.IsSet(PerBootState::POLICY_FILES_STATUS_SENT));
+
+  scoped_ptr<PerBootState> other(CreateState());
+  EXPECT_TRUE(other->IsSet(PerBootState::POLICY_FILES_STATUS_SENT));
+}
+
+}  // namespace login_manager
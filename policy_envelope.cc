@@ -0,0 +1,184 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/policy_envelope.h"
+
+#include <base/logging.h>
+
+#include "login_manager/device_management_backend.pb.h"
+
+namespace login_manager {
+
+namespace {
+
+// Field numbers of PolicyFetchResponse, see device_management_backend.proto.
+enum FieldNumber {
+  POLICY_DATA = 3,
+  POLICY_DATA_SIGNATURE = 4,
+  NEW_PUBLIC_KEY = 5,
+  NEW_PUBLIC_KEY_SIGNATURE = 6,
+};
+
+enum WireType {
+  WIRETYPE_VARINT = 0,
+  WIRETYPE_FIXED64 = 1,
+  WIRETYPE_LENGTH_DELIMITED = 2,
+  WIRETYPE_START_GROUP = 3,
+  WIRETYPE_END_GROUP = 4,
+  WIRETYPE_FIXED32 = 5,
+};
+
+// Same limit protobuf uses for nested messages and groups.
+const int kMaxGroupDepth = 64;
+
+// Reads a varint at |*pos|, advancing |*pos| past it. Returns false if the
+// varint is truncated or longer than 10 bytes.
+bool ReadVarint(const uint8** pos, const uint8* end, uint64* value) {
+  uint64 result = 0;
+  for (int shift = 0; shift < 64 && *pos < end; shift += 7) {
+    const uint8 byte = *(*pos)++;
+    result |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads a tag, splitting it into field number and wire type.
+bool ReadTag(const uint8** pos, const uint8* end,
+             uint32* number, uint32* wire_type) {
+  uint64 tag;
+  if (!ReadVarint(pos, end, &tag) || tag > kuint32max)
+    return false;
+  *number = static_cast<uint32>(tag >> 3);
+  *wire_type = static_cast<uint32>(tag & 0x7);
+  return *number != 0;
+}
+
+// Advances |*pos| past |length| bytes, if there are that many left.
+bool Skip(const uint8** pos, const uint8* end, uint64 length) {
+  if (length > static_cast<uint64>(end - *pos))
+    return false;
+  *pos += length;
+  return true;
+}
+
+// Reads the length of a length-delimited value and returns the value itself.
+bool ReadLengthDelimited(const uint8** pos, const uint8* end,
+                         base::StringPiece* value) {
+  uint64 length;
+  if (!ReadVarint(pos, end, &length))
+    return false;
+  const uint8* start = *pos;
+  if (!Skip(pos, end, length))
+    return false;
+  *value = base::StringPiece(reinterpret_cast<const char*>(start), length);
+  return true;
+}
+
+// Skips the value of field |number|, which has |wire_type|.
+bool SkipValue(uint32 number, uint32 wire_type, int depth,
+               const uint8** pos, const uint8* end) {
+  uint64 unused_varint;
+  base::StringPiece unused_value;
+  switch (wire_type) {
+    case WIRETYPE_VARINT:
+      return ReadVarint(pos, end, &unused_varint);
+    case WIRETYPE_FIXED64:
+      return Skip(pos, end, 8);
+    case WIRETYPE_LENGTH_DELIMITED:
+      return ReadLengthDelimited(pos, end, &unused_value);
+    case WIRETYPE_FIXED32:
+      return Skip(pos, end, 4);
+    case WIRETYPE_START_GROUP: {
+      if (depth >= kMaxGroupDepth)
+        return false;
+      uint32 inner_number, inner_wire_type;
+      while (ReadTag(pos, end, &inner_number, &inner_wire_type)) {
+        if (inner_wire_type == WIRETYPE_END_GROUP)
+          return inner_number == number;
+        if (!SkipValue(inner_number, inner_wire_type, depth + 1, pos, end))
+          return false;
+      }
+      return false;
+    }
+    default:
+      // Stray end of group or an invalid wire type.
+      return false;
+  }
+}
+
+}  // namespace
+
+PolicyEnvelope::PolicyEnvelope()
+    : data_(NULL),
+      size_(0) {
+}
+
+PolicyEnvelope::~PolicyEnvelope() {
+}
+
+bool PolicyEnvelope::Parse(const uint8* data, uint32 size) {
+  Clear();
+  const uint8* pos = data;
+  const uint8* const end = data + size;
+  while (pos < end) {
+    uint32 number, wire_type;
+    if (!ReadTag(&pos, end, &number, &wire_type)) {
+      Clear();
+      return false;
+    }
+    // Like protobuf, treat a known field with an unexpected wire type as an
+    // unknown field.
+    Field* field = GetField(number);
+    if (field && wire_type == WIRETYPE_LENGTH_DELIMITED) {
+      // As for any singular field, the last occurrence wins.
+      if (!ReadLengthDelimited(&pos, end, &field->value)) {
+        Clear();
+        return false;
+      }
+      field->present = true;
+    } else if (!SkipValue(number, wire_type, 0, &pos, end)) {
+      Clear();
+      return false;
+    }
+  }
+  data_ = data;
+  size_ = size;
+  return true;
+}
+
+bool PolicyEnvelope::Materialize(
+    enterprise_management::PolicyFetchResponse* policy) const {
+  DCHECK(data_ || !size_);
+  return policy->ParseFromArray(data_, size_);
+}
+
+PolicyEnvelope::Field* PolicyEnvelope::GetField(uint32 number) {
+  switch (number) {
+    case POLICY_DATA:
+      return &policy_data_;
+    case POLICY_DATA_SIGNATURE:
+      return &policy_data_signature_;
+    case NEW_PUBLIC_KEY:
+      return &new_public_key_;
+    case NEW_PUBLIC_KEY_SIGNATURE:
+      return &new_public_key_signature_;
+    default:
+      return NULL;
+  }
+}
+
+void PolicyEnvelope::Clear() {
+  data_ = NULL;
+  size_ = 0;
+  policy_data_ = Field();
+  policy_data_signature_ = Field();
+  new_public_key_ = Field();
+  new_public_key_signature_ = Field();
+}
+
+}  // namespace login_manager
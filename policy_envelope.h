@@ -0,0 +1,85 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_POLICY_ENVELOPE_H_
+#define LOGIN_MANAGER_POLICY_ENVELOPE_H_
+
+#include <base/basictypes.h>
+#include <base/string_piece.h>
+
+namespace enterprise_management {
+class PolicyFetchResponse;
+}
+
+namespace login_manager {
+
+// Reads the fields of a serialized PolicyFetchResponse straight off the wire
+// format, without copying them. Policy blobs can be large, so this lets
+// signatures be checked before anything is copied, and lets a blob that fails
+// the checks be rejected without ever being copied at all.
+//
+// The fields are returned as pieces of the buffer passed to Parse(), which
+// therefore has to outlive the envelope.
+class PolicyEnvelope {
+ public:
+  PolicyEnvelope();
+  ~PolicyEnvelope();
+
+  // Checks that the |size| bytes at |data| are a well-formed
+  // PolicyFetchResponse and picks out the fields below. Returns false if they
+  // are not, in which case all fields are absent.
+  bool Parse(const uint8* data, uint32 size);
+
+  bool has_policy_data() const { return policy_data_.present; }
+  const base::StringPiece& policy_data() const { return policy_data_.value; }
+
+  bool has_policy_data_signature() const {
+    return policy_data_signature_.present;
+  }
+  const base::StringPiece& policy_data_signature() const {
+    return policy_data_signature_.value;
+  }
+
+  bool has_new_public_key() const { return new_public_key_.present; }
+  const base::StringPiece& new_public_key() const {
+    return new_public_key_.value;
+  }
+
+  bool has_new_public_key_signature() const {
+    return new_public_key_signature_.present;
+  }
+  const base::StringPiece& new_public_key_signature() const {
+    return new_public_key_signature_.value;
+  }
+
+  // Parses the whole blob into |policy|. This is where the bytes get copied,
+  // so it should be done once, after the checks have passed.
+  bool Materialize(enterprise_management::PolicyFetchResponse* policy) const;
+
+ private:
+  struct Field {
+    Field() : present(false) {}
+    bool present;
+    base::StringPiece value;
+  };
+
+  // Returns the field with wire format field number |number|, or NULL if it
+  // isn't one of the fields picked out.
+  Field* GetField(uint32 number);
+
+  void Clear();
+
+  const uint8* data_;
+  uint32 size_;
+  Field policy_data_;
+  Field policy_data_signature_;
+  Field new_public_key_;
+  Field new_public_key_signature_;
+
+  DISALLOW_COPY_AND_ASSIGN(PolicyEnvelope);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_POLICY_ENVELOPE_H_
@@ -0,0 +1,179 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/policy_envelope.h"
+
+#include <string>
+
+#include <base/logging.h>
+#include <base/time.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/device_management_backend.pb.h"
+
+namespace em = enterprise_management;
+
+namespace login_manager {
+
+class PolicyEnvelopeTest : public ::testing::Test {
+ public:
+  PolicyEnvelopeTest() {}
+  virtual ~PolicyEnvelopeTest() {}
+
+  virtual void SetUp() {
+    policy_.set_error_code(200);
+    policy_.set_policy_data("fake_data");
+    policy_.set_policy_data_signature("fake_signature");
+    policy_.set_new_public_key("fake_key");
+    policy_.set_new_public_key_signature("fake_key_signature");
+    ASSERT_TRUE(policy_.SerializeToString(&blob_));
+  }
+
+ protected:
+  bool Parse(const std::string& blob) {
+    return envelope_.Parse(reinterpret_cast<const uint8*>(blob.data()),
+                           blob.size());
+  }
+
+  // Returns true if |piece| points into |blob|, i.e. nothing was copied.
+  static bool IsInside(const base::StringPiece& piece,
+                       const std::string& blob) {
+    return piece.data() >= blob.data() &&
+        piece.data() + piece.size() <= blob.data() + blob.size();
+  }
+
+  em::PolicyFetchResponse policy_;
+  std::string blob_;
+  PolicyEnvelope envelope_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PolicyEnvelopeTest);
+};
+
+TEST_F(PolicyEnvelopeTest, Fields) {
+  ASSERT_TRUE(Parse(blob_));
+  ASSERT_TRUE(envelope_.has_policy_data());
+  ASSERT_TRUE(envelope_.has_policy_data_signature());
+  ASSERT_TRUE(envelope_.has_new_public_key());
+  ASSERT_TRUE(envelope_.has_new_public_key_signature());
+  EXPECT_EQ("fake_data", envelope_.policy_data().as_string());
+  EXPECT_EQ("fake_signature", envelope_.policy_data_signature().as_string());
+  EXPECT_EQ("fake_key", envelope_.new_public_key().as_string());
+  EXPECT_EQ("fake_key_signature",
+            envelope_.new_public_key_signature().as_string());
+  EXPECT_TRUE(IsInside(envelope_.policy_data(), blob_));
+  EXPECT_TRUE(IsInside(envelope_.policy_data_signature(), blob_));
+}
+
+TEST_F(PolicyEnvelopeTest, MissingFields) {
+  policy_.clear_new_public_key();
+  policy_.clear_new_public_key_signature();
+  ASSERT_TRUE(policy_.SerializeToString(&blob_));
+
+  ASSERT_TRUE(Parse(blob_));
+  EXPECT_TRUE(envelope_.has_policy_data());
+  EXPECT_TRUE(envelope_.has_policy_data_signature());
+  EXPECT_FALSE(envelope_.has_new_public_key());
+  EXPECT_FALSE(envelope_.has_new_public_key_signature());
+}
+
+TEST_F(PolicyEnvelopeTest, Empty) {
+  ASSERT_TRUE(Parse(""));
+  EXPECT_FALSE(envelope_.has_policy_data());
+  EXPECT_FALSE(envelope_.has_policy_data_signature());
+}
+
+TEST_F(PolicyEnvelopeTest, LastOccurrenceWins) {
+  em::PolicyFetchResponse second;
+  second.set_policy_data("other_data");
+  std::string blob = blob_ + second.SerializeAsString();
+
+  ASSERT_TRUE(Parse(blob));
+  EXPECT_EQ("other_data", envelope_.policy_data().as_string());
+  EXPECT_EQ("fake_signature", envelope_.policy_data_signature().as_string());
+}
+
+TEST_F(PolicyEnvelopeTest, SkipsUnknownFields) {
+  const char kUnknown[] = {
+    0x50, 0x01,                                            // 10: varint
+    0x5d, 0x01, 0x02, 0x03, 0x04,                          // 11: fixed32
+    0x61, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,  // 12: fixed64
+    0x6b, 0x08, 0x01, 0x6c,                                // 13: group
+    0x18, 0x01,                                            // 3 as varint
+  };
+  std::string blob = std::string(kUnknown, sizeof(kUnknown)) + blob_;
+
+  ASSERT_TRUE(Parse(blob));
+  EXPECT_EQ("fake_data", envelope_.policy_data().as_string());
+
+  em::PolicyFetchResponse policy;
+  ASSERT_TRUE(policy.ParseFromString(blob));
+  EXPECT_EQ("fake_data", policy.policy_data());
+}
+
+TEST_F(PolicyEnvelopeTest, Malformed) {
+  // Truncated varint, length beyond the end, stray end of group, field number
+  // zero, unterminated group and a wire type that doesn't exist.
+  const char* kMalformed[] = {
+    "\x08\x80",
+    "\x1a\x05" "abc",
+    "\x0c",
+    "\x02\x00",
+    "\x0b\x08\x01",
+    "\x1e",
+  };
+  for (size_t i = 0; i < arraysize(kMalformed); ++i) {
+    EXPECT_FALSE(Parse(kMalformed[i])) << i;
+    EXPECT_FALSE(envelope_.has_policy_data()) << i;
+  }
+}
+
+TEST_F(PolicyEnvelopeTest, AgreesWithProtobufOnTruncation) {
+  for (size_t length = 0; length <= blob_.size(); ++length) {
+    std::string truncated(blob_, 0, length);
+    em::PolicyFetchResponse policy;
+    EXPECT_EQ(policy.ParseFromString(truncated), Parse(truncated)) << length;
+  }
+}
+
+TEST_F(PolicyEnvelopeTest, Materialize) {
+  ASSERT_TRUE(Parse(blob_));
+  em::PolicyFetchResponse policy;
+  ASSERT_TRUE(envelope_.Materialize(&policy));
+  EXPECT_EQ(blob_, policy.SerializeAsString());
+}
+
+// Compares the cost of getting at the fields of a large policy blob with and
+// without parsing it into a protobuf first. Run with
+// --gtest_also_run_disabled_tests.
+TEST_F(PolicyEnvelopeTest, DISABLED_Benchmark) {
+  const size_t kPolicySize = 1024 * 1024;
+  const int kIterations = 200;
+  policy_.set_policy_data(std::string(kPolicySize, 'p'));
+  ASSERT_TRUE(policy_.SerializeToString(&blob_));
+
+  size_t checksum = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    em::PolicyFetchResponse policy;
+    ASSERT_TRUE(policy.ParseFromString(blob_));
+    checksum += policy.policy_data().size();
+  }
+  const base::TimeDelta proto_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    ASSERT_TRUE(Parse(blob_));
+    checksum += envelope_.policy_data().size();
+  }
+  const base::TimeDelta envelope_time = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(2 * kIterations * kPolicySize, checksum);
+  LOG(INFO) << "Getting at a " << kPolicySize << " byte policy: "
+            << proto_time.InMicroseconds() / kIterations << "us parsed, "
+            << envelope_time.InMicroseconds() / kIterations
+            << "us through the envelope.";
+}
+
+}  // namespace login_manager
@@ -4,6 +4,8 @@
 
 #include "login_manager/policy_key.h"
 
+#include <algorithm>
+
 #include <base/file_path.h>
 #include <base/file_util.h>
 #include <base/logging.h>
@@ -175,4 +177,18 @@ bool PolicyKey::Verify(const uint8* data,
   return true;
 }
 
+void PolicyKey::VerifyBatch(const std::vector<NssUtil::VerifyItem>& items,
+                            std::vector<bool>* results) {
+  if (!IsPopulated()) {
+    LOG(ERROR) << "Don't yet have an owner key!";
+    results->assign(items.size(), false);
+    return;
+  }
+  nss_->VerifyBatch(kAlgorithm, sizeof(kAlgorithm), &key_[0], key_.size(),
+                    items, results);
+  const int failures = std::count(results->begin(), results->end(), false);
+  LOG_IF(ERROR, failures) << failures << " of " << items.size()
+                          << " signatures failed verification";
+}
+
 }  // namespace login_manager
@@ -11,13 +11,14 @@
 #include <base/file_path.h>
 #include <base/memory/scoped_ptr.h>
 
+#include "login_manager/nss_util.h"
+
 namespace crypto {
 class RSAPrivateKey;
 }  // namespace crypto
 
 namespace login_manager {
 class ChildJobInterface;
-class NssUtil;
 class SessionManagerService;
 class SystemUtils;
 
@@ -81,6 +82,12 @@ class PolicyKey {
                       const uint8* signature,
                       uint32 sig_len);
 
+  // Verifies each of |items| like Verify() does, spreading the work over a
+  // few threads, see NssUtil::VerifyBatch(). Sets |results| to whether each
+  // item is valid, in order.
+  virtual void VerifyBatch(const std::vector<NssUtil::VerifyItem>& items,
+                           std::vector<bool>* results);
+
   // Returned reference will be empty if we haven't populated |key_| yet.
   virtual const std::vector<uint8>& public_key_der() const {
     return key_;
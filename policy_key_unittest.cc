@@ -191,6 +191,17 @@ TEST_F(PolicyKeyTest, SignVerify) {
                          data.length(),
                          &signature[0],
                          signature.size()));
+
+  std::vector<NssUtil::VerifyItem> items;
+  items.push_back(NssUtil::VerifyItem(&signature[0], signature.size(),
+                                      data_p, data.length()));
+  items.push_back(NssUtil::VerifyItem(&signature[0], signature.size(),
+                                      data_p, data.length() - 1));
+  std::vector<bool> results;
+  key.VerifyBatch(items, &results);
+  ASSERT_EQ(2U, results.size());
+  EXPECT_TRUE(results[0]);
+  EXPECT_FALSE(results[1]);
 }
 
 TEST_F(PolicyKeyTest, RotateKey) {
@@ -4,6 +4,7 @@
 
 #include "login_manager/policy_service.h"
 
+#include <algorithm>
 #include <string>
 
 #include <base/bind.h>
@@ -11,11 +12,11 @@
 #include <base/location.h>
 #include <base/logging.h>
 #include <base/message_loop_proxy.h>
+#include <base/sequenced_task_runner.h>
 #include <base/stl_util.h>
-#include <base/synchronization/waitable_event.h>
 
 #include "login_manager/device_management_backend.pb.h"
-#include "login_manager/nss_util.h"
+#include "login_manager/policy_envelope.h"
 #include "login_manager/policy_key.h"
 #include "login_manager/policy_store.h"
 #include "login_manager/system_utils.h"
@@ -24,6 +25,9 @@ namespace em = enterprise_management;
 
 namespace login_manager {
 
+// static
+const int PolicyService::kSlowPersistMs = 1000;
+
 PolicyService::Error::Error()
     : code_(CHROMEOS_LOGIN_ERROR_DECODE_FAIL) {
 }
@@ -46,6 +50,16 @@ PolicyService::Completion::~Completion() {
 PolicyService::Delegate::~Delegate() {
 }
 
+PolicyService::PersistStats::PersistStats()
+    : queue_depth(0),
+      completed(0) {
+}
+
+PolicyService::WriteResult::WriteResult()
+    : status(false),
+      superseded(false) {
+}
+
 PolicyService::PolicyService(
     scoped_ptr<PolicyStore> policy_store,
     PolicyKey* policy_key,
@@ -53,6 +67,11 @@ PolicyService::PolicyService(
     : policy_store_(policy_store.Pass()),
       policy_key_(policy_key),
       main_loop_(main_loop),
+      writes_scheduled_(0),
+      newest_write_done_(0),
+      // Only device-local account policy is managed by a plain PolicyService,
+      // subclasses relabel this.
+      stats_(PolicyStats::DEVICE_LOCAL_ACCOUNT),
       delegate_(NULL) {
 }
 
@@ -63,10 +82,17 @@ bool PolicyService::Store(const uint8* policy_blob,
                           uint32 len,
                           Completion* completion,
                           int flags) {
-  em::PolicyFetchResponse policy;
-  if (!policy.ParseFromArray(policy_blob, len) ||
-      !policy.has_policy_data() ||
-      !policy.has_policy_data_signature()) {
+  stats_.Increment(PolicyStats::STORE);
+  stats_.AddSample(PolicyStats::BLOB_SIZE, len);
+  const base::TimeTicks parse_start = base::TimeTicks::Now();
+  PolicyEnvelope envelope;
+  const bool parsed = envelope.Parse(policy_blob, len) &&
+      envelope.has_policy_data() &&
+      envelope.has_policy_data_signature();
+  stats_.AddTime(PolicyStats::PARSE_TIME,
+                 base::TimeTicks::Now() - parse_start);
+  if (!parsed) {
+    stats_.Increment(PolicyStats::PARSE_FAILURE);
     const char msg[] = "Unable to parse policy protobuf.";
     LOG(ERROR) << msg;
     Error error(CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg);
@@ -74,10 +100,11 @@ bool PolicyService::Store(const uint8* policy_blob,
     return FALSE;
   }
 
-  return StorePolicy(policy, completion, flags);
+  return StorePolicy(envelope, completion, flags);
 }
 
 bool PolicyService::Retrieve(std::vector<uint8>* policy_blob) {
+  stats_.Increment(PolicyStats::RETRIEVE);
   const em::PolicyFetchResponse& policy = store()->Get();
   policy_blob->resize(policy.ByteSize());
   uint8* start = vector_as_array(policy_blob);
@@ -87,11 +114,37 @@ bool PolicyService::Retrieve(std::vector<uint8>* policy_blob) {
 }
 
 bool PolicyService::PersistPolicySync() {
-  bool status = store()->Persist();
+  bool status = false;
+  if (io_runner_.get()) {
+    // Writes still queued on |io_runner_| hold older policy than this one.
+    // Rather than waiting for them, write right here; they'll see that they
+    // have been superseded and drop themselves, so none of them can land
+    // after this one.
+    std::string blob;
+    if (store()->Get().SerializeToString(&blob)) {
+      WriteResult result;
+      const base::TimeTicks scheduled = base::TimeTicks::Now();
+      WritePolicy(blob, ++writes_scheduled_, &result);
+      RecordWrite(scheduled, result);
+      status = result.status;
+    } else {
+      LOG(ERROR) << "Could not serialize policy!";
+    }
+  } else {
+    const base::TimeTicks start = base::TimeTicks::Now();
+    status = store()->Persist();
+    stats_.AddTime(PolicyStats::PERSIST_TIME, base::TimeTicks::Now() - start);
+  }
   OnPolicyPersisted(NULL, status);
   return status;
 }
 
+void PolicyService::set_io_runner(
+    const scoped_refptr<base::SequencedTaskRunner>& io_runner) {
+  DCHECK_EQ(0, persist_stats_.queue_depth);
+  io_runner_ = io_runner;
+}
+
 void PolicyService::PersistKey() {
   main_loop_->PostTask(
       FROM_HERE,
@@ -99,46 +152,78 @@ void PolicyService::PersistKey() {
 }
 
 void PolicyService::PersistPolicy() {
-  main_loop_->PostTask(
-      FROM_HERE,
-      base::Bind(&PolicyService::PersistPolicyOnLoop, this,
-                 static_cast<Completion*>(NULL)));
+  PersistPolicyWithCompletion(NULL);
 }
 
 void PolicyService::PersistPolicyWithCompletion(Completion* completion) {
-  main_loop_->PostTask(
+  if (!io_runner_.get()) {
+    main_loop_->PostTask(
+        FROM_HERE,
+        base::Bind(&PolicyService::PersistPolicyOnLoop, this, completion,
+                   base::TimeTicks::Now()));
+    return;
+  }
+
+  // The store is only ever touched on the main loop, so take a snapshot of the
+  // policy here and hand just the bytes to |io_runner_|.
+  std::string blob;
+  if (!store()->Get().SerializeToString(&blob)) {
+    LOG(ERROR) << "Could not serialize policy!";
+    main_loop_->PostTask(
+        FROM_HERE,
+        base::Bind(&PolicyService::OnPolicyPersisted, this, completion,
+                   false));
+    return;
+  }
+  WriteResult* result = new WriteResult;
+  stats_.AddSample(PolicyStats::QUEUE_DEPTH, persist_stats_.queue_depth);
+  ++persist_stats_.queue_depth;
+  io_runner_->PostTaskAndReply(
       FROM_HERE,
-      base::Bind(&PolicyService::PersistPolicyOnLoop, this, completion));
+      base::Bind(&PolicyService::WritePolicy, this, blob,
+                 ++writes_scheduled_, result),
+      base::Bind(&PolicyService::OnPolicyWritten, this, completion,
+                 base::TimeTicks::Now(), base::Owned(result)));
 }
 
-bool PolicyService::StorePolicy(const em::PolicyFetchResponse& policy,
+bool PolicyService::StorePolicy(const PolicyEnvelope& envelope,
                                 Completion* completion,
                                 int flags) {
   // Determine if the policy has pushed a new owner key and, if so, set it.
-  if (policy.has_new_public_key() && !key()->Equals(policy.new_public_key())) {
+  // Keys are small, so copying them is fine.
+  if (envelope.has_new_public_key() &&
+      !key()->Equals(envelope.new_public_key().as_string())) {
     // The policy contains a new key, and it is different from |key_|.
-    std::vector<uint8> der;
-    NssUtil::BlobFromBuffer(policy.new_public_key(), &der);
+    const base::StringPiece& new_key = envelope.new_public_key();
+    std::vector<uint8> der(new_key.begin(), new_key.end());
 
     bool installed = false;
     if (key()->IsPopulated()) {
-      if (policy.has_new_public_key_signature() && (flags & KEY_ROTATE)) {
+      if (envelope.has_new_public_key_signature() && (flags & KEY_ROTATE)) {
         // Graceful key rotation.
         LOG(INFO) << "Attempting policy key rotation.";
-        std::vector<uint8> sig;
-        NssUtil::BlobFromBuffer(policy.new_public_key_signature(), &sig);
+        const base::StringPiece& new_key_sig =
+            envelope.new_public_key_signature();
+        std::vector<uint8> sig(new_key_sig.begin(), new_key_sig.end());
         installed = key()->Rotate(der, sig);
+        if (installed)
+          stats_.Increment(PolicyStats::KEY_ROTATION);
       }
     } else if (flags & KEY_INSTALL_NEW) {
       LOG(INFO) << "Attempting to install new policy key.";
       installed = key()->PopulateFromBuffer(der);
+      if (installed)
+        stats_.Increment(PolicyStats::KEY_INSTALL);
     }
     if (!installed && (flags & KEY_CLOBBER)) {
       LOG(INFO) << "Clobbering existing policy key.";
       installed = key()->ClobberCompromisedKey(der);
+      if (installed)
+        stats_.Increment(PolicyStats::KEY_CLOBBER);
     }
 
     if (!installed) {
+      stats_.Increment(PolicyStats::VERIFY_FAILURE);
       const char msg[] = "Failed to install policy key!";
       LOG(ERROR) << msg;
       Error error(CHROMEOS_LOGIN_ERROR_ILLEGAL_PUBKEY, msg);
@@ -151,12 +236,18 @@ bool PolicyService::StorePolicy(const em::PolicyFetchResponse& policy,
   }
 
   // Validate signature on policy and persist to disk.
-  const std::string& data(policy.policy_data());
-  const std::string& sig(policy.policy_data_signature());
-  if (!key()->Verify(reinterpret_cast<const uint8*>(data.c_str()),
-                     data.size(),
-                     reinterpret_cast<const uint8*>(sig.c_str()),
-                     sig.size())) {
+  const base::StringPiece& data(envelope.policy_data());
+  const base::StringPiece& sig(envelope.policy_data_signature());
+  const base::TimeTicks verify_start = base::TimeTicks::Now();
+  const bool verified =
+      key()->Verify(reinterpret_cast<const uint8*>(data.data()),
+                    data.size(),
+                    reinterpret_cast<const uint8*>(sig.data()),
+                    sig.size());
+  stats_.AddTime(PolicyStats::VERIFY_TIME,
+                 base::TimeTicks::Now() - verify_start);
+  if (!verified) {
+    stats_.Increment(PolicyStats::VERIFY_FAILURE);
     const char msg[] = "Signature could not be verified.";
     LOG(ERROR) << msg;
     Error error(CHROMEOS_LOGIN_ERROR_VERIFY_FAIL, msg);
@@ -164,7 +255,16 @@ bool PolicyService::StorePolicy(const em::PolicyFetchResponse& policy,
     return false;
   }
 
-  store()->Set(policy);
+  em::PolicyFetchResponse policy;
+  if (!envelope.Materialize(&policy)) {
+    // Can't happen for a blob that Parse() accepted.
+    const char msg[] = "Unable to parse policy protobuf.";
+    LOG(ERROR) << msg;
+    Error error(CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg);
+    completion->Failure(error);
+    return false;
+  }
+  store()->Swap(&policy);
   PersistPolicyWithCompletion(completion);
   return true;
 }
@@ -183,9 +283,15 @@ void PolicyService::PersistKeyOnLoop() {
   OnKeyPersisted(key()->Persist());
 }
 
-void PolicyService::PersistPolicyOnLoop(Completion* completion) {
+void PolicyService::PersistPolicyOnLoop(Completion* completion,
+                                        base::TimeTicks scheduled) {
   DCHECK(main_loop_->BelongsToCurrentThread());
-  OnPolicyPersisted(completion, store()->Persist());
+  WriteResult result;
+  result.started = base::TimeTicks::Now();
+  result.status = store()->Persist();
+  result.duration = base::TimeTicks::Now() - result.started;
+  RecordWrite(scheduled, result);
+  OnPolicyPersisted(completion, result.status);
 }
 
 void PolicyService::OnPolicyPersisted(Completion* completion, bool status) {
@@ -206,4 +312,45 @@ void PolicyService::OnPolicyPersisted(Completion* completion, bool status) {
     delegate_->OnPolicyPersisted(status);
 }
 
+void PolicyService::WritePolicy(const std::string& blob,
+                                uint64 sequence,
+                                WriteResult* result) {
+  base::AutoLock lock(write_lock_);
+  result->started = base::TimeTicks::Now();
+  if (sequence < newest_write_done_) {
+    // What's on disk is newer than |blob| already.
+    result->status = true;
+    result->superseded = true;
+    return;
+  }
+  result->status = store()->PersistBlob(blob);
+  result->duration = base::TimeTicks::Now() - result->started;
+  if (result->status)
+    newest_write_done_ = sequence;
+}
+
+void PolicyService::OnPolicyWritten(Completion* completion,
+                                    base::TimeTicks scheduled,
+                                    const WriteResult* result) {
+  DCHECK(main_loop_->BelongsToCurrentThread());
+  RecordWrite(scheduled, *result);
+  const base::TimeDelta latency = base::TimeTicks::Now() - scheduled;
+  --persist_stats_.queue_depth;
+  ++persist_stats_.completed;
+  persist_stats_.last_latency = latency;
+  persist_stats_.max_latency = std::max(persist_stats_.max_latency, latency);
+  stats_.AddTime(PolicyStats::PERSIST_LATENCY, latency);
+  LOG_IF(WARNING, latency.InMilliseconds() > kSlowPersistMs)
+      << "Writing policy took " << latency.InMilliseconds() << "ms, "
+      << persist_stats_.queue_depth << " more writes queued.";
+  OnPolicyPersisted(completion, result->status);
+}
+
+void PolicyService::RecordWrite(base::TimeTicks scheduled,
+                                const WriteResult& result) {
+  stats_.AddTime(PolicyStats::QUEUE_DELAY, result.started - scheduled);
+  if (!result.superseded)
+    stats_.AddTime(PolicyStats::PERSIST_TIME, result.duration);
+}
+
 }  // namespace login_manager
@@ -12,20 +12,25 @@
 #include <base/file_path.h>
 #include <base/memory/ref_counted.h>
 #include <base/memory/scoped_ptr.h>
+#include <base/synchronization/lock.h>
+#include <base/time.h>
 #include <chromeos/dbus/error_constants.h>
 #include <chromeos/dbus/service_constants.h>
 
+#include "login_manager/policy_stats.h"
+
 namespace enterprise_management {
 class PolicyFetchResponse;
 }
 
 namespace base {
 class MessageLoopProxy;
-class WaitableEvent;
+class SequencedTaskRunner;
 }  // namespace base
 
 namespace login_manager {
 
+class PolicyEnvelope;
 class PolicyKey;
 class PolicyStore;
 
@@ -76,6 +81,20 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
     virtual void OnKeyPersisted(bool success) = 0;
   };
 
+  // Bookkeeping for policy writes done on the I/O runner. The depth and
+  // latency of every write also go into stats(), see PolicyStats.
+  struct PersistStats {
+    PersistStats();
+    // Writes that have been scheduled but haven't completed yet.
+    int queue_depth;
+    // Writes that have completed, successfully or not.
+    int completed;
+    // Time from scheduling a write to its completion being reported, for the
+    // most recent and for the slowest write.
+    base::TimeDelta last_latency;
+    base::TimeDelta max_latency;
+  };
+
   PolicyService(scoped_ptr<PolicyStore> policy_store,
                 PolicyKey* policy_key,
                 const scoped_refptr<base::MessageLoopProxy>& main_loop);
@@ -97,8 +116,10 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
   // otherwise.
   virtual bool Retrieve(std::vector<uint8>* policy_blob);
 
-  // Policy is persisted to disk on the IO loop. The current thread waits for
-  // completion and reports back the status afterwards.
+  // Persists policy to disk on the current thread and reports back the status.
+  // With an I/O runner, this waits for at most the one write in progress
+  // there; queued writes of older policy are dropped rather than waited for,
+  // as they would only be overwritten.
   virtual bool PersistPolicySync();
 
   // Accessors for the delegate. PolicyService doesn't own the delegate, thus
@@ -106,6 +127,22 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
   void set_delegate(Delegate* delegate) { delegate_ = delegate; }
   Delegate* delegate() { return delegate_; }
 
+  // Makes policy get written to disk on |io_runner| instead of the main loop.
+  // Writes still happen in the order they were scheduled in, and completions
+  // and delegate notifications are still delivered on the main loop. Key
+  // writes, which are rare, stay on the main loop.
+  void set_io_runner(
+      const scoped_refptr<base::SequencedTaskRunner>& io_runner);
+
+  const PersistStats& persist_stats() const { return persist_stats_; }
+
+  // Counters and histograms for this service. Subclasses and owners label
+  // them with the kind of policy managed and hook them up to UMA.
+  PolicyStats* stats() { return &stats_; }
+
+  // Writes that take longer than this are logged.
+  static const int kSlowPersistMs;
+
  protected:
   friend class PolicyServiceTest;
 
@@ -114,6 +151,9 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
   const scoped_refptr<base::MessageLoopProxy>& main_loop() {
     return main_loop_;
   }
+  const scoped_refptr<base::SequencedTaskRunner>& io_runner() {
+    return io_runner_;
+  }
 
   // Schedules the key to be persisted.
   void PersistKey();
@@ -127,8 +167,9 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
 
   // Store a policy blob. This does the heavy lifting for Store(), making the
   // signature checks, taking care of key changes and persisting policy and key
-  // data to disk.
-  bool StorePolicy(const enterprise_management::PolicyFetchResponse& policy,
+  // data to disk. The checks run on the fields in |envelope|; the policy is
+  // only materialized once they have passed.
+  bool StorePolicy(const PolicyEnvelope& envelope,
                    Completion* completion,
                    int flags);
 
@@ -140,18 +181,58 @@ class PolicyService : public base::RefCountedThreadSafe<PolicyService> {
   // Takes care of persisting the policy key to disk.
   void PersistKeyOnLoop();
 
+  // Outcome of a policy write done on |io_runner_|.
+  struct WriteResult {
+    WriteResult();
+    bool status;
+    // Set if the write was dropped because newer policy had been written.
+    bool superseded;
+    // When the write started, and how long it took.
+    base::TimeTicks started;
+    base::TimeDelta duration;
+  };
+
   // Persists policy to disk on the main thread. If |completion| is non-NULL
-  // it will be signaled when done.
-  void PersistPolicyOnLoop(Completion* completion);
+  // it will be signaled when done. |scheduled| is when the write was posted.
+  void PersistPolicyOnLoop(Completion* completion, base::TimeTicks scheduled);
 
   // Finishes persisting policy with |status|, notifying the delegate and
   // reporting the status through |completion|.
   void OnPolicyPersisted(Completion* completion, bool status);
 
+  // Writes |blob|, the |sequence|th write scheduled, unless a later one has
+  // already made it to disk. Stores the outcome in |result|. Runs on
+  // |io_runner_|, or on the main loop for PersistPolicySync().
+  void WritePolicy(const std::string& blob,
+                   uint64 sequence,
+                   WriteResult* result);
+
+  // Back on the main loop after a write scheduled at |scheduled| has finished
+  // on |io_runner_|. Updates |persist_stats_| and |stats_| and calls
+  // OnPolicyPersisted().
+  void OnPolicyWritten(Completion* completion,
+                       base::TimeTicks scheduled,
+                       const WriteResult* result);
+
+  // Records the timing of a write in |stats_|.
+  void RecordWrite(base::TimeTicks scheduled, const WriteResult& result);
+
  private:
   scoped_ptr<PolicyStore> policy_store_;
   PolicyKey* policy_key_;
   scoped_refptr<base::MessageLoopProxy> main_loop_;
+  // If set, policy writes go here. See set_io_runner().
+  scoped_refptr<base::SequencedTaskRunner> io_runner_;
+  PersistStats persist_stats_;
+  // Number of writes scheduled for |io_runner_| or done by
+  // PersistPolicySync(). Only touched on the main loop.
+  uint64 writes_scheduled_;
+  // Serializes writes, so that PersistPolicySync() and a write on
+  // |io_runner_| never overlap, and protects |newest_write_done_|.
+  base::Lock write_lock_;
+  // Sequence number of the newest write that made it to disk.
+  uint64 newest_write_done_;
+  PolicyStats stats_;
   Delegate* delegate_;
 
   DISALLOW_COPY_AND_ASSIGN(PolicyService);
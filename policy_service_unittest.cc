@@ -8,10 +8,13 @@
 #include <string>
 #include <vector>
 
+#include <base/bind.h>
+#include <base/location.h>
 #include <base/memory/scoped_ptr.h>
 #include <base/message_loop.h>
 #include <base/message_loop_proxy.h>
 #include <base/run_loop.h>
+#include <base/synchronization/waitable_event.h>
 #include <base/threading/thread.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -27,6 +30,7 @@ namespace em = enterprise_management;
 using ::testing::DoAll;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Mock;
+using ::testing::Pointee;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::Sequence;
@@ -79,7 +83,8 @@ class PolicyServiceTest : public testing::Test {
                               CastEq(fake_sig_), fake_sig_.size()))
         .InSequence(sequence)
         .WillOnce(Return(true));
-    EXPECT_CALL(*store_, Set(PolicyStrEq(policy_str_))).Times(1)
+    EXPECT_CALL(*store_, Swap(Pointee(PolicyStrEq(policy_str_))))
+        .Times(1)
         .InSequence(sequence);
   }
 
@@ -112,7 +117,7 @@ class PolicyServiceTest : public testing::Test {
 
   void ExpectStoreFail(int flags, ChromeOSLoginError code) {
     EXPECT_CALL(key_, Persist()).Times(0);
-    EXPECT_CALL(*store_, Set(_)).Times(0);
+    EXPECT_CALL(*store_, Swap(_)).Times(0);
     EXPECT_CALL(*store_, Persist()).Times(0);
     EXPECT_CALL(completion_, Success()).Times(0);
     EXPECT_CALL(completion_, Failure(_)).Times(1);
@@ -122,6 +127,16 @@ class PolicyServiceTest : public testing::Test {
     base::RunLoop().RunUntilIdle();
   }
 
+  void ExpectVerifyAndSnapshotPolicy() {
+    EXPECT_CALL(key_, Verify(CastEq(fake_data_), fake_data_.size(),
+                              CastEq(fake_sig_), fake_sig_.size()))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*store_, Swap(Pointee(PolicyStrEq(policy_str_))))
+        .Times(testing::AnyNumber());
+    EXPECT_CALL(*store_, Get())
+        .WillRepeatedly(ReturnRef(policy_proto_));
+  }
+
   PolicyStore* store() { return service_->store(); }
   PolicyKey* key() { return service_->key(); }
 
@@ -179,6 +194,16 @@ TEST_F(PolicyServiceTest, Store) {
 
   ExpectPersistPolicy(s2);
   base::RunLoop().RunUntilIdle();
+
+  PolicyStats* stats = service_->stats();
+  EXPECT_EQ(1, stats->counter(PolicyStats::STORE));
+  EXPECT_EQ(0, stats->counter(PolicyStats::PARSE_FAILURE));
+  EXPECT_EQ(0, stats->counter(PolicyStats::VERIFY_FAILURE));
+  EXPECT_EQ(static_cast<int64>(policy_len_),
+            stats->histogram(PolicyStats::BLOB_SIZE).max());
+  EXPECT_EQ(1, stats->histogram(PolicyStats::VERIFY_TIME).count());
+  EXPECT_EQ(1, stats->histogram(PolicyStats::QUEUE_DELAY).count());
+  EXPECT_EQ(1, stats->histogram(PolicyStats::PERSIST_TIME).count());
 }
 
 TEST_F(PolicyServiceTest, StoreWrongSignature) {
@@ -193,12 +218,15 @@ TEST_F(PolicyServiceTest, StoreWrongSignature) {
       .WillRepeatedly(Return(false));
 
   ExpectStoreFail(kAllKeyFlags, CHROMEOS_LOGIN_ERROR_VERIFY_FAIL);
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::VERIFY_FAILURE));
 }
 
 TEST_F(PolicyServiceTest, StoreNoData) {
   InitPolicy("", "", "", "");
 
   ExpectStoreFail(kAllKeyFlags, CHROMEOS_LOGIN_ERROR_DECODE_FAIL);
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::STORE));
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::PARSE_FAILURE));
 }
 
 TEST_F(PolicyServiceTest, StoreNoSignature) {
@@ -318,6 +346,7 @@ TEST_F(PolicyServiceTest, StoreRotation) {
   ExpectPersistKey(s1);
   ExpectPersistPolicy(s2);
   base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::KEY_ROTATION));
 }
 
 TEST_F(PolicyServiceTest, StoreRotationClobber) {
@@ -389,6 +418,7 @@ TEST_F(PolicyServiceTest, Retrieve) {
   ASSERT_EQ(policy_str_.size(), policy_data.size());
   EXPECT_TRUE(std::equal(policy_str_.begin(), policy_str_.end(),
                          policy_data.begin()));
+  EXPECT_EQ(1, service_->stats()->counter(PolicyStats::RETRIEVE));
 }
 
 TEST_F(PolicyServiceTest, PersistPolicySyncSuccess) {
@@ -403,4 +433,111 @@ TEST_F(PolicyServiceTest, PersistPolicySyncFailure) {
   service_->PersistPolicySync();
 }
 
+TEST_F(PolicyServiceTest, StoreOnIORunner) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+  base::Thread io_thread("io");
+  ASSERT_TRUE(io_thread.Start());
+  service_->set_io_runner(io_thread.message_loop_proxy());
+
+  ExpectVerifyAndSnapshotPolicy();
+  EXPECT_CALL(*store_, Persist()).Times(0);
+  EXPECT_CALL(*store_, PersistBlob(policy_str_)).WillOnce(Return(true));
+  EXPECT_CALL(completion_, Success()).Times(1);
+  EXPECT_CALL(delegate_, OnPolicyPersisted(true)).Times(1);
+
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_, &completion_,
+                              kAllKeyFlags));
+  EXPECT_EQ(1, service_->persist_stats().queue_depth);
+
+  // Stopping the thread flushes the write, which posts its completion here.
+  io_thread.Stop();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, service_->persist_stats().queue_depth);
+  EXPECT_EQ(1, service_->persist_stats().completed);
+  EXPECT_EQ(1,
+            service_->stats()->histogram(PolicyStats::QUEUE_DELAY).count());
+  EXPECT_EQ(1,
+            service_->stats()->histogram(PolicyStats::PERSIST_TIME).count());
+}
+
+TEST_F(PolicyServiceTest, IORunnerKeepsWritesInOrder) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+  base::Thread io_thread("io");
+  ASSERT_TRUE(io_thread.Start());
+  service_->set_io_runner(io_thread.message_loop_proxy());
+
+  ExpectVerifyAndSnapshotPolicy();
+  Sequence writes, completions;
+  EXPECT_CALL(*store_, PersistBlob(policy_str_))
+      .InSequence(writes)
+      .WillOnce(Return(false));
+  EXPECT_CALL(*store_, PersistBlob(policy_str_))
+      .InSequence(writes)
+      .WillOnce(Return(true));
+  EXPECT_CALL(completion_, Failure(_)).InSequence(completions);
+  EXPECT_CALL(delegate_, OnPolicyPersisted(false)).InSequence(completions);
+  EXPECT_CALL(completion_, Success()).InSequence(completions);
+  EXPECT_CALL(delegate_, OnPolicyPersisted(true)).InSequence(completions);
+
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_, &completion_,
+                              kAllKeyFlags));
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_, &completion_,
+                              kAllKeyFlags));
+  EXPECT_EQ(2, service_->persist_stats().queue_depth);
+
+  io_thread.Stop();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, service_->persist_stats().queue_depth);
+  EXPECT_EQ(2, service_->persist_stats().completed);
+}
+
+TEST_F(PolicyServiceTest, PersistPolicySyncOnIORunner) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+  base::Thread io_thread("io");
+  ASSERT_TRUE(io_thread.Start());
+  service_->set_io_runner(io_thread.message_loop_proxy());
+
+  EXPECT_CALL(*store_, Get()).WillOnce(ReturnRef(policy_proto_));
+  EXPECT_CALL(*store_, Persist()).Times(0);
+  EXPECT_CALL(*store_, PersistBlob(policy_str_)).WillOnce(Return(true));
+  EXPECT_CALL(delegate_, OnPolicyPersisted(true)).Times(1);
+  EXPECT_TRUE(service_->PersistPolicySync());
+}
+
+TEST_F(PolicyServiceTest, PersistPolicySyncSupersedesQueuedWrites) {
+  InitPolicy(fake_data_, fake_sig_, "", "");
+  base::Thread io_thread("io");
+  ASSERT_TRUE(io_thread.Start());
+  service_->set_io_runner(io_thread.message_loop_proxy());
+
+  // Hold up the I/O thread so that the writes scheduled by Store() queue up.
+  base::WaitableEvent gate(false, false);
+  io_thread.message_loop_proxy()->PostTask(
+      FROM_HERE,
+      base::Bind(&base::WaitableEvent::Wait, base::Unretained(&gate)));
+
+  ExpectVerifyAndSnapshotPolicy();
+  // Only the synchronous write makes it to disk.
+  EXPECT_CALL(*store_, PersistBlob(policy_str_)).WillOnce(Return(true));
+  EXPECT_CALL(completion_, Success()).Times(2);
+  EXPECT_CALL(delegate_, OnPolicyPersisted(true)).Times(3);
+
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_, &completion_,
+                              kAllKeyFlags));
+  EXPECT_TRUE(service_->Store(policy_data_, policy_len_, &completion_,
+                              kAllKeyFlags));
+  EXPECT_EQ(2, service_->persist_stats().queue_depth);
+  EXPECT_TRUE(service_->PersistPolicySync());
+
+  gate.Signal();
+  io_thread.Stop();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, service_->persist_stats().queue_depth);
+  EXPECT_EQ(2, service_->persist_stats().completed);
+  EXPECT_EQ(2,
+            service_->stats()->histogram(PolicyStats::QUEUE_DEPTH).count());
+  EXPECT_EQ(2,
+            service_->stats()->histogram(PolicyStats::PERSIST_LATENCY).count());
+}
+
 }  // namespace login_manager
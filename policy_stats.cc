@@ -0,0 +1,172 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/policy_stats.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/stringprintf.h>
+
+#include "login_manager/login_metrics.h"
+
+namespace login_manager {
+
+namespace {
+
+const char* kKindNames[] = {
+  "Device",
+  "User",
+  "DeviceLocalAccount",
+};
+COMPILE_ASSERT(arraysize(kKindNames) == PolicyStats::NUM_KINDS,
+               kind_names_out_of_sync);
+
+// Labels used in ToString().
+const char* kCounterLabels[] = {
+  "stores",
+  "retrieves",
+  "parse_failures",
+  "verify_failures",
+  "key_installs",
+  "key_rotations",
+  "key_clobbers",
+  "owner_sign_failures",
+};
+COMPILE_ASSERT(arraysize(kCounterLabels) == PolicyStats::NUM_COUNTERS,
+               counter_labels_out_of_sync);
+
+// How samples are named and bucketed in UMA.
+struct SampleInfo {
+  const char* label;
+  const char* metric;
+  int max;
+};
+const SampleInfo kSampleInfo[] = {
+  { "blob_size", "Login.PolicyBlobSize", 16 * 1024 * 1024 },
+  { "parse_us", "Login.PolicyParseTime", 10 * 1000 * 1000 },
+  { "verify_us", "Login.PolicyVerifyTime", 10 * 1000 * 1000 },
+  { "persist_us", "Login.PolicyPersistTime", 10 * 1000 * 1000 },
+  { "queue_us", "Login.PolicyQueueDelay", 10 * 1000 * 1000 },
+  { "queue_depth", "Login.PolicyQueueDepth", 100 },
+  { "latency_us", "Login.PolicyPersistLatency", 10 * 1000 * 1000 },
+};
+COMPILE_ASSERT(arraysize(kSampleInfo) == PolicyStats::NUM_SAMPLES,
+               sample_info_out_of_sync);
+
+const char kCounterMetric[] = "Login.PolicyOperation";
+const int kUMABuckets = 50;
+
+}  // namespace
+
+PolicyStats::Histogram::Histogram()
+    : count_(0),
+      sum_(0),
+      max_(0) {
+  std::fill(buckets_, buckets_ + kNumBuckets, 0);
+}
+
+void PolicyStats::Histogram::Add(int64 value) {
+  max_ = count_ ? std::max(max_, value) : value;
+  ++count_;
+  sum_ += value;
+  ++buckets_[BucketFor(value)];
+}
+
+int64 PolicyStats::Histogram::Percentile(int percent) const {
+  if (!count_)
+    return 0;
+  // The number of samples at or below the percentile, rounded up.
+  const int64 rank = (count_ * percent + 99) / 100;
+  int64 seen = 0;
+  for (int i = 0; i < kNumBuckets - 1; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank && seen > 0)
+      return std::min(max_, i ? (GG_INT64_C(1) << i) - 1 : 0);
+  }
+  return max_;
+}
+
+// static
+int PolicyStats::Histogram::BucketFor(int64 value) {
+  int bucket = 0;
+  while (value > 0 && bucket < kNumBuckets - 1) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+PolicyStats::PolicyStats(Kind kind)
+    : kind_(kind),
+      metrics_(NULL) {
+  std::fill(counters_, counters_ + NUM_COUNTERS, 0);
+}
+
+PolicyStats::~PolicyStats() {
+}
+
+void PolicyStats::Increment(Counter counter) {
+  DCHECK_LT(counter, NUM_COUNTERS);
+  ++counters_[counter];
+  if (metrics_)
+    metrics_->SendEnum(CounterMetricName(kind_), counter, NUM_COUNTERS);
+}
+
+void PolicyStats::AddSample(Sample sample, int64 value) {
+  DCHECK_LT(sample, NUM_SAMPLES);
+  histograms_[sample].Add(value);
+  if (metrics_) {
+    const int max = kSampleInfo[sample].max;
+    metrics_->SendHistogram(SampleMetricName(kind_, sample),
+                            static_cast<int>(std::min<int64>(value, max)),
+                            1, max, kUMABuckets);
+  }
+}
+
+void PolicyStats::AddTime(Sample sample, base::TimeDelta time) {
+  AddSample(sample, time.InMicroseconds());
+}
+
+std::string PolicyStats::ToString() const {
+  std::string out;
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    base::StringAppendF(&out, "%s%s=%lld", i ? " " : "", kCounterLabels[i],
+                        static_cast<long long>(counters_[i]));
+  }
+  for (int i = 0; i < NUM_SAMPLES; ++i) {
+    const Histogram& histogram = histograms_[i];
+    if (!histogram.count())
+      continue;
+    base::StringAppendF(&out, " %s[n=%lld mean=%lld p50<=%lld p99<=%lld "
+                        "max=%lld]",
+                        kSampleInfo[i].label,
+                        static_cast<long long>(histogram.count()),
+                        static_cast<long long>(histogram.sum() /
+                                               histogram.count()),
+                        static_cast<long long>(histogram.Percentile(50)),
+                        static_cast<long long>(histogram.Percentile(99)),
+                        static_cast<long long>(histogram.max()));
+  }
+  return out;
+}
+
+// static
+const char* PolicyStats::KindName(Kind kind) {
+  DCHECK_LT(kind, NUM_KINDS);
+  return kKindNames[kind];
+}
+
+// static
+std::string PolicyStats::CounterMetricName(Kind kind) {
+  return base::StringPrintf("%s.%s", kCounterMetric, KindName(kind));
+}
+
+// static
+std::string PolicyStats::SampleMetricName(Kind kind, Sample sample) {
+  return base::StringPrintf("%s.%s", kSampleInfo[sample].metric,
+                            KindName(kind));
+}
+
+}  // namespace login_manager
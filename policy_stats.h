@@ -0,0 +1,128 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_POLICY_STATS_H_
+#define LOGIN_MANAGER_POLICY_STATS_H_
+
+#include <string>
+
+#include <base/basictypes.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+class LoginMetrics;
+
+// Operational counters and histograms for a single PolicyService, labelled by
+// the kind of policy the service manages. Everything is kept in memory for
+// the stats surface, and also sent to UMA if a LoginMetrics is set.
+//
+// Only ever touched on the main loop.
+class PolicyStats {
+ public:
+  // What kind of policy a service manages. Used to label metrics.
+  enum Kind {
+    DEVICE = 0,
+    USER = 1,
+    DEVICE_LOCAL_ACCOUNT = 2,
+    NUM_KINDS = 3
+  };
+
+  // Things that are counted. Also the sample values of the UMA enum.
+  enum Counter {
+    STORE = 0,           // Store() calls, successful or not.
+    RETRIEVE = 1,        // Retrieve() calls.
+    PARSE_FAILURE = 2,   // Blobs passed to Store() that didn't parse.
+    VERIFY_FAILURE = 3,  // Blobs whose key or signature was rejected.
+    KEY_INSTALL = 4,     // Keys installed where there was none.
+    KEY_ROTATION = 5,    // Keys replaced through a signed rotation.
+    KEY_CLOBBER = 6,     // Keys replaced or cleared without any checks.
+    OWNER_SIGN_FAILURE = 7,  // Owner properties that couldn't be signed.
+    NUM_COUNTERS = 8
+  };
+
+  // Things that are sampled into histograms. Sizes are in bytes, times in
+  // microseconds.
+  enum Sample {
+    BLOB_SIZE = 0,     // Size of blobs passed to Store().
+    PARSE_TIME = 1,    // Time spent parsing them.
+    VERIFY_TIME = 2,   // Time spent checking their signature.
+    PERSIST_TIME = 3,  // Time spent writing policy to disk.
+    QUEUE_DELAY = 4,   // Time from scheduling a write to it starting.
+    QUEUE_DEPTH = 5,   // Writes already queued when one is scheduled.
+    PERSIST_LATENCY = 6,  // Time from scheduling a write to its completion.
+    NUM_SAMPLES = 7
+  };
+
+  // Histogram with power-of-two buckets: bucket 0 counts samples <= 0, bucket
+  // i counts samples in [2^(i-1), 2^i), and the last bucket also counts
+  // everything larger.
+  class Histogram {
+   public:
+    static const int kNumBuckets = 32;
+
+    Histogram();
+
+    void Add(int64 value);
+
+    int64 count() const { return count_; }
+    int64 sum() const { return sum_; }
+    int64 max() const { return max_; }
+    int64 bucket(int index) const { return buckets_[index]; }
+
+    // Returns an upper bound for the |percent|th percentile, i.e. the upper
+    // end of the bucket it falls into. Returns 0 if there are no samples.
+    int64 Percentile(int percent) const;
+
+    // Returns the bucket |value| is counted in.
+    static int BucketFor(int64 value);
+
+   private:
+    int64 count_;
+    int64 sum_;
+    int64 max_;
+    int64 buckets_[kNumBuckets];
+  };
+
+  explicit PolicyStats(Kind kind);
+  ~PolicyStats();
+
+  Kind kind() const { return kind_; }
+  void set_kind(Kind kind) { kind_ = kind; }
+
+  // If set, everything recorded is also sent to UMA. Not owned, may be NULL.
+  void set_metrics(LoginMetrics* metrics) { metrics_ = metrics; }
+
+  void Increment(Counter counter);
+  void AddSample(Sample sample, int64 value);
+  void AddTime(Sample sample, base::TimeDelta time);
+
+  int64 counter(Counter counter) const { return counters_[counter]; }
+  const Histogram& histogram(Sample sample) const {
+    return histograms_[sample];
+  }
+
+  // Returns a one-line, human-readable summary for the stats surface.
+  std::string ToString() const;
+
+  // Returns the label used for |kind| in metric names.
+  static const char* KindName(Kind kind);
+
+  // Returns the UMA names of the counter enum and of |sample|'s histogram for
+  // a service of |kind|.
+  static std::string CounterMetricName(Kind kind);
+  static std::string SampleMetricName(Kind kind, Sample sample);
+
+ private:
+  Kind kind_;
+  LoginMetrics* metrics_;  // Owned by the caller.
+  int64 counters_[NUM_COUNTERS];
+  Histogram histograms_[NUM_SAMPLES];
+
+  DISALLOW_COPY_AND_ASSIGN(PolicyStats);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_POLICY_STATS_H_
@@ -0,0 +1,90 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/policy_stats.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_metrics.h"
+
+using ::testing::HasSubstr;
+using ::testing::StrictMock;
+
+namespace login_manager {
+
+TEST(PolicyStatsHistogramTest, Buckets) {
+  EXPECT_EQ(0, PolicyStats::Histogram::BucketFor(-5));
+  EXPECT_EQ(0, PolicyStats::Histogram::BucketFor(0));
+  EXPECT_EQ(1, PolicyStats::Histogram::BucketFor(1));
+  EXPECT_EQ(2, PolicyStats::Histogram::BucketFor(2));
+  EXPECT_EQ(2, PolicyStats::Histogram::BucketFor(3));
+  EXPECT_EQ(11, PolicyStats::Histogram::BucketFor(1024));
+  EXPECT_EQ(PolicyStats::Histogram::kNumBuckets - 1,
+            PolicyStats::Histogram::BucketFor(kint64max));
+}
+
+TEST(PolicyStatsHistogramTest, Summary) {
+  PolicyStats::Histogram histogram;
+  EXPECT_EQ(0, histogram.Percentile(50));
+  for (int i = 0; i < 99; ++i)
+    histogram.Add(100);
+  histogram.Add(5000);
+
+  EXPECT_EQ(100, histogram.count());
+  EXPECT_EQ(99 * 100 + 5000, histogram.sum());
+  EXPECT_EQ(5000, histogram.max());
+  EXPECT_EQ(99, histogram.bucket(PolicyStats::Histogram::BucketFor(100)));
+  EXPECT_EQ(127, histogram.Percentile(50));
+  EXPECT_EQ(127, histogram.Percentile(99));
+  EXPECT_EQ(5000, histogram.Percentile(100));
+}
+
+TEST(PolicyStatsTest, CountsAndDescribes) {
+  PolicyStats stats(PolicyStats::DEVICE);
+  stats.Increment(PolicyStats::STORE);
+  stats.Increment(PolicyStats::STORE);
+  stats.Increment(PolicyStats::VERIFY_FAILURE);
+  stats.AddSample(PolicyStats::BLOB_SIZE, 2048);
+
+  EXPECT_EQ(2, stats.counter(PolicyStats::STORE));
+  EXPECT_EQ(1, stats.counter(PolicyStats::VERIFY_FAILURE));
+  EXPECT_EQ(0, stats.counter(PolicyStats::RETRIEVE));
+
+  const std::string description = stats.ToString();
+  EXPECT_THAT(description, HasSubstr("stores=2"));
+  EXPECT_THAT(description, HasSubstr("verify_failures=1"));
+  EXPECT_THAT(description, HasSubstr("blob_size[n=1 mean=2048"));
+  // Histograms without samples are left out.
+  EXPECT_THAT(description, ::testing::Not(HasSubstr("parse_us")));
+}
+
+TEST(PolicyStatsTest, SendsToUMA) {
+  StrictMock<MockMetrics> metrics;
+  PolicyStats stats(PolicyStats::DEVICE);
+  stats.set_kind(PolicyStats::USER);
+  stats.set_metrics(&metrics);
+
+  EXPECT_CALL(metrics, SendEnum("Login.PolicyOperation.User",
+                                PolicyStats::KEY_ROTATION,
+                                PolicyStats::NUM_COUNTERS));
+  stats.Increment(PolicyStats::KEY_ROTATION);
+
+  // Samples beyond the range of the UMA histogram are clamped.
+  EXPECT_CALL(metrics, SendHistogram("Login.PolicyBlobSize.User",
+                                     16 * 1024 * 1024, 1, 16 * 1024 * 1024,
+                                     50));
+  stats.AddSample(PolicyStats::BLOB_SIZE, GG_INT64_C(1) << 40);
+  EXPECT_EQ(GG_INT64_C(1) << 40,
+            stats.histogram(PolicyStats::BLOB_SIZE).max());
+
+  EXPECT_CALL(metrics, SendHistogram("Login.PolicyPersistTime.User", 1500, 1,
+                                     10 * 1000 * 1000, 50));
+  stats.AddTime(PolicyStats::PERSIST_TIME,
+                base::TimeDelta::FromMicroseconds(1500));
+}
+
+}  // namespace login_manager
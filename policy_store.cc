@@ -4,18 +4,30 @@
 
 #include "login_manager/policy_store.h"
 
+#include <string.h>
+
 #include <base/file_util.h>
 #include <base/logging.h>
+#include <base/sys_byteorder.h>
 
+#include "login_manager/crc32c.h"
 #include "login_manager/login_metrics.h"
 #include "login_manager/system_utils.h"
 
 namespace login_manager {
 // static
 const char PolicyStore::kPrefsFileName[] = "preferences";
+// The first byte is zero, which can't start a valid protobuf, so containers
+// and bare policy files can't be mistaken for one another.
+// static
+const uint32 PolicyStore::kContainerMagic = 0x4c4f5000;  // "\0POL"
+// static
+const uint32 PolicyStore::kContainerVersion = 1;
 
 PolicyStore::PolicyStore(const FilePath& policy_path)
-    : policy_path_(policy_path) {
+    : policy_path_(policy_path),
+      use_container_(false),
+      file_state_(FILE_NOT_LOADED) {
 }
 
 PolicyStore::~PolicyStore() {
@@ -26,16 +38,35 @@ bool PolicyStore::DefunctPrefsFilePresent() {
 }
 
 bool PolicyStore::LoadOrCreate() {
-  if (!file_util::PathExists(policy_path_))
+  if (!file_util::PathExists(policy_path_)) {
+    file_state_ = FILE_NOT_PRESENT;
     return true;
+  }
 
   std::string polstr;
-  if (!file_util::ReadFileToString(policy_path_, &polstr) || polstr.empty()) {
+  if (!file_util::ReadFileToString(policy_path_, &polstr)) {
     PLOG(ERROR) << "Could not read policy off disk at " << policy_path_.value();
+    file_state_ = FILE_MALFORMED;
+    return false;
+  }
+  if (polstr.empty()) {
+    LOG(ERROR) << "Policy file at " << policy_path_.value() << " is empty.";
+    file_state_ = FILE_TORN;
+    return false;
+  }
+
+  const char* payload = NULL;
+  size_t payload_size = 0;
+  file_state_ = DecodeContainer(polstr, &payload, &payload_size);
+  if (file_state_ == FILE_TORN) {
+    LOG(ERROR) << "Policy on disk is incomplete or corrupt and will be deleted!";
+    file_util::Delete(policy_path_, false);
     return false;
   }
-  if (!policy_.ParseFromString(polstr)) {
+  if (file_state_ != FILE_GOOD ||
+      !policy_.ParseFromArray(payload, payload_size)) {
     LOG(ERROR) << "Policy on disk could not be parsed and will be deleted!";
+    file_state_ = FILE_MALFORMED;
     file_util::Delete(policy_path_, false);
     return false;
   }
@@ -47,13 +78,26 @@ const enterprise_management::PolicyFetchResponse& PolicyStore::Get() const {
 }
 
 bool PolicyStore::Persist() {
-  SystemUtils utils;
   std::string polstr;
   if (!policy_.SerializeToString(&polstr)) {
     LOG(ERROR) << "Could not serialize policy!";
     return false;
   }
-  return utils.AtomicFileWrite(policy_path_, polstr.c_str(), polstr.length());
+  return PersistBlob(polstr);
+}
+
+bool PolicyStore::PersistBlob(const std::string& blob) {
+  SystemUtils utils;
+  if (use_container_) {
+    const std::string container(EncodeContainer(blob));
+    return utils.AtomicFileWrite(policy_path_, container.c_str(),
+                                 container.length());
+  }
+  return utils.AtomicFileWrite(policy_path_, blob.c_str(), blob.length());
+}
+
+PolicyStore::FileState PolicyStore::GetFileState() const {
+  return file_state_;
 }
 
 void PolicyStore::Set(
@@ -63,4 +107,62 @@ void PolicyStore::Set(
   policy_.CheckTypeAndMergeFrom(policy);
 }
 
+void PolicyStore::Swap(enterprise_management::PolicyFetchResponse* policy) {
+  policy_.Swap(policy);
+}
+
+// static
+std::string PolicyStore::EncodeContainer(const std::string& payload) {
+  ContainerHeader header;
+  header.magic = base::ByteSwapToLE32(kContainerMagic);
+  header.version = base::ByteSwapToLE32(kContainerVersion);
+  header.length = base::ByteSwapToLE32(payload.size());
+  header.crc32c = base::ByteSwapToLE32(Crc32c(payload.data(), payload.size()));
+  std::string container(reinterpret_cast<const char*>(&header),
+                        sizeof(header));
+  container.append(payload);
+  return container;
+}
+
+// static
+PolicyStore::FileState PolicyStore::DecodeContainer(const std::string& data,
+                                                    const char** payload,
+                                                    size_t* payload_size) {
+  uint32 magic = 0;
+  if (data.size() >= sizeof(magic))
+    memcpy(&magic, data.data(), sizeof(magic));
+  if (base::ByteSwapToLE32(magic) != kContainerMagic) {
+    // A bare protobuf, which can only be checked by parsing it.
+    *payload = data.data();
+    *payload_size = data.size();
+    return FILE_GOOD;
+  }
+
+  ContainerHeader header;
+  if (data.size() < sizeof(header)) {
+    LOG(ERROR) << "Policy container header is truncated.";
+    return FILE_TORN;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (base::ByteSwapToLE32(header.version) != kContainerVersion) {
+    LOG(ERROR) << "Unknown policy container version "
+               << base::ByteSwapToLE32(header.version);
+    return FILE_MALFORMED;
+  }
+  const size_t length = base::ByteSwapToLE32(header.length);
+  if (data.size() - sizeof(header) != length) {
+    LOG(ERROR) << "Policy container holds " << data.size() - sizeof(header)
+               << " bytes, expected " << length;
+    return FILE_TORN;
+  }
+  const char* start = data.data() + sizeof(header);
+  if (Crc32c(start, length) != base::ByteSwapToLE32(header.crc32c)) {
+    LOG(ERROR) << "Policy container checksum mismatch.";
+    return FILE_TORN;
+  }
+  *payload = start;
+  *payload_size = length;
+  return FILE_GOOD;
+}
+
 }  // namespace login_manager
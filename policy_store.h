@@ -26,9 +26,27 @@ class PolicyKey;
 // THIS CLASS DOES NO SIGNATURE VALIDATION.
 class PolicyStore {
  public:
+  // What LoadOrCreate() found on disk.
+  enum FileState {
+    // LoadOrCreate() hasn't been called yet.
+    FILE_NOT_LOADED,
+    FILE_NOT_PRESENT,
+    FILE_GOOD,
+    // The file is empty, or is a container whose length or checksum doesn't
+    // match its payload, i.e. what's on disk isn't what was written.
+    FILE_TORN,
+    // The data is intact, or can't be checked, but doesn't parse.
+    FILE_MALFORMED,
+  };
+
   explicit PolicyStore(const FilePath& policy_path);
   virtual ~PolicyStore();
 
+  // Makes Persist() wrap the policy in a container that carries its length and
+  // CRC32C, so that a torn write is told apart from bad data and is noticed
+  // even if it happens to parse. Both formats are always read.
+  void set_use_container(bool use) { use_container_ = use; }
+
   virtual bool DefunctPrefsFilePresent();
 
   // Load the signed policy off of disk into |policy_|.
@@ -41,14 +59,47 @@ class PolicyStore {
   // Returns false if there's an error while writing data.
   virtual bool Persist();
 
+  // Writes |blob|, an already serialized policy, to |policy_file_|. Doesn't
+  // touch |policy_|, so this may be called off the thread that owns the store.
+  virtual bool PersistBlob(const std::string& blob);
+
+  virtual FileState GetFileState() const;
+
   // Clobber the stored policy with new data.
   virtual void Set(const enterprise_management::PolicyFetchResponse& policy);
 
+  // Like Set(), but takes the contents of |policy| instead of copying them.
+  // |policy| is left holding the previously stored policy.
+  virtual void Swap(enterprise_management::PolicyFetchResponse* policy);
+
  private:
+  // Container layout, all fields little endian. The payload follows right
+  // after the header. Bump |kContainerVersion| on any change.
+  struct ContainerHeader {
+    uint32 magic;
+    uint32 version;
+    uint32 length;
+    uint32 crc32c;
+  };
+
+  // Wraps |payload| in a container.
+  static std::string EncodeContainer(const std::string& payload);
+
+  // If |data| is a container, checks it and points |payload| at its contents.
+  // Otherwise, |data| is taken to be a bare protobuf. Returns FILE_GOOD if
+  // |payload| is worth parsing.
+  static FileState DecodeContainer(const std::string& data,
+                                   const char** payload,
+                                   size_t* payload_size);
+
   static const char kPrefsFileName[];
+  static const uint32 kContainerMagic;
+  static const uint32 kContainerVersion;
 
   enterprise_management::PolicyFetchResponse policy_;
   const FilePath policy_path_;
+  bool use_container_;
+  FileState file_state_;
 
   DISALLOW_COPY_AND_ASSIGN(PolicyStore);
 };
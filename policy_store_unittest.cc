@@ -86,6 +86,20 @@ TEST_F(PolicyStoreTest, VerifyPolicyUpdate) {
   CheckExpectedPolicy(&store, new_policy);
 }
 
+TEST_F(PolicyStoreTest, VerifyPolicySwap) {
+  PolicyStore store(tmpfile_);
+  enterprise_management::PolicyFetchResponse policy;
+  policy.set_error_message("policy");
+  store.Set(policy);
+
+  enterprise_management::PolicyFetchResponse new_policy;
+  new_policy.set_error_message("new policy");
+  enterprise_management::PolicyFetchResponse swapped(new_policy);
+  store.Swap(&swapped);
+  CheckExpectedPolicy(&store, new_policy);
+  EXPECT_EQ("policy", swapped.error_message());
+}
+
 TEST_F(PolicyStoreTest, LoadStoreFromDisk) {
   PolicyStore store(tmpfile_);
   enterprise_management::PolicyFetchResponse policy;
@@ -97,6 +111,95 @@ TEST_F(PolicyStoreTest, LoadStoreFromDisk) {
   PolicyStore store2(tmpfile_);
   ASSERT_TRUE(store2.LoadOrCreate());
   CheckExpectedPolicy(&store2, policy);
+  EXPECT_EQ(PolicyStore::FILE_GOOD, store2.GetFileState());
+}
+
+TEST_F(PolicyStoreTest, FileStateMissing) {
+  PolicyStore store(tmpfile_);
+  EXPECT_EQ(PolicyStore::FILE_NOT_LOADED, store.GetFileState());
+  ASSERT_TRUE(store.LoadOrCreate());
+  EXPECT_EQ(PolicyStore::FILE_NOT_PRESENT, store.GetFileState());
+}
+
+TEST_F(PolicyStoreTest, FileStateEmpty) {
+  ASSERT_EQ(0, file_util::WriteFile(tmpfile_, "", 0));
+  PolicyStore store(tmpfile_);
+  ASSERT_FALSE(store.LoadOrCreate());
+  EXPECT_EQ(PolicyStore::FILE_TORN, store.GetFileState());
+}
+
+TEST_F(PolicyStoreTest, FileStateMalformed) {
+  const char kGarbage[] = "\xff\xff\xff";
+  ASSERT_EQ(3, file_util::WriteFile(tmpfile_, kGarbage, 3));
+  PolicyStore store(tmpfile_);
+  ASSERT_FALSE(store.LoadOrCreate());
+  EXPECT_EQ(PolicyStore::FILE_MALFORMED, store.GetFileState());
+  EXPECT_FALSE(file_util::PathExists(tmpfile_));
+}
+
+TEST_F(PolicyStoreTest, LoadContainerFromDisk) {
+  PolicyStore store(tmpfile_);
+  store.set_use_container(true);
+  enterprise_management::PolicyFetchResponse policy;
+  policy.set_error_message("policy");
+  store.Set(policy);
+  ASSERT_TRUE(store.Persist());
+
+  std::string bare;
+  ASSERT_TRUE(policy.SerializeToString(&bare));
+  std::string on_disk;
+  ASSERT_TRUE(file_util::ReadFileToString(tmpfile_, &on_disk));
+  EXPECT_EQ(bare.size() + 16, on_disk.size());
+  EXPECT_EQ(bare, on_disk.substr(16));
+
+  // Containers are read regardless of how the store is set up.
+  PolicyStore store2(tmpfile_);
+  ASSERT_TRUE(store2.LoadOrCreate());
+  CheckExpectedPolicy(&store2, policy);
+  EXPECT_EQ(PolicyStore::FILE_GOOD, store2.GetFileState());
+}
+
+TEST_F(PolicyStoreTest, LoadBareIntoContainerStore) {
+  PolicyStore store(tmpfile_);
+  enterprise_management::PolicyFetchResponse policy;
+  policy.set_error_message("policy");
+  store.Set(policy);
+  ASSERT_TRUE(store.Persist());
+
+  PolicyStore store2(tmpfile_);
+  store2.set_use_container(true);
+  ASSERT_TRUE(store2.LoadOrCreate());
+  CheckExpectedPolicy(&store2, policy);
+}
+
+TEST_F(PolicyStoreTest, TornContainer) {
+  PolicyStore store(tmpfile_);
+  store.set_use_container(true);
+  enterprise_management::PolicyFetchResponse policy;
+  policy.set_error_message("policy");
+  store.Set(policy);
+  ASSERT_TRUE(store.Persist());
+  std::string on_disk;
+  ASSERT_TRUE(file_util::ReadFileToString(tmpfile_, &on_disk));
+
+  // A short write. The truncated payload would still parse as a protobuf.
+  std::string truncated(on_disk, 0, on_disk.size() - 1);
+  ASSERT_EQ(static_cast<int>(truncated.size()),
+            file_util::WriteFile(tmpfile_, truncated.data(),
+                                 truncated.size()));
+  PolicyStore store2(tmpfile_);
+  ASSERT_FALSE(store2.LoadOrCreate());
+  EXPECT_EQ(PolicyStore::FILE_TORN, store2.GetFileState());
+  EXPECT_FALSE(file_util::PathExists(tmpfile_));
+
+  // A payload that doesn't match the checksum.
+  std::string corrupt(on_disk);
+  corrupt[corrupt.size() - 1] ^= 0x01;
+  ASSERT_EQ(static_cast<int>(corrupt.size()),
+            file_util::WriteFile(tmpfile_, corrupt.data(), corrupt.size()));
+  PolicyStore store3(tmpfile_);
+  ASSERT_FALSE(store3.LoadOrCreate());
+  EXPECT_EQ(PolicyStore::FILE_TORN, store3.GetFileState());
 }
 
 }  // namespace login_manager
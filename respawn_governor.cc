@@ -0,0 +1,152 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/respawn_governor.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/string_number_conversions.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+
+#include "login_manager/system_utils.h"
+
+namespace login_manager {
+
+// static
+const char RespawnGovernor::kHistoryFile[] = "/var/lib/ui/respawn_history";
+// static
+const uint32 RespawnGovernor::kMagic = 0x55495248;  // "UIRH"
+// static
+const uint32 RespawnGovernor::kVersion = 2;
+// static
+const char RespawnGovernor::kBootIdFile[] = "/proc/sys/kernel/random/boot_id";
+
+RespawnGovernor::Config::Config()
+    : too_crashy(1, 180),
+      reboot(1, 540),
+      self_restart(6, 60) {
+}
+
+RespawnGovernor::RespawnGovernor(const base::FilePath& history_file,
+                                 const Config& config,
+                                 SystemUtils* system)
+    : config_(config),
+      system_(system),
+      boot_id_file_(kBootIdFile),
+      mapped_record_(history_file, sizeof(History), kMagic, kVersion) {
+}
+
+RespawnGovernor::~RespawnGovernor() {
+}
+
+bool RespawnGovernor::Initialize() {
+  const base::FilePath dir(mapped_record_.path().DirName());
+  if (!file_util::CreateDirectory(dir)) {
+    PLOG(ERROR) << "Can't create " << dir.value();
+    return false;
+  }
+  return mapped_record_.Initialize();
+}
+
+bool RespawnGovernor::OnStartup() {
+  History* record = history();
+  const std::string boot_id = ReadBootId();
+  bool ok = true;
+  if (record->running && boot_id == record->boot_id) {
+    LOG(WARNING) << "Previous session_manager did not exit cleanly.";
+    ok = RecordAndCheck(SELF_RESTART, config_.self_restart);
+  } else {
+    // A clean exit doesn't count, and neither does a run that ended with the
+    // boot it was in. An abnormal exit recorded by OnExit() might already
+    // have used up the budget, though.
+    ok = CountRecent(SELF_RESTART, config_.self_restart, system_->time(NULL)) <=
+        config_.self_restart.count;
+  }
+  if (!ok) {
+    LOG(ERROR) << "session_manager restarted too often, giving up.";
+    return false;
+  }
+  record->running = 1;
+  base::strlcpy(record->boot_id, boot_id.c_str(), sizeof(record->boot_id));
+  mapped_record_.Sync();
+  return true;
+}
+
+RespawnGovernor::Action RespawnGovernor::OnBrowserExitingTooFast() {
+  if (RecordAndCheck(TOO_CRASHY, config_.too_crashy)) {
+    LOG(WARNING) << "Browser exiting too fast, giving it another chance.";
+    return RESTART_BROWSER;
+  }
+  if (RecordAndCheck(REBOOT_REQUESTED, config_.reboot)) {
+    LOG(ERROR) << "Browser keeps exiting too fast, rebooting to mitigate.";
+    return REBOOT;
+  }
+  LOG(ERROR) << "Rebooted too much, restarting session_manager.";
+  return RESTART_SELF;
+}
+
+void RespawnGovernor::OnExit(bool clean) {
+  if (!clean)
+    RecordAndCheck(SELF_RESTART, config_.self_restart);
+  history()->running = 0;
+  mapped_record_.Sync();
+}
+
+// static
+bool RespawnGovernor::ParseLimit(const std::string& spec, Limit* limit) {
+  std::vector<std::string> parts;
+  base::SplitString(spec, '/', &parts);
+  int count = 0, window = 0;
+  if (parts.size() != 2 ||
+      !base::StringToInt(parts[0], &count) ||
+      !base::StringToInt(parts[1], &window) ||
+      count < 0 || window <= 0) {
+    return false;
+  }
+  if (count >= kMaxEvents) {
+    LOG(WARNING) << "Clamping respawn limit " << spec;
+    count = kMaxEvents - 1;
+  }
+  *limit = Limit(count, window);
+  return true;
+}
+
+bool RespawnGovernor::RecordAndCheck(EventType type, const Limit& limit) {
+  const int64 now = system_->time(NULL);
+  Ring& ring = history()->rings[type];
+  ring.times[ring.next % kMaxEvents] = now;
+  ring.next = (ring.next + 1) % kMaxEvents;
+  mapped_record_.Sync();
+  return CountRecent(type, limit, now) <= limit.count;
+}
+
+int RespawnGovernor::CountRecent(EventType type,
+                                 const Limit& limit,
+                                 int64 now) const {
+  const Ring& ring = history()->rings[type];
+  int recent = 0;
+  for (int i = 0; i < kMaxEvents; ++i) {
+    // Timestamps from the future mean the clock was set back; count them,
+    // erring on the side of caution.
+    if (ring.times[i] && now - ring.times[i] < limit.window_seconds)
+      ++recent;
+  }
+  return recent;
+}
+
+std::string RespawnGovernor::ReadBootId() const {
+  std::string boot_id;
+  if (!file_util::ReadFileToString(boot_id_file_, &boot_id))
+    PLOG(WARNING) << "Can't read " << boot_id_file_.value();
+  TrimWhitespaceASCII(boot_id, TRIM_ALL, &boot_id);
+  return boot_id;
+}
+
+}  // namespace login_manager
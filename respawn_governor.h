@@ -0,0 +1,148 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_RESPAWN_GOVERNOR_H_
+#define LOGIN_MANAGER_RESPAWN_GOVERNOR_H_
+
+#include <time.h>
+
+#include <string>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+
+#include "login_manager/mapped_record.h"
+
+namespace login_manager {
+
+class SystemUtils;
+
+// Decides how to recover when the browser keeps crashing. The options, in
+// order of escalation, are to restart the browser, to reboot the device,
+// and to have upstart restart session_manager. The governor also notices
+// when session_manager itself keeps exiting abnormally, and gives up on the
+// UI when that happens too often.
+//
+// Decisions are based on a crash history that is kept in a MappedRecord, so
+// that it survives both session_manager restarts and reboots. A run that is
+// cut short by a reboot, e.g. a power loss, isn't counted as an abnormal
+// exit.
+class RespawnGovernor {
+ public:
+  enum Action {
+    // Give the browser another set of restart tries.
+    RESTART_BROWSER,
+    // Ask the power manager to reboot the device.
+    REBOOT,
+    // Exit and let upstart start session_manager again.
+    RESTART_SELF,
+  };
+
+  // Allows up to |count| events within |window_seconds|.
+  struct Limit {
+    Limit() : count(0), window_seconds(0) {}
+    Limit(int c, int w) : count(c), window_seconds(w) {}
+    int count;
+    int window_seconds;
+  };
+
+  struct Config {
+    Config();
+    // How often the browser may exit too fast before a reboot is tried.
+    Limit too_crashy;
+    // How often a reboot may be tried before falling back to restarting
+    // session_manager.
+    Limit reboot;
+    // How often session_manager may exit abnormally before the UI is given
+    // up on.
+    Limit self_restart;
+  };
+
+  RespawnGovernor(const base::FilePath& history_file,
+                  const Config& config,
+                  SystemUtils* system);
+  virtual ~RespawnGovernor();
+
+  // Maps the crash history, starting a fresh one if it is missing or not
+  // understood. Without a mapping, history is only kept in memory.
+  bool Initialize();
+
+  // Called when session_manager starts. Returns false if session_manager has
+  // exited abnormally too often and the UI should not be started.
+  virtual bool OnStartup();
+
+  // Called when the browser has used up its restart tries.
+  virtual Action OnBrowserExitingTooFast();
+
+  // Called when session_manager is about to exit. Only |clean| exits are not
+  // counted against the self-restart limit.
+  virtual void OnExit(bool clean);
+
+  // Parses a limit in "<count>/<window seconds>" form, as used on the command
+  // line. Returns false if |spec| is malformed.
+  static bool ParseLimit(const std::string& spec, Limit* limit);
+
+  // Default location of the crash history.
+  static const char kHistoryFile[];
+
+  // Maximum number of events kept per kind. Limits beyond this can't be
+  // enforced.
+  static const int kMaxEvents = 16;
+
+ private:
+  friend class RespawnGovernorTest;
+
+  enum EventType {
+    TOO_CRASHY = 0,
+    REBOOT_REQUESTED,
+    SELF_RESTART,
+    NUM_EVENT_TYPES,
+  };
+
+  struct Ring {
+    uint32 next;
+    int64 times[kMaxEvents];
+  };
+
+  // On-disk layout. Bump |kVersion| on any change.
+  struct History {
+    MappedRecord::Header header;
+    // Nonzero while a session_manager instance is running.
+    uint32 running;
+    // The boot that instance is running in, NUL-terminated.
+    char boot_id[40];
+    Ring rings[NUM_EVENT_TYPES];
+  };
+
+  static const uint32 kMagic;
+  static const uint32 kVersion;
+  static const char kBootIdFile[];
+
+  History* history() { return static_cast<History*>(mapped_record_.data()); }
+  const History* history() const {
+    return static_cast<const History*>(mapped_record_.data());
+  }
+
+  // Returns the id of the current boot, or an empty string if it's unknown.
+  std::string ReadBootId() const;
+
+  // Records an event of |type| now and returns true if this keeps the number
+  // of such events within |limit|.
+  bool RecordAndCheck(EventType type, const Limit& limit);
+
+  // Returns the number of events of |type| within the window of |limit|.
+  int CountRecent(EventType type, const Limit& limit, int64 now) const;
+
+  const Config config_;
+  SystemUtils* system_;  // Owned by the caller.
+  base::FilePath boot_id_file_;
+
+  MappedRecord mapped_record_;
+
+  DISALLOW_COPY_AND_ASSIGN(RespawnGovernor);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_RESPAWN_GOVERNOR_H_
@@ -0,0 +1,159 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/respawn_governor.h"
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/string_number_conversions.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_system_utils.h"
+
+using ::testing::Return;
+using ::testing::ReturnPointee;
+using ::testing::_;
+
+namespace login_manager {
+
+class RespawnGovernorTest : public ::testing::Test {
+ public:
+  RespawnGovernorTest() : now_(1000000) {}
+  virtual ~RespawnGovernorTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    history_file_ = tmpdir_.path().AppendASCII("ui").AppendASCII("history");
+    boot_id_file_ = tmpdir_.path().AppendASCII("boot_id");
+    SetBootId("b07");
+    EXPECT_CALL(utils_, time(_)).WillRepeatedly(ReturnPointee(&now_));
+  }
+
+ protected:
+  scoped_ptr<RespawnGovernor> CreateGovernor() {
+    scoped_ptr<RespawnGovernor> governor(
+        new RespawnGovernor(history_file_, config_, &utils_));
+    governor->boot_id_file_ = boot_id_file_;
+    EXPECT_TRUE(governor->Initialize());
+    return governor.Pass();
+  }
+
+  void SetBootId(const std::string& boot_id) {
+    const std::string contents = boot_id + "\n";
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(boot_id_file_, contents.data(),
+                                   contents.size()));
+  }
+
+  time_t now_;
+  RespawnGovernor::Config config_;
+  MockSystemUtils utils_;
+  base::ScopedTempDir tmpdir_;
+  base::FilePath history_file_;
+  base::FilePath boot_id_file_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RespawnGovernorTest);
+};
+
+TEST_F(RespawnGovernorTest, Escalation) {
+  scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+  ASSERT_TRUE(governor->OnStartup());
+  EXPECT_EQ(RespawnGovernor::RESTART_BROWSER,
+            governor->OnBrowserExitingTooFast());
+  now_ += 10;
+  EXPECT_EQ(RespawnGovernor::REBOOT, governor->OnBrowserExitingTooFast());
+  now_ += 10;
+  EXPECT_EQ(RespawnGovernor::RESTART_SELF,
+            governor->OnBrowserExitingTooFast());
+}
+
+TEST_F(RespawnGovernorTest, WindowExpires) {
+  scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+  ASSERT_TRUE(governor->OnStartup());
+  EXPECT_EQ(RespawnGovernor::RESTART_BROWSER,
+            governor->OnBrowserExitingTooFast());
+  now_ += config_.too_crashy.window_seconds;
+  EXPECT_EQ(RespawnGovernor::RESTART_BROWSER,
+            governor->OnBrowserExitingTooFast());
+}
+
+TEST_F(RespawnGovernorTest, HistorySurvivesRestart) {
+  scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+  ASSERT_TRUE(governor->OnStartup());
+  EXPECT_EQ(RespawnGovernor::RESTART_BROWSER,
+            governor->OnBrowserExitingTooFast());
+  EXPECT_EQ(RespawnGovernor::REBOOT, governor->OnBrowserExitingTooFast());
+  governor->OnExit(true);
+  governor.reset();
+
+  now_ += 60;
+  governor = CreateGovernor();
+  ASSERT_TRUE(governor->OnStartup());
+  // Still within both windows.
+  EXPECT_EQ(RespawnGovernor::RESTART_SELF,
+            governor->OnBrowserExitingTooFast());
+}
+
+TEST_F(RespawnGovernorTest, GivesUpAfterUncleanExits) {
+  for (int i = 0; i <= config_.self_restart.count; ++i) {
+    scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+    ASSERT_TRUE(governor->OnStartup());
+    governor->OnExit(false);
+    now_ += 1;
+  }
+  scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+  EXPECT_FALSE(governor->OnStartup());
+}
+
+TEST_F(RespawnGovernorTest, CountsCrashedInstances) {
+  for (int i = 0; i <= config_.self_restart.count; ++i) {
+    // Never calls OnExit(), as if session_manager had crashed.
+    scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+    ASSERT_TRUE(governor->OnStartup());
+    now_ += 1;
+  }
+  // The last instance left |running| set.
+  scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+  EXPECT_FALSE(governor->OnStartup());
+}
+
+TEST_F(RespawnGovernorTest, RebootsDontCount) {
+  for (int i = 0; i <= 2 * config_.self_restart.count; ++i) {
+    // Never calls OnExit(), as if the device had lost power.
+    SetBootId(base::IntToString(i));
+    scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+    ASSERT_TRUE(governor->OnStartup());
+    now_ += 1;
+  }
+}
+
+TEST_F(RespawnGovernorTest, CleanExitsDontCount) {
+  for (int i = 0; i < 2 * config_.self_restart.count; ++i) {
+    scoped_ptr<RespawnGovernor> governor(CreateGovernor());
+    ASSERT_TRUE(governor->OnStartup());
+    governor->OnExit(true);
+  }
+}
+
+TEST_F(RespawnGovernorTest, ParseLimit) {
+  RespawnGovernor::Limit limit;
+  EXPECT_TRUE(RespawnGovernor::ParseLimit("3/120", &limit));
+  EXPECT_EQ(3, limit.count);
+  EXPECT_EQ(120, limit.window_seconds);
+
+  EXPECT_TRUE(RespawnGovernor::ParseLimit("100/60", &limit));
+  EXPECT_EQ(RespawnGovernor::kMaxEvents - 1, limit.count);
+
+  EXPECT_FALSE(RespawnGovernor::ParseLimit("", &limit));
+  EXPECT_FALSE(RespawnGovernor::ParseLimit("3", &limit));
+  EXPECT_FALSE(RespawnGovernor::ParseLimit("3/0", &limit));
+  EXPECT_FALSE(RespawnGovernor::ParseLimit("-1/60", &limit));
+  EXPECT_FALSE(RespawnGovernor::ParseLimit("a/b", &limit));
+}
+
+}  // namespace login_manager
@@ -0,0 +1,167 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/restart_policy.h"
+
+#include <base/logging.h>
+#include <base/rand_util.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+
+#include "login_manager/system_utils.h"
+
+namespace login_manager {
+
+namespace {
+
+// Default fallback flags. The first mode turns off the GPU features that are
+// most likely to take the browser down on bad drivers; the second one stops
+// using the GPU altogether.
+const char* kDegradedMode1[] = {
+  "--disable-accelerated-video-decode",
+  "--disable-accelerated-2d-canvas",
+  "--disable-webgl",
+};
+const char* kDegradedMode2[] = {
+  "--disable-gpu",
+};
+
+RestartPolicy::Flags MakeFlags(const char** flags, size_t count) {
+  return RestartPolicy::Flags(flags, flags + count);
+}
+
+}  // namespace
+
+RestartPolicy::Config::Config()
+    : restart_tries(4),
+      restart_window_seconds(60),
+      initial_backoff(base::TimeDelta::FromMilliseconds(500)),
+      max_backoff(base::TimeDelta::FromSeconds(5)),
+      jitter(0.25) {
+  degraded_modes.push_back(
+      MakeFlags(kDegradedMode1, arraysize(kDegradedMode1)));
+  degraded_modes.push_back(
+      MakeFlags(kDegradedMode2, arraysize(kDegradedMode2)));
+}
+
+RestartPolicy::RestartPolicy(const Config& config, SystemUtils* system)
+    : config_(config),
+      system_(system),
+      quick_exits_(0),
+      degraded_level_(0) {
+  DCHECK_GT(config_.restart_tries, 0U);
+}
+
+RestartPolicy::~RestartPolicy() {
+}
+
+void RestartPolicy::RecordStart() {
+  start_times_.push_back(system_->time(NULL));
+  while (start_times_.size() > config_.restart_tries)
+    start_times_.pop_front();
+}
+
+RestartPolicy::Decision RestartPolicy::OnExit() {
+  const time_t now = system_->time(NULL);
+  Decision decision;
+
+  if (!start_times_.empty() &&
+      now - start_times_.back() < config_.restart_window_seconds) {
+    ++quick_exits_;
+  } else {
+    quick_exits_ = 0;
+    // The current mode held up for a while, so whatever made the browser
+    // crash may have been transient; try the next less degraded mode.
+    if (degraded_level_ > 0 && !start_times_.empty()) {
+      --degraded_level_;
+      LOG(INFO) << "Browser ran for a while, stepping down to degraded mode "
+                << degraded_level_;
+    }
+  }
+
+  if (!ExitingTooFast(now)) {
+    decision.delay = ComputeBackoff();
+    return decision;
+  }
+
+  if (static_cast<size_t>(degraded_level_) >= config_.degraded_modes.size()) {
+    LOG(ERROR) << "Browser exiting too fast, out of degraded modes.";
+    decision.give_up = true;
+    return decision;
+  }
+
+  // Give the new mode a fresh set of tries, and don't make the user wait for
+  // what is hopefully a working browser.
+  ++degraded_level_;
+  start_times_.clear();
+  quick_exits_ = 0;
+  LOG(WARNING) << "Browser exiting too fast, relaunching in degraded mode "
+               << degraded_level_ << ": "
+               << JoinString(GetDegradedFlags(), ' ');
+  return decision;
+}
+
+void RestartPolicy::Reset() {
+  start_times_.clear();
+  quick_exits_ = 0;
+}
+
+void RestartPolicy::SetRestartLimit(uint restart_tries,
+                                    time_t restart_window_seconds) {
+  DCHECK_GT(restart_tries, 0U);
+  config_.restart_tries = restart_tries;
+  config_.restart_window_seconds = restart_window_seconds;
+  while (start_times_.size() > config_.restart_tries)
+    start_times_.pop_front();
+}
+
+RestartPolicy::Flags RestartPolicy::GetDegradedFlags() const {
+  if (degraded_level_ == 0)
+    return Flags();
+  return config_.degraded_modes[degraded_level_ - 1];
+}
+
+// static
+bool RestartPolicy::ParseDegradedModes(const std::string& spec,
+                                       std::vector<Flags>* modes) {
+  std::vector<std::string> mode_specs;
+  base::SplitString(spec, ';', &mode_specs);
+  std::vector<Flags> parsed;
+  for (std::vector<std::string>::const_iterator it = mode_specs.begin();
+       it != mode_specs.end(); ++it) {
+    Flags flags;
+    base::SplitStringAlongWhitespace(*it, &flags);
+    if (flags.empty())
+      return false;
+    parsed.push_back(flags);
+  }
+  modes->swap(parsed);
+  return true;
+}
+
+bool RestartPolicy::ExitingTooFast(time_t now) const {
+  return start_times_.size() >= config_.restart_tries &&
+      now - start_times_.front() < config_.restart_window_seconds;
+}
+
+base::TimeDelta RestartPolicy::ComputeBackoff() const {
+  // The first quick exit in a row is restarted right away.
+  if (quick_exits_ < 2)
+    return base::TimeDelta();
+
+  base::TimeDelta delay = config_.initial_backoff;
+  for (int i = 2; i < quick_exits_ && delay < config_.max_backoff; ++i)
+    delay *= 2;
+  if (delay > config_.max_backoff)
+    delay = config_.max_backoff;
+
+  if (config_.jitter > 0) {
+    const double scale = 1.0 - config_.jitter * base::RandDouble();
+    delay = base::TimeDelta::FromMicroseconds(
+        static_cast<int64>(delay.InMicroseconds() * scale));
+  }
+  return delay;
+}
+
+}  // namespace login_manager
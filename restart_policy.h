@@ -0,0 +1,118 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_RESTART_POLICY_H_
+#define LOGIN_MANAGER_RESTART_POLICY_H_
+
+#include <time.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+class SystemUtils;
+
+// Decides when and how the browser is restarted after it exits.
+//
+// A browser that exits shortly after it was started is restarted after an
+// exponentially growing, jittered delay. Once it has been started too many
+// times too quickly, it is relaunched in progressively degraded modes, each
+// of which adds some fallback flags (e.g. to turn off GPU features) to the
+// command line. Only when all degraded modes have been tried does the policy
+// give up, at which point the caller escalates (see RespawnGovernor). Every
+// run that outlasts the restart window steps back down one degraded mode.
+class RestartPolicy {
+ public:
+  typedef std::vector<std::string> Flags;
+
+  struct Config {
+    Config();
+    // The browser is considered to be exiting too fast once it has been
+    // started |restart_tries| times within |restart_window_seconds|.
+    uint restart_tries;
+    time_t restart_window_seconds;
+    // Delay before the second quick restart in a row. Doubled for every
+    // further quick restart, up to |max_backoff|.
+    base::TimeDelta initial_backoff;
+    base::TimeDelta max_backoff;
+    // Delays are randomly shortened by up to this fraction, so that the
+    // browser doesn't restart in lockstep with whatever is making it crash.
+    double jitter;
+    // Flags for each degraded mode, in the order they're tried.
+    std::vector<Flags> degraded_modes;
+  };
+
+  struct Decision {
+    Decision() : give_up(false) {}
+    // True if the browser should not be restarted anymore.
+    bool give_up;
+    // How long to wait before restarting the browser.
+    base::TimeDelta delay;
+  };
+
+  RestartPolicy(const Config& config, SystemUtils* system);
+  virtual ~RestartPolicy();
+
+  // Records that the browser is being started now.
+  virtual void RecordStart();
+
+  // Called when the browser has exited, to decide what to do next. May
+  // switch to the next, or back to the previous, degraded mode.
+  virtual Decision OnExit();
+
+  // Forgets recorded starts and backoff, giving the browser a fresh set of
+  // restart tries in the current mode.
+  virtual void Reset();
+
+  // Changes how many starts within how long count as exiting too fast, see
+  // Config. Takes effect from the next exit on.
+  virtual void SetRestartLimit(uint restart_tries,
+                               time_t restart_window_seconds);
+
+  // Returns the flags to add to the browser's command line in the current
+  // mode; empty unless running degraded.
+  virtual Flags GetDegradedFlags() const;
+
+  // Returns how many degraded modes have been entered so far.
+  int degraded_level() const { return degraded_level_; }
+
+  // Parses degraded modes separated by ';', each consisting of flags
+  // separated by whitespace, e.g. "--disable-webgl;--disable-gpu". An empty
+  // |spec| turns degraded modes off. Returns false if |spec| contains an
+  // empty mode.
+  static bool ParseDegradedModes(const std::string& spec,
+                                 std::vector<Flags>* modes);
+
+ private:
+  // Returns true if the browser has been started too often recently.
+  bool ExitingTooFast(time_t now) const;
+
+  // Returns the delay before the next restart, given how many times in a row
+  // the browser has exited shortly after starting.
+  base::TimeDelta ComputeBackoff() const;
+
+  Config config_;
+  SystemUtils* system_;  // Owned by the caller.
+
+  // The most recent start times, oldest first. Holds at most
+  // |config_.restart_tries| entries.
+  std::deque<time_t> start_times_;
+
+  // Number of consecutive exits that happened within the restart window of
+  // the corresponding start.
+  int quick_exits_;
+
+  int degraded_level_;
+
+  DISALLOW_COPY_AND_ASSIGN(RestartPolicy);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_RESTART_POLICY_H_
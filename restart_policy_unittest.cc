@@ -0,0 +1,191 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/restart_policy.h"
+
+#include <string>
+#include <vector>
+
+#include <base/memory/scoped_ptr.h>
+#include <base/time.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_system_utils.h"
+
+using ::testing::ReturnPointee;
+using ::testing::_;
+
+namespace login_manager {
+
+class RestartPolicyTest : public ::testing::Test {
+ public:
+  RestartPolicyTest() : now_(1000) {}
+  virtual ~RestartPolicyTest() {}
+
+  virtual void SetUp() {
+    config_.jitter = 0;
+    EXPECT_CALL(utils_, time(_)).WillRepeatedly(ReturnPointee(&now_));
+  }
+
+ protected:
+  void CreatePolicy() {
+    policy_.reset(new RestartPolicy(config_, &utils_));
+  }
+
+  // Starts the browser and has it exit |seconds| later.
+  RestartPolicy::Decision RunFor(time_t seconds) {
+    policy_->RecordStart();
+    now_ += seconds;
+    return policy_->OnExit();
+  }
+
+  time_t now_;
+  RestartPolicy::Config config_;
+  MockSystemUtils utils_;
+  scoped_ptr<RestartPolicy> policy_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RestartPolicyTest);
+};
+
+TEST_F(RestartPolicyTest, LongRunRestartsImmediately) {
+  CreatePolicy();
+  for (int i = 0; i < 10; ++i) {
+    RestartPolicy::Decision decision =
+        RunFor(config_.restart_window_seconds + 1);
+    EXPECT_FALSE(decision.give_up);
+    EXPECT_EQ(base::TimeDelta(), decision.delay);
+  }
+  EXPECT_EQ(0, policy_->degraded_level());
+}
+
+TEST_F(RestartPolicyTest, BackoffGrows) {
+  config_.restart_tries = 10;
+  config_.initial_backoff = base::TimeDelta::FromMilliseconds(500);
+  config_.max_backoff = base::TimeDelta::FromSeconds(2);
+  CreatePolicy();
+
+  EXPECT_EQ(base::TimeDelta(), RunFor(1).delay);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(500), RunFor(1).delay);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(1000), RunFor(1).delay);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(2000), RunFor(1).delay);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(2000), RunFor(1).delay);
+
+  // A long run resets the backoff.
+  EXPECT_EQ(base::TimeDelta(),
+            RunFor(config_.restart_window_seconds + 1).delay);
+  EXPECT_EQ(base::TimeDelta(), RunFor(1).delay);
+}
+
+TEST_F(RestartPolicyTest, JitterShortensDelay) {
+  config_.jitter = 0.5;
+  CreatePolicy();
+  RunFor(1);
+  base::TimeDelta delay = RunFor(1).delay;
+  EXPECT_LE(delay, config_.initial_backoff);
+  EXPECT_GE(delay, config_.initial_backoff / 2);
+}
+
+TEST_F(RestartPolicyTest, DegradedLadder) {
+  CreatePolicy();
+  EXPECT_TRUE(policy_->GetDegradedFlags().empty());
+
+  for (size_t level = 1; level <= config_.degraded_modes.size(); ++level) {
+    for (uint i = 0; i < config_.restart_tries - 1; ++i)
+      EXPECT_FALSE(RunFor(1).give_up);
+    RestartPolicy::Decision decision = RunFor(1);
+    EXPECT_FALSE(decision.give_up);
+    // Degraded relaunches aren't delayed.
+    EXPECT_EQ(base::TimeDelta(), decision.delay);
+    EXPECT_EQ(static_cast<int>(level), policy_->degraded_level());
+    EXPECT_EQ(config_.degraded_modes[level - 1], policy_->GetDegradedFlags());
+  }
+
+  for (uint i = 0; i < config_.restart_tries - 1; ++i)
+    EXPECT_FALSE(RunFor(1).give_up);
+  EXPECT_TRUE(RunFor(1).give_up);
+}
+
+TEST_F(RestartPolicyTest, LongRunStepsDownDegradedModes) {
+  CreatePolicy();
+  for (size_t level = 1; level <= config_.degraded_modes.size(); ++level) {
+    for (uint i = 0; i < config_.restart_tries; ++i)
+      RunFor(1);
+  }
+  const int top = static_cast<int>(config_.degraded_modes.size());
+  ASSERT_EQ(top, policy_->degraded_level());
+
+  // Short runs in the current mode don't count as holding up.
+  EXPECT_FALSE(RunFor(1).give_up);
+  EXPECT_EQ(top, policy_->degraded_level());
+
+  for (int level = top - 1; level >= 0; --level) {
+    EXPECT_FALSE(RunFor(config_.restart_window_seconds + 1).give_up);
+    EXPECT_EQ(level, policy_->degraded_level());
+  }
+  EXPECT_TRUE(policy_->GetDegradedFlags().empty());
+  EXPECT_FALSE(RunFor(config_.restart_window_seconds + 1).give_up);
+  EXPECT_EQ(0, policy_->degraded_level());
+}
+
+TEST_F(RestartPolicyTest, NoDegradedModes) {
+  config_.degraded_modes.clear();
+  CreatePolicy();
+  for (uint i = 0; i < config_.restart_tries - 1; ++i)
+    EXPECT_FALSE(RunFor(1).give_up);
+  EXPECT_TRUE(RunFor(1).give_up);
+}
+
+TEST_F(RestartPolicyTest, ResetKeepsDegradedMode) {
+  config_.degraded_modes.resize(1);
+  CreatePolicy();
+  for (uint i = 0; i < config_.restart_tries; ++i)
+    RunFor(1);
+  for (uint i = 0; i < config_.restart_tries; ++i)
+    RunFor(1);
+  EXPECT_EQ(1, policy_->degraded_level());
+
+  policy_->Reset();
+  EXPECT_FALSE(RunFor(1).give_up);
+  EXPECT_EQ(1, policy_->degraded_level());
+  EXPECT_FALSE(policy_->GetDegradedFlags().empty());
+}
+
+TEST_F(RestartPolicyTest, SetRestartLimit) {
+  config_.degraded_modes.clear();
+  config_.restart_tries = 4;
+  CreatePolicy();
+  EXPECT_FALSE(RunFor(1).give_up);
+  EXPECT_FALSE(RunFor(1).give_up);
+
+  // The starts already recorded count against the new limit.
+  policy_->SetRestartLimit(3, config_.restart_window_seconds);
+  EXPECT_TRUE(RunFor(1).give_up);
+
+  // Too slow to be too fast anymore.
+  policy_->SetRestartLimit(3, 1);
+  EXPECT_FALSE(RunFor(1).give_up);
+}
+
+TEST_F(RestartPolicyTest, ParseDegradedModes) {
+  std::vector<RestartPolicy::Flags> modes;
+  ASSERT_TRUE(RestartPolicy::ParseDegradedModes(
+      "--disable-webgl --disable-accelerated-video-decode;--disable-gpu",
+      &modes));
+  ASSERT_EQ(2U, modes.size());
+  ASSERT_EQ(2U, modes[0].size());
+  EXPECT_EQ("--disable-webgl", modes[0][0]);
+  EXPECT_EQ("--disable-accelerated-video-decode", modes[0][1]);
+  ASSERT_EQ(1U, modes[1].size());
+  EXPECT_EQ("--disable-gpu", modes[1][0]);
+
+  ASSERT_TRUE(RestartPolicy::ParseDegradedModes("", &modes));
+  EXPECT_TRUE(modes.empty());
+
+  EXPECT_FALSE(RestartPolicy::ParseDegradedModes("--disable-gpu;;", &modes));
+  EXPECT_FALSE(RestartPolicy::ParseDegradedModes(" ;--disable-gpu", &modes));
+}
+
+}  // namespace login_manager
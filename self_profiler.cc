@@ -0,0 +1,355 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/self_profiler.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <base/bind.h>
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/message_loop_proxy.h>
+#include <base/string_number_conversions.h>
+#include <base/string_util.h>
+#include <base/stringprintf.h>
+
+#include "login_manager/system_utils.h"
+
+namespace login_manager {
+
+namespace {
+
+// Data pages in each ring buffer; must be a power of two. At kSamplingHz,
+// this holds a few seconds of deep stacks, far more than a poll interval.
+const size_t kRingDataPages = 16;
+
+const int kPollIntervalMs = 100;
+
+const char kTaskDir[] = "/proc/self/task";
+const char kMapsPath[] = "/proc/self/maps";
+
+size_t RingSize() {
+  // One page of metadata ahead of the data.
+  return (kRingDataPages + 1) * getpagesize();
+}
+
+// Copies |size| bytes at |offset| out of the ring buffer |data| of
+// |data_size| bytes, wrapping around its end.
+void CopyFromRing(const char* data,
+                  uint64 data_size,
+                  uint64 offset,
+                  size_t size,
+                  void* out) {
+  char* dest = static_cast<char*>(out);
+  while (size > 0) {
+    const uint64 position = offset % data_size;
+    const size_t chunk =
+        std::min(static_cast<uint64>(size), data_size - position);
+    memcpy(dest, data + position, chunk);
+    dest += chunk;
+    offset += chunk;
+    size -= chunk;
+  }
+}
+
+// Pulls the user-space call stack out of a PERF_RECORD_SAMPLE |record| of
+// |size| bytes, laid out as PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN asks.
+bool ParseSample(const char* record, size_t size, std::vector<uint64>* stack) {
+  const size_t kFixedSize = sizeof(perf_event_header) + 2 * sizeof(uint64);
+  if (size < kFixedSize)
+    return false;
+  const uint64* words =
+      reinterpret_cast<const uint64*>(record + sizeof(perf_event_header));
+  const uint64 ip = words[0];
+  const uint64 depth = words[1];
+  if (depth > (size - kFixedSize) / sizeof(uint64))
+    return false;
+  for (uint64 i = 0; i < depth; ++i) {
+    // Skip the markers of where user and kernel frames start.
+    if (words[2 + i] < PERF_CONTEXT_MAX)
+      stack->push_back(words[2 + i]);
+  }
+  if (stack->empty())
+    stack->push_back(ip);
+  return true;
+}
+
+void AppendWord(uintptr_t word, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+// dl_iterate_phdr() callback that looks for the build id note of the first
+// object, which is the executable, and stores it in |data|.
+int FindBuildId(struct dl_phdr_info* info, size_t size, void* data) {
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE)
+      continue;
+    const char* note =
+        reinterpret_cast<const char*>(info->dlpi_addr + phdr.p_vaddr);
+    const char* end = note + phdr.p_memsz;
+    while (note + sizeof(ElfW(Nhdr)) <= end) {
+      const ElfW(Nhdr)* header = reinterpret_cast<const ElfW(Nhdr)*>(note);
+      const char* name = note + sizeof(*header);
+      const char* desc = name + ((header->n_namesz + 3) & ~3);
+      note = desc + ((header->n_descsz + 3) & ~3);
+      if (note > end)
+        break;
+      if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 &&
+          memcmp(name, "GNU", 4) == 0) {
+        *static_cast<std::string*>(data) =
+            StringToLowerASCII(base::HexEncode(desc, header->n_descsz));
+        return 1;
+      }
+    }
+  }
+  return 1;
+}
+
+// Reports the outcome of writing the profile at |path|.
+void LogProfileWrite(const base::FilePath& path, bool success) {
+  if (success)
+    LOG(INFO) << "Wrote profile to " << path.value();
+  else
+    LOG(ERROR) << "Failed to write profile to " << path.value();
+}
+
+}  // namespace
+
+// static
+const int SelfProfiler::kSamplingHz = 99;
+// static
+const int SelfProfiler::kMaxDurationSeconds = 60;
+
+SelfProfiler::SelfProfiler(SystemUtils* utils,
+                           const scoped_refptr<base::MessageLoopProxy>& loop,
+                           const base::FilePath& dir)
+    : system_(utils),
+      loop_proxy_(loop),
+      dir_(dir),
+      lost_samples_(0) {
+}
+
+SelfProfiler::~SelfProfiler() {
+  poll_.Cancel();
+  CloseEvents();
+}
+
+bool SelfProfiler::Start(base::TimeDelta duration,
+                         base::FilePath* profile_path) {
+  if (is_running()) {
+    LOG(WARNING) << "Already writing a profile to " << profile_path_.value();
+    return false;
+  }
+  if (duration <= base::TimeDelta() ||
+      duration > base::TimeDelta::FromSeconds(kMaxDurationSeconds)) {
+    LOG(WARNING) << "Can't profile for " << duration.InSeconds() << "s";
+    return false;
+  }
+
+  file_util::FileEnumerator tasks(base::FilePath(kTaskDir), false,
+                                  file_util::FileEnumerator::DIRECTORIES);
+  for (base::FilePath task = tasks.Next(); !task.empty(); task = tasks.Next()) {
+    int tid = 0;
+    ThreadEvent event;
+    // Threads may exit before they can be sampled; that's fine.
+    if (base::StringToInt(task.BaseName().value(), &tid) &&
+        OpenEvent(tid, &event)) {
+      events_.push_back(event);
+    }
+  }
+  if (events_.empty()) {
+    LOG(ERROR) << "Can't sample any threads";
+    return false;
+  }
+  // Enabled together, so that every thread is sampled for the same time.
+  for (size_t i = 0; i < events_.size(); ++i)
+    ioctl(events_[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+
+  base::Time::Exploded now;
+  base::Time::Now().UTCExplode(&now);
+  profile_path_ = dir_.Append(base::StringPrintf(
+      "session_manager.%04d%02d%02d-%02d%02d%02d.prof", now.year, now.month,
+      now.day_of_month, now.hour, now.minute, now.second));
+  samples_.clear();
+  lost_samples_ = 0;
+  end_ = base::TimeTicks::Now() + duration;
+  // Unretained, as the pending task is cancelled along with |poll_|.
+  poll_.Reset(base::Bind(&SelfProfiler::Poll, base::Unretained(this)));
+  loop_proxy_->PostDelayedTask(FROM_HERE, poll_.callback(),
+                               base::TimeDelta::FromMilliseconds(
+                                   kPollIntervalMs));
+  LOG(INFO) << "Profiling " << events_.size() << " threads for "
+            << duration.InSeconds() << "s";
+  *profile_path = profile_path_;
+  return true;
+}
+
+// static
+std::string SelfProfiler::EncodeProfile(const Samples& samples,
+                                        int period_us,
+                                        const std::string& maps) {
+  std::string profile;
+  // Header: count, header words, version, sampling period, padding.
+  AppendWord(0, &profile);
+  AppendWord(3, &profile);
+  AppendWord(0, &profile);
+  AppendWord(period_us, &profile);
+  AppendWord(0, &profile);
+  for (Samples::const_iterator it = samples.begin(); it != samples.end();
+       ++it) {
+    AppendWord(it->second, &profile);
+    AppendWord(it->first.size(), &profile);
+    for (size_t i = 0; i < it->first.size(); ++i)
+      AppendWord(it->first[i], &profile);
+  }
+  // Trailer: a sample of one frame that is never taken.
+  AppendWord(0, &profile);
+  AppendWord(1, &profile);
+  AppendWord(0, &profile);
+  profile.append(maps);
+  return profile;
+}
+
+// static
+std::string SelfProfiler::GetBuildId() {
+  std::string build_id;
+  dl_iterate_phdr(&FindBuildId, &build_id);
+  return build_id;
+}
+
+// static
+bool SelfProfiler::OpenEvent(int tid, ThreadEvent* event) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  // CPU time of the thread, rather than wall time, so idle threads cost
+  // nothing.
+  attr.config = PERF_COUNT_SW_TASK_CLOCK;
+  attr.freq = 1;
+  attr.sample_freq = kSamplingHz;
+  attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  const int fd = syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+  if (fd < 0) {
+    PLOG(WARNING) << "Can't sample thread " << tid;
+    return false;
+  }
+  // Keep it out of the children.
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  void* ring =
+      mmap(NULL, RingSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ring == MAP_FAILED) {
+    PLOG(WARNING) << "Can't map samples of thread " << tid;
+    close(fd);
+    return false;
+  }
+  event->fd = fd;
+  event->ring = ring;
+  return true;
+}
+
+void SelfProfiler::Drain() {
+  const uint64 page_size = getpagesize();
+  const uint64 data_size = kRingDataPages * page_size;
+  std::vector<char> record;
+  for (size_t i = 0; i < events_.size(); ++i) {
+    perf_event_mmap_page* meta =
+        static_cast<perf_event_mmap_page*>(events_[i].ring);
+    const char* data = static_cast<const char*>(events_[i].ring) + page_size;
+    const uint64 head = meta->data_head;
+    // Read the records only after the head that covers them.
+    __sync_synchronize();
+    uint64 tail = meta->data_tail;
+    while (tail + sizeof(perf_event_header) <= head) {
+      perf_event_header header;
+      CopyFromRing(data, data_size, tail, sizeof(header), &header);
+      if (header.size < sizeof(header) || tail + header.size > head) {
+        LOG(ERROR) << "Bad sample record, dropping the rest";
+        tail = head;
+        break;
+      }
+      record.resize(header.size);
+      CopyFromRing(data, data_size, tail, header.size, &record[0]);
+      tail += header.size;
+      if (header.type == PERF_RECORD_SAMPLE) {
+        std::vector<uint64> stack;
+        if (ParseSample(&record[0], record.size(), &stack))
+          ++samples_[stack];
+      } else if (header.type == PERF_RECORD_LOST &&
+                 header.size >= sizeof(header) + 2 * sizeof(uint64)) {
+        // Laid out as the id of the event, then the number lost.
+        uint64 lost;
+        memcpy(&lost, &record[sizeof(header) + sizeof(uint64)], sizeof(lost));
+        lost_samples_ += lost;
+      }
+    }
+    // Finish reading before handing the space back to the kernel.
+    __sync_synchronize();
+    meta->data_tail = tail;
+  }
+}
+
+void SelfProfiler::Poll() {
+  Drain();
+  if (base::TimeTicks::Now() >= end_) {
+    Finish();
+    return;
+  }
+  loop_proxy_->PostDelayedTask(FROM_HERE, poll_.callback(),
+                               base::TimeDelta::FromMilliseconds(
+                                   kPollIntervalMs));
+}
+
+void SelfProfiler::Finish() {
+  for (size_t i = 0; i < events_.size(); ++i)
+    ioctl(events_[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+  Drain();
+  CloseEvents();
+
+  std::string maps;
+  if (!file_util::ReadFileToString(base::FilePath(kMapsPath), &maps))
+    PLOG(WARNING) << "Can't read " << kMapsPath << ", addresses won't resolve";
+  // pprof skips lines that aren't mappings, so this is only for people.
+  const std::string build_id = GetBuildId();
+  maps.append("session_manager build id " + build_id + "\n");
+
+  int64 total = 0;
+  for (Samples::const_iterator it = samples_.begin(); it != samples_.end();
+       ++it) {
+    total += it->second;
+  }
+  LOG(INFO) << "Took " << total << " samples, lost " << lost_samples_
+            << "; build id " << build_id;
+  system_->AtomicFileWriteAsync(
+      profile_path_,
+      EncodeProfile(samples_, 1000 * 1000 / kSamplingHz, maps),
+      S_IRUSR | S_IWUSR,  // The maps give away our layout; keep it private.
+      base::Bind(&LogProfileWrite, profile_path_));
+  samples_.clear();
+}
+
+void SelfProfiler::CloseEvents() {
+  for (size_t i = 0; i < events_.size(); ++i) {
+    munmap(events_[i].ring, RingSize());
+    close(events_[i].fd);
+  }
+  events_.clear();
+}
+
+}  // namespace login_manager
@@ -0,0 +1,107 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_SELF_PROFILER_H_
+#define LOGIN_MANAGER_SELF_PROFILER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/cancelable_callback.h>
+#include <base/file_path.h>
+#include <base/memory/ref_counted.h>
+#include <base/time.h>
+
+namespace base {
+class MessageLoopProxy;
+}  // namespace base
+
+namespace login_manager {
+class SystemUtils;
+
+// Samples where the threads of this process spend their CPU time, using
+// perf_event_open(), and writes a profile that pprof reads: the legacy CPU
+// profile format of gperftools, followed by /proc/self/maps and the build id
+// of the executable, so that the addresses can be symbolized off the device.
+//
+// Holds no file descriptors and posts no tasks unless a profile is being
+// taken.
+class SelfProfiler {
+ public:
+  // Call stacks, innermost frame first, mapped to how often they were seen.
+  typedef std::map<std::vector<uint64>, int64> Samples;
+
+  // Profiles are written through |utils| into |dir|, and samples collected
+  // on |loop|.
+  SelfProfiler(SystemUtils* utils,
+               const scoped_refptr<base::MessageLoopProxy>& loop,
+               const base::FilePath& dir);
+  // Drops a profile still being taken.
+  ~SelfProfiler();
+
+  // Samples the threads that exist now for |duration|, after which the
+  // profile is written to |profile_path|. Returns false if a profile is
+  // already being taken, |duration| is out of bounds, or sampling isn't
+  // possible.
+  bool Start(base::TimeDelta duration, base::FilePath* profile_path);
+
+  bool is_running() const { return !events_.empty(); }
+
+  // Returns |samples|, taken every |period_us| microseconds, in the legacy
+  // pprof format, followed by |maps|.
+  static std::string EncodeProfile(const Samples& samples,
+                                   int period_us,
+                                   const std::string& maps);
+
+  // Returns the GNU build id of the running executable in hex, or an empty
+  // string if it has none.
+  static std::string GetBuildId();
+
+  // How often each thread is sampled while it is on a CPU.
+  static const int kSamplingHz;
+  // Longest profile that can be taken.
+  static const int kMaxDurationSeconds;
+
+ private:
+  // A sampling event on one thread, and its ring buffer.
+  struct ThreadEvent {
+    int fd;
+    void* ring;
+  };
+
+  // Opens and maps a disabled sampling event on thread |tid|.
+  static bool OpenEvent(int tid, ThreadEvent* event);
+
+  // Moves the samples in the ring buffers into |samples_|.
+  void Drain();
+
+  // Drains the ring buffers before they fill up, and finishes at the end.
+  void Poll();
+
+  // Stops sampling and writes the profile.
+  void Finish();
+
+  // Closes the events, dropping whatever is left in their ring buffers.
+  void CloseEvents();
+
+  SystemUtils* system_;  // Owned by the caller.
+  scoped_refptr<base::MessageLoopProxy> loop_proxy_;
+  const base::FilePath dir_;
+
+  // State of the profile being taken.
+  std::vector<ThreadEvent> events_;
+  Samples samples_;
+  int64 lost_samples_;
+  base::FilePath profile_path_;
+  base::TimeTicks end_;
+  base::CancelableClosure poll_;
+
+  DISALLOW_COPY_AND_ASSIGN(SelfProfiler);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_SELF_PROFILER_H_
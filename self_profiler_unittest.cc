@@ -0,0 +1,118 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/self_profiler.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/logging.h>
+#include <base/message_loop.h>
+#include <base/message_loop_proxy.h>
+#include <base/run_loop.h>
+#include <base/time.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_system_utils.h"
+
+using ::testing::DoAll;
+using ::testing::InvokeWithoutArgs;
+using ::testing::SaveArg;
+using ::testing::_;
+
+namespace login_manager {
+
+class SelfProfilerTest : public ::testing::Test {
+ public:
+  SelfProfilerTest()
+      : profiler_(&utils_, base::MessageLoopProxy::current(),
+                  base::FilePath("/var/log/ui")) {
+  }
+  virtual ~SelfProfilerTest() {}
+
+ protected:
+  // Returns the |index|th word of |profile|.
+  static uintptr_t Word(const std::string& profile, size_t index) {
+    uintptr_t word = 0;
+    memcpy(&word, profile.data() + index * sizeof(word), sizeof(word));
+    return word;
+  }
+
+  MessageLoop loop_;
+  MockSystemUtils utils_;
+  SelfProfiler profiler_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SelfProfilerTest);
+};
+
+TEST_F(SelfProfilerTest, EncodeProfile) {
+  SelfProfiler::Samples samples;
+  std::vector<uint64> stack;
+  stack.push_back(0x1234);
+  stack.push_back(0x5678);
+  samples[stack] = 7;
+  const std::string maps = "00400000-0048a000 r-xp 00000000 fd:03 1 /x\n";
+
+  const std::string profile =
+      SelfProfiler::EncodeProfile(samples, 10101, maps);
+  ASSERT_EQ(12 * sizeof(uintptr_t) + maps.size(), profile.size());
+  EXPECT_EQ(0U, Word(profile, 0));
+  EXPECT_EQ(3U, Word(profile, 1));
+  EXPECT_EQ(10101U, Word(profile, 3));
+  EXPECT_EQ(7U, Word(profile, 5));
+  EXPECT_EQ(2U, Word(profile, 6));
+  EXPECT_EQ(0x1234U, Word(profile, 7));
+  EXPECT_EQ(0x5678U, Word(profile, 8));
+  EXPECT_EQ(1U, Word(profile, 10));
+  EXPECT_EQ(maps, profile.substr(12 * sizeof(uintptr_t)));
+}
+
+TEST_F(SelfProfilerTest, BadDuration) {
+  base::FilePath path;
+  EXPECT_FALSE(profiler_.Start(base::TimeDelta(), &path));
+  EXPECT_FALSE(profiler_.Start(
+      base::TimeDelta::FromSeconds(SelfProfiler::kMaxDurationSeconds + 1),
+      &path));
+  EXPECT_FALSE(profiler_.is_running());
+}
+
+TEST_F(SelfProfilerTest, Profile) {
+  base::FilePath path;
+  if (!profiler_.Start(base::TimeDelta::FromMilliseconds(200), &path)) {
+    LOG(WARNING) << "perf events unavailable, skipping";
+    return;
+  }
+  EXPECT_TRUE(profiler_.is_running());
+  EXPECT_FALSE(profiler_.Start(base::TimeDelta::FromSeconds(1), &path));
+
+  // Keep a CPU busy so that there is something to sample.
+  const base::TimeTicks end =
+      base::TimeTicks::Now() + base::TimeDelta::FromMilliseconds(300);
+  while (base::TimeTicks::Now() < end) {
+  }
+
+  std::string profile;
+  base::RunLoop run_loop;
+  EXPECT_CALL(utils_,
+              AtomicFileWriteAsync(path, _,
+                                   static_cast<mode_t>(S_IRUSR | S_IWUSR), _))
+      .WillOnce(DoAll(SaveArg<1>(&profile),
+                      InvokeWithoutArgs(&run_loop, &base::RunLoop::Quit)));
+  run_loop.Run();
+
+  EXPECT_FALSE(profiler_.is_running());
+  ASSERT_GT(profile.size(), 8 * sizeof(uintptr_t));
+  EXPECT_EQ(3U, Word(profile, 1));
+  // Samples come before the trailer.
+  EXPECT_NE(0U, Word(profile, 5));
+  EXPECT_NE(std::string::npos, profile.find("session_manager build id"));
+}
+
+}  // namespace login_manager
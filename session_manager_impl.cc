@@ -4,6 +4,8 @@
 
 #include "login_manager/session_manager_impl.h"
 
+#include <sys/stat.h>
+
 #include <string>
 
 #include <base/basictypes.h>
@@ -14,6 +16,7 @@
 #include <base/memory/scoped_ptr.h>
 #include <base/message_loop_proxy.h>
 #include <base/stl_util.h>
+#include <base/string_number_conversions.h>
 #include <base/string_util.h>
 #include <chromeos/cryptohome.h>
 #include <chromeos/utility.h>
@@ -21,18 +24,26 @@
 #include <dbus/dbus-glib-bindings.h>
 #include <dbus/dbus-glib.h>
 
+#include "login_manager/chrome_device_policy.pb.h"
 #include "login_manager/device_local_account_policy_service.h"
 #include "login_manager/device_management_backend.pb.h"
 #include "login_manager/device_policy_service.h"
+#include "login_manager/device_settings_snapshot.h"
+#include "login_manager/device_settings_snapshot_builder.h"
 #include "login_manager/login_metrics.h"
 #include "login_manager/nss_util.h"
+#include "login_manager/per_boot_state.h"
 #include "login_manager/policy_key.h"
 #include "login_manager/policy_service.h"
 #include "login_manager/process_manager_service_interface.h"
+#include "login_manager/signal_coalescer.h"
 #include "login_manager/system_utils.h"
+#include "login_manager/tunables.h"
 #include "login_manager/upstart_signal_emitter.h"
 #include "login_manager/user_policy_service_factory.h"
 
+namespace em = enterprise_management;
+
 using base::FilePath;
 using chromeos::cryptohome::home::kGuestUserName;
 using chromeos::cryptohome::home::GetUserPath;
@@ -51,6 +62,9 @@ const char SessionManagerImpl::kLoggedInFlag[] =
 const char SessionManagerImpl::kResetFile[] =
     "/mnt/stateful_partition/factory_install_reset";
 
+const char SessionManagerImpl::kDeviceSettingsChangedSignal[] =
+    "DeviceSettingsChanged";
+
 namespace {
 
 const size_t kCookieEntropyBytes = 16;
@@ -75,6 +89,29 @@ const char kDeviceOwnerPref[] = "cros.device.owner";
 // The flag to pass to chrome to open a named socket for testing.
 const char kTestingChannelFlag[] = "--testing-channel=NamedTestingInterface:";
 
+// Time from a browser crash with the screen locked until the restarted
+// browser shows the lock screen again.
+const char kLockedRecoveryMetric[] = "Login.LockedRecoveryTime";
+const int kLockedRecoveryMetricMaxMs = 60 * 1000;
+const int kLockedRecoveryMetricBuckets = 50;
+
+// Proportional set size of the session_manager after trimming, in KB.
+const char kTrimmedPssMetric[] = "Login.SessionManagerPss";
+const int kTrimmedPssMetricMaxKb = 256 * 1024;
+const int kTrimmedPssMetricBuckets = 50;
+
+// Reports the outcome of writing kLoggedInFlag.
+void LogFlagWrite(bool success) {
+  LOG_IF(ERROR, !success) << "Failed to write "
+                          << SessionManagerImpl::kLoggedInFlag;
+}
+
+// Reports the outcome of publishing a device settings snapshot.
+void LogSnapshotWrite(bool success) {
+  LOG_IF(ERROR, !success) << "Failed to write "
+                          << DeviceSettingsSnapshot::kPath;
+}
+
 }  // namespace
 
 // PolicyService::Completion implementation that forwards the result to a DBus
@@ -145,15 +182,19 @@ SessionManagerImpl::SessionManagerImpl(
     ProcessManagerServiceInterface* manager,
     LoginMetrics* metrics,
     NssUtil* nss,
+    PerBootState* per_boot_state,
     SystemUtils* utils)
     : session_started_(false),
       session_stopping_(false),
       screen_locked_(false),
+      recovering_lock_(false),
       upstart_signal_emitter_(emitter.Pass()),
       manager_(manager),
       login_metrics_(metrics),
       nss_(nss),
-      system_(utils) {
+      per_boot_state_(per_boot_state),
+      system_(utils),
+      tunables_(NULL) {
   // TODO(ellyjones): http://crosbug.com/6615
   // The intent was to use this cookie to authenticate RPC requests from the
   // browser process kicked off by the session_manager.  This didn't actually
@@ -178,6 +219,15 @@ void SessionManagerImpl::InjectPolicyServices(
   device_local_account_policy_ = device_local_account_policy.Pass();
 }
 
+void SessionManagerImpl::InjectSignalCoalescer(
+    scoped_ptr<SignalCoalescer> coalescer) {
+  signal_coalescer_ = coalescer.Pass();
+}
+
+void SessionManagerImpl::InjectProfiler(scoped_ptr<SelfProfiler> profiler) {
+  profiler_ = profiler.Pass();
+}
+
 void SessionManagerImpl::AnnounceSessionStoppingIfNeeded() {
   if (session_started_) {
     session_stopping_ = true;
@@ -203,6 +253,7 @@ bool SessionManagerImpl::Initialize() {
   if (device_policy_->Initialize()) {
     device_local_account_policy_->UpdateDeviceSettings(
         device_policy_->GetSettings());
+    PublishSettingsSnapshot();
     return true;
   }
   return false;
@@ -210,11 +261,22 @@ bool SessionManagerImpl::Initialize() {
 
 void SessionManagerImpl::Finalize() {
   device_policy_->PersistPolicySync();
+  LOG(INFO) << "Device policy: " << device_policy_->stats()->ToString();
   for (UserSessionMap::const_iterator it = user_sessions_.begin();
        it != user_sessions_.end(); ++it) {
-    if (it->second)
-      it->second->policy_service->PersistPolicySync();
+    if (!it->second)
+      continue;
+    const PolicyService::PersistStats& stats =
+        it->second->policy_service->persist_stats();
+    LOG(INFO) << "Policy writes for " << it->second->userhash << ": "
+              << stats.completed << " done, " << stats.queue_depth
+              << " queued, last took " << stats.last_latency.InMilliseconds()
+              << "ms, slowest took " << stats.max_latency.InMilliseconds()
+              << "ms; " << it->second->policy_service->stats()->ToString();
+    it->second->policy_service->PersistPolicySync();
   }
+  if (signal_coalescer_.get())
+    signal_coalescer_->Flush();
 }
 
 gboolean SessionManagerImpl::EmitLoginPromptReady(gboolean* OUT_emitted,
@@ -238,6 +300,8 @@ gboolean SessionManagerImpl::EnableChromeTesting(gboolean force_relaunch,
                                                  const gchar** extra_args,
                                                  gchar** OUT_filepath,
                                                  GError** error) {
+  if (RefuseDuringLockedRecovery("EnableChromeTesting", error))
+    return FALSE;
   // Check to see if we already have Chrome testing enabled.
   bool already_enabled = !chrome_testing_path_.empty();
 
@@ -275,6 +339,8 @@ gboolean SessionManagerImpl::StartSession(gchar* email_address,
                                           gchar* unique_identifier,
                                           gboolean* OUT_done,
                                           GError** error) {
+  if (RefuseDuringLockedRecovery("StartSession", error))
+    return *OUT_done = FALSE;
   // Validate the |email_address|.
   const std::string email_string(
       StringToLowerASCII(GCharToString(email_address)));
@@ -303,10 +369,12 @@ gboolean SessionManagerImpl::StartSession(gchar* email_address,
     return *OUT_done = FALSE;
 
   // Check whether the current user is the owner, and if so make sure she is
-  // whitelisted and has an owner key.
+  // whitelisted and has an owner key. Incognito users can't own the device,
+  // and have no key database to search anyway.
   bool user_is_owner = false;
   PolicyService::Error policy_error;
-  if (!device_policy_->CheckAndHandleOwnerLogin(user_session->username,
+  if (!is_incognito &&
+      !device_policy_->CheckAndHandleOwnerLogin(user_session->username,
                                                 user_session->slot.get(),
                                                 &user_is_owner,
                                                 &policy_error)) {
@@ -349,7 +417,13 @@ gboolean SessionManagerImpl::StartSession(gchar* email_address,
     }
 
     // Record that a login has successfully completed on this boot.
-    system_->AtomicFileWrite(FilePath(kLoggedInFlag), "1", 1);
+    if (!per_boot_state_->IsSet(PerBootState::LOGGED_IN)) {
+      // Nobody waits for this, so keep it off the login path.
+      system_->AtomicFileWriteAsync(FilePath(kLoggedInFlag), "1",
+                                    S_IRUSR | S_IWUSR | S_IROTH,
+                                    base::Bind(&LogFlagWrite));
+      per_boot_state_->Set(PerBootState::LOGGED_IN);
+    }
   }
 
   return *OUT_done;
@@ -478,6 +552,219 @@ GHashTable* SessionManagerImpl::RetrieveActiveSessions() {
   return to_return;
 }
 
+gboolean SessionManagerImpl::RetrievePolicyStats(gchar** OUT_stats) {
+  std::string stats = "device: " + device_policy_->stats()->ToString() + "\n";
+  for (UserSessionMap::const_iterator it = user_sessions_.begin();
+       it != user_sessions_.end(); ++it) {
+    if (!it->second)
+      continue;
+    stats += "user " + it->second->userhash + ": " +
+        it->second->policy_service->stats()->ToString() + "\n";
+  }
+  device_local_account_policy_->AppendStats(&stats);
+  *OUT_stats = g_strdup(stats.c_str());
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::GetDeviceSettingValues(const gchar** field_paths,
+                                                    GHashTable** OUT_values,
+                                                    GError** error) {
+  const em::ChromeDeviceSettingsProto& settings = device_policy_->GetSettings();
+  GHashTable* values =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  for (; *field_paths; ++field_paths) {
+    const std::string path(GCharToString(*field_paths));
+    if (!DeviceSettingsWatcher::IsKnownField(path)) {
+      const std::string msg = "Unknown device setting " + path;
+      LOG(ERROR) << msg;
+      SetDBusGError(error, DBUS_GERROR_INVALID_ARGS, msg.c_str());
+      g_hash_table_unref(values);
+      return FALSE;
+    }
+    std::string value;
+    if (DeviceSettingsWatcher::GetFieldValue(settings, path, &value)) {
+      g_hash_table_insert(values, g_strdup(path.c_str()),
+                          g_strdup(value.c_str()));
+    }
+  }
+  *OUT_values = values;
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::WatchDeviceSettings(
+    const gchar** field_paths,
+    DBusGMethodInvocation* context) {
+  gchar* sender = dbus_g_method_get_sender(context);
+  guint watch_id = 0;
+  GError* error = NULL;
+  const gboolean success = AddDeviceSettingsWatch(GCharToString(sender),
+                                                  field_paths,
+                                                  &watch_id,
+                                                  &error);
+  g_free(sender);
+  if (!success) {
+    dbus_g_method_return_error(context, error);
+    g_error_free(error);
+    return FALSE;
+  }
+  dbus_g_method_return(context, watch_id);
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::AddDeviceSettingsWatch(const std::string& owner,
+                                                    const gchar** field_paths,
+                                                    guint* OUT_watch_id,
+                                                    GError** error) {
+  std::vector<std::string> paths;
+  for (; *field_paths; ++field_paths) {
+    const std::string path(GCharToString(*field_paths));
+    if (!DeviceSettingsWatcher::IsKnownField(path)) {
+      const std::string msg = "Unknown device setting " + path;
+      LOG(ERROR) << msg;
+      SetDBusGError(error, DBUS_GERROR_INVALID_ARGS, msg.c_str());
+      return FALSE;
+    }
+    paths.push_back(path);
+  }
+  // With the paths vetted, this can only fail for lack of room.
+  const int id =
+      settings_watcher_.AddWatch(owner, paths, device_policy_->GetSettings());
+  if (!id) {
+    const char msg[] = "Too many device settings watches.";
+    LOG(ERROR) << msg;
+    SetDBusGError(error, DBUS_GERROR_LIMITS_EXCEEDED, msg);
+    return FALSE;
+  }
+  *OUT_watch_id = id;
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::UnwatchDeviceSettings(
+    guint watch_id,
+    DBusGMethodInvocation* context) {
+  gchar* sender = dbus_g_method_get_sender(context);
+  GError* error = NULL;
+  const gboolean success = RemoveDeviceSettingsWatch(GCharToString(sender),
+                                                     watch_id,
+                                                     &error);
+  g_free(sender);
+  if (!success) {
+    dbus_g_method_return_error(context, error);
+    g_error_free(error);
+    return FALSE;
+  }
+  dbus_g_method_return(context);
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::RemoveDeviceSettingsWatch(
+    const std::string& owner,
+    guint watch_id,
+    GError** error) {
+  std::string watch_owner;
+  if (!settings_watcher_.GetOwner(watch_id, &watch_owner)) {
+    const char msg[] = "No such device settings watch.";
+    LOG(ERROR) << msg;
+    SetDBusGError(error, DBUS_GERROR_INVALID_ARGS, msg);
+    return FALSE;
+  }
+  if (watch_owner != owner) {
+    const char msg[] = "Device settings watch belongs to another client.";
+    LOG(ERROR) << msg << " " << owner << " tried to remove one of "
+               << watch_owner << "'s.";
+    SetDBusGError(error, DBUS_GERROR_ACCESS_DENIED, msg);
+    return FALSE;
+  }
+  settings_watcher_.RemoveWatch(watch_id);
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::GetTunables(GHashTable** OUT_values,
+                                         GError** error) {
+  GHashTable* values =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (tunables_) {
+    const std::map<std::string, std::string> tunables = tunables_->GetValues();
+    for (std::map<std::string, std::string>::const_iterator it =
+             tunables.begin();
+         it != tunables.end(); ++it) {
+      g_hash_table_insert(values, g_strdup(it->first.c_str()),
+                          g_strdup(it->second.c_str()));
+    }
+  }
+  *OUT_values = values;
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::GetMemoryStats(GHashTable** OUT_values,
+                                            GError** error) {
+  MemoryStats::Values stats;
+  CollectMemoryStats(&stats);
+  GHashTable* values =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  for (MemoryStats::Values::const_iterator it = stats.begin();
+       it != stats.end(); ++it) {
+    g_hash_table_insert(values, g_strdup(it->first.c_str()),
+                        g_strdup(base::Int64ToString(it->second).c_str()));
+  }
+  *OUT_values = values;
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::StartProfiling(gint duration_seconds,
+                                            gchar** OUT_profile_path,
+                                            GError** error) {
+  base::FilePath profile_path;
+  if (!profiler_.get() ||
+      !profiler_->Start(base::TimeDelta::FromSeconds(duration_seconds),
+                        &profile_path)) {
+    const char msg[] = "Can't start profiling.";
+    LOG(ERROR) << msg;
+    SetGError(error, CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, msg);
+    return FALSE;
+  }
+  *OUT_profile_path = g_strdup(profile_path.value().c_str());
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::SetTunable(gchar* name,
+                                        gint64 value,
+                                        GError** error) {
+  // Only for tuning test and developer devices, not for use in the field.
+  if (system_->IsDevMode() != 1) {
+    const char msg[] = "Tunables can only be set in developer mode.";
+    LOG(ERROR) << msg;
+    SetGError(error, CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, msg);
+    return FALSE;
+  }
+  const std::string name_string(GCharToString(name));
+  if (!tunables_ || !tunables_->Set(name_string, Tunables::OVERRIDE, value)) {
+    const std::string msg = "Can't set tunable " + name_string + " to " +
+        base::Int64ToString(value);
+    LOG(ERROR) << msg;
+    SetGError(error, CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg.c_str());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean SessionManagerImpl::ReloadTunables(GError** error) {
+  if (!tunables_) {
+    const char msg[] = "There are no tunables.";
+    LOG(ERROR) << msg;
+    SetGError(error, CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, msg);
+    return FALSE;
+  }
+  if (!tunables_->ReloadConfigFile()) {
+    const std::string msg =
+        std::string("Some of ") + Tunables::kConfigFile + " was ignored.";
+    LOG(ERROR) << msg;
+    SetGError(error, CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg.c_str());
+    return FALSE;
+  }
+  return TRUE;
+}
+
 gboolean SessionManagerImpl::LockScreen(GError** error) {
   if (!session_started_) {
     LOG(WARNING) << "Attempt to lock screen outside of user session.";
@@ -498,11 +785,26 @@ gboolean SessionManagerImpl::LockScreen(GError** error) {
 
 gboolean SessionManagerImpl::HandleLockScreenShown(GError** error) {
   LOG(INFO) << "HandleLockScreenShown() method called.";
+  if (recovering_lock_) {
+    recovering_lock_ = false;
+    const base::TimeDelta elapsed =
+        base::TimeTicks::Now() - lock_recovery_start_;
+    LOG(INFO) << "Recovered into the lock screen in "
+              << elapsed.InMilliseconds() << "ms";
+    login_metrics_->SendHistogram(kLockedRecoveryMetric,
+                                  elapsed.InMilliseconds(), 1,
+                                  kLockedRecoveryMetricMaxMs,
+                                  kLockedRecoveryMetricBuckets);
+  }
   system_->EmitSignal(login_manager::kScreenIsLockedSignal);
   return TRUE;
 }
 
 gboolean SessionManagerImpl::HandleLockScreenDismissed(GError** error) {
+  // The browser that was locked is gone; only the lock screen of the new one
+  // may unlock the session.
+  if (RefuseDuringLockedRecovery("HandleLockScreenDismissed", error))
+    return FALSE;
   screen_locked_ = false;
   LOG(INFO) << "HandleLockScreenDismissed() method called.";
   system_->EmitSignal(login_manager::kScreenIsUnlockedSignal);
@@ -513,6 +815,8 @@ gboolean SessionManagerImpl::RestartJob(gint pid,
                                         gchar* arguments,
                                         gboolean* OUT_done,
                                         GError** error) {
+  if (RefuseDuringLockedRecovery("RestartJob", error))
+    return *OUT_done = FALSE;
   if (!manager_->IsBrowser(static_cast<pid_t>(pid))) {
     *OUT_done = FALSE;
     const char msg[] = "Provided pid is unknown.";
@@ -561,8 +865,10 @@ gboolean SessionManagerImpl::RestartJobWithAuth(gint pid,
 
 gboolean SessionManagerImpl::StartDeviceWipe(gboolean* OUT_done,
                                              GError** error) {
-  const FilePath session_path(kLoggedInFlag);
-  if (system_->Exists(session_path)) {
+  // The per-boot record forgets logins across session_manager restarts if it
+  // couldn't be mapped, so the flag file written at login is checked too.
+  if (per_boot_state_->IsSet(PerBootState::LOGGED_IN) ||
+      system_->Exists(FilePath(kLoggedInFlag))) {
     const char msg[] = "A user has already logged in this boot.";
     LOG(ERROR) << msg;
     SetGError(error, CHROMEOS_LOGIN_ERROR_ALREADY_SESSION, msg);
@@ -589,14 +895,42 @@ gboolean SessionManagerImpl::SetFlagsForUser(gchar* user_email,
 }
 
 void SessionManagerImpl::OnPolicyPersisted(bool success) {
-  system_->EmitStatusSignal(login_manager::kPropertyChangeCompleteSignal,
-                            success);
-  device_local_account_policy_->UpdateDeviceSettings(
-      device_policy_->GetSettings());
+  EmitDeviceStatusSignal(login_manager::kPropertyChangeCompleteSignal,
+                         success);
+  const em::ChromeDeviceSettingsProto& settings = device_policy_->GetSettings();
+  device_local_account_policy_->UpdateDeviceSettings(settings);
+  PublishSettingsSnapshot();
+
+  const DeviceSettingsWatcher::Changes changes =
+      settings_watcher_.Update(settings);
+  for (DeviceSettingsWatcher::Changes::const_iterator it = changes.begin();
+       it != changes.end(); ++it) {
+    std::vector<std::string> args;
+    args.push_back(base::IntToString(it->first));
+    args.push_back(JoinString(it->second, ','));
+    system_->EmitSignalWithStringArgs(kDeviceSettingsChangedSignal, args);
+  }
+}
+
+void SessionManagerImpl::CollectMemoryStats(MemoryStats::Values* values) {
+  MemoryStats::Collect(values);
+  (*values)["user_sessions"] = user_sessions_.size();
+  (*values)["device_settings_watches"] = settings_watcher_.watch_count();
+  (*values)["device_local_account_policies"] =
+      device_local_account_policy_.get() ?
+          device_local_account_policy_->LoadedServiceCount() : 0;
+}
+
+void SessionManagerImpl::PublishSettingsSnapshot() {
+  system_->AtomicFileWriteAsync(
+      FilePath(DeviceSettingsSnapshot::kPath),
+      BuildDeviceSettingsSnapshot(device_policy_->GetSettings()),
+      S_IRUSR | S_IWUSR | S_IROTH,
+      base::Bind(&LogSnapshotWrite));
 }
 
 void SessionManagerImpl::OnKeyPersisted(bool success) {
-  system_->EmitStatusSignal(login_manager::kOwnerKeySetSignal, success);
+  EmitDeviceStatusSignal(login_manager::kOwnerKeySetSignal, success);
 }
 
 void SessionManagerImpl::ImportValidateAndStoreGeneratedKey(
@@ -612,6 +946,38 @@ void SessionManagerImpl::ImportValidateAndStoreGeneratedKey(
       user_sessions_[username]->slot.get());
 }
 
+void SessionManagerImpl::StartLockedRecovery() {
+  DCHECK(screen_locked_);
+  LOG(WARNING) << "Restarting the browser into the lock screen.";
+  recovering_lock_ = true;
+  lock_recovery_start_ = base::TimeTicks::Now();
+}
+
+void SessionManagerImpl::TrimMemory() {
+  const int dropped = device_local_account_policy_.get() ?
+      device_local_account_policy_->DropIdleServices() : 0;
+  const int64 trimmed = MemoryStats::TrimHeap();
+  MemoryStats::Values values;
+  CollectMemoryStats(&values);
+  LOG(INFO) << "Dropped " << dropped << " device-local account policies and "
+            << trimmed << " bytes of heap";
+  MemoryStats::Values::const_iterator pss = values.find("pss_kb");
+  if (pss != values.end()) {
+    LOG(INFO) << "PSS is now " << pss->second << "KB";
+    login_metrics_->SendHistogram(kTrimmedPssMetric, pss->second, 1,
+                                  kTrimmedPssMetricMaxKb,
+                                  kTrimmedPssMetricBuckets);
+  }
+}
+
+void SessionManagerImpl::OnNameLost(const std::string& name) {
+  const int dropped = settings_watcher_.RemoveWatchesOf(name);
+  if (dropped) {
+    LOG(INFO) << "Dropped " << dropped << " device settings watches of "
+              << name;
+  }
+}
+
 void SessionManagerImpl::InitiateDeviceWipe() {
   const char *contents = "fast safe";
   const FilePath reset_path(kResetFile);
@@ -658,6 +1024,13 @@ void SessionManagerImpl::SetGError(GError** error,
   g_set_error(error, CHROMEOS_LOGIN_ERROR, code, "Login error: %s", message);
 }
 
+// static
+void SessionManagerImpl::SetDBusGError(GError** error,
+                                       DBusGError code,
+                                       const char* message) {
+  g_set_error(error, DBUS_GERROR, code, "%s", message);
+}
+
 // static
 bool SessionManagerImpl::ValidateEmail(const std::string& email_address) {
   if (email_address.find_first_not_of(kLegalCharacters) != std::string::npos)
@@ -686,6 +1059,17 @@ bool SessionManagerImpl::AllSessionsAreIncognito() {
   return incognito_count == user_sessions_.size();
 }
 
+bool SessionManagerImpl::RefuseDuringLockedRecovery(const char* method,
+                                                    GError** error) {
+  if (!recovering_lock_)
+    return false;
+  const std::string msg =
+      std::string(method) + " refused until the lock screen is shown.";
+  LOG(ERROR) << msg;
+  SetGError(error, CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, msg.c_str());
+  return true;
+}
+
 bool SessionManagerImpl::IsValidCookie(const char *cookie) {
   size_t len = strlen(cookie) < cookie_.size()
              ? strlen(cookie)
@@ -697,8 +1081,11 @@ SessionManagerImpl::UserSession*
 SessionManagerImpl::CreateUserSession(const std::string& username,
                                       bool is_incognito,
                                       GError** error) {
+  // Incognito sessions keep nothing, so they get their policy in memory and no
+  // NSS database, which spares the guest login path a round of disk I/O.
   scoped_refptr<PolicyService> user_policy =
-      user_policy_factory_->Create(username);
+      is_incognito ? user_policy_factory_->CreateEphemeral(username)
+                   : user_policy_factory_->Create(username);
   if (!user_policy) {
     const char msg[] = "User policy failed to initialize.";
     LOG(ERROR) << msg;
@@ -706,6 +1093,13 @@ SessionManagerImpl::CreateUserSession(const std::string& username,
       SetGError(error, CHROMEOS_LOGIN_ERROR_POLICY_INIT_FAIL, msg);
     return NULL;
   }
+  if (is_incognito) {
+    return new SessionManagerImpl::UserSession(username,
+                                               SanitizeUserName(username),
+                                               is_incognito,
+                                               crypto::ScopedPK11Slot(),
+                                               user_policy);
+  }
   crypto::ScopedPK11Slot slot(nss_->OpenUserDB(GetUserPath(username)));
   if (!slot) {
     const char msg[] = "Could not open the current user's NSS database.";
@@ -728,4 +1122,14 @@ scoped_refptr<PolicyService> SessionManagerImpl::GetPolicyService(
   return it == user_sessions_.end() ? NULL : it->second->policy_service;
 }
 
+void SessionManagerImpl::EmitDeviceStatusSignal(const char* signal_name,
+                                                bool status) {
+  if (signal_coalescer_.get()) {
+    signal_coalescer_->EmitStatusSignal(
+        signal_name, status, PolicyStats::KindName(PolicyStats::DEVICE));
+  } else {
+    system_->EmitStatusSignal(signal_name, status);
+  }
+}
+
 }  // namespace login_manage
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 
 #include <base/basictypes.h>
+#include <base/time.h>
 #include <chromeos/dbus/dbus.h>
 #include <chromeos/dbus/error_constants.h>
 #include <chromeos/glib/object.h>
@@ -18,6 +19,9 @@
 #include <glib-object.h>
 
 #include "login_manager/device_policy_service.h"
+#include "login_manager/device_settings_watcher.h"
+#include "login_manager/memory_stats.h"
+#include "login_manager/self_profiler.h"
 #include "login_manager/policy_service.h"
 #include "login_manager/session_manager_interface.h"
 
@@ -25,9 +29,12 @@ namespace login_manager {
 class DeviceLocalAccountPolicyService;
 class LoginMetrics;
 class NssUtil;
+class PerBootState;
 class PolicyKey;
 class ProcessManagerServiceInterface;
+class SignalCoalescer;
 class SystemUtils;
+class Tunables;
 class UpstartSignalEmitter;
 class UserPolicyServiceFactory;
 
@@ -41,6 +48,7 @@ class SessionManagerImpl : public SessionManagerInterface,
                      ProcessManagerServiceInterface* manager,
                      LoginMetrics* metrics,
                      NssUtil* nss,
+                     PerBootState* per_boot_state,
                      SystemUtils* utils);
   virtual ~SessionManagerImpl();
 
@@ -49,12 +57,28 @@ class SessionManagerImpl : public SessionManagerInterface,
       scoped_ptr<UserPolicyServiceFactory> user_policy_factory,
       scoped_ptr<DeviceLocalAccountPolicyService> device_local_account_policy);
 
+  // Makes policy and key status signals go out through |coalescer|. Without
+  // one, they go out right away.
+  void InjectSignalCoalescer(scoped_ptr<SignalCoalescer> coalescer);
+
+  // |tunables| is owned by the caller, and may be NULL, in which case there
+  // are no tunables to get or set.
+  void set_tunables(Tunables* tunables) { tunables_ = tunables; }
+
+  // Lets StartProfiling() take profiles with |profiler|. Without one, it
+  // fails.
+  void InjectProfiler(scoped_ptr<SelfProfiler> profiler);
+
   // SessionManagerInterface implementation.
   void AnnounceSessionStoppingIfNeeded() OVERRIDE;
   void AnnounceSessionStopped() OVERRIDE;
   void ImportValidateAndStoreGeneratedKey(const std::string& username,
                                           const base::FilePath& temp_key_file);
   bool ScreenIsLocked() OVERRIDE { return screen_locked_; }
+  void StartLockedRecovery() OVERRIDE;
+  bool IsRecoveringLock() OVERRIDE { return recovering_lock_; }
+  void TrimMemory() OVERRIDE;
+  void OnNameLost(const std::string& name) OVERRIDE;
   // Should set up policy stuff; if false DIE.
   bool Initialize() OVERRIDE;
   void Finalize() OVERRIDE;
@@ -99,6 +123,31 @@ class SessionManagerImpl : public SessionManagerInterface,
 
   gboolean RetrieveSessionState(gchar** OUT_state) OVERRIDE;
   GHashTable* RetrieveActiveSessions() OVERRIDE;
+  gboolean RetrievePolicyStats(gchar** OUT_stats) OVERRIDE;
+  gboolean GetDeviceSettingValues(const gchar** field_paths,
+                                  GHashTable** OUT_values,
+                                  GError** error) OVERRIDE;
+  gboolean WatchDeviceSettings(const gchar** field_paths,
+                               DBusGMethodInvocation* context) OVERRIDE;
+  gboolean UnwatchDeviceSettings(guint watch_id,
+                                 DBusGMethodInvocation* context) OVERRIDE;
+
+  // Does the work of WatchDeviceSettings() for the bus name |owner|.
+  gboolean AddDeviceSettingsWatch(const std::string& owner,
+                                  const gchar** field_paths,
+                                  guint* OUT_watch_id,
+                                  GError** error);
+  // Does the work of UnwatchDeviceSettings() for the bus name |owner|.
+  gboolean RemoveDeviceSettingsWatch(const std::string& owner,
+                                     guint watch_id,
+                                     GError** error);
+  gboolean GetTunables(GHashTable** OUT_values, GError** error) OVERRIDE;
+  gboolean SetTunable(gchar* name, gint64 value, GError** error) OVERRIDE;
+  gboolean ReloadTunables(GError** error) OVERRIDE;
+  gboolean GetMemoryStats(GHashTable** OUT_values, GError** error) OVERRIDE;
+  gboolean StartProfiling(gint duration_seconds,
+                          gchar** OUT_profile_path,
+                          GError** error) OVERRIDE;
 
   gboolean LockScreen(GError** error) OVERRIDE;
   gboolean HandleLockScreenShown(GError** error) OVERRIDE;
@@ -134,11 +183,16 @@ class SessionManagerImpl : public SessionManagerInterface,
   static const char kStopped[];
 
   // Path to flag file indicating that a user has logged in since last boot.
+  // Kept for the benefit of external tools; session_manager itself tracks
+  // this in PerBootState.
   static const char kLoggedInFlag[];
 
   // Path to magic file that will trigger device wiping on next boot.
   static const char kResetFile[];
 
+  // Emitted when watched device settings change, see WatchDeviceSettings().
+  static const char kDeviceSettingsChangedSignal[];
+
  private:
   // Holds the state related to one of the signed in users.
   struct UserSession;
@@ -168,6 +222,10 @@ class SessionManagerImpl : public SessionManagerInterface,
   static void SetGError(GError** error,
                         ChromeOSLoginError code,
                         const char* message);
+  // Same for the standard D-Bus errors, e.g. InvalidArgs.
+  static void SetDBusGError(GError** error,
+                            DBusGError code,
+                            const char* message);
   // Perform very, very basic validation of |email_address|.
   static bool ValidateEmail(const std::string& email_address);
 
@@ -176,15 +234,31 @@ class SessionManagerImpl : public SessionManagerInterface,
 
   bool AllSessionsAreIncognito();
 
+  // Fails |method| with |error| and returns true while the browser is being
+  // restarted into the lock screen, see StartLockedRecovery().
+  bool RefuseDuringLockedRecovery(const char* method, GError** error);
+
   UserSession* CreateUserSession(const std::string& username,
                                  bool is_incognito,
                                  GError** error);
 
   scoped_refptr<PolicyService> GetPolicyService(gchar* user_email);
 
+  // Fills |values| with what GetMemoryStats() reports.
+  void CollectMemoryStats(MemoryStats::Values* values);
+
+  // Writes the current device settings to DeviceSettingsSnapshot::kPath.
+  void PublishSettingsSnapshot();
+
+  // Emits a status signal about device policy or the owner key, through
+  // |signal_coalescer_| if there is one.
+  void EmitDeviceStatusSignal(const char* signal_name, bool status);
+
   bool session_started_;
   bool session_stopping_;
   bool screen_locked_;
+  bool recovering_lock_;
+  base::TimeTicks lock_recovery_start_;  // Valid while |recovering_lock_|.
   std::string cookie_;
 
   base::FilePath chrome_testing_path_;
@@ -194,11 +268,16 @@ class SessionManagerImpl : public SessionManagerInterface,
   ProcessManagerServiceInterface* manager_;  // Owned by the caller.
   LoginMetrics* login_metrics_;  // Owned by the caller.
   NssUtil* nss_;  // Owned by the caller.
+  PerBootState* per_boot_state_;  // Owned by the caller.
   SystemUtils* system_;  // Owned by the caller.
 
   scoped_refptr<DevicePolicyService> device_policy_;
   scoped_ptr<UserPolicyServiceFactory> user_policy_factory_;
   scoped_ptr<DeviceLocalAccountPolicyService> device_local_account_policy_;
+  scoped_ptr<SignalCoalescer> signal_coalescer_;
+  scoped_ptr<SelfProfiler> profiler_;
+  DeviceSettingsWatcher settings_watcher_;
+  Tunables* tunables_;  // Owned by the caller.
 
   // Map of the currently signed-in users to their state.
   UserSessionMap user_sessions_;
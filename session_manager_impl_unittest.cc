@@ -6,6 +6,8 @@
 
 #include <glib.h>
 #include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -20,6 +22,7 @@
 #include <base/memory/ref_counted.h>
 #include <base/message_loop.h>
 #include <base/message_loop_proxy.h>
+#include <base/string_number_conversions.h>
 #include <base/string_util.h>
 #include <chromeos/cryptohome.h>
 #include <chromeos/dbus/dbus.h>
@@ -32,6 +35,7 @@
 
 #include "login_manager/child_job.h"
 #include "login_manager/device_management_backend.pb.h"
+#include "login_manager/device_settings_snapshot.h"
 #include "login_manager/file_checker.h"
 #include "login_manager/matchers.h"
 #include "login_manager/mock_child_job.h"
@@ -46,6 +50,8 @@
 #include "login_manager/mock_system_utils.h"
 #include "login_manager/mock_upstart_signal_emitter.h"
 #include "login_manager/mock_user_policy_service_factory.h"
+#include "login_manager/per_boot_state.h"
+#include "login_manager/tunables.h"
 
 using ::testing::AnyNumber;
 using ::testing::AtMost;
@@ -56,6 +62,8 @@ using ::testing::HasSubstr;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Mock;
 using ::testing::Return;
+using ::testing::ReturnRef;
+using ::testing::SaveArg;
 using ::testing::SetArgumentPointee;
 using ::testing::StrEq;
 using ::testing::_;
@@ -70,6 +78,8 @@ using std::map;
 using std::string;
 using std::vector;
 
+namespace em = enterprise_management;
+
 namespace login_manager {
 
 class SessionManagerImplTest : public ::testing::Test {
@@ -77,10 +87,12 @@ class SessionManagerImplTest : public ::testing::Test {
   SessionManagerImplTest()
       : upstart_(new MockUpstartSignalEmitter),
         device_policy_service_(new MockDevicePolicyService),
+        per_boot_state_((FilePath())),
         impl_(scoped_ptr<UpstartSignalEmitter>(upstart_),
               &manager_,
               &metrics_,
               &nss_,
+              &per_boot_state_,
               &utils_),
         fake_salt_("fake salt") {
   }
@@ -95,6 +107,9 @@ class SessionManagerImplTest : public ::testing::Test {
     EXPECT_CALL(*factory, Create(_))
         .WillRepeatedly(
             Invoke(this, &SessionManagerImplTest::CreateUserPolicyService));
+    EXPECT_CALL(*factory, CreateEphemeral(_))
+        .WillRepeatedly(
+            Invoke(this, &SessionManagerImplTest::CreateUserPolicyService));
     scoped_ptr<DeviceLocalAccountPolicyService> device_local_account_policy(
         new DeviceLocalAccountPolicyService(tmpdir_.path(), NULL, NULL));
     impl_.InjectPolicyServices(device_policy_service_,
@@ -198,6 +213,7 @@ class SessionManagerImplTest : public ::testing::Test {
   MockMetrics metrics_;
   MockNssUtil nss_;
   MockSystemUtils utils_;
+  PerBootState per_boot_state_;
 
   SessionManagerImpl impl_;
   base::ScopedTempDir tmpdir_;
@@ -212,10 +228,17 @@ class SessionManagerImplTest : public ::testing::Test {
                                          StrEq(SanitizeUserName(email_string))))
         .Times(1);
     // Expect initialization of the device policy service, return success.
-    EXPECT_CALL(*device_policy_service_,
-                CheckAndHandleOwnerLogin(StrEq(email_string), _, _, _))
-        .WillOnce(DoAll(SetArgumentPointee<2>(for_owner),
-                        Return(true)));
+    // Incognito users are never the owner, so they aren't checked.
+    if (guest) {
+      EXPECT_CALL(*device_policy_service_,
+                  CheckAndHandleOwnerLogin(_, _, _, _))
+          .Times(0);
+    } else {
+      EXPECT_CALL(*device_policy_service_,
+                  CheckAndHandleOwnerLogin(StrEq(email_string), _, _, _))
+          .WillOnce(DoAll(SetArgumentPointee<2>(for_owner),
+                          Return(true)));
+    }
     // Confirm that the key is present.
     EXPECT_CALL(*device_policy_service_, KeyMissing())
         .WillOnce(Return(false));
@@ -227,10 +250,11 @@ class SessionManagerImplTest : public ::testing::Test {
                     StrEq(login_manager::kSessionStateChangedSignal),
                     ElementsAre(SessionManagerImpl::kStarted)))
         .Times(1);
+    // The compatibility flag file only gets written by the first login.
     EXPECT_CALL(utils_,
-                AtomicFileWrite(FilePath(SessionManagerImpl::kLoggedInFlag),
-                                StrEq("1"), 1))
-        .Times(1);
+                AtomicFileWriteAsync(
+                    FilePath(SessionManagerImpl::kLoggedInFlag), "1", _, _))
+        .Times(per_boot_state_.IsSet(PerBootState::LOGGED_IN) ? 0 : 1);
     EXPECT_CALL(utils_, IsDevMode())
         .WillOnce(Return(false));
   }
@@ -444,6 +468,11 @@ TEST_F(SessionManagerImplTest, StartSession_BadNssDB) {
   EXPECT_EQ(CHROMEOS_LOGIN_ERROR_NO_USER_NSSDB, error->code);
 }
 
+TEST_F(SessionManagerImplTest, StartSession_GuestNeedsNoNssDB) {
+  nss_.MakeBadDB();
+  ExpectAndRunGuestSession();
+}
+
 TEST_F(SessionManagerImplTest, StartSession_DevicePolicyFailure) {
   gboolean out;
   gchar email[] = "user@somewhere";
@@ -707,6 +736,222 @@ TEST_F(SessionManagerImplTest, RetrieveActiveSessions) {
   g_hash_table_unref(active_users);
 }
 
+TEST_F(SessionManagerImplTest, RetrievePolicyStats) {
+  gboolean out;
+  gchar email[] = "user@somewhere";
+  gchar nothing[] = "";
+  ExpectStartSession(email);
+  EXPECT_EQ(TRUE, impl_.StartSession(email, nothing, &out, NULL));
+
+  gchar* stats = NULL;
+  EXPECT_EQ(TRUE, impl_.RetrievePolicyStats(&stats));
+  ASSERT_TRUE(stats);
+  const std::string description(stats);
+  g_free(stats);
+  EXPECT_EQ(0U, description.find("device: stores=0"));
+  EXPECT_NE(std::string::npos,
+            description.find("\nuser " + SanitizeUserName(email) +
+                             ": stores=0"));
+}
+
+TEST_F(SessionManagerImplTest, GetDeviceSettingValues) {
+  em::ChromeDeviceSettingsProto settings;
+  settings.mutable_allow_new_users()->set_allow_new_users(false);
+  EXPECT_CALL(*device_policy_service_, GetSettings())
+      .WillRepeatedly(ReturnRef(settings));
+
+  const gchar* paths[] = {
+    "allow_new_users.allow_new_users",
+    "release_channel.release_channel",
+    NULL
+  };
+  GHashTable* values = NULL;
+  EXPECT_EQ(TRUE, impl_.GetDeviceSettingValues(paths, &values, NULL));
+  ASSERT_TRUE(values);
+  // Fields that aren't set are left out.
+  EXPECT_EQ(1U, g_hash_table_size(values));
+  EXPECT_STREQ("false",
+               static_cast<char*>(g_hash_table_lookup(values, paths[0])));
+  g_hash_table_unref(values);
+
+  const gchar* unknown[] = { "allow_new_users.no_such_field", NULL };
+  ScopedError error;
+  EXPECT_EQ(FALSE, impl_.GetDeviceSettingValues(unknown, &values,
+                                                &Resetter(&error).lvalue()));
+  EXPECT_EQ(DBUS_GERROR, error->domain);
+  EXPECT_EQ(DBUS_GERROR_INVALID_ARGS, error->code);
+}
+
+TEST_F(SessionManagerImplTest, WatchDeviceSettings) {
+  em::ChromeDeviceSettingsProto settings;
+  EXPECT_CALL(*device_policy_service_, GetSettings())
+      .WillRepeatedly(ReturnRef(settings));
+
+  const char* signal = SessionManagerImpl::kDeviceSettingsChangedSignal;
+  const gchar* paths[] = { "release_channel.release_channel", NULL };
+  guint watch_id = 0;
+  EXPECT_EQ(TRUE,
+            impl_.AddDeviceSettingsWatch(":1.42", paths, &watch_id, NULL));
+  EXPECT_NE(0U, watch_id);
+
+  // Only changes to watched fields are signalled.
+  settings.mutable_show_user_names()->set_show_user_names(false);
+  EXPECT_CALL(utils_, EmitSignalWithStringArgs(StrEq(signal), _)).Times(0);
+  impl_.OnPolicyPersisted(true);
+  Mock::VerifyAndClearExpectations(&utils_);
+
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  EXPECT_CALL(utils_,
+              EmitSignalWithStringArgs(StrEq(signal),
+                                       ElementsAre(base::UintToString(watch_id),
+                                                   paths[0])))
+      .Times(1);
+  impl_.OnPolicyPersisted(true);
+  Mock::VerifyAndClearExpectations(&utils_);
+
+  // Only the owner may remove the watch.
+  ScopedError error;
+  EXPECT_EQ(FALSE,
+            impl_.RemoveDeviceSettingsWatch(":1.43", watch_id,
+                                            &Resetter(&error).lvalue()));
+  EXPECT_EQ(DBUS_GERROR, error->domain);
+  EXPECT_EQ(DBUS_GERROR_ACCESS_DENIED, error->code);
+  EXPECT_EQ(TRUE, impl_.RemoveDeviceSettingsWatch(":1.42", watch_id, NULL));
+  EXPECT_EQ(FALSE,
+            impl_.RemoveDeviceSettingsWatch(":1.42", watch_id,
+                                            &Resetter(&error).lvalue()));
+  EXPECT_EQ(DBUS_GERROR, error->domain);
+  EXPECT_EQ(DBUS_GERROR_INVALID_ARGS, error->code);
+
+  const gchar* unknown[] = { "release_channel.no_such_field", NULL };
+  EXPECT_EQ(FALSE,
+            impl_.AddDeviceSettingsWatch(":1.42", unknown, &watch_id,
+                                         &Resetter(&error).lvalue()));
+  EXPECT_EQ(DBUS_GERROR_INVALID_ARGS, error->code);
+}
+
+TEST_F(SessionManagerImplTest, WatchDeviceSettings_OwnerLeaves) {
+  em::ChromeDeviceSettingsProto settings;
+  EXPECT_CALL(*device_policy_service_, GetSettings())
+      .WillRepeatedly(ReturnRef(settings));
+
+  const gchar* paths[] = { "release_channel.release_channel", NULL };
+  guint watch_id = 0;
+  guint other_watch_id = 0;
+  ASSERT_EQ(TRUE,
+            impl_.AddDeviceSettingsWatch(":1.42", paths, &watch_id, NULL));
+  ASSERT_EQ(TRUE, impl_.AddDeviceSettingsWatch(":1.43", paths,
+                                               &other_watch_id, NULL));
+
+  // Only the watches of the name that went away are dropped.
+  impl_.OnNameLost(":1.42");
+  const char* signal = SessionManagerImpl::kDeviceSettingsChangedSignal;
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  EXPECT_CALL(utils_,
+              EmitSignalWithStringArgs(
+                  StrEq(signal),
+                  ElementsAre(base::UintToString(other_watch_id), paths[0])))
+      .Times(1);
+  impl_.OnPolicyPersisted(true);
+  Mock::VerifyAndClearExpectations(&utils_);
+
+  ScopedError error;
+  EXPECT_EQ(FALSE,
+            impl_.RemoveDeviceSettingsWatch(":1.42", watch_id,
+                                            &Resetter(&error).lvalue()));
+  EXPECT_EQ(TRUE,
+            impl_.RemoveDeviceSettingsWatch(":1.43", other_watch_id, NULL));
+}
+
+TEST_F(SessionManagerImplTest, PublishSettingsSnapshot) {
+  em::ChromeDeviceSettingsProto settings;
+  settings.mutable_release_channel()->set_release_channel("beta-channel");
+  EXPECT_CALL(*device_policy_service_, GetSettings())
+      .WillRepeatedly(ReturnRef(settings));
+
+  std::string snapshot;
+  EXPECT_CALL(utils_,
+              AtomicFileWriteAsync(FilePath(DeviceSettingsSnapshot::kPath),
+                                   _,
+                                   static_cast<mode_t>(
+                                       S_IRUSR | S_IWUSR | S_IROTH),
+                                   _))
+      .WillOnce(SaveArg<1>(&snapshot));
+  impl_.OnPolicyPersisted(true);
+
+  DeviceSettingsSnapshot reader;
+  ASSERT_TRUE(reader.Init(snapshot.data(), snapshot.size()));
+  base::StringPiece channel;
+  EXPECT_TRUE(reader.GetString(
+      DeviceSettingsSnapshot::FIELD_release_channel_release_channel,
+      &channel));
+  EXPECT_EQ("beta-channel", channel.as_string());
+}
+
+TEST_F(SessionManagerImplTest, Tunables) {
+  Tunables tunables;
+  tunables.Register(Tunables::kKillTimeout, 3, 1, 60);
+  impl_.set_tunables(&tunables);
+
+  gchar name[] = "kill_timeout_seconds";
+  EXPECT_CALL(utils_, IsDevMode())
+      .WillOnce(Return(0))
+      .WillRepeatedly(Return(1));
+  ScopedError error;
+  EXPECT_EQ(FALSE, impl_.SetTunable(name, 10, &Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  EXPECT_EQ(TRUE, impl_.SetTunable(name, 10, NULL));
+  EXPECT_EQ(FALSE, impl_.SetTunable(name, 61, &Resetter(&error).lvalue()));
+  gchar unknown[] = "no_such_tunable";
+  EXPECT_EQ(FALSE, impl_.SetTunable(unknown, 1, &Resetter(&error).lvalue()));
+
+  GHashTable* values = NULL;
+  EXPECT_EQ(TRUE, impl_.GetTunables(&values, NULL));
+  ASSERT_TRUE(values);
+  EXPECT_EQ(1U, g_hash_table_size(values));
+  EXPECT_STREQ("10", static_cast<char*>(g_hash_table_lookup(values, name)));
+  g_hash_table_unref(values);
+}
+
+TEST_F(SessionManagerImplTest, ReloadTunables) {
+  ScopedError error;
+  EXPECT_EQ(FALSE, impl_.ReloadTunables(&Resetter(&error).lvalue()));
+
+  Tunables tunables;
+  const Tunable* tunable = tunables.Register(Tunables::kKillTimeout, 3, 1, 60);
+  impl_.set_tunables(&tunables);
+  base::ScopedTempDir tmpdir;
+  ASSERT_TRUE(tmpdir.CreateUniqueTempDir());
+  const FilePath config = tmpdir.path().AppendASCII("tunables.conf");
+  ASSERT_TRUE(tunables.LoadConfigFile(config));
+
+  const char contents[] = "kill_timeout_seconds=12\n";
+  ASSERT_EQ(static_cast<int>(strlen(contents)),
+            file_util::WriteFile(config, contents, strlen(contents)));
+  EXPECT_EQ(TRUE, impl_.ReloadTunables(NULL));
+  EXPECT_EQ(12, tunable->value());
+}
+
+TEST_F(SessionManagerImplTest, GetMemoryStats) {
+  GHashTable* values = NULL;
+  EXPECT_EQ(TRUE, impl_.GetMemoryStats(&values, NULL));
+  ASSERT_TRUE(values);
+  EXPECT_STREQ("0", static_cast<char*>(
+      g_hash_table_lookup(values, "user_sessions")));
+  EXPECT_TRUE(g_hash_table_lookup(values, "heap_in_use_bytes"));
+  EXPECT_TRUE(g_hash_table_lookup(values, "pss_kb"));
+  g_hash_table_unref(values);
+}
+
+TEST_F(SessionManagerImplTest, StartProfilingUnavailable) {
+  gchar* path = NULL;
+  ScopedError error;
+  EXPECT_EQ(FALSE, impl_.StartProfiling(10, &path,
+                                        &Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  EXPECT_EQ(NULL, path);
+}
+
 TEST_F(SessionManagerImplTest, RestartJob_UnknownPid) {
   gboolean out;
   gint pid = kDummyPid;
@@ -804,18 +1049,94 @@ TEST_F(SessionManagerImplTest, LockUnlockScreen) {
   EXPECT_EQ(FALSE, impl_.ScreenIsLocked());
 }
 
+TEST_F(SessionManagerImplTest, LockedRecovery) {
+  ExpectAndRunStartSession("user@somewhere");
+  EXPECT_CALL(utils_, EmitSignal(StrEq(chromium::kLockScreenSignal))).Times(1);
+  EXPECT_EQ(TRUE, impl_.LockScreen(NULL));
+  impl_.StartLockedRecovery();
+  EXPECT_TRUE(impl_.IsRecoveringLock());
+
+  // Nothing may unlock the screen, start a session or replace the browser
+  // until the lock screen is back up.
+  EXPECT_CALL(utils_, EmitSignal(StrEq(login_manager::kScreenIsUnlockedSignal)))
+      .Times(0);
+  EXPECT_CALL(manager_, RestartBrowserWithArgs(_, _)).Times(0);
+  EXPECT_CALL(manager_, SetBrowserSessionForUser(_, _)).Times(0);
+  ScopedError error;
+  EXPECT_EQ(FALSE, impl_.HandleLockScreenDismissed(&Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  EXPECT_TRUE(impl_.ScreenIsLocked());
+
+  gboolean out = TRUE;
+  gchar email[] = "other@somewhere";
+  gchar nothing[] = "";
+  EXPECT_EQ(FALSE, impl_.StartSession(email, nothing, &out,
+                                      &Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  EXPECT_EQ(FALSE, out);
+
+  gchar arguments[] = "dummy";
+  out = TRUE;
+  EXPECT_EQ(FALSE, impl_.RestartJob(kDummyPid, arguments, &out,
+                                    &Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  EXPECT_EQ(FALSE, out);
+
+  const gchar* args[] = {NULL};
+  gchar* testing_path = NULL;
+  EXPECT_EQ(FALSE, impl_.EnableChromeTesting(true, args, &testing_path,
+                                             &Resetter(&error).lvalue()));
+  EXPECT_EQ(CHROMEOS_LOGIN_ERROR_ILLEGAL_SERVICE, error->code);
+  Mock::VerifyAndClearExpectations(&utils_);
+  Mock::VerifyAndClearExpectations(&manager_);
+
+  // Showing the lock screen ends the recovery and records how long it took.
+  EXPECT_CALL(utils_, EmitSignal(StrEq(login_manager::kScreenIsLockedSignal)))
+      .Times(1);
+  EXPECT_CALL(metrics_, SendHistogram(StrEq("Login.LockedRecoveryTime"),
+                                      _, _, _, _))
+      .Times(1);
+  EXPECT_EQ(TRUE, impl_.HandleLockScreenShown(NULL));
+  EXPECT_FALSE(impl_.IsRecoveringLock());
+  EXPECT_TRUE(impl_.ScreenIsLocked());
+
+  EXPECT_CALL(utils_, EmitSignal(StrEq(login_manager::kScreenIsUnlockedSignal)))
+      .Times(1);
+  EXPECT_EQ(TRUE, impl_.HandleLockScreenDismissed(NULL));
+  EXPECT_FALSE(impl_.ScreenIsLocked());
+}
+
 TEST_F(SessionManagerImplTest, StartDeviceWipe_AlreadyLoggedIn) {
-  FilePath logged_in_path(SessionManagerImpl::kLoggedInFlag);
-  EXPECT_CALL(utils_, Exists(logged_in_path)).WillOnce(Return(true));
+  per_boot_state_.Set(PerBootState::LOGGED_IN);
+  EXPECT_CALL(utils_, AtomicFileWrite(_, _, _)).Times(0);
   GError *error = NULL;
   gboolean done = FALSE;
   EXPECT_EQ(FALSE, impl_.StartDeviceWipe(&done, &error));
 }
 
+TEST_F(SessionManagerImplTest, StartDeviceWipe_LoggedInBeforeRestart) {
+  // Without a mapping, a restarted session_manager has nothing but the flag
+  // file to go by.
+  PerBootState unmapped(tmpdir_.path().Append("missing").Append("state"));
+  ASSERT_FALSE(unmapped.Initialize());
+  SessionManagerImpl impl(
+      scoped_ptr<UpstartSignalEmitter>(new MockUpstartSignalEmitter),
+      &manager_, &metrics_, &nss_, &unmapped, &utils_);
+  EXPECT_CALL(utils_, Exists(FilePath(SessionManagerImpl::kLoggedInFlag)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(utils_, AtomicFileWrite(_, _, _)).Times(0);
+  EXPECT_CALL(utils_, CallMethodOnPowerManager(_)).Times(0);
+  GError *error = NULL;
+  gboolean done = FALSE;
+  EXPECT_EQ(FALSE, impl.StartDeviceWipe(&done, &error));
+  EXPECT_FALSE(done);
+  g_error_free(error);
+}
+
 TEST_F(SessionManagerImplTest, StartDeviceWipe) {
-  FilePath logged_in_path(SessionManagerImpl::kLoggedInFlag);
+  EXPECT_CALL(utils_, Exists(FilePath(SessionManagerImpl::kLoggedInFlag)))
+      .WillOnce(Return(false));
   FilePath reset_path(SessionManagerImpl::kResetFile);
-  EXPECT_CALL(utils_, Exists(logged_in_path)).WillOnce(Return(false));
   EXPECT_CALL(utils_, AtomicFileWrite(reset_path, _, _)).WillOnce(Return(true));
   EXPECT_CALL(utils_, CallMethodOnPowerManager(_)).Times(1);
   gboolean done = FALSE;
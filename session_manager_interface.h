@@ -39,6 +39,22 @@ class SessionManagerInterface {
       const base::FilePath& temp_key_file) = 0;
   virtual bool ScreenIsLocked() = 0;
 
+  // Called when the browser died with the screen locked and is about to be
+  // restarted straight into the lock screen. Until HandleLockScreenShown()
+  // is called, the screen can't be unlocked and nothing may start a session
+  // or replace the browser.
+  virtual void StartLockedRecovery() = 0;
+  // True from StartLockedRecovery() until the lock screen is shown.
+  virtual bool IsRecoveringLock() = 0;
+
+  // Gives back memory that is cached but not needed right now: idle policy
+  // services and free heap. Called once things settle down after login.
+  virtual void TrimMemory() = 0;
+
+  // Called when the bus name |name| goes away. Drops whatever was kept on
+  // its behalf, i.e. its device settings watches.
+  virtual void OnNameLost(const std::string& name) = 0;
+
   //////////////////////////////////////////////////////////////////////////////
   // Methods exposed via RPC are defined below.
 
@@ -149,6 +165,51 @@ class SessionManagerInterface {
   // the GHashTable structure.
   virtual GHashTable* RetrieveActiveSessions() = 0;
 
+  // Describes the operational counters and histograms kept for device policy,
+  // the policy of each signed-in user and each loaded device-local account,
+  // one per line. See PolicyStats::ToString().
+  virtual gboolean RetrievePolicyStats(gchar** OUT_stats) = 0;
+
+  // Looks up the fields at |field_paths| in the decoded device settings, see
+  // DeviceSettingsWatcher. |OUT_values| maps the path of each of those fields
+  // that is set to its value. Fails if a path is unknown.
+  virtual gboolean GetDeviceSettingValues(const gchar** field_paths,
+                                          GHashTable** OUT_values,
+                                          GError** error) = 0;
+
+  // Has DeviceSettingsChanged emitted whenever one of the fields at
+  // |field_paths| changes, until UnwatchDeviceSettings() is called with the
+  // watch id returned through |context| or the caller leaves the bus. Fails
+  // with InvalidArgs if a path is unknown.
+  virtual gboolean WatchDeviceSettings(const gchar** field_paths,
+                                       DBusGMethodInvocation* context) = 0;
+  // Fails with InvalidArgs if there's no watch with |watch_id|, and with
+  // AccessDenied if the caller isn't the one who added it.
+  virtual gboolean UnwatchDeviceSettings(guint watch_id,
+                                         DBusGMethodInvocation* context) = 0;
+
+  // |OUT_values| maps the name of each tunable to its value, see Tunables.
+  virtual gboolean GetTunables(GHashTable** OUT_values, GError** error) = 0;
+
+  // Overrides the value of the tunable |name| until the session_manager
+  // exits. Only allowed in developer mode.
+  virtual gboolean SetTunable(gchar* name, gint64 value, GError** error) = 0;
+
+  // Rereads Tunables::kConfigFile, so that changes to it take effect without
+  // a restart. Values set by SetTunable() still take precedence.
+  virtual gboolean ReloadTunables(GError** error) = 0;
+
+  // |OUT_values| maps the name of each measure of memory use, see
+  // MemoryStats::Collect(), and of each count of cached objects to its value.
+  virtual gboolean GetMemoryStats(GHashTable** OUT_values, GError** error) = 0;
+
+  // Samples where the session_manager spends CPU time for |duration_seconds|
+  // and writes a pprof profile to |OUT_profile_path|, see SelfProfiler. Fails
+  // if a profile is already being taken.
+  virtual gboolean StartProfiling(gint duration_seconds,
+                                  gchar** OUT_profile_path,
+                                  GError** error) = 0;
+
   // Handles LockScreen request from Chromium or PowerManager. It emits
   // LockScreen signal to Chromium Browser to tell it to lock the screen. The
   // browser should call the HandleScreenLocked method when the screen is
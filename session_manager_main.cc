@@ -26,8 +26,10 @@
 #include "login_manager/child_job.h"
 #include "login_manager/file_checker.h"
 #include "login_manager/regen_mitigator.h"
+#include "login_manager/respawn_governor.h"
 #include "login_manager/session_manager_service.h"
 #include "login_manager/system_utils.h"
+#include "login_manager/tunables.h"
 
 using std::string;
 using std::vector;
@@ -63,10 +65,46 @@ static const int kKillTimeoutDefault = 3;
 static const char kEnableHangDetection[] = "enable-hang-detection";
 static const uint kHangDetectionIntervalDefaultSeconds = 60;
 
+// Name of the flag that makes the browser beat on a shared memory page,
+// which is then used for hang detection instead of D-Bus pings.
+static const char kEnableBrowserHeartbeat[] = "enable-browser-heartbeat";
+
+// Name of the flag that makes session_manager serve the browser over a
+// private D-Bus connection, bypassing dbus-daemon.
+static const char kEnableBrowserChannel[] = "enable-browser-channel";
+
+// Name of the flag that makes session_manager kill what's left of the session
+// on exit, instead of leaving it to ui.conf.
+static const char kNativeTeardown[] = "native-session-teardown";
+
+// Name of the flag that restarts a browser that died with the screen locked
+// into the lock screen, rather than ending the session.
+static const char kLockedRecovery[] = "enable-locked-recovery";
+
+// Name of the flag that makes user and device-local account policy get
+// written with a length and checksum, so torn writes can be detected.
+static const char kPolicyContainer[] = "policy-container";
+
+// Name of the flag specifying the window (in ms) within which policy and owner
+// key status signals are folded into one. 0 sends each one right away.
+static const char kPolicySignalWindow[] = "policy-signal-window-ms";
+
 // Name of the flag indicating the session_manager should enable support
 // for simultaneous active sessions.
 static const char kMultiProfile[] = "multi-profiles";
 
+// Names of the flags specifying how often, in "<count>/<window seconds>" form,
+// the browser may exit too fast before a reboot is tried; a reboot may be
+// tried before falling back to restarting session_manager; and
+// session_manager may exit abnormally before the UI is given up on.
+static const char kTooCrashyLimit[] = "too-crashy-limit";
+static const char kRebootLimit[] = "reboot-limit";
+static const char kSelfRestartLimit[] = "self-restart-limit";
+
+// Name of the flag listing the fallback flags to relaunch the browser with
+// when it keeps crashing, one ';'-separated entry per degraded mode.
+static const char kDegradedModes[] = "degraded-modes";
+
 // Flag that causes session manager to show the help message and exit.
 static const char kHelp[] = "help";
 // The help message shown if help flag is passed to the program.
@@ -82,9 +120,45 @@ static const char kHelpMessage[] = "\nAvailable Switches: \n"
 "  --enable-hang-detection[=number in seconds]\n"
 "    Ping the browser over DBus periodically to determine if it's alive.\n"
 "    Optionally accepts a period value in seconds.  Default is 60.\n"
-"    If it fails to respond, SIGABRT and restart it."
+"    If it fails to respond, SIGABRT and restart it.\n"
+"  --enable-browser-heartbeat\n"
+"    Detect hangs by watching a heartbeat the browser writes to shared\n"
+"    memory. Browsers that don't write it are still pinged over DBus.\n"
+"  --enable-browser-channel\n"
+"    Give the browser a private DBus connection to this program, so its\n"
+"    calls don't go through the bus daemon. Everything else still does.\n"
+"  --native-session-teardown\n"
+"    On exit, kill the processes of --uid and those holding files on the\n"
+"    session mounts, so that ui.conf doesn't have to.\n"
+"  --enable-locked-recovery\n"
+"    If the browser dies with the screen locked, restart it into the lock\n"
+"    screen instead of ending the session.\n"
+"  --policy-container\n"
+"    Write user and device-local account policy with a length and CRC32C,\n"
+"    so that torn writes are detected. Either format is read regardless.\n"
+"  --policy-signal-window-ms=[number in ms]\n"
+"    Fold policy and owner key status signals that come in within this\n"
+"    many ms of each other into one. 0 disables this. (default: 100)\n"
+"  --too-crashy-limit=<count>/<seconds>\n"
+"    How often the browser may exit too fast before rebooting.\n"
+"    (default: 1/180)\n"
+"  --reboot-limit=<count>/<seconds>\n"
+"    How often to reboot before restarting this program instead.\n"
+"    (default: 1/540)\n"
+"  --self-restart-limit=<count>/<seconds>\n"
+"    How often this program may exit abnormally before the UI is given up\n"
+"    on. (default: 6/60)\n"
+"  --degraded-modes=<flags>[;<flags>...]\n"
+"    Flags to relaunch the browser with, in order, when it keeps exiting\n"
+"    too fast. Pass an empty value to always relaunch it unchanged.\n"
 "  -- /path/to/program [arg1 [arg2 [ . . . ] ] ]\n"
-"    Supplies the required program to execute and its arguments.\n";
+"    Supplies the required program to execute and its arguments.\n"
+"\n"
+"The kill timeout, hang detection interval and browser restart limit can\n"
+"also be set in /etc/session_manager_tunables.conf, as name=value lines\n"
+"that take precedence over the above. Values set over D-Bus, which is\n"
+"only allowed in developer mode, take precedence over the file. The file\n"
+"is read at startup, and again when ReloadTunables is called.\n";
 
 }  // namespace switches
 
@@ -93,8 +167,27 @@ using login_manager::ChildJobInterface;
 using login_manager::FileChecker;
 using login_manager::KeyGenerator;
 using login_manager::RegenMitigator;
+using login_manager::RespawnGovernor;
+using login_manager::RestartPolicy;
 using login_manager::SessionManagerService;
 using login_manager::SystemUtils;
+using login_manager::Tunable;
+using login_manager::Tunables;
+
+namespace {
+
+// Overrides |limit| with the value of |switch_name|, if present and valid.
+void ParseRespawnLimit(const CommandLine* cl,
+                       const char* switch_name,
+                       RespawnGovernor::Limit* limit) {
+  if (!cl->HasSwitch(switch_name))
+    return;
+  string spec = cl->GetSwitchValueASCII(switch_name);
+  if (!RespawnGovernor::ParseLimit(spec, limit))
+    LOG(WARNING) << "Ignoring malformed --" << switch_name << "=" << spec;
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
   base::AtExitManager exit_manager;
@@ -121,32 +214,49 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // Defaults, overridden by switches, overridden by the config file.
+  RestartPolicy::Config restart_config;
+  Tunables tunables;
+  const Tunable* kill_timeout =
+      tunables.Register(Tunables::kKillTimeout, switches::kKillTimeoutDefault,
+                        0, 600);
+  const Tunable* hang_detection_interval =
+      tunables.Register(Tunables::kHangDetectionInterval,
+                        switches::kHangDetectionIntervalDefaultSeconds,
+                        1, 3600);
+  const Tunable* restart_tries =
+      tunables.Register(Tunables::kRestartTries, restart_config.restart_tries,
+                        1, 100);
+  const Tunable* restart_window =
+      tunables.Register(Tunables::kRestartWindow,
+                        restart_config.restart_window_seconds, 1, 3600);
+
   // Parse kill timeout if it's present.
-  int kill_timeout = switches::kKillTimeoutDefault;
   if (cl->HasSwitch(switches::kKillTimeout)) {
     string timeout_flag = cl->GetSwitchValueASCII(switches::kKillTimeout);
     int from_flag = 0;
-    if (base::StringToInt(timeout_flag, &from_flag)) {
-      kill_timeout = from_flag;
-    } else {
+    if (!base::StringToInt(timeout_flag, &from_flag) ||
+        !tunables.Set(Tunables::kKillTimeout, Tunables::SWITCH, from_flag)) {
       DLOG(WARNING) << "Failed to parse kill timeout, defaulting to "
-                    << kill_timeout;
+                    << kill_timeout->value();
     }
   }
 
   // Parse hang detection interval if it's present.
-  uint hang_detection_interval = switches::kHangDetectionIntervalDefaultSeconds;
   if (cl->HasSwitch(switches::kEnableHangDetection)) {
     string flag = cl->GetSwitchValueASCII(switches::kEnableHangDetection);
     uint from_flag = 0;
-    if (base::StringToUint(flag, &from_flag)) {
-      hang_detection_interval = from_flag;
-    } else {
+    if (!base::StringToUint(flag, &from_flag) ||
+        !tunables.Set(Tunables::kHangDetectionInterval, Tunables::SWITCH,
+                      from_flag)) {
       DLOG(WARNING) << "Failed to parse hang detection interval, defaulting to "
-                    << hang_detection_interval;
+                    << hang_detection_interval->value();
     }
   }
 
+  LOG_IF(WARNING, !tunables.LoadConfigFile(FilePath(Tunables::kConfigFile)))
+      << "Some of " << Tunables::kConfigFile << " was ignored.";
+
   // Check for simultaneous active session support.
   bool support_multi_profile = cl->HasSwitch(switches::kMultiProfile);
 
@@ -164,9 +274,9 @@ int main(int argc, char* argv[]) {
   scoped_refptr<SessionManagerService> manager =
       new SessionManagerService(
           browser_job.Pass(),
-          kill_timeout,
+          kill_timeout->value(),
           cl->HasSwitch(switches::kEnableHangDetection),
-          base::TimeDelta::FromSeconds(hang_detection_interval),
+          base::TimeDelta::FromSeconds(hang_detection_interval->value()),
           &system);
 
   string magic_chrome_file =
@@ -177,12 +287,60 @@ int main(int argc, char* argv[]) {
 
   if (uid_set)
     manager->set_uid(uid);
+  manager->set_use_browser_heartbeat(
+      cl->HasSwitch(switches::kEnableBrowserHeartbeat));
+  manager->set_use_browser_channel(
+      cl->HasSwitch(switches::kEnableBrowserChannel));
+  manager->set_use_native_teardown(cl->HasSwitch(switches::kNativeTeardown));
+  manager->set_use_locked_recovery(cl->HasSwitch(switches::kLockedRecovery));
+  manager->set_use_policy_container(cl->HasSwitch(switches::kPolicyContainer));
+  if (cl->HasSwitch(switches::kPolicySignalWindow)) {
+    string flag = cl->GetSwitchValueASCII(switches::kPolicySignalWindow);
+    int window_ms = 0;
+    if (base::StringToInt(flag, &window_ms) && window_ms >= 0) {
+      manager->set_policy_signal_window(
+          base::TimeDelta::FromMilliseconds(window_ms));
+    } else {
+      LOG(WARNING) << "Ignoring malformed --" << switches::kPolicySignalWindow
+                   << "=" << flag;
+    }
+  }
+
+  restart_config.restart_tries = restart_tries->value();
+  restart_config.restart_window_seconds = restart_window->value();
+  if (cl->HasSwitch(switches::kDegradedModes)) {
+    string modes = cl->GetSwitchValueASCII(switches::kDegradedModes);
+    if (!RestartPolicy::ParseDegradedModes(modes,
+                                           &restart_config.degraded_modes)) {
+      LOG(WARNING) << "Ignoring malformed --" << switches::kDegradedModes
+                   << "=" << modes;
+    }
+  }
+  manager->set_restart_policy(new RestartPolicy(restart_config, &system));
+  manager->set_tunables(&tunables);
+
+  RespawnGovernor::Config respawn_config;
+  ParseRespawnLimit(cl, switches::kTooCrashyLimit, &respawn_config.too_crashy);
+  ParseRespawnLimit(cl, switches::kRebootLimit, &respawn_config.reboot);
+  ParseRespawnLimit(cl, switches::kSelfRestartLimit,
+                    &respawn_config.self_restart);
+  RespawnGovernor governor(FilePath(RespawnGovernor::kHistoryFile),
+                           respawn_config,
+                           &system);
+  LOG_IF(WARNING, !governor.Initialize())
+      << "Crash history will not survive a restart.";
+  if (!governor.OnStartup())
+    return SessionManagerService::DONT_RESPAWN;
+  manager->set_respawn_governor(&governor);
 
   LOG_IF(FATAL, !manager->Initialize()) << "Failed";
   LOG_IF(FATAL, !manager->Register(chromeos::dbus::GetSystemBusConnection()))
     << "Failed";
   LOG_IF(FATAL, !manager->Run()) << "Failed";
 
+  governor.OnExit(manager->exit_code() == SessionManagerService::SUCCESS ||
+                  manager->exit_code() == SessionManagerService::DONT_RESPAWN);
+
   LOG_IF(WARNING, manager->exit_code() != SessionManagerService::SUCCESS)
       << "session_manager exiting with code " << manager->exit_code();
   return manager->exit_code();
@@ -4,6 +4,7 @@
 
 #include <errno.h>
 
+#include <base/bind.h>
 #include <base/file_path.h>
 #include <base/file_util.h>
 #include <base/files/scoped_temp_dir.h>
@@ -14,17 +15,21 @@
 #include <base/memory/scoped_ptr.h>
 #include <base/message_loop.h>
 #include <base/string_util.h>
+#include <chromeos/dbus/service_constants.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "login_manager/child_job.h"
 #include "login_manager/mock_child_job.h"
 #include "login_manager/mock_child_process.h"
+#include "login_manager/mock_crash_collection_watcher.h"
 #include "login_manager/mock_device_policy_service.h"
 #include "login_manager/mock_file_checker.h"
 #include "login_manager/mock_key_generator.h"
 #include "login_manager/mock_liveness_checker.h"
 #include "login_manager/mock_metrics.h"
+#include "login_manager/mock_respawn_governor.h"
+#include "login_manager/mock_restart_policy.h"
 #include "login_manager/mock_session_manager.h"
 #include "login_manager/mock_system_utils.h"
 
@@ -34,6 +39,7 @@ using ::testing::AtMost;
 using ::testing::ContainerEq;
 using ::testing::DoAll;
 using ::testing::Invoke;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::Sequence;
@@ -45,6 +51,26 @@ using std::string;
 
 namespace login_manager {
 
+namespace {
+
+RestartPolicy::Decision RestartNow() {
+  return RestartPolicy::Decision();
+}
+
+RestartPolicy::Decision RestartAfter(base::TimeDelta delay) {
+  RestartPolicy::Decision decision;
+  decision.delay = delay;
+  return decision;
+}
+
+RestartPolicy::Decision GiveUp() {
+  RestartPolicy::Decision decision;
+  decision.give_up = true;
+  return decision;
+}
+
+}  // namespace
+
 // Used as a fixture for the tests in this file.
 // Gives useful shared functionality.
 class SessionManagerProcessTest : public ::testing::Test {
@@ -54,6 +80,7 @@ class SessionManagerProcessTest : public ::testing::Test {
         file_checker_(new MockFileChecker(kCheckedFile)),
         liveness_checker_(new MockLivenessChecker),
         metrics_(new MockMetrics),
+        restart_policy_(new MockRestartPolicy),
         session_manager_impl_(new MockSessionManager),
         must_destroy_mocks_(true) {
   }
@@ -63,6 +90,7 @@ class SessionManagerProcessTest : public ::testing::Test {
       delete file_checker_;
       delete liveness_checker_;
       delete metrics_;
+      delete restart_policy_;
       delete session_manager_impl_;
     }
   }
@@ -114,6 +142,7 @@ class SessionManagerProcessTest : public ::testing::Test {
         .Times(1);
     EXPECT_CALL(*session_manager_impl_, AnnounceSessionStopped())
         .Times(AtMost(1));
+    EXPECT_CALL(*metrics_, Flush()).Times(AtMost(1));
   }
 
   void ExpectLivenessChecking() {
@@ -131,7 +160,7 @@ class SessionManagerProcessTest : public ::testing::Test {
 
   void ExpectChildJobBoilerplate(MockChildJob* job) {
     ExpectOneTimeArgsBoilerplate(job);
-    EXPECT_CALL(*job, RecordTime()).Times(1);
+    EXPECT_CALL(*restart_policy_, RecordStart()).Times(1);
     ExpectLivenessChecking();
   }
 
@@ -181,6 +210,10 @@ class SessionManagerProcessTest : public ::testing::Test {
                                          &real_utils_);
     manager_->Reset();
     manager_->set_file_checker(file_checker_);
+    manager_->set_restart_policy(restart_policy_);
+    ON_CALL(*restart_policy_, OnExit()).WillByDefault(Return(RestartNow()));
+    EXPECT_CALL(*restart_policy_, GetDegradedFlags())
+        .WillRepeatedly(Return(std::vector<std::string>()));
     manager_->test_api().set_liveness_checker(liveness_checker_);
     manager_->test_api().set_login_metrics(metrics_);
     manager_->test_api().set_session_manager(session_manager_impl_);
@@ -218,6 +251,15 @@ class SessionManagerProcessTest : public ::testing::Test {
     SetFileCheckerPolicy(child_runs);
   }
 
+  // Has the manager restart the browser with no extra arguments, once the
+  // current task is done.
+  void PostBrowserRestart() {
+    MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(&SessionManagerService::RestartBrowserWithArgs, manager_,
+                   std::vector<std::string>(), true));
+  }
+
   int PackStatus(int status) { return __W_EXITCODE(status, 0); }
   int PackSignal(int signal) { return __W_EXITCODE(0, signal); }
 
@@ -231,6 +273,7 @@ class SessionManagerProcessTest : public ::testing::Test {
   MockFileChecker* file_checker_;
   MockLivenessChecker* liveness_checker_;
   MockMetrics* metrics_;
+  MockRestartPolicy* restart_policy_;
   MockSessionManager* session_manager_impl_;
 
  private:
@@ -287,6 +330,42 @@ TEST_F(SessionManagerProcessTest, SlowKillCleanupChildren) {
   manager_->test_api().CleanupChildren(3);
 }
 
+TEST_F(SessionManagerProcessTest, SlowKillWaitsForCrashCollection) {
+  InitManager(new MockChildJob);
+  manager_->test_api().set_browser_pid(kDummyPid);
+  MockCrashCollectionWatcher* watcher = new MockCrashCollectionWatcher;
+  manager_->test_api().set_crash_watcher(watcher);
+
+  // The child is still being dumped after the kill timeout, and goes away
+  // during the second poll.
+  EXPECT_CALL(utils_, kill(kDummyPid, getuid(), SIGTERM)).WillOnce(Return(0));
+  EXPECT_CALL(utils_, ChildIsGone(kDummyPid, 3)).WillOnce(Return(false));
+  EXPECT_CALL(*watcher, IsCollecting(kDummyPid)).WillRepeatedly(Return(true));
+  EXPECT_CALL(utils_, ChildIsGone(kDummyPid, 1))
+      .WillOnce(Return(false))
+      .WillOnce(Return(true));
+  EXPECT_CALL(utils_, kill(kDummyPid, getuid(), SIGABRT)).Times(0);
+  MockUtils();
+
+  manager_->test_api().CleanupChildren(3);
+}
+
+TEST_F(SessionManagerProcessTest, SlowKillWithoutCrashCollection) {
+  InitManager(new MockChildJob);
+  manager_->test_api().set_browser_pid(kDummyPid);
+  MockCrashCollectionWatcher* watcher = new MockCrashCollectionWatcher;
+  manager_->test_api().set_crash_watcher(watcher);
+
+  // Nothing is being collected, so there's no reason to wait any longer.
+  EXPECT_CALL(utils_, kill(kDummyPid, getuid(), SIGTERM)).WillOnce(Return(0));
+  EXPECT_CALL(utils_, ChildIsGone(kDummyPid, 3)).WillOnce(Return(false));
+  EXPECT_CALL(*watcher, IsCollecting(kDummyPid)).WillOnce(Return(false));
+  EXPECT_CALL(utils_, kill(kDummyPid, getuid(), SIGABRT)).WillOnce(Return(0));
+  MockUtils();
+
+  manager_->test_api().CleanupChildren(3);
+}
+
 TEST_F(SessionManagerProcessTest, SessionStartedCleanup) {
   MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
 
@@ -345,7 +424,7 @@ TEST_F(SessionManagerProcessTest, BadExitChildFlagFileStop) {
   ExpectChildJobBoilerplate(job);
   InitManager(job);
 
-  EXPECT_CALL(*job, ShouldStop()).WillOnce(Return(false));
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(RestartNow()));
   EXPECT_CALL(*file_checker_, exists())
       .WillOnce(Return(false))
       .WillOnce(Return(true));
@@ -364,7 +443,7 @@ TEST_F(SessionManagerProcessTest, BadExitChildOnSignal) {
   MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
   ExpectChildJobBoilerplate(job);
 
-  EXPECT_CALL(*job, ShouldStop()).WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -381,10 +460,10 @@ TEST_F(SessionManagerProcessTest, BadExitChild) {
   ExpectLivenessChecking();
   ExpectOneTimeArgsBoilerplate(job);
 
-  EXPECT_CALL(*job, RecordTime()).Times(2);
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(false))
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -397,12 +476,105 @@ TEST_F(SessionManagerProcessTest, BadExitChild) {
   SimpleRunManager();
 }
 
+TEST_F(SessionManagerProcessTest, BadExitChildGovernorRestartsBrowser) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  MockRespawnGovernor governor;
+  manager_->set_respawn_governor(&governor);
+  ExpectLivenessChecking();
+  ExpectOneTimeArgsBoilerplate(job);
+
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit()).WillRepeatedly(Return(GiveUp()));
+  EXPECT_CALL(*restart_policy_, Reset()).Times(1);
+  EXPECT_CALL(governor, OnBrowserExitingTooFast())
+      .WillOnce(Return(RespawnGovernor::RESTART_BROWSER))
+      .WillOnce(Return(RespawnGovernor::RESTART_SELF));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(false));
+
+  MockChildProcess proc(kDummyPid, PackStatus(kExit), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())))
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+  SimpleRunManager();
+  EXPECT_EQ(SessionManagerService::CHILD_EXITING_TOO_FAST,
+            manager_->exit_code());
+}
+
+TEST_F(SessionManagerProcessTest, BadExitChildGovernorReboots) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  MockRespawnGovernor governor;
+  manager_->set_respawn_governor(&governor);
+  ExpectChildJobBoilerplate(job);
+
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(GiveUp()));
+  EXPECT_CALL(governor, OnBrowserExitingTooFast())
+      .WillOnce(Return(RespawnGovernor::REBOOT));
+  EXPECT_CALL(utils_,
+              CallMethodOnPowerManager(
+                  StrEq(power_manager::kRequestRestartMethod)))
+      .Times(1);
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(false));
+
+  MockChildProcess proc(kDummyPid, PackStatus(kExit), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+  SimpleRunManager();
+  EXPECT_EQ(SessionManagerService::DONT_RESPAWN, manager_->exit_code());
+}
+
+TEST_F(SessionManagerProcessTest, BadExitChildRestartsAfterBackoff) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  ExpectLivenessChecking();
+  ExpectOneTimeArgsBoilerplate(job);
+
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartAfter(base::TimeDelta::FromMilliseconds(10))))
+      .WillOnce(Return(GiveUp()));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(false));
+
+  MockChildProcess proc(kDummyPid, PackStatus(kExit), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())))
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+  SimpleRunManager();
+}
+
+TEST_F(SessionManagerProcessTest, DegradedFlagsPassedOnce) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  ExpectChildJobBoilerplate(job);
+
+  std::vector<std::string> degraded_flags;
+  degraded_flags.push_back("--disable-gpu");
+  EXPECT_CALL(*restart_policy_, GetDegradedFlags())
+      .WillRepeatedly(Return(degraded_flags));
+  EXPECT_CALL(*job, SetOneTimeArguments(ContainerEq(degraded_flags)))
+      .Times(1);
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(GiveUp()));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(false));
+
+  MockChildProcess proc(kDummyPid, PackStatus(kExit), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+  SimpleRunManager();
+}
+
 TEST_F(SessionManagerProcessTest, CleanExitChild) {
   MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
   ExpectChildJobBoilerplate(job);
 
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -413,13 +585,56 @@ TEST_F(SessionManagerProcessTest, CleanExitChild) {
   SimpleRunManager();
 }
 
+TEST_F(SessionManagerProcessTest, RequestedRestartIsNotAnExit) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  ExpectLivenessChecking();
+  ExpectOneTimeArgsBoilerplate(job);
+  manager_->test_api().set_exit_on_child_done(true);
+  ExpectSuccessfulInitialization();
+  ExpectShutdown();
+
+  // The browser killed for the restart doesn't count as exiting; only the
+  // second one does.
+  EXPECT_CALL(*job, SetExtraArguments(_)).Times(1);
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, Reset()).Times(1);
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(GiveUp()));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(false));
+
+  MockChildProcess killed(kDummyPid, PackSignal(SIGKILL),
+                          manager_->test_api());
+  MockChildProcess proc(kDummyPid, PackStatus(kExit), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(InvokeWithoutArgs(
+                          this, &SessionManagerProcessTest::PostBrowserRestart),
+                      Invoke(&killed, &MockChildProcess::ScheduleExit),
+                      Return(killed.pid())))
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+
+  // Mimic successful cleanup of children, as SimpleRunManager() does.
+  EXPECT_CALL(utils_, kill(_, _, _))
+      .Times(AtMost(1))
+      .WillRepeatedly(WithArgs<0,2>(Invoke(::kill)));
+  EXPECT_CALL(utils_, ChildIsGone(_, _))
+      .Times(AtMost(1))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(utils_, kill(-kDummyPid, _, SIGKILL))
+      .WillOnce(Return(0))
+      .RetiresOnSaturation();
+
+  MockUtils();
+  manager_->Run();
+}
+
 TEST_F(SessionManagerProcessTest, LockedExit) {
   MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
   ExpectChildJobBoilerplate(job);
   // Let the manager cause the clean exit.
   manager_->test_api().set_exit_on_child_done(false);
 
-  EXPECT_CALL(*job, ShouldStop())
+  EXPECT_CALL(*restart_policy_, OnExit())
       .Times(0);
 
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
@@ -432,6 +647,69 @@ TEST_F(SessionManagerProcessTest, LockedExit) {
   SimpleRunManager();
 }
 
+TEST_F(SessionManagerProcessTest, LockedRecovery) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  ExpectOneTimeArgsBoilerplate(job);
+  ExpectLivenessChecking();
+  manager_->set_use_locked_recovery(true);
+
+  // The first crash restarts the browser into the lock screen, and counts
+  // towards the restart policy.
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit()).WillOnce(Return(RestartNow()));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*session_manager_impl_, IsRecoveringLock())
+      .WillOnce(Return(false))
+      .WillOnce(Return(false))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*session_manager_impl_, StartLockedRecovery()).Times(1);
+  std::vector<std::string> one_time_args;
+  one_time_args.push_back(SessionManagerService::kStartLockedFlag);
+  EXPECT_CALL(*job, SetOneTimeArguments(ContainerEq(one_time_args)))
+      .Times(1);
+
+  // Crashing again before the lock screen is up ends the session.
+  MockChildProcess proc(kDummyPid, PackSignal(SIGSEGV), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())))
+      .WillOnce(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                      Return(proc.pid())));
+  SimpleRunManager();
+  EXPECT_EQ(SessionManagerService::CRASH_WHILE_SCREEN_LOCKED,
+            manager_->exit_code());
+}
+
+TEST_F(SessionManagerProcessTest, LockedRecoveryGivesUp) {
+  MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
+  ExpectOneTimeArgsBoilerplate(job);
+  ExpectLivenessChecking();
+  manager_->set_use_locked_recovery(true);
+
+  // The lock screen comes back up every time, but the browser keeps crashing
+  // until the restart policy gives up on it, which ends the session.
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(3);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(GiveUp()));
+  EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*session_manager_impl_, IsRecoveringLock())
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*session_manager_impl_, StartLockedRecovery()).Times(2);
+
+  MockChildProcess proc(kDummyPid, PackSignal(SIGSEGV), manager_->test_api());
+  EXPECT_CALL(utils_, fork())
+      .Times(3)
+      .WillRepeatedly(DoAll(Invoke(&proc, &MockChildProcess::ScheduleExit),
+                            Return(proc.pid())));
+  SimpleRunManager();
+  EXPECT_EQ(SessionManagerService::CRASH_WHILE_SCREEN_LOCKED,
+            manager_->exit_code());
+}
+
 TEST_F(SessionManagerProcessTest, FirstExecAfterBootFlagUsedOnce) {
   // job should run, die, and get run again.  On its first run, it should
   // have a one-time-flag.  That should get cleared and not used again.
@@ -448,10 +726,10 @@ TEST_F(SessionManagerProcessTest, FirstExecAfterBootFlagUsedOnce) {
   EXPECT_CALL(*job, ClearOneTimeArguments()).Times(2);
 
   ExpectLivenessChecking();
-  EXPECT_CALL(*job, RecordTime()).Times(2);
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(false))
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -472,10 +750,10 @@ TEST_F(SessionManagerProcessTest, LivenessCheckingStartStop) {
     EXPECT_CALL(*liveness_checker_, Start()).Times(2);
     EXPECT_CALL(*liveness_checker_, Stop()).Times(AtLeast(2));
   }
-  EXPECT_CALL(*job, RecordTime()).Times(2);
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(false))
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -491,8 +769,8 @@ TEST_F(SessionManagerProcessTest, LivenessCheckingStartStop) {
 TEST_F(SessionManagerProcessTest, MustStopChild) {
   MockChildJob* job = CreateMockJobWithRestartPolicy(ALWAYS);
   ExpectChildJobBoilerplate(job);
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
   MockChildProcess proc(kDummyPid, 0, manager_->test_api());
@@ -509,8 +787,8 @@ TEST_F(SessionManagerProcessTest, StatsRecorded) {
   EXPECT_CALL(*metrics_, RecordStats(StrEq(("chrome-exec"))))
       .Times(1);
 
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
@@ -557,10 +835,10 @@ TEST_F(SessionManagerProcessTest, InSessionFlagsSpecified) {
   EXPECT_CALL(*job, SetExtraArguments(_)).Times(1);
 
   ExpectLivenessChecking();
-  EXPECT_CALL(*job, RecordTime()).Times(2);
-  EXPECT_CALL(*job, ShouldStop())
-      .WillOnce(Return(false))
-      .WillOnce(Return(true));
+  EXPECT_CALL(*restart_policy_, RecordStart()).Times(2);
+  EXPECT_CALL(*restart_policy_, OnExit())
+      .WillOnce(Return(RestartNow()))
+      .WillOnce(Return(GiveUp()));
   EXPECT_CALL(*session_manager_impl_, ScreenIsLocked())
       .WillRepeatedly(Return(false));
 
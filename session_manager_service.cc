@@ -34,6 +34,7 @@
 #include <base/message_loop_proxy.h>
 #include <base/posix/eintr_wrapper.h>
 #include <base/run_loop.h>
+#include <base/sequenced_task_runner.h>
 #include <base/stl_util.h>
 #include <base/string_util.h>
 #include <base/time.h>
@@ -42,7 +43,11 @@
 #include <chromeos/dbus/service_constants.h>
 #include <chromeos/utility.h>
 
+#include "login_manager/browser_channel.h"
+#include "login_manager/browser_heartbeat.h"
 #include "login_manager/child_job.h"
+#include "login_manager/child_output_logger.h"
+#include "login_manager/crash_collection_watcher.h"
 #include "login_manager/dbus_glib_shim.h"
 #include "login_manager/device_local_account_policy_service.h"
 #include "login_manager/device_management_backend.pb.h"
@@ -52,7 +57,10 @@
 #include "login_manager/nss_util.h"
 #include "login_manager/policy_store.h"
 #include "login_manager/regen_mitigator.h"
+#include "login_manager/self_profiler.h"
 #include "login_manager/session_manager_impl.h"
+#include "login_manager/session_teardown.h"
+#include "login_manager/signal_coalescer.h"
 #include "login_manager/system_utils.h"
 
 // Forcibly namespace the dbus-bindings generated server bindings instead of
@@ -66,6 +74,23 @@ namespace gobject {  // NOLINT
 namespace em = enterprise_management;
 namespace login_manager {
 
+namespace {
+
+// Names of the files under ChildOutputLogger::kLogDir that supervised
+// children's output goes to.
+const char kBrowserLogName[] = "chrome";
+const char kKeygenLogName[] = "keygen";
+const char kChildLogExtension[] = "out";
+// The browser's last output is saved here when it crashes or gets aborted.
+const char kCrashTailExtension[] = "crash-tail";
+
+// Matches NameOwnerChanged for names that have gone away.
+const char kNameLostMatch[] =
+    "type='signal',sender='" DBUS_SERVICE_DBUS "',"
+    "interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged',arg2=''";
+
+}  // namespace
+
 int g_shutdown_pipe_write_fd = -1;
 int g_shutdown_pipe_read_fd = -1;
 
@@ -118,17 +143,25 @@ void SessionManagerService::SIGTERMHandler(int signal) {
 const char SessionManagerService::kFirstExecAfterBootFlag[] =
     "--first-exec-after-boot";
 
+const char SessionManagerService::kStartLockedFlag[] = "--start-screen-locked";
+
+const int SessionManagerService::kLockedRecoveryTimeoutSeconds = 30;
+
+const int SessionManagerService::kMemoryTrimDelaySeconds = 60;
+
 const char SessionManagerService::kFlagFileDir[] = "/var/run/session_manager";
 
 // TODO(mkrebs): Remove CollectChrome timeout and file when
 // crosbug.com/5872 is fixed.
 // When crash-reporter based crash reporting of Chrome is enabled
-// (which should only be during test runs) we use
-// kKillTimeoutCollectChrome instead of the kill timeout specified at
-// the command line.
+// (which should only be during test runs), children that are still around
+// after the kill timeout specified at the command line are given up to
+// kKillTimeoutCollectChrome more seconds, but only while their crash is
+// actually being collected.
 const int SessionManagerService::kKillTimeoutCollectChrome = 60;
 const char SessionManagerService::kCollectChromeFile[] =
     "/mnt/stateful_partition/etc/collect_chrome_crashes";
+const int SessionManagerService::kCrashCollectionPollSeconds = 1;
 
 namespace {
 
@@ -154,6 +187,7 @@ SessionManagerService::SessionManagerService(
     base::TimeDelta hang_detection_interval,
     SystemUtils* utils)
     : browser_(child_job.Pass()),
+      browser_restart_requested_(false),
       exit_on_child_done_(false),
       kill_timeout_(kill_timeout),
       session_manager_(NULL),
@@ -164,10 +198,20 @@ SessionManagerService::SessionManagerService(
       nss_(NssUtil::Create()),
       key_gen_(new KeyGenerator(utils, this)),
       login_metrics_(NULL),
+      use_browser_heartbeat_(false),
+      use_browser_channel_(false),
+      use_native_teardown_(false),
+      use_locked_recovery_(false),
+      use_policy_container_(false),
+      policy_signal_window_(base::TimeDelta::FromMilliseconds(
+          SignalCoalescer::kDefaultWindowMs)),
       liveness_checker_(NULL),
+      restart_policy_(new RestartPolicy(RestartPolicy::Config(), utils)),
       enable_browser_abort_on_hang_(enable_browser_abort_on_hang),
       liveness_checking_interval_(hang_detection_interval),
+      tunables_(NULL),
       set_uid_(false),
+      respawn_governor_(NULL),
       shutting_down_(false),
       shutdown_already_(false),
       exit_code_(SUCCESS) {
@@ -180,8 +224,11 @@ SessionManagerService::SessionManagerService(
 }
 
 SessionManagerService::~SessionManagerService() {
+  if (tunables_)
+    tunables_->RemoveObserver(this);
   if (main_loop_)
     g_main_loop_unref(main_loop_);
+  browser_channel_.reset();
   if (session_manager_)
     g_object_unref(session_manager_);
 
@@ -190,6 +237,13 @@ SessionManagerService::~SessionManagerService() {
   RevertHandlers();
 }
 
+void SessionManagerService::set_tunables(Tunables* tunables) {
+  if (tunables_)
+    tunables_->RemoveObserver(this);
+  tunables_ = tunables;
+  tunables_->AddObserver(this);
+}
+
 bool SessionManagerService::Initialize() {
   // Install the type-info for the service with dbus.
   dbus_g_object_type_install_info(
@@ -251,22 +305,53 @@ bool SessionManagerService::Initialize() {
     PLOG(ERROR) << "Cannot create flag file directory at " << kFlagFileDir;
     return false;
   }
-  login_metrics_.reset(new LoginMetrics(flag_file_dir));
+  per_boot_state_.reset(
+      new PerBootState(flag_file_dir.Append(PerBootState::kStateFileName)));
+  if (!per_boot_state_->Initialize())
+    LOG(WARNING) << "Per-boot state will not survive a restart.";
+  login_metrics_.reset(new LoginMetrics(per_boot_state_.get()));
+
+  const FilePath child_log_dir(ChildOutputLogger::kLogDir);
+  browser_output_.reset(
+      new ChildOutputLogger(kBrowserLogName,
+                            child_log_dir.Append(kBrowserLogName)
+                                .AddExtension(kChildLogExtension),
+                            ChildOutputLogger::Config()));
+  keygen_output_.reset(
+      new ChildOutputLogger(kKeygenLogName,
+                            child_log_dir.Append(kKeygenLogName)
+                                .AddExtension(kChildLogExtension),
+                            ChildOutputLogger::Config()));
+  key_gen_->set_output_logger(keygen_output_.get());
+
+  machine_info_.reset(new MachineInfo(FilePath(MachineInfo::kMachineInfoFile)));
 
   // Initially store in derived-type pointer, so that we can initialize
   // appropriately below, and also use as delegate for device_policy_.
   SessionManagerImpl* impl =
       new SessionManagerImpl(
           scoped_ptr<UpstartSignalEmitter>(new UpstartSignalEmitter),
-          this, login_metrics_.get(), nss_.get(), system_);
+          this, login_metrics_.get(), nss_.get(), per_boot_state_.get(),
+          system_);
 
   // The below require loop_proxy_, created in Reset(), to be set already.
-  liveness_checker_.reset(
+  LivenessCheckerImpl* liveness_checker =
       new LivenessCheckerImpl(this,
                               system_,
                               loop_proxy_,
                               enable_browser_abort_on_hang_,
-                              liveness_checking_interval_));
+                              liveness_checking_interval_);
+  if (use_browser_heartbeat_) {
+    heartbeat_.reset(new BrowserHeartbeat);
+    if (heartbeat_->Initialize()) {
+      browser_.job->SetHeartbeatFd(heartbeat_->fd());
+      liveness_checker->set_heartbeat(heartbeat_.get());
+    } else {
+      LOG(WARNING) << "Browser heartbeat unavailable, pinging over D-Bus.";
+      heartbeat_.reset();
+    }
+  }
+  liveness_checker_.reset(liveness_checker);
 
 
   owner_key_.reset(new PolicyKey(nss_->GetOwnerKeyFilePath(), nss_.get()));
@@ -278,19 +363,34 @@ bool SessionManagerService::Initialize() {
                                                nss_.get(),
                                                loop_proxy_);
   device_policy_->set_delegate(impl);
+  // Device policy is written at sign-in and on every policy fetch; keep the
+  // main loop free to answer the browser meanwhile.
+  device_policy_->set_io_runner(system_->async_file_io()->GetTaskRunnerForPath(
+      FilePath(DevicePolicyService::kPolicyPath)));
 
   scoped_ptr<UserPolicyServiceFactory> user_policy_factory(
       new UserPolicyServiceFactory(getuid(), loop_proxy_, nss_.get(), system_));
+  user_policy_factory->set_use_policy_container(use_policy_container_);
+  user_policy_factory->set_metrics(login_metrics_.get());
   scoped_ptr<DeviceLocalAccountPolicyService> device_local_account_policy(
       new DeviceLocalAccountPolicyService(FilePath(kDeviceLocalAccountStateDir),
                                           owner_key_.get(),
                                           loop_proxy_));
+  device_local_account_policy->set_use_policy_container(use_policy_container_);
+  device_local_account_policy->set_metrics(login_metrics_.get());
   impl->InjectPolicyServices(device_policy_,
                              user_policy_factory.Pass(),
                              device_local_account_policy.Pass());
+  impl->InjectSignalCoalescer(scoped_ptr<SignalCoalescer>(
+      new SignalCoalescer(system_, loop_proxy_, policy_signal_window_)));
+  impl->set_tunables(tunables_);
+  impl->InjectProfiler(scoped_ptr<SelfProfiler>(
+      new SelfProfiler(system_, loop_proxy_,
+                       FilePath(ChildOutputLogger::kLogDir))));
   impl_.reset(impl);
 
   // Wire impl to dbus-glib glue.
+  browser_channel_.reset();
   if (session_manager_)
     g_object_unref(session_manager_);
   session_manager_ =
@@ -298,6 +398,20 @@ bool SessionManagerService::Initialize() {
           g_object_new(gobject::session_manager_get_type(), NULL));
   session_manager_->impl = impl_.get();
 
+  // The browser still gets the system bus address from the environment, so
+  // one that can't use the private connection keeps working.
+  if (use_browser_channel_) {
+    browser_channel_.reset(new BrowserChannel(this,
+                                              G_OBJECT(session_manager_),
+                                              kSessionManagerServicePath));
+    if (browser_channel_->Initialize()) {
+      browser_.job->SetSessionManagerAddress(browser_channel_->address());
+    } else {
+      LOG(WARNING) << "Browser channel unavailable, using the system bus.";
+      browser_channel_.reset();
+    }
+  }
+
   return true;
 }
 
@@ -313,9 +427,13 @@ bool SessionManagerService::Register(
   DBusError error;
   ::dbus_error_init(&error);
   ::dbus_bus_add_match(conn, filter.c_str(), &error);
+  // Clients that leave the bus have their device settings watches dropped.
+  if (!::dbus_error_is_set(&error))
+    ::dbus_bus_add_match(conn, kNameLostMatch, &error);
   if (::dbus_error_is_set(&error)) {
     LOG(WARNING) << "Failed to add match to bus: " << error.name << ", message="
                  << (error.message ? error.message : "unknown error");
+    ::dbus_error_free(&error);
     return false;
   }
   if (!::dbus_connection_add_filter(conn,
@@ -342,11 +460,14 @@ bool SessionManagerService::Reset() {
   return true;
 }
 
-int SessionManagerService::GetKillTimeout() {
-  if (file_util::PathExists(FilePath(kCollectChromeFile)))
-    return kKillTimeoutCollectChrome;
-  else
-    return kill_timeout_;
+void SessionManagerService::WatchCrashCollectionIfNeeded() {
+  if (crash_watcher_.get() ||
+      !file_util::PathExists(FilePath(kCollectChromeFile))) {
+    return;
+  }
+  crash_watcher_.reset(CrashCollectionWatcher::CreateDefault());
+  // Without inotify, the state of processes is still checked.
+  crash_watcher_->Initialize();
 }
 
 bool SessionManagerService::Run() {
@@ -375,14 +496,25 @@ bool SessionManagerService::Run() {
   if (device_policy_)
     browser_.job->SetExtraArguments(device_policy_->GetStartUpFlags());
 
-  if (ShouldRunBrowser())  // Allows devs to start/stop browser manually.
-    RunBrowser();
+  // OOBE and enrollment read the machine info as soon as they come up, so the
+  // browser is held until it's in place. The rest of the loop runs meanwhile.
+  if (machine_info_.get() && device_policy_ &&
+      device_policy_->MachineInfoNeeded()) {
+    machine_info_->GenerateAsync(
+        base::Bind(&SessionManagerService::RunBrowserOnStartup, this));
+  } else {
+    RunBrowserOnStartup();
+  }
 
   base::RunLoop run_loop;
   quit_closure_ = run_loop.QuitClosure();
   run_loop.Run();  // Will return when quit_closure_ is posted and run.
-  CleanupChildren(GetKillTimeout());
+  WatchCrashCollectionIfNeeded();
+  CleanupChildren(kill_timeout_);
+  if (use_native_teardown_)
+    TearDownSession();
   impl_->AnnounceSessionStopped();
+  login_metrics_->Flush();
   return true;
 }
 
@@ -390,8 +522,101 @@ bool SessionManagerService::ShouldRunBrowser() {
   return !file_checker_.get() || !file_checker_->exists();
 }
 
-bool SessionManagerService::ShouldStopChild(ChildJobInterface* child_job) {
-  return child_job->ShouldStop();
+void SessionManagerService::HandleBrowserExitingTooFast() {
+  if (!respawn_governor_) {
+    LOG(WARNING) << "Child stopped, shutting down";
+    SetExitAndShutdown(CHILD_EXITING_TOO_FAST);
+    return;
+  }
+  switch (respawn_governor_->OnBrowserExitingTooFast()) {
+    case RespawnGovernor::RESTART_BROWSER:
+      restart_policy_->Reset();
+      if (ShouldRunBrowser())
+        RunBrowser();
+      else
+        AllowGracefulExit();
+      break;
+    case RespawnGovernor::REBOOT:
+      system_->CallMethodOnPowerManager(power_manager::kRequestRestartMethod);
+      SetExitAndShutdown(DONT_RESPAWN);
+      break;
+    case RespawnGovernor::RESTART_SELF:
+      SetExitAndShutdown(CHILD_EXITING_TOO_FAST);
+      break;
+    default:
+      NOTREACHED();
+  }
+}
+
+void SessionManagerService::ScheduleBrowserRestart(base::TimeDelta delay) {
+  if (delay == base::TimeDelta()) {
+    RunBrowser();
+    return;
+  }
+  LOG(INFO) << "Restarting " << browser_.job->GetName() << " in "
+            << delay.InMilliseconds() << "ms";
+  // The old browser is gone; make sure nothing tries to signal its pid while
+  // the new one is pending.
+  browser_.pid = -1;
+  loop_proxy_->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&SessionManagerService::RunBrowserAfterBackoff, this),
+      delay);
+}
+
+void SessionManagerService::RunBrowserOnStartup() {
+  if (shutting_down_ || browser_.pid > 0)
+    return;
+  if (ShouldRunBrowser())  // Allows devs to start/stop browser manually.
+    RunBrowser();
+}
+
+void SessionManagerService::RunBrowserAfterBackoff() {
+  if (shutting_down_ || browser_.pid > 0)
+    return;
+  if (ShouldRunBrowser())
+    RunBrowser();
+  else
+    AllowGracefulExit();
+}
+
+bool SessionManagerService::RecoverLockedSession() {
+  // A browser that can't even get the lock screen back up once isn't given
+  // another go with the session still unlocked underneath.
+  if (!use_locked_recovery_ || impl_->IsRecoveringLock() || !ShouldRunBrowser())
+    return false;
+  // Nor is one that keeps crashing after getting the lock screen back up.
+  const RestartPolicy::Decision decision = restart_policy_->OnExit();
+  if (decision.give_up) {
+    LOG(ERROR) << "Browser keeps crashing with the screen locked";
+    return false;
+  }
+  impl_->StartLockedRecovery();
+  liveness_checker_->Stop();
+  // Unretained, as holding a reference from a member would be a cycle; the
+  // pending task is cancelled along with |locked_recovery_timeout_|.
+  locked_recovery_timeout_.Reset(
+      base::Bind(&SessionManagerService::OnLockedRecoveryTimeout,
+                 base::Unretained(this)));
+  loop_proxy_->PostDelayedTask(
+      FROM_HERE,
+      locked_recovery_timeout_.callback(),
+      decision.delay +
+          base::TimeDelta::FromSeconds(kLockedRecoveryTimeoutSeconds));
+  ScheduleBrowserRestart(decision.delay);
+  return true;
+}
+
+void SessionManagerService::OnLockedRecoveryTimeout() {
+  if (shutting_down_ || !impl_->IsRecoveringLock())
+    return;
+  LOG(ERROR) << "Lock screen not shown in time, shutting down";
+  SetExitAndShutdown(CRASH_WHILE_SCREEN_LOCKED);
+}
+
+void SessionManagerService::TrimMemory() {
+  if (!shutting_down_)
+    impl_->TrimMemory();
 }
 
 bool SessionManagerService::Shutdown() {
@@ -408,25 +633,33 @@ void SessionManagerService::ScheduleShutdown() {
 void SessionManagerService::RunBrowser() {
   bool first_boot = !login_metrics_->HasRecordedChromeExec();
 
-  login_metrics_->RecordStats("chrome-exec");
-  if (first_boot) {
-    std::vector<std::string> one_time_args;
+  login_metrics_->RecordStats(LoginMetrics::kChromeExecTag);
+  std::vector<std::string> one_time_args = restart_policy_->GetDegradedFlags();
+  if (first_boot)
     one_time_args.push_back(kFirstExecAfterBootFlag);
+  if (impl_->IsRecoveringLock())
+    one_time_args.push_back(kStartLockedFlag);
+  if (!one_time_args.empty())
     browser_.job->SetOneTimeArguments(one_time_args);
-  }
   LOG(INFO) << "Running child " << browser_.job->GetName() << "...";
   browser_.pid = RunChild(browser_.job.get());
   liveness_checker_->Start();
 }
 
 int SessionManagerService::RunChild(ChildJobInterface* child_job) {
-  child_job->RecordTime();
+  restart_policy_->RecordStart();
+  const bool capture_output =
+      browser_output_.get() && browser_output_->CreatePipes();
   pid_t pid = system_->fork();
   if (pid == 0) {
     RevertHandlers();
+    if (capture_output)
+      browser_output_->AttachToChild();
     child_job->Run();
     exit(ChildJobInterface::kCantExec);  // Run() is not supposed to return.
   }
+  if (capture_output)
+    browser_output_->StartWatching();
   child_job->ClearOneTimeArguments();
 
   browser_.watcher = g_child_watch_add_full(G_PRIORITY_HIGH_IDLE,
@@ -438,7 +671,8 @@ int SessionManagerService::RunChild(ChildJobInterface* child_job) {
 }
 
 void SessionManagerService::AbortBrowser(int signal) {
-  KillChild(browser_.job.get(), browser_.pid, signal);
+  if (browser_.pid > 0)
+    KillChild(browser_.job.get(), browser_.pid, signal);
 }
 
 void SessionManagerService::RestartBrowserWithArgs(
@@ -447,7 +681,11 @@ void SessionManagerService::RestartBrowserWithArgs(
   // We're killing it immediately hoping that data Chrome uses before
   // logging in is not corrupted.
   // TODO(avayvod): Remove RestartJob when crosbug.com/6924 is fixed.
-  KillChild(browser_.job.get(), browser_.pid, SIGKILL);
+  // If a restart is already pending, it will pick up the new arguments.
+  if (browser_.pid > 0) {
+    browser_restart_requested_ = true;
+    KillChild(browser_.job.get(), browser_.pid, SIGKILL);
+  }
   if (args_are_extra)
     browser_.job->SetExtraArguments(args);
   else
@@ -458,7 +696,19 @@ void SessionManagerService::RestartBrowserWithArgs(
 void SessionManagerService::SetBrowserSessionForUser(
     const std::string& username,
     const std::string& userhash) {
+  // The machine info must not outlive the login screen.
+  if (machine_info_.get())
+    machine_info_->Remove();
   browser_.job->StartSession(username, userhash);
+
+  // Another user joining the session pushes the trim back. Unretained for the
+  // same reason as in RecoverLockedSession().
+  memory_trim_.Reset(base::Bind(&SessionManagerService::TrimMemory,
+                                base::Unretained(this)));
+  loop_proxy_->PostDelayedTask(
+      FROM_HERE,
+      memory_trim_.callback(),
+      base::TimeDelta::FromSeconds(kMemoryTrimDelaySeconds));
 }
 
 void SessionManagerService::SetFlagsForUser(
@@ -505,6 +755,22 @@ void SessionManagerService::ProcessNewOwnerKey(const std::string& username,
   impl_->ImportValidateAndStoreGeneratedKey(username, key_file);
 }
 
+void SessionManagerService::OnTunableChanged(const Tunable& tunable) {
+  if (tunable.name() == Tunables::kKillTimeout) {
+    kill_timeout_ = tunable.value();
+  } else if (tunable.name() == Tunables::kHangDetectionInterval) {
+    liveness_checking_interval_ = base::TimeDelta::FromSeconds(tunable.value());
+    if (liveness_checker_.get())
+      liveness_checker_->SetInterval(liveness_checking_interval_);
+  } else if (tunable.name() == Tunables::kRestartTries ||
+             tunable.name() == Tunables::kRestartWindow) {
+    const Tunable* tries = tunables_->Get(Tunables::kRestartTries);
+    const Tunable* window = tunables_->Get(Tunables::kRestartWindow);
+    if (tries && window)
+      restart_policy_->SetRestartLimit(tries->value(), window->value());
+  }
+}
+
 bool SessionManagerService::IsBrowser(pid_t pid) {
   return pid == browser_.pid;
 }
@@ -553,19 +819,39 @@ void SessionManagerService::HandleBrowserExit(GPid pid,
 
   LOG(ERROR) << StringPrintf("Process %s(%d) exited.",
                              child_job->GetName().c_str(), pid);
+  const bool restart_requested = manager->browser_restart_requested_;
+  manager->browser_restart_requested_ = false;
+  // Crashes and hang aborts both end in a signal; keep the last words around
+  // for the report.
+  if (WIFSIGNALED(status) && !restart_requested &&
+      manager->browser_output_.get()) {
+    manager->browser_output_->StopWatching();
+    manager->browser_output_->DumpTail(
+        FilePath(ChildOutputLogger::kLogDir).Append(kBrowserLogName)
+            .AddExtension(kCrashTailExtension));
+  }
   if (manager->impl_->ScreenIsLocked()) {
+    if (manager->RecoverLockedSession())
+      return;
     LOG(ERROR) << "Screen locked, shutting down";
     manager->SetExitAndShutdown(CRASH_WHILE_SCREEN_LOCKED);
     return;
   }
 
   manager->liveness_checker_->Stop();
-  if (manager->ShouldStopChild(child_job)) {
-    LOG(WARNING) << "Child stopped, shutting down";
-    manager->SetExitAndShutdown(CHILD_EXITING_TOO_FAST);
+  RestartPolicy::Decision decision;
+  if (restart_requested) {
+    // Killed on request, e.g. for a guest login; that is no reason to back
+    // off or to degrade the browser.
+    manager->restart_policy_->Reset();
+  } else {
+    decision = manager->restart_policy_->OnExit();
+  }
+  if (decision.give_up) {
+    manager->HandleBrowserExitingTooFast();
   } else if (manager->ShouldRunBrowser()) {
     // TODO(cmasone): deal with fork failing in RunBrowser()
-    manager->RunBrowser();
+    manager->ScheduleBrowserRestart(decision.delay);
   } else {
     LOG(INFO) << StringPrintf(
         "Should NOT run %s again...", child_job->GetName().data());
@@ -590,6 +876,8 @@ void SessionManagerService::Finalize() {
   liveness_checker_->Stop();
   impl_->AnnounceSessionStoppingIfNeeded();
   impl_->Finalize();
+  if (machine_info_.get())
+    machine_info_->Remove();
 }
 
 void SessionManagerService::SetExitAndShutdown(ExitCode code) {
@@ -605,6 +893,21 @@ DBusHandlerResult SessionManagerService::FilterMessage(DBusConnection* conn,
                                                        DBusMessage* message,
                                                        void* data) {
   SessionManagerService* service = static_cast<SessionManagerService*>(data);
+  if (::dbus_message_is_signal(message, DBUS_INTERFACE_DBUS,
+                               "NameOwnerChanged")) {
+    const char* name = NULL;
+    const char* old_owner = NULL;
+    const char* new_owner = NULL;
+    if (::dbus_message_get_args(message, NULL,
+                                DBUS_TYPE_STRING, &name,
+                                DBUS_TYPE_STRING, &old_owner,
+                                DBUS_TYPE_STRING, &new_owner,
+                                DBUS_TYPE_INVALID) &&
+        !*new_owner && service->impl_.get()) {
+      service->impl_->OnNameLost(name);
+    }
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
   if (::dbus_message_is_method_call(message,
                                     service->service_interface(),
                                     kSessionManagerRestartJob)) {
@@ -696,6 +999,16 @@ void SessionManagerService::KillAndRemember(const ChildJob::Spec& spec,
 }
 
 void SessionManagerService::CleanupChildren(int timeout) {
+  // The main loop isn't running anymore, so keep draining the children's
+  // output meanwhile; a child blocked on a full pipe can't exit.
+  ChildOutputLogger* const loggers[] = {
+    browser_output_.get(), keygen_output_.get()
+  };
+  for (size_t i = 0; i < arraysize(loggers); ++i) {
+    if (loggers[i])
+      loggers[i]->StartBackgroundDrain();
+  }
+
   PidUidPairList pids_to_abort;
   KillAndRemember(browser_, &pids_to_abort);
   KillAndRemember(generator_, &pids_to_abort);
@@ -704,7 +1017,7 @@ void SessionManagerService::CleanupChildren(int timeout) {
        it != pids_to_abort.end(); ++it) {
     const pid_t pid = it->first;
     const uid_t uid = it->second;
-    if (!system_->ChildIsGone(pid, timeout)) {
+    if (!system_->ChildIsGone(pid, timeout) && !WaitForCrashCollection(pid)) {
       LOG(WARNING) << "Killing child process " << pid << " " << timeout
                    << " seconds after sending TERM signal";
       system_->kill(pid, uid, SIGABRT);
@@ -712,6 +1025,44 @@ void SessionManagerService::CleanupChildren(int timeout) {
       DLOG(INFO) << "Cleaned up child " << pid;
     }
   }
+
+  for (size_t i = 0; i < arraysize(loggers); ++i) {
+    if (loggers[i]) {
+      loggers[i]->StopBackgroundDrain();
+      loggers[i]->StopWatching();
+    }
+  }
+}
+
+bool SessionManagerService::WaitForCrashCollection(pid_t pid) {
+  if (!crash_watcher_.get())
+    return false;
+  for (int waited = 0;
+       waited < kKillTimeoutCollectChrome && crash_watcher_->IsCollecting(pid);
+       waited += kCrashCollectionPollSeconds) {
+    LOG_IF(INFO, waited == 0) << "Waiting for crash collection of " << pid;
+    if (system_->ChildIsGone(pid, kCrashCollectionPollSeconds))
+      return true;
+  }
+  return false;
+}
+
+void SessionManagerService::TearDownSession() {
+  // Without a uid, the session's processes would be root's.
+  if (!set_uid_) {
+    LOG(WARNING) << "No session uid, leaving teardown to ui.conf";
+    return;
+  }
+  scoped_ptr<SessionTeardown> teardown(
+      SessionTeardown::CreateDefault(uid_, system_, login_metrics_.get()));
+  if (!teardown->Run()) {
+    LOG(WARNING) << "Processes survived session teardown, leaving the rest "
+                 << "to ui.conf";
+    return;
+  }
+  const FilePath done_file(SessionTeardown::kDoneFile);
+  if (file_util::WriteFile(done_file, "", 0) != 0)
+    PLOG(WARNING) << "Can't create " << done_file.value();
 }
 
 void SessionManagerService::DeregisterChildWatchers() {
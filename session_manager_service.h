@@ -17,6 +17,7 @@
 
 #include <base/basictypes.h>
 #include <base/callback_forward.h>
+#include <base/cancelable_callback.h>
 #include <base/file_path.h>
 #include <base/memory/ref_counted.h>
 #include <base/memory/scoped_ptr.h>
@@ -33,11 +34,16 @@
 #include "login_manager/key_generator.h"
 #include "login_manager/liveness_checker.h"
 #include "login_manager/login_metrics.h"
+#include "login_manager/machine_info.h"
 #include "login_manager/owner_key_loss_mitigator.h"
+#include "login_manager/per_boot_state.h"
 #include "login_manager/policy_key.h"
 #include "login_manager/process_manager_service_interface.h"
+#include "login_manager/respawn_governor.h"
+#include "login_manager/restart_policy.h"
 #include "login_manager/session_manager_impl.h"
 #include "login_manager/session_manager_interface.h"
+#include "login_manager/tunables.h"
 #include "login_manager/upstart_signal_emitter.h"
 #include "login_manager/user_policy_service_factory.h"
 
@@ -52,7 +58,11 @@ namespace gobject {
 struct SessionManager;
 }  // namespace gobject
 
+class BrowserChannel;
+class BrowserHeartbeat;
+class ChildOutputLogger;
 class ChildJobInterface;
+class CrashCollectionWatcher;
 class NssUtil;
 class PolicyService;
 class SystemUtils;
@@ -67,12 +77,16 @@ class SystemUtils;
 class SessionManagerService
     : public base::RefCountedThreadSafe<SessionManagerService>,
       public chromeos::dbus::AbstractDbusService,
-      public login_manager::ProcessManagerServiceInterface {
+      public login_manager::ProcessManagerServiceInterface,
+      public Tunables::Observer {
  public:
   enum ExitCode {
     SUCCESS = 0,
     CRASH_WHILE_SCREEN_LOCKED = 1,
-    CHILD_EXITING_TOO_FAST = 2
+    CHILD_EXITING_TOO_FAST = 2,
+    // The UI must not be respawned, e.g. because a reboot is pending.
+    // Keep in sync with ui-respawn.conf.
+    DONT_RESPAWN = 3
   };
 
   SessionManagerService(scoped_ptr<ChildJobInterface> child_job,
@@ -106,6 +120,9 @@ class SessionManagerService
     void set_session_manager(SessionManagerInterface* impl) {
       session_manager_service_->impl_.reset(impl);
     }
+    void set_crash_watcher(CrashCollectionWatcher* watcher) {
+      session_manager_service_->crash_watcher_.reset(watcher);
+    }
     // Sets whether the the manager exits when a child finishes.
     void set_exit_on_child_done(bool do_exit) {
       session_manager_service_->exit_on_child_done_ = do_exit;
@@ -140,6 +157,48 @@ class SessionManagerService
     file_checker_.reset(file_checker);
   }
 
+  // Has the browser beat on a shared page instead of answering liveness
+  // pings over D-Bus. Must be called before Initialize().
+  void set_use_browser_heartbeat(bool use) { use_browser_heartbeat_ = use; }
+
+  // Serves the browser over a private D-Bus connection as well as the system
+  // bus, see BrowserChannel. Must be called before Initialize().
+  void set_use_browser_channel(bool use) { use_browser_channel_ = use; }
+
+  // Tears the session down on exit rather than leaving it to ui.conf.
+  void set_use_native_teardown(bool use) { use_native_teardown_ = use; }
+
+  // When the browser dies with the screen locked, restarts it straight into
+  // the lock screen, keeping the session, instead of ending the session.
+  void set_use_locked_recovery(bool use) { use_locked_recovery_ = use; }
+
+  // Writes user and device-local account policy in a checksummed container.
+  // Must be called before Initialize().
+  void set_use_policy_container(bool use) { use_policy_container_ = use; }
+
+  // Policy and owner key status signals that come in within |window| of each
+  // other go out as one, see SignalCoalescer. Must be called before
+  // Initialize().
+  void set_policy_signal_window(base::TimeDelta window) {
+    policy_signal_window_ = window;
+  }
+
+  // Takes ownership of |policy|.
+  void set_restart_policy(RestartPolicy* policy) {
+    restart_policy_.reset(policy);
+  }
+
+  // |tunables| is owned by the caller. Changes to the kill timeout, the hang
+  // detection interval and the restart limit take effect right away, and
+  // tunables can be changed over D-Bus. Must be called before Initialize().
+  void set_tunables(Tunables* tunables);
+
+  // |governor| is owned by the caller. Without a governor, the service exits
+  // whenever |restart_policy_| gives up on the browser.
+  void set_respawn_governor(RespawnGovernor* governor) {
+    respawn_governor_ = governor;
+  }
+
   // Can't be "unset".
   void set_uid(uid_t uid) {
     uid_ = uid;
@@ -195,6 +254,9 @@ class SessionManagerService
   virtual void ProcessNewOwnerKey(const std::string& username,
                                   const base::FilePath& key_file) OVERRIDE;
 
+  // Implementing Tunables::Observer
+  virtual void OnTunableChanged(const Tunable& tunable) OVERRIDE;
+
   // Tell us that, if we want, we can cause a graceful exit from g_main_loop.
   void AllowGracefulExit();
 
@@ -211,6 +273,18 @@ class SessionManagerService
   // system boots. Not passed when Chrome is restarted after signout.
   static const char kFirstExecAfterBootFlag[];
 
+  // Flag passed to Chrome when it is restarted after crashing with the screen
+  // locked, so that it comes up showing the lock screen.
+  static const char kStartLockedFlag[];
+
+  // How long the restarted browser has to show the lock screen before the
+  // session is ended after all.
+  static const int kLockedRecoveryTimeoutSeconds;
+
+  // How long after login memory is trimmed, giving the browser time to fetch
+  // policy and the like first.
+  static const int kMemoryTrimDelaySeconds;
+
   // Directory in which per-boot metrics flag files will be stored.
   static const char kFlagFileDir[];
 
@@ -266,20 +340,55 @@ class SessionManagerService
   // later.
   void KillAndRemember(const ChildJob::Spec& spec, PidUidPairList* to_remember);
 
-  // Returns appropriate child-killing timeout, depending on flag file state.
-  int GetKillTimeout();
+  // Starts watching for crash collection if crashes of the browser are being
+  // collected, so that shutdown doesn't abort a child that is being dumped.
+  void WatchCrashCollectionIfNeeded();
 
   // Terminate all children, with increasing prejudice.
   void CleanupChildren(int timeout);
 
+  // Waits for |pid| to go away for as long as its crash is being collected,
+  // up to kKillTimeoutCollectChrome. Returns true if |pid| went away.
+  bool WaitForCrashCollection(pid_t pid);
+
+  // Kills whatever is left of the session once the children are gone, see
+  // SessionTeardown, and leaves SessionTeardown::kDoneFile behind for ui.conf
+  // if that worked.
+  void TearDownSession();
+
   // De-register all child-exit handlers.
   void DeregisterChildWatchers();
 
   bool ShouldRunBrowser();
-  // Returns true if |child_job| believes it should be stopped.
-  // If the child believes it should be stopped (as opposed to not run anymore)
-  // we actually exit the Service as well.
-  bool ShouldStopChild(ChildJobInterface* child_job);
+
+  // Asks |respawn_governor_| how to recover from the browser exiting too fast
+  // and acts on the answer.
+  void HandleBrowserExitingTooFast();
+
+  // Restarts the browser after |delay|, unless the service is shutting down
+  // or the browser shouldn't run anymore by then.
+  void ScheduleBrowserRestart(base::TimeDelta delay);
+
+  // Runs the browser for the first time, unless devs have asked for it not to
+  // be, or shutdown has begun.
+  void RunBrowserOnStartup();
+
+  // Runs the browser, if it's still needed, once a restart delay is over.
+  void RunBrowserAfterBackoff();
+
+  // Restarts the browser into the lock screen after it died with the screen
+  // locked. Each recovery counts as an exit towards |restart_policy_|.
+  // Returns false if that isn't allowed, or the policy gives up on the
+  // browser, in which case the session must end.
+  bool RecoverLockedSession();
+
+  // Ends the session if the browser didn't get back to the lock screen in
+  // time after RecoverLockedSession().
+  void OnLockedRecoveryTimeout();
+
+  // Has |impl_| give back memory it no longer needs, see
+  // SessionManagerInterface::TrimMemory().
+  void TrimMemory();
 
   // Run() particular ChildJobInterface, specified by |child_job|.
   int RunChild(ChildJobInterface* child_job);
@@ -289,8 +398,13 @@ class SessionManagerService
 
   static const int kKillTimeoutCollectChrome;
   static const char kCollectChromeFile[];
+  // How often crash collection progress is checked during shutdown.
+  static const int kCrashCollectionPollSeconds;
 
   ChildJob::Spec browser_;
+  // Set when the browser is killed to restart it with new arguments, so that
+  // its exit doesn't count against |restart_policy_|.
+  bool browser_restart_requested_;
   ChildJob::Spec generator_;
   bool exit_on_child_done_;
   int kill_timeout_;
@@ -304,11 +418,27 @@ class SessionManagerService
 
   SystemUtils* system_;  // Owned by the caller.
   scoped_ptr<NssUtil> nss_;
+  scoped_ptr<ChildOutputLogger> browser_output_;
+  scoped_ptr<ChildOutputLogger> keygen_output_;
   scoped_ptr<KeyGenerator> key_gen_;
+  scoped_ptr<PerBootState> per_boot_state_;
   scoped_ptr<LoginMetrics> login_metrics_;
+  scoped_ptr<CrashCollectionWatcher> crash_watcher_;  // Only during shutdown.
+  bool use_browser_heartbeat_;
+  bool use_browser_channel_;
+  bool use_native_teardown_;
+  bool use_locked_recovery_;
+  base::CancelableClosure locked_recovery_timeout_;
+  base::CancelableClosure memory_trim_;
+  bool use_policy_container_;
+  base::TimeDelta policy_signal_window_;
+  scoped_ptr<BrowserHeartbeat> heartbeat_;  // Must outlive |liveness_checker_|.
+  scoped_ptr<BrowserChannel> browser_channel_;  // Exports |session_manager_|.
   scoped_ptr<LivenessChecker> liveness_checker_;
+  scoped_ptr<MachineInfo> machine_info_;
   const bool enable_browser_abort_on_hang_;
-  const base::TimeDelta liveness_checking_interval_;
+  base::TimeDelta liveness_checking_interval_;
+  Tunables* tunables_;  // Owned by the caller.
 
   uid_t uid_;
   bool set_uid_;
@@ -316,6 +446,8 @@ class SessionManagerService
   scoped_ptr<PolicyKey> owner_key_;
 
   scoped_ptr<FileChecker> file_checker_;
+  scoped_ptr<RestartPolicy> restart_policy_;
+  RespawnGovernor* respawn_governor_;  // Owned by the caller.
 
   scoped_ptr<SessionManagerInterface> impl_;
   scoped_refptr<DevicePolicyService> device_policy_;
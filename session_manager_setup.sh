@@ -418,7 +418,7 @@ export PATH=/bin:/usr/bin:/usr/bin/X11
 #APITRACE=/usr/bin/apitrace trace --output=/tmp/chrome.$(date --utc "+%Y-%m-%d-%H-%M-%S").apitrace
 
 exec /sbin/session_manager --uid=${USER_ID} ${KILL_TIMEOUT_FLAG} \
-    ${HANG_DETECTION_FLAG} -- \
+    ${HANG_DETECTION_FLAG} --native-session-teardown -- \
     $APITRACE \
     $CHROME --allow-webui-compositing \
             --enable-impl-side-painting \
@@ -0,0 +1,370 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/session_teardown.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/memory/scoped_vector.h>
+#include <base/string_number_conversions.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+#include <base/threading/platform_thread.h>
+#include <base/threading/simple_thread.h>
+
+#include "login_manager/login_metrics.h"
+#include "login_manager/system_utils.h"
+
+namespace login_manager {
+
+// static
+const char SessionTeardown::kDoneFile[] =
+    "/var/run/session_manager/teardown_done";
+// static
+const int SessionTeardown::kScanThreads = 4;
+
+namespace {
+
+const char kProcDir[] = "/proc";
+// The tmpfs the signin profile lives on, see ui.conf.
+const char kSigninProfileDir[] = "/home/chronos/Default";
+// Where cryptohome mounts the vaults of signed-in users. /home/chronos/user
+// and /home/{user,root}/<hash> are bind mounts of these, so they are on the
+// same devices.
+const char kUserMountDir[] = "/home/chronos";
+const char kUserMountPattern[] = "u-*";
+
+// Links in /proc/<pid> that point to files the process holds.
+const char* kHeldLinks[] = { "cwd", "root", "exe" };
+
+// Bootstat events and UMA histograms for each step.
+const char* kStepEvents[] = {
+  "session-holders-found",
+  "session-processes-killed",
+  "session-teardown-verified",
+};
+const char* kStepMetrics[] = {
+  "Login.SessionTeardownTime.Scan",
+  "Login.SessionTeardownTime.Kill",
+  "Login.SessionTeardownTime.Verify",
+};
+COMPILE_ASSERT(arraysize(kStepEvents) == arraysize(kStepMetrics),
+               step_tables_out_of_sync);
+const int kStepMaxMs = 10 * 1000;
+const int kStepBuckets = 50;
+
+// kill(-1) fails if the killer is killed first, so it's tried a few times.
+const int kMaxKillAttempts = 10;
+
+// SIGKILL isn't synchronous, so survivors are looked for a few times.
+const int kVerifyAttempts = 10;
+const int kVerifyIntervalMs = 50;
+
+// Returns true if |path| is on one of |devices|.
+bool IsOnDevices(const base::FilePath& path, const std::set<dev_t>& devices) {
+  struct stat st;
+  return stat(path.value().c_str(), &st) == 0 && devices.count(st.st_dev);
+}
+
+}  // namespace
+
+// Classifies a slice of the pids on a thread of its own.
+class SessionTeardown::Scanner : public base::DelegateSimpleThread::Delegate {
+ public:
+  Scanner(const SessionTeardown* teardown,
+          const std::set<dev_t>& devices,
+          std::vector<pid_t>::const_iterator begin,
+          std::vector<pid_t>::const_iterator end)
+      : teardown_(teardown),
+        devices_(devices),
+        begin_(begin),
+        end_(end) {
+  }
+  virtual ~Scanner() {}
+
+  // base::DelegateSimpleThread::Delegate implementation:
+  virtual void Run() OVERRIDE {
+    for (std::vector<pid_t>::const_iterator it = begin_; it != end_; ++it) {
+      if (teardown_->IsHolder(*it, devices_))
+        holders_.push_back(*it);
+      if (teardown_->IsOwned(*it))
+        owned_.push_back(*it);
+    }
+  }
+
+  const std::vector<pid_t>& holders() const { return holders_; }
+  const std::vector<pid_t>& owned() const { return owned_; }
+
+ private:
+  const SessionTeardown* teardown_;
+  const std::set<dev_t>& devices_;
+  const std::vector<pid_t>::const_iterator begin_;
+  const std::vector<pid_t>::const_iterator end_;
+  std::vector<pid_t> holders_;
+  std::vector<pid_t> owned_;
+
+  DISALLOW_COPY_AND_ASSIGN(Scanner);
+};
+
+SessionTeardown::SessionTeardown(const std::vector<base::FilePath>& mounts,
+                                 const base::FilePath& proc_dir,
+                                 uid_t uid,
+                                 SystemUtils* utils,
+                                 LoginMetrics* metrics)
+    : mounts_(mounts),
+      proc_dir_(proc_dir),
+      uid_(uid),
+      system_(utils),
+      metrics_(metrics) {
+}
+
+SessionTeardown::~SessionTeardown() {
+}
+
+// static
+SessionTeardown* SessionTeardown::CreateDefault(uid_t uid,
+                                                SystemUtils* utils,
+                                                LoginMetrics* metrics) {
+  std::vector<base::FilePath> mounts;
+  mounts.push_back(base::FilePath(kSigninProfileDir));
+  file_util::FileEnumerator enumerator(base::FilePath(kUserMountDir), false,
+                                       file_util::FileEnumerator::DIRECTORIES,
+                                       kUserMountPattern);
+  for (base::FilePath dir = enumerator.Next(); !dir.empty();
+       dir = enumerator.Next()) {
+    mounts.push_back(dir);
+  }
+  return new SessionTeardown(mounts, base::FilePath(kProcDir), uid, utils,
+                             metrics);
+}
+
+bool SessionTeardown::Run() {
+  base::TimeTicks start = base::TimeTicks::Now();
+  std::vector<pid_t> holders;
+  std::vector<pid_t> owned;
+  Scan(GetMountDevices(mounts_), &holders, &owned);
+  RecordStep(SCAN, start);
+  LOG(INFO) << holders.size() << " processes hold session mounts, "
+            << owned.size() << " processes are owned by " << uid_;
+
+  start = base::TimeTicks::Now();
+  holders.insert(holders.end(), owned.begin(), owned.end());
+  std::sort(holders.begin(), holders.end());
+  holders.erase(std::unique(holders.begin(), holders.end()), holders.end());
+  KillAll(holders);
+  RecordStep(KILL, start);
+
+  start = base::TimeTicks::Now();
+  std::vector<pid_t> survivors;
+  for (int attempt = 0; attempt < kVerifyAttempts; ++attempt) {
+    if (attempt > 0) {
+      base::PlatformThread::Sleep(
+          base::TimeDelta::FromMilliseconds(kVerifyIntervalMs));
+    }
+    // The mounts are looked at again, in case something was mounted since.
+    holders.clear();
+    owned.clear();
+    Scan(GetMountDevices(mounts_), &holders, &owned);
+    survivors.swap(holders);
+    survivors.insert(survivors.end(), owned.begin(), owned.end());
+    if (survivors.empty())
+      break;
+  }
+  if (!survivors.empty()) {
+    std::sort(survivors.begin(), survivors.end());
+    survivors.erase(std::unique(survivors.begin(), survivors.end()),
+                    survivors.end());
+    for (std::vector<pid_t>::const_iterator it = survivors.begin();
+         it != survivors.end(); ++it) {
+      LogSurvivor(*it);
+    }
+    return false;
+  }
+  RecordStep(VERIFY, start);
+  return true;
+}
+
+void SessionTeardown::Scan(const std::set<dev_t>& devices,
+                           std::vector<pid_t>* holders,
+                           std::vector<pid_t>* owned) const {
+  const std::vector<pid_t> pids = ListPids();
+  const size_t slice = (pids.size() + kScanThreads - 1) / kScanThreads;
+  ScopedVector<Scanner> scanners;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  for (size_t begin = 0; begin < pids.size(); begin += slice) {
+    const size_t end = std::min(begin + slice, pids.size());
+    Scanner* scanner = new Scanner(this, devices, pids.begin() + begin,
+                                   pids.begin() + end);
+    scanners.push_back(scanner);
+    base::DelegateSimpleThread* thread =
+        new base::DelegateSimpleThread(scanner, "SessionTeardown");
+    threads.push_back(thread);
+    thread->Start();
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Join();
+    if (holders) {
+      holders->insert(holders->end(), scanners[i]->holders().begin(),
+                      scanners[i]->holders().end());
+    }
+    if (owned) {
+      owned->insert(owned->end(), scanners[i]->owned().begin(),
+                    scanners[i]->owned().end());
+    }
+  }
+}
+
+// static
+std::set<dev_t> SessionTeardown::GetMountDevices(
+    const std::vector<base::FilePath>& mounts) {
+  std::set<dev_t> devices;
+  for (std::vector<base::FilePath>::const_iterator it = mounts.begin();
+       it != mounts.end(); ++it) {
+    struct stat mount_stat;
+    struct stat parent_stat;
+    if (stat(it->value().c_str(), &mount_stat) != 0 ||
+        stat(it->DirName().value().c_str(), &parent_stat) != 0) {
+      continue;
+    }
+    // Otherwise it's just a directory, and everything else on its filesystem
+    // would be taken for the session's.
+    if (mount_stat.st_dev != parent_stat.st_dev)
+      devices.insert(mount_stat.st_dev);
+  }
+  return devices;
+}
+
+std::vector<pid_t> SessionTeardown::ListPids() const {
+  std::vector<pid_t> pids;
+  DIR* dir = opendir(proc_dir_.value().c_str());
+  if (!dir) {
+    PLOG(ERROR) << "Can't list " << proc_dir_.value();
+    return pids;
+  }
+  const pid_t self = getpid();
+  while (struct dirent* entry = readdir(dir)) {
+    int pid;
+    if (!base::StringToInt(entry->d_name, &pid) || pid <= 1 || pid == self)
+      continue;
+    pids.push_back(pid);
+  }
+  closedir(dir);
+  return pids;
+}
+
+bool SessionTeardown::IsHolder(pid_t pid,
+                               const std::set<dev_t>& devices) const {
+  if (devices.empty())
+    return false;
+  const base::FilePath dir = proc_dir_.Append(base::IntToString(pid));
+  for (size_t i = 0; i < arraysize(kHeldLinks); ++i) {
+    if (IsOnDevices(dir.Append(kHeldLinks[i]), devices))
+      return true;
+  }
+
+  const base::FilePath fd_dir = dir.Append("fd");
+  if (DIR* fds = opendir(fd_dir.value().c_str())) {
+    bool holds = false;
+    while (struct dirent* entry = readdir(fds)) {
+      if (entry->d_name[0] == '.')
+        continue;
+      if (IsOnDevices(fd_dir.Append(entry->d_name), devices)) {
+        holds = true;
+        break;
+      }
+    }
+    closedir(fds);
+    if (holds)
+      return true;
+  }
+
+  // Each line is "<range> <perms> <offset> <major>:<minor> <inode> <path>",
+  // with inode 0 for anonymous mappings.
+  std::string maps;
+  if (!file_util::ReadFileToString(dir.Append("maps"), &maps))
+    return false;
+  std::vector<std::string> lines;
+  base::SplitString(maps, '\n', &lines);
+  for (std::vector<std::string>::const_iterator it = lines.begin();
+       it != lines.end(); ++it) {
+    unsigned int major_number, minor_number;
+    unsigned long inode;
+    if (sscanf(it->c_str(), "%*s %*s %*s %x:%x %lu", &major_number,
+               &minor_number, &inode) != 3 || inode == 0) {
+      continue;
+    }
+    if (devices.count(makedev(major_number, minor_number)))
+      return true;
+  }
+  return false;
+}
+
+bool SessionTeardown::IsOwned(pid_t pid) const {
+  const base::FilePath dir = proc_dir_.Append(base::IntToString(pid));
+  struct stat st;
+  if (stat(dir.value().c_str(), &st) != 0 || st.st_uid != uid_)
+    return false;
+  // "<pid> (<comm>) <state> ...", where comm may contain anything.
+  std::string stat_line;
+  if (!file_util::ReadFileToString(dir.Append("stat"), &stat_line))
+    return false;
+  const size_t comm_end = stat_line.rfind(')');
+  if (comm_end == std::string::npos || comm_end + 2 >= stat_line.size())
+    return false;
+  // Zombies are dead already, they're just waiting for their parent.
+  return stat_line[comm_end + 2] != 'Z';
+}
+
+void SessionTeardown::KillAll(const std::vector<pid_t>& pids) {
+  const uid_t self = getuid();
+  for (std::vector<pid_t>::const_iterator it = pids.begin();
+       it != pids.end(); ++it) {
+    system_->kill(*it, self, SIGKILL);
+  }
+  // Processes forked since the scan are caught by this, as kill(-1) is atomic
+  // with respect to process creation.
+  for (int attempt = 0; attempt < kMaxKillAttempts; ++attempt) {
+    errno = 0;
+    if (system_->kill(-1, uid_, SIGKILL) == 0 || errno == ESRCH)
+      return;
+  }
+  PLOG(WARNING) << "Can't kill all processes of " << uid_;
+}
+
+void SessionTeardown::LogSurvivor(pid_t pid) const {
+  std::string cmdline;
+  file_util::ReadFileToString(
+      proc_dir_.Append(base::IntToString(pid)).Append("cmdline"), &cmdline);
+  std::replace(cmdline.begin(), cmdline.end(), '\0', ' ');
+  TrimWhitespaceASCII(cmdline, TRIM_TRAILING, &cmdline);
+  LOG(ERROR) << "Unkillable process " << pid << ": " << cmdline;
+}
+
+void SessionTeardown::RecordStep(Step step, base::TimeTicks start) {
+  DCHECK_LT(step, NUM_STEPS);
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  DLOG(INFO) << kStepEvents[step] << " after " << elapsed.InMilliseconds()
+             << "ms";
+  if (!metrics_)
+    return;
+  metrics_->RecordStats(kStepEvents[step]);
+  metrics_->SendHistogram(
+      kStepMetrics[step],
+      static_cast<int>(std::min<int64>(elapsed.InMilliseconds(), kStepMaxMs)),
+      1, kStepMaxMs, kStepBuckets);
+}
+
+}  // namespace login_manager
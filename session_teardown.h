@@ -0,0 +1,111 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_SESSION_TEARDOWN_H_
+#define LOGIN_MANAGER_SESSION_TEARDOWN_H_
+
+#include <sys/types.h>
+
+#include <set>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/time.h>
+
+namespace login_manager {
+
+class LoginMetrics;
+class SystemUtils;
+
+// Gets rid of what's left of a session once the browser is gone: finds the
+// processes that hold files on the session mounts (the signin profile and the
+// user cryptohomes), kills them along with every other process of the session
+// user, and checks that nothing survived. This used to be done by loops in
+// ui.conf's post-stop script, which now only run if this didn't finish.
+//
+// Processes are found by scanning /proc once, with a few threads. A process
+// holds a mount if its cwd, root, executable, one of its open files or one of
+// its mappings is on the mount's filesystem, which is what lsof looks at too.
+// Each step is recorded as a bootstat event and timed in UMA.
+class SessionTeardown {
+ public:
+  // Processes of |uid| are killed, as are those holding one of |mounts|.
+  // Mounts that aren't mount points are ignored. Processes are looked for
+  // under |proc_dir|. |utils| and |metrics| are owned by the caller.
+  SessionTeardown(const std::vector<base::FilePath>& mounts,
+                  const base::FilePath& proc_dir,
+                  uid_t uid,
+                  SystemUtils* utils,
+                  LoginMetrics* metrics);
+  ~SessionTeardown();
+
+  // Creates a teardown for the session mounts of the system and the
+  // processes of |uid|.
+  static SessionTeardown* CreateDefault(uid_t uid,
+                                        SystemUtils* utils,
+                                        LoginMetrics* metrics);
+
+  // Tears the session down. Returns true if no process survived.
+  bool Run();
+
+  // Sets |holders| to the processes that hold a file on a filesystem in
+  // |devices|, and |owned| to the live processes of |uid_|. Either may be
+  // NULL.
+  void Scan(const std::set<dev_t>& devices,
+            std::vector<pid_t>* holders,
+            std::vector<pid_t>* owned) const;
+
+  // Returns the devices of those of |mounts| that are mount points.
+  static std::set<dev_t> GetMountDevices(
+      const std::vector<base::FilePath>& mounts);
+
+  // Created by the session_manager once Run() succeeded, so that ui.conf
+  // knows it doesn't have to clean up after it.
+  static const char kDoneFile[];
+
+  // How many threads /proc is scanned with.
+  static const int kScanThreads;
+
+ private:
+  class Scanner;
+
+  // Steps that are timed.
+  enum Step {
+    SCAN = 0,
+    KILL = 1,
+    VERIFY = 2,
+    NUM_STEPS = 3
+  };
+
+  // Returns the pids under |proc_dir_|, except for this process and init.
+  std::vector<pid_t> ListPids() const;
+
+  // Returns true if |pid| holds a file on one of |devices|.
+  bool IsHolder(pid_t pid, const std::set<dev_t>& devices) const;
+
+  // Returns true if |pid| is a live process of |uid_|, i.e. not a zombie.
+  bool IsOwned(pid_t pid) const;
+
+  // Sends SIGKILL to all |pids|, and to everything else of |uid_|.
+  void KillAll(const std::vector<pid_t>& pids);
+
+  // Logs what's known about |pid|, which wouldn't die.
+  void LogSurvivor(pid_t pid) const;
+
+  // Records that |step|, which started at |start|, is done.
+  void RecordStep(Step step, base::TimeTicks start);
+
+  const std::vector<base::FilePath> mounts_;
+  const base::FilePath proc_dir_;
+  const uid_t uid_;
+  SystemUtils* system_;  // Owned by the caller.
+  LoginMetrics* metrics_;  // Owned by the caller.
+
+  DISALLOW_COPY_AND_ASSIGN(SessionTeardown);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_SESSION_TEARDOWN_H_
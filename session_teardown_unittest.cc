@@ -0,0 +1,177 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/session_teardown.h"
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/string_number_conversions.h>
+#include <base/stringprintf.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_metrics.h"
+#include "login_manager/mock_system_utils.h"
+
+using ::testing::AnyNumber;
+using ::testing::ElementsAre;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::StrEq;
+using ::testing::_;
+
+namespace login_manager {
+
+class SessionTeardownTest : public ::testing::Test {
+ public:
+  SessionTeardownTest() {}
+  virtual ~SessionTeardownTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    proc_dir_ = tmpdir_.path().AppendASCII("proc");
+    ASSERT_TRUE(file_util::CreateDirectory(proc_dir_));
+    held_file_ = tmpdir_.path().AppendASCII("held");
+    ASSERT_EQ(0, file_util::WriteFile(held_file_, "", 0));
+
+    struct stat st;
+    ASSERT_EQ(0, stat(tmpdir_.path().value().c_str(), &st));
+    devices_.insert(st.st_dev);
+
+    teardown_.reset(new SessionTeardown(std::vector<base::FilePath>(),
+                                        proc_dir_, getuid(), &utils_,
+                                        &metrics_));
+  }
+
+ protected:
+  // Fakes up /proc/<pid>/|name| with |contents|.
+  void WriteProcFile(pid_t pid,
+                     const std::string& name,
+                     const std::string& contents) {
+    base::FilePath dir = proc_dir_.AppendASCII(base::IntToString(pid));
+    ASSERT_TRUE(file_util::CreateDirectory(dir));
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(dir.AppendASCII(name), contents.data(),
+                                   contents.size()));
+  }
+
+  // Fakes up /proc/<pid>/fd/0 pointing to |target|.
+  void LinkProcFd(pid_t pid, const base::FilePath& target) {
+    base::FilePath fd_dir =
+        proc_dir_.AppendASCII(base::IntToString(pid)).AppendASCII("fd");
+    ASSERT_TRUE(file_util::CreateDirectory(fd_dir));
+    ASSERT_TRUE(file_util::CreateSymbolicLink(target,
+                                              fd_dir.AppendASCII("0")));
+  }
+
+  // Makes the fake process |pid| go away, as a kill would.
+  int FakeKill(pid_t pid, uid_t uid, int signal) {
+    if (pid > 0)
+      file_util::Delete(proc_dir_.AppendASCII(base::IntToString(pid)), true);
+    return 0;
+  }
+
+  std::vector<pid_t> Holders() {
+    std::vector<pid_t> holders;
+    teardown_->Scan(devices_, &holders, NULL);
+    std::sort(holders.begin(), holders.end());
+    return holders;
+  }
+
+  std::vector<pid_t> Owned() {
+    std::vector<pid_t> owned;
+    teardown_->Scan(devices_, NULL, &owned);
+    std::sort(owned.begin(), owned.end());
+    return owned;
+  }
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath proc_dir_;
+  base::FilePath held_file_;
+  std::set<dev_t> devices_;
+  MockSystemUtils utils_;
+  MockMetrics metrics_;
+  scoped_ptr<SessionTeardown> teardown_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SessionTeardownTest);
+};
+
+TEST_F(SessionTeardownTest, OpenFileHolds) {
+  LinkProcFd(42, held_file_);
+  LinkProcFd(43, tmpdir_.path().AppendASCII("gone"));
+  EXPECT_THAT(Holders(), ElementsAre(42));
+  devices_.clear();
+  EXPECT_TRUE(Holders().empty());
+}
+
+TEST_F(SessionTeardownTest, MappingHolds) {
+  const dev_t dev = *devices_.begin();
+  WriteProcFile(42, "maps",
+                base::StringPrintf("00400000-0040b000 r-xp 00000000 %02x:%02x "
+                                   "1234 /home/chronos/u-1/lib.so\n",
+                                   major(dev), minor(dev)));
+  // Anonymous mappings don't count, even if they claim the device.
+  WriteProcFile(43, "maps",
+                base::StringPrintf("7fff0000-7fff1000 rw-p 00000000 %02x:%02x "
+                                   "0 [stack]\n",
+                                   major(dev), minor(dev)));
+  EXPECT_THAT(Holders(), ElementsAre(42));
+}
+
+TEST_F(SessionTeardownTest, Owned) {
+  WriteProcFile(42, "stat", "42 (a) b) S 1 42 42");
+  WriteProcFile(43, "stat", "43 (zombie) Z 1 43 43");
+  WriteProcFile(44, "cmdline", "no stat");
+  // Not a pid.
+  WriteProcFile(1, "stat", "1 (init) S 0 1 1");
+  ASSERT_TRUE(file_util::CreateDirectory(proc_dir_.AppendASCII("self")));
+  EXPECT_THAT(Owned(), ElementsAre(42));
+}
+
+TEST_F(SessionTeardownTest, PlainDirectoryIsNoMount) {
+  base::FilePath dir = tmpdir_.path().AppendASCII("u-1");
+  ASSERT_TRUE(file_util::CreateDirectory(dir));
+  std::vector<base::FilePath> mounts;
+  mounts.push_back(dir);
+  mounts.push_back(tmpdir_.path().AppendASCII("missing"));
+  EXPECT_TRUE(SessionTeardown::GetMountDevices(mounts).empty());
+}
+
+TEST_F(SessionTeardownTest, Run) {
+  WriteProcFile(42, "stat", "42 (chrome) S 1 42 42");
+  EXPECT_CALL(utils_, kill(42, getuid(), SIGKILL))
+      .WillOnce(Invoke(this, &SessionTeardownTest::FakeKill));
+  EXPECT_CALL(utils_, kill(-1, getuid(), SIGKILL))
+      .WillOnce(Return(0));
+  EXPECT_CALL(metrics_, RecordStats(StrEq("session-holders-found")));
+  EXPECT_CALL(metrics_, RecordStats(StrEq("session-processes-killed")));
+  EXPECT_CALL(metrics_, RecordStats(StrEq("session-teardown-verified")));
+  EXPECT_CALL(metrics_, SendHistogram(_, _, _, _, _)).Times(3);
+  EXPECT_TRUE(teardown_->Run());
+}
+
+TEST_F(SessionTeardownTest, RunWithSurvivor) {
+  WriteProcFile(42, "stat", "42 (chrome) D 1 42 42");
+  EXPECT_CALL(utils_, kill(42, getuid(), SIGKILL)).WillOnce(Return(0));
+  EXPECT_CALL(utils_, kill(-1, getuid(), SIGKILL)).WillOnce(Return(0));
+  EXPECT_CALL(metrics_, RecordStats(_)).Times(AnyNumber());
+  EXPECT_CALL(metrics_, RecordStats(StrEq("session-teardown-verified")))
+      .Times(0);
+  EXPECT_FALSE(teardown_->Run());
+}
+
+}  // namespace login_manager
@@ -0,0 +1,88 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/signal_coalescer.h"
+
+#include <base/bind.h>
+#include <base/callback.h>
+#include <base/location.h>
+#include <base/message_loop_proxy.h>
+#include <base/string_util.h>
+
+#include "login_manager/system_utils.h"
+
+namespace login_manager {
+
+// static
+const int SignalCoalescer::kDefaultWindowMs = 100;
+
+SignalCoalescer::PendingSignal::PendingSignal()
+    : status(false) {
+}
+
+SignalCoalescer::PendingSignal::~PendingSignal() {
+}
+
+SignalCoalescer::SignalCoalescer(
+    SystemUtils* utils,
+    const scoped_refptr<base::MessageLoopProxy>& loop,
+    base::TimeDelta window)
+    : system_(utils),
+      loop_proxy_(loop),
+      window_(window),
+      coalesced_count_(0) {
+}
+
+SignalCoalescer::~SignalCoalescer() {
+  Flush();
+}
+
+void SignalCoalescer::EmitStatusSignal(const char* signal_name,
+                                       bool status,
+                                       const std::string& store) {
+  for (std::vector<PendingSignal>::iterator it = pending_.begin();
+       it != pending_.end(); ++it) {
+    if (it->name == signal_name) {
+      it->status = status;
+      it->stores.insert(store);
+      ++coalesced_count_;
+      return;
+    }
+  }
+
+  PendingSignal signal;
+  signal.name = signal_name;
+  signal.status = status;
+  signal.stores.insert(store);
+  if (window_ <= base::TimeDelta()) {
+    Emit(signal);
+    return;
+  }
+
+  pending_.push_back(signal);
+  if (flush_.IsCancelled()) {
+    flush_.Reset(base::Bind(&SignalCoalescer::Flush, base::Unretained(this)));
+    loop_proxy_->PostDelayedTask(FROM_HERE, flush_.callback(), window_);
+  }
+}
+
+void SignalCoalescer::Flush() {
+  flush_.Cancel();
+  std::vector<PendingSignal> pending;
+  pending.swap(pending_);
+  for (std::vector<PendingSignal>::const_iterator it = pending.begin();
+       it != pending.end(); ++it) {
+    Emit(*it);
+  }
+}
+
+void SignalCoalescer::Emit(const PendingSignal& signal) {
+  const std::vector<std::string> stores(signal.stores.begin(),
+                                        signal.stores.end());
+  system_->EmitStatusSignalWithStringArgs(signal.name.c_str(), signal.status,
+                                          std::vector<std::string>(
+                                              1, JoinString(stores, ',')));
+}
+
+}  // namespace login_manager
@@ -0,0 +1,87 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_SIGNAL_COALESCER_H_
+#define LOGIN_MANAGER_SIGNAL_COALESCER_H_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <base/basictypes.h>
+#include <base/cancelable_callback.h>
+#include <base/memory/ref_counted.h>
+#include <base/time.h>
+
+namespace base {
+class MessageLoopProxy;
+}  // namespace base
+
+namespace login_manager {
+class SystemUtils;
+
+// Holds back status signals, e.g. PropertyChangeComplete, for a short window
+// so that a burst of them reaches listeners as a single signal. Each of these
+// makes the listeners refetch, so a burst of stores would otherwise turn into
+// a burst of refetches.
+//
+// Signals with the same name that come in during the window are folded into
+// one, which carries the latest status followed by a comma-separated list of
+// the stores that changed. Signals with different names are emitted in the
+// order they first came in.
+//
+// Signals that listeners need to see right away, like the ones for screen
+// locking and session state, shouldn't be sent through here.
+class SignalCoalescer {
+ public:
+  // Signals are emitted through |utils| on |loop|. A zero |window| makes
+  // signals go out right away.
+  SignalCoalescer(SystemUtils* utils,
+                  const scoped_refptr<base::MessageLoopProxy>& loop,
+                  base::TimeDelta window);
+  // Emits anything still pending.
+  ~SignalCoalescer();
+
+  // Emits status signal |signal_name| with |status| on behalf of |store|,
+  // within the window.
+  void EmitStatusSignal(const char* signal_name,
+                        bool status,
+                        const std::string& store);
+
+  // Emits all pending signals right away.
+  void Flush();
+
+  // Returns the number of signals that were folded into others.
+  int coalesced_count() const { return coalesced_count_; }
+
+  // Default for the window.
+  static const int kDefaultWindowMs;
+
+ private:
+  struct PendingSignal {
+    PendingSignal();
+    ~PendingSignal();
+
+    std::string name;
+    bool status;
+    std::set<std::string> stores;
+  };
+
+  // Emits |signal| through |system_|.
+  void Emit(const PendingSignal& signal);
+
+  SystemUtils* system_;  // Owned by the caller.
+  scoped_refptr<base::MessageLoopProxy> loop_proxy_;
+  const base::TimeDelta window_;
+  std::vector<PendingSignal> pending_;
+  // Calls Flush() at the end of the window. Cancelled when nothing's pending.
+  base::CancelableClosure flush_;
+  int coalesced_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(SignalCoalescer);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_SIGNAL_COALESCER_H_
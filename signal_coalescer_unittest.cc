@@ -0,0 +1,109 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/signal_coalescer.h"
+
+#include <string>
+#include <vector>
+
+#include <base/memory/ref_counted.h>
+#include <base/memory/scoped_ptr.h>
+#include <base/message_loop.h>
+#include <base/message_loop_proxy.h>
+#include <base/run_loop.h>
+#include <base/time.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "login_manager/mock_system_utils.h"
+
+using ::base::TimeDelta;
+using ::testing::ElementsAre;
+using ::testing::InSequence;
+using ::testing::InvokeWithoutArgs;
+using ::testing::StrEq;
+using ::testing::StrictMock;
+using ::testing::_;
+
+namespace login_manager {
+
+class SignalCoalescerTest : public ::testing::Test {
+ public:
+  SignalCoalescerTest() {}
+  virtual ~SignalCoalescerTest() {}
+
+ protected:
+  void Init(TimeDelta window) {
+    coalescer_.reset(new SignalCoalescer(&system_,
+                                         base::MessageLoopProxy::current(),
+                                         window));
+  }
+
+  static const char kSignal[];
+  static const char kOtherSignal[];
+
+  MessageLoop loop_;
+  StrictMock<MockSystemUtils> system_;
+  scoped_ptr<SignalCoalescer> coalescer_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SignalCoalescerTest);
+};
+
+const char SignalCoalescerTest::kSignal[] = "PropertyChangeComplete";
+const char SignalCoalescerTest::kOtherSignal[] = "SetOwnerKeyComplete";
+
+TEST_F(SignalCoalescerTest, NoWindow) {
+  Init(TimeDelta());
+  EXPECT_CALL(system_, EmitStatusSignalWithStringArgs(StrEq(kSignal), true,
+                                                      ElementsAre("Device")))
+      .Times(2);
+  coalescer_->EmitStatusSignal(kSignal, true, "Device");
+  coalescer_->EmitStatusSignal(kSignal, true, "Device");
+  EXPECT_EQ(0, coalescer_->coalesced_count());
+}
+
+TEST_F(SignalCoalescerTest, FoldsBurst) {
+  Init(TimeDelta::FromMilliseconds(1));
+  // One signal with the latest status and every store that changed, once the
+  // window is over.
+  EXPECT_CALL(system_, EmitStatusSignalWithStringArgs(
+                           StrEq(kSignal), false,
+                           ElementsAre("Device,User")))
+      .WillOnce(InvokeWithoutArgs(&loop_, &MessageLoop::QuitNow));
+
+  coalescer_->EmitStatusSignal(kSignal, true, "Device");
+  coalescer_->EmitStatusSignal(kSignal, true, "User");
+  coalescer_->EmitStatusSignal(kSignal, false, "Device");
+  loop_.Run();
+  EXPECT_EQ(2, coalescer_->coalesced_count());
+}
+
+TEST_F(SignalCoalescerTest, KeepsOrderOfNames) {
+  Init(TimeDelta::FromHours(1));
+  coalescer_->EmitStatusSignal(kOtherSignal, true, "Device");
+  coalescer_->EmitStatusSignal(kSignal, true, "Device");
+  coalescer_->EmitStatusSignal(kOtherSignal, true, "Device");
+
+  InSequence sequence;
+  EXPECT_CALL(system_,
+              EmitStatusSignalWithStringArgs(StrEq(kOtherSignal), true, _));
+  EXPECT_CALL(system_,
+              EmitStatusSignalWithStringArgs(StrEq(kSignal), true, _));
+  coalescer_->Flush();
+
+  // Nothing's left for the end of the window.
+  base::RunLoop().RunUntilIdle();
+}
+
+TEST_F(SignalCoalescerTest, DestructionFlushes) {
+  Init(TimeDelta::FromHours(1));
+  coalescer_->EmitStatusSignal(kSignal, true, "Device");
+  EXPECT_CALL(system_,
+              EmitStatusSignalWithStringArgs(StrEq(kSignal), true, _));
+  coalescer_.reset();
+  base::RunLoop().RunUntilIdle();
+}
+
+}  // namespace login_manager
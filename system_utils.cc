@@ -45,6 +45,12 @@ const char SystemUtils::kSignalFailure[] = "failure";
 SystemUtils::SystemUtils() {}
 SystemUtils::~SystemUtils() {}
 
+AsyncFileIo* SystemUtils::async_file_io() {
+  if (!async_file_io_.get())
+    async_file_io_.reset(new AsyncFileIo);
+  return async_file_io_.get();
+}
+
 int SystemUtils::IsDevMode() {
   int dev_mode_code = system("crossystem 'cros_debug?0'");
   if (WIFEXITED(dev_mode_code)) {
@@ -169,6 +175,14 @@ bool SystemUtils::AtomicFileWrite(const base::FilePath& filename,
           chmod(filename.value().c_str(), (S_IRUSR | S_IWUSR | S_IROTH)) == 0);
 }
 
+void SystemUtils::AtomicFileWriteAsync(
+    const base::FilePath& filename,
+    const std::string& data,
+    mode_t mode,
+    const AsyncFileIo::StatusCallback& callback) {
+  async_file_io()->AtomicWrite(filename, data, mode, callback);
+}
+
 void SystemUtils::EmitSignal(const char* signal_name) {
   EmitSignalWithStringArgs(signal_name, vector<string>());
 }
@@ -180,10 +194,16 @@ void SystemUtils::EmitSignalWithStringArgs(const char* signal_name,
 }
 
 void SystemUtils::EmitStatusSignal(const char* signal_name, bool status) {
-  EmitSignalFrom(chromium::kChromiumInterface, signal_name,
-                 vector<string>(1, status ? kSignalSuccess : kSignalFailure));
-  EmitSignalFrom(login_manager::kSessionManagerInterface, signal_name,
-                 vector<string>(1, status ? kSignalSuccess : kSignalFailure));
+  EmitStatusSignalWithStringArgs(signal_name, status, vector<string>());
+}
+
+void SystemUtils::EmitStatusSignalWithStringArgs(
+    const char* signal_name,
+    bool status,
+    const vector<string>& payload) {
+  vector<string> args(1, status ? kSignalSuccess : kSignalFailure);
+  args.insert(args.end(), payload.begin(), payload.end());
+  EmitSignalWithStringArgs(signal_name, args);
 }
 
 void SystemUtils::CallMethodOnPowerManager(const char* method_name) {
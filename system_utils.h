@@ -5,6 +5,7 @@
 #ifndef LOGIN_MANAGER_SYSTEM_UTILS_H_
 #define LOGIN_MANAGER_SYSTEM_UTILS_H_
 
+#include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -19,6 +20,8 @@
 #include <dbus/dbus-glib.h>
 #include <glib.h>
 
+#include "login_manager/async_file_io.h"
+
 namespace base {
 class FilePath;
 }
@@ -75,6 +78,20 @@ class SystemUtils {
                                const char* data,
                                int size);
 
+  // Like AtomicFileWrite(), but done off the calling thread, which must run a
+  // message loop, and the file gets permissions |mode|; |callback| runs on
+  // the calling thread with the outcome.
+  virtual void AtomicFileWriteAsync(
+      const base::FilePath& filename,
+      const std::string& data,
+      mode_t mode,
+      const AsyncFileIo::StatusCallback& callback);
+
+  // Runs file operations off the calling thread for the above, and for
+  // anyone else who wants to. Created on first use; destroying this object
+  // blocks until the operations in flight are done.
+  AsyncFileIo* async_file_io();
+
   // Broadcasts |signal_name| from the session manager DBus interface.
   virtual void EmitSignal(const char* signal_name);
 
@@ -88,6 +105,12 @@ class SystemUtils {
   // |kSignalSuccess| and |kSignalFailure| respectively.
   virtual void EmitStatusSignal(const char* signal_name, bool status);
 
+  // Same, with the contents of |payload| added as further args.
+  virtual void EmitStatusSignalWithStringArgs(
+      const char* signal_name,
+      bool status,
+      const std::vector<std::string>& payload);
+
   // Calls |method_name| on power manager.
   virtual void CallMethodOnPowerManager(const char* method_name);
 
@@ -120,6 +143,8 @@ class SystemUtils {
                                 const char* message);
 
  private:
+  scoped_ptr<AsyncFileIo> async_file_io_;
+
   // If this file exists on the next boot, the stateful partition will be wiped.
   static const char kResetFile[];
 
@@ -0,0 +1,174 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/tunables.h"
+
+#include <vector>
+
+#include <base/file_util.h>
+#include <base/logging.h>
+#include <base/string_number_conversions.h>
+#include <base/string_split.h>
+#include <base/string_util.h>
+
+namespace login_manager {
+
+// static
+const char Tunables::kKillTimeout[] = "kill_timeout_seconds";
+// static
+const char Tunables::kHangDetectionInterval[] =
+    "hang_detection_interval_seconds";
+// static
+const char Tunables::kRestartTries[] = "restart_tries";
+// static
+const char Tunables::kRestartWindow[] = "restart_window_seconds";
+// static
+const char Tunables::kConfigFile[] = "/etc/session_manager_tunables.conf";
+
+Tunable::Tunable(const std::string& name,
+                 int64 default_value,
+                 int64 min,
+                 int64 max)
+    : name_(name),
+      min_(min),
+      max_(max),
+      value_(default_value) {
+  values_[Tunables::DEFAULT] = default_value;
+}
+
+Tunable::~Tunable() {
+}
+
+Tunables::Observer::~Observer() {
+}
+
+Tunables::Tunables() {
+}
+
+Tunables::~Tunables() {
+}
+
+const Tunable* Tunables::Register(const std::string& name,
+                                  int64 default_value,
+                                  int64 min,
+                                  int64 max) {
+  DCHECK(!Get(name)) << name << " registered twice";
+  DCHECK(min <= default_value && default_value <= max) << name;
+  linked_ptr<Tunable>& tunable = tunables_[name];
+  tunable.reset(new Tunable(name, default_value, min, max));
+  return tunable.get();
+}
+
+const Tunable* Tunables::Get(const std::string& name) const {
+  TunableMap::const_iterator it = tunables_.find(name);
+  return it == tunables_.end() ? NULL : it->second.get();
+}
+
+bool Tunables::Set(const std::string& name, Source source, int64 value) {
+  TunableMap::iterator it = tunables_.find(name);
+  if (it == tunables_.end()) {
+    LOG(WARNING) << "Unknown tunable " << name;
+    return false;
+  }
+  Tunable* tunable = it->second.get();
+  if (value < tunable->min() || value > tunable->max()) {
+    LOG(WARNING) << "Tunable " << name << " must be within ["
+                 << tunable->min() << ", " << tunable->max() << "], not "
+                 << value;
+    return false;
+  }
+  tunable->values_[source] = value;
+  Update(tunable);
+  return true;
+}
+
+void Tunables::Unset(const std::string& name, Source source) {
+  DCHECK_NE(source, DEFAULT);
+  TunableMap::iterator it = tunables_.find(name);
+  if (it == tunables_.end() || !it->second->values_.erase(source))
+    return;
+  Update(it->second.get());
+}
+
+bool Tunables::LoadConfigFile(const base::FilePath& path) {
+  config_file_ = path;
+  std::string contents;
+  bool success = true;
+  if (file_util::PathExists(path) &&
+      !file_util::ReadFileToString(path, &contents)) {
+    PLOG(ERROR) << "Can't read " << path.value();
+    success = false;
+  }
+
+  std::map<std::string, int64> values;
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::string line;
+    TrimWhitespaceASCII(lines[i], TRIM_ALL, &line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    // SplitString() trims whitespace around each piece.
+    std::vector<std::string> pair;
+    base::SplitString(line, '=', &pair);
+    int64 value = 0;
+    if (pair.size() != 2 || !Get(pair[0]) ||
+        !base::StringToInt64(pair[1], &value)) {
+      LOG(WARNING) << path.value() << ":" << i + 1 << ": ignoring "
+                   << line;
+      success = false;
+      continue;
+    }
+    values[pair[0]] = value;
+  }
+
+  for (TunableMap::iterator it = tunables_.begin(); it != tunables_.end();
+       ++it) {
+    std::map<std::string, int64>::const_iterator value =
+        values.find(it->first);
+    if (value != values.end() &&
+        Set(it->first, CONFIG_FILE, value->second)) {
+      continue;
+    }
+    if (value != values.end())
+      success = false;
+    Unset(it->first, CONFIG_FILE);
+  }
+  return success;
+}
+
+bool Tunables::ReloadConfigFile() {
+  if (config_file_.empty())
+    return false;
+  return LoadConfigFile(config_file_);
+}
+
+std::map<std::string, std::string> Tunables::GetValues() const {
+  std::map<std::string, std::string> values;
+  for (TunableMap::const_iterator it = tunables_.begin();
+       it != tunables_.end(); ++it) {
+    values[it->first] = base::Int64ToString(it->second->value());
+  }
+  return values;
+}
+
+void Tunables::AddObserver(Observer* observer) {
+  observers_.AddObserver(observer);
+}
+
+void Tunables::RemoveObserver(Observer* observer) {
+  observers_.RemoveObserver(observer);
+}
+
+void Tunables::Update(Tunable* tunable) {
+  // Sources are ordered by importance, so the last one set wins.
+  const int64 value = tunable->values_.rbegin()->second;
+  if (value == tunable->value_)
+    return;
+  LOG(INFO) << "Tunable " << tunable->name() << " is now " << value;
+  tunable->value_ = value;
+  FOR_EACH_OBSERVER(Observer, observers_, OnTunableChanged(*tunable));
+}
+
+}  // namespace login_manager
@@ -0,0 +1,130 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOGIN_MANAGER_TUNABLES_H_
+#define LOGIN_MANAGER_TUNABLES_H_
+
+#include <map>
+#include <string>
+
+#include <base/basictypes.h>
+#include <base/file_path.h>
+#include <base/memory/linked_ptr.h>
+#include <base/observer_list.h>
+
+namespace login_manager {
+
+// A single integer knob, e.g. the kill timeout. The value in effect is the
+// one from the most important source that set it, see Tunables::Source.
+// Subsystems hold on to a Tunable and read value(), which is just a member.
+class Tunable {
+ public:
+  ~Tunable();
+
+  const std::string& name() const { return name_; }
+  int64 value() const { return value_; }
+  int64 min() const { return min_; }
+  int64 max() const { return max_; }
+
+ private:
+  friend class Tunables;
+
+  Tunable(const std::string& name, int64 default_value, int64 min, int64 max);
+
+  const std::string name_;
+  const int64 min_;
+  const int64 max_;
+  int64 value_;
+  // Indexed by Tunables::Source.
+  std::map<int, int64> values_;
+
+  DISALLOW_COPY_AND_ASSIGN(Tunable);
+};
+
+// Registry of the knobs that tune the session_manager, so that they can be
+// changed without restarting the UI. Each knob is registered once, with its
+// compiled-in default and the range it must stay in, after which its value
+// can be set from command line switches, a config file, and over D-Bus.
+//
+// The config file has one "name=value" per line; blank lines and lines
+// starting with '#' are ignored.
+class Tunables {
+ public:
+  // Where a value comes from, from least to most important.
+  enum Source {
+    DEFAULT = 0,
+    SWITCH = 1,
+    CONFIG_FILE = 2,
+    OVERRIDE = 3,  // Set over D-Bus.
+  };
+
+  class Observer {
+   public:
+    virtual ~Observer();
+    // Called when the value of |tunable| changed.
+    virtual void OnTunableChanged(const Tunable& tunable) = 0;
+  };
+
+  Tunables();
+  ~Tunables();
+
+  // Adds a tunable called |name|, which must not exist yet, and returns it.
+  // |default_value| must be within [|min|, |max|].
+  const Tunable* Register(const std::string& name,
+                          int64 default_value,
+                          int64 min,
+                          int64 max);
+
+  // Returns the tunable called |name|, or NULL if there's none.
+  const Tunable* Get(const std::string& name) const;
+
+  // Sets the value of |name| from |source|. Returns false, and changes
+  // nothing, if there's no such tunable or |value| is out of its range.
+  bool Set(const std::string& name, Source source, int64 value);
+
+  // Forgets the value of |name| from |source|, if any.
+  void Unset(const std::string& name, Source source);
+
+  // Replaces the values from the config file with those in |path|. A missing
+  // file is the same as an empty one. Lines that can't be parsed or name an
+  // unknown tunable are skipped. Returns false if |path| couldn't be read or
+  // some lines were skipped.
+  bool LoadConfigFile(const base::FilePath& path);
+
+  // Loads the config file again from where LoadConfigFile() last read it.
+  // Returns false if it was never loaded, or as LoadConfigFile() does.
+  bool ReloadConfigFile();
+
+  // Returns the value of every tunable, as decimal strings, by name.
+  std::map<std::string, std::string> GetValues() const;
+
+  void AddObserver(Observer* observer);
+  void RemoveObserver(Observer* observer);
+
+  // Names of the tunables the session_manager registers.
+  static const char kKillTimeout[];
+  static const char kHangDetectionInterval[];
+  static const char kRestartTries[];
+  static const char kRestartWindow[];
+
+  // Where the config file is read from.
+  static const char kConfigFile[];
+
+ private:
+  typedef std::map<std::string, linked_ptr<Tunable> > TunableMap;
+
+  // Recomputes the value of |tunable| and notifies observers if it changed.
+  void Update(Tunable* tunable);
+
+  TunableMap tunables_;
+  ObserverList<Observer> observers_;
+  // Where LoadConfigFile() last read from; empty until then.
+  base::FilePath config_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(Tunables);
+};
+
+}  // namespace login_manager
+
+#endif  // LOGIN_MANAGER_TUNABLES_H_
@@ -0,0 +1,156 @@
+// Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "login_manager/tunables.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/file_path.h>
+#include <base/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/string_number_conversions.h>
+#include <gtest/gtest.h>
+
+namespace login_manager {
+
+namespace {
+const char kName[] = "kill_timeout_seconds";
+const char kOther[] = "restart_tries";
+}  // namespace
+
+class TunablesTest : public ::testing::Test,
+                     public Tunables::Observer {
+ public:
+  TunablesTest() {}
+  virtual ~TunablesTest() {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(tmpdir_.CreateUniqueTempDir());
+    config_file_ = tmpdir_.path().AppendASCII("tunables.conf");
+    tunable_ = tunables_.Register(kName, 3, 1, 60);
+    tunables_.Register(kOther, 4, 1, 100);
+    tunables_.AddObserver(this);
+  }
+
+  virtual void TearDown() {
+    tunables_.RemoveObserver(this);
+  }
+
+  // Tunables::Observer implementation:
+  virtual void OnTunableChanged(const Tunable& tunable) OVERRIDE {
+    changes_.push_back(tunable.name() + "=" +
+                       base::Int64ToString(tunable.value()));
+  }
+
+ protected:
+  void WriteConfig(const std::string& contents) {
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(config_file_, contents.data(),
+                                   contents.size()));
+  }
+
+  base::ScopedTempDir tmpdir_;
+  base::FilePath config_file_;
+  Tunables tunables_;
+  const Tunable* tunable_;
+  std::vector<std::string> changes_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TunablesTest);
+};
+
+TEST_F(TunablesTest, Register) {
+  EXPECT_EQ(tunable_, tunables_.Get(kName));
+  EXPECT_EQ(kName, tunable_->name());
+  EXPECT_EQ(3, tunable_->value());
+  EXPECT_FALSE(tunables_.Get("no_such_tunable"));
+
+  std::map<std::string, std::string> values = tunables_.GetValues();
+  EXPECT_EQ(2U, values.size());
+  EXPECT_EQ("3", values[kName]);
+  EXPECT_EQ("4", values[kOther]);
+}
+
+TEST_F(TunablesTest, Precedence) {
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::OVERRIDE, 30));
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::SWITCH, 10));
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::CONFIG_FILE, 20));
+  EXPECT_EQ(30, tunable_->value());
+
+  tunables_.Unset(kName, Tunables::OVERRIDE);
+  EXPECT_EQ(20, tunable_->value());
+  tunables_.Unset(kName, Tunables::CONFIG_FILE);
+  EXPECT_EQ(10, tunable_->value());
+  tunables_.Unset(kName, Tunables::SWITCH);
+  EXPECT_EQ(3, tunable_->value());
+}
+
+TEST_F(TunablesTest, OutOfRange) {
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::SWITCH, 60));
+  EXPECT_FALSE(tunables_.Set(kName, Tunables::OVERRIDE, 61));
+  EXPECT_FALSE(tunables_.Set(kName, Tunables::OVERRIDE, 0));
+  EXPECT_FALSE(tunables_.Set("no_such_tunable", Tunables::OVERRIDE, 1));
+  EXPECT_EQ(60, tunable_->value());
+}
+
+TEST_F(TunablesTest, ObserversSeeChangesOnly) {
+  tunables_.Set(kName, Tunables::SWITCH, 3);
+  EXPECT_TRUE(changes_.empty());
+
+  tunables_.Set(kName, Tunables::OVERRIDE, 5);
+  tunables_.Set(kName, Tunables::SWITCH, 7);
+  tunables_.Unset(kName, Tunables::OVERRIDE);
+  ASSERT_EQ(2U, changes_.size());
+  EXPECT_EQ("kill_timeout_seconds=5", changes_[0]);
+  EXPECT_EQ("kill_timeout_seconds=7", changes_[1]);
+}
+
+TEST_F(TunablesTest, LoadConfigFile) {
+  // A missing file is an empty one.
+  EXPECT_TRUE(tunables_.LoadConfigFile(config_file_));
+  EXPECT_EQ(3, tunable_->value());
+
+  WriteConfig("# Comment\n"
+              "\n"
+              " kill_timeout_seconds = 12 \n"
+              "restart_tries=7\n");
+  EXPECT_TRUE(tunables_.LoadConfigFile(config_file_));
+  EXPECT_EQ(12, tunable_->value());
+  EXPECT_EQ(7, tunables_.Get(kOther)->value());
+
+  // A reload replaces what was loaded before; bad lines are skipped.
+  WriteConfig("kill_timeout_seconds=13\n"
+              "restart_tries=1000\n"
+              "no_such_tunable=1\n"
+              "garbage\n");
+  EXPECT_FALSE(tunables_.LoadConfigFile(config_file_));
+  EXPECT_EQ(13, tunable_->value());
+  EXPECT_EQ(4, tunables_.Get(kOther)->value());
+
+  // Switches don't override the config file.
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::SWITCH, 14));
+  EXPECT_EQ(13, tunable_->value());
+}
+
+TEST_F(TunablesTest, ReloadConfigFile) {
+  EXPECT_FALSE(tunables_.ReloadConfigFile());
+
+  WriteConfig("kill_timeout_seconds=12\n");
+  EXPECT_TRUE(tunables_.LoadConfigFile(config_file_));
+  EXPECT_EQ(12, tunable_->value());
+
+  WriteConfig("kill_timeout_seconds=15\n");
+  EXPECT_TRUE(tunables_.ReloadConfigFile());
+  EXPECT_EQ(15, tunable_->value());
+
+  // The file doesn't override what was set over D-Bus.
+  EXPECT_TRUE(tunables_.Set(kName, Tunables::OVERRIDE, 20));
+  WriteConfig("kill_timeout_seconds=16\n");
+  EXPECT_TRUE(tunables_.ReloadConfigFile());
+  EXPECT_EQ(20, tunable_->value());
+}
+
+}  // namespace login_manager
@@ -13,6 +13,7 @@
 #include <base/message_loop_proxy.h>
 
 #include "login_manager/device_management_backend.pb.h"
+#include "login_manager/policy_envelope.h"
 #include "login_manager/policy_key.h"
 #include "login_manager/policy_store.h"
 #include "login_manager/system_utils.h"
@@ -31,6 +32,7 @@ UserPolicyService::UserPolicyService(
       scoped_policy_key_(policy_key.Pass()),
       key_copy_path_(key_copy_path),
       system_utils_(system_utils) {
+  stats()->set_kind(PolicyStats::USER);
 }
 
 UserPolicyService::~UserPolicyService() {
@@ -62,11 +64,19 @@ bool UserPolicyService::Store(const uint8* policy_blob,
                               uint32 len,
                               Completion* completion,
                               int flags) {
-  em::PolicyFetchResponse policy;
+  stats()->Increment(PolicyStats::STORE);
+  stats()->AddSample(PolicyStats::BLOB_SIZE, len);
+  const base::TimeTicks parse_start = base::TimeTicks::Now();
+  PolicyEnvelope envelope;
   em::PolicyData policy_data;
-  if (!policy.ParseFromArray(policy_blob, len) ||
-      !policy.has_policy_data() ||
-      !policy_data.ParseFromString(policy.policy_data())) {
+  const bool parsed = envelope.Parse(policy_blob, len) &&
+      envelope.has_policy_data() &&
+      policy_data.ParseFromArray(envelope.policy_data().data(),
+                                 envelope.policy_data().size());
+  stats()->AddTime(PolicyStats::PARSE_TIME,
+                   base::TimeTicks::Now() - parse_start);
+  if (!parsed) {
+    stats()->Increment(PolicyStats::PARSE_FAILURE);
     const char msg[] = "Unable to parse policy protobuf.";
     LOG(ERROR) << msg;
     Error error(CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg);
@@ -76,19 +86,29 @@ bool UserPolicyService::Store(const uint8* policy_blob,
 
   // Allow to switch to unmanaged state even if no signature is present.
   if (policy_data.state() == em::PolicyData::UNMANAGED &&
-      !policy.has_policy_data_signature()) {
+      !envelope.has_policy_data_signature()) {
     // Also clear the key.
     if (key()->IsPopulated()) {
       key()->ClobberCompromisedKey(std::vector<uint8>());
+      stats()->Increment(PolicyStats::KEY_CLOBBER);
       PersistKey();
     }
 
-    store()->Set(policy);
+    em::PolicyFetchResponse policy;
+    if (!envelope.Materialize(&policy)) {
+      // Can't happen for a blob that Parse() accepted.
+      const char msg[] = "Unable to parse policy protobuf.";
+      LOG(ERROR) << msg;
+      Error error(CHROMEOS_LOGIN_ERROR_DECODE_FAIL, msg);
+      completion->Failure(error);
+      return false;
+    }
+    store()->Swap(&policy);
     PersistPolicyWithCompletion(completion);
     return true;
   }
 
-  return PolicyService::StorePolicy(policy, completion, flags);
+  return PolicyService::StorePolicy(envelope, completion, flags);
 }
 
 void UserPolicyService::OnKeyPersisted(bool status) {
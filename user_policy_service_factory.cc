@@ -9,14 +9,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <base/compiler_specific.h>
 #include <base/file_path.h>
 #include <base/file_util.h>
 #include <base/logging.h>
+#include <base/memory/scoped_ptr.h>
 #include <base/message_loop_proxy.h>
+#include <base/sequenced_task_runner.h>
 #include <base/stringprintf.h>
 
 #include "chromeos/cryptohome.h"
 
+#include "login_manager/async_file_io.h"
 #include "login_manager/nss_util.h"
 #include "login_manager/policy_key.h"
 #include "login_manager/policy_store.h"
@@ -47,6 +51,34 @@ const FilePath::CharType kPolicyKeyCopyDir[] =
 // Name of the policy key files.
 const FilePath::CharType kPolicyKeyCopyFile[] = FILE_PATH_LITERAL("policy.pub");
 
+// Policy that is dropped along with the session.
+class EphemeralPolicyStore : public PolicyStore {
+ public:
+  EphemeralPolicyStore() : PolicyStore(FilePath()) {}
+  virtual ~EphemeralPolicyStore() {}
+
+  virtual bool DefunctPrefsFilePresent() OVERRIDE { return false; }
+  virtual bool LoadOrCreate() OVERRIDE { return true; }
+  virtual bool Persist() OVERRIDE { return true; }
+  virtual bool PersistBlob(const std::string& blob) OVERRIDE { return true; }
+  virtual FileState GetFileState() const OVERRIDE { return FILE_NOT_PRESENT; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EphemeralPolicyStore);
+};
+
+// Policy key that is dropped along with the session.
+class EphemeralPolicyKey : public PolicyKey {
+ public:
+  explicit EphemeralPolicyKey(NssUtil* nss) : PolicyKey(FilePath(), nss) {}
+  virtual ~EphemeralPolicyKey() {}
+
+  virtual bool Persist() OVERRIDE { return true; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EphemeralPolicyKey);
+};
+
 }  // namespace
 
 UserPolicyServiceFactory::UserPolicyServiceFactory(
@@ -57,7 +89,9 @@ UserPolicyServiceFactory::UserPolicyServiceFactory(
     : uid_(uid),
       main_loop_(main_loop),
       nss_(nss),
-      system_utils_(system_utils) {
+      system_utils_(system_utils),
+      use_policy_container_(false),
+      metrics_(NULL) {
 }
 
 UserPolicyServiceFactory::~UserPolicyServiceFactory() {
@@ -81,6 +115,7 @@ PolicyService* UserPolicyServiceFactory::Create(const std::string& username) {
 
   scoped_ptr<PolicyStore> store(
       new PolicyStore(policy_dir.Append(kPolicyDataFile)));
+  store->set_use_container(use_policy_container_);
   bool policy_success = store->LoadOrCreate();
   if (!policy_success)  // Non-fatal, so log, and keep going.
     LOG(WARNING) << "Failed to load user policy data, continuing anyway.";
@@ -94,8 +129,24 @@ PolicyService* UserPolicyServiceFactory::Create(const std::string& username) {
 
   UserPolicyService* service = new UserPolicyService(
       store.Pass(), key.Pass(), key_copy_file, main_loop_, system_utils_);
+  service->stats()->set_metrics(metrics_);
+  service->set_io_runner(system_utils_->async_file_io()->GetTaskRunnerForPath(
+      policy_dir.Append(kPolicyDataFile)));
   service->PersistKeyCopy();
   return service;
 }
 
+PolicyService* UserPolicyServiceFactory::CreateEphemeral(
+    const std::string& username) {
+  scoped_ptr<PolicyKey> key(new EphemeralPolicyKey(nss_));
+  // There's nothing on disk, but the key insists on having looked.
+  key->PopulateFromDiskIfPossible();
+  // No key copy and no I/O runner: nothing is ever written.
+  UserPolicyService* service = new UserPolicyService(
+      scoped_ptr<PolicyStore>(new EphemeralPolicyStore), key.Pass(),
+      FilePath(), main_loop_, system_utils_);
+  service->stats()->set_metrics(metrics_);
+  return service;
+}
+
 }  // namespace login_manager
@@ -17,12 +17,17 @@ class MessageLoopProxy;
 }  // namespace base
 
 namespace login_manager {
+class LoginMetrics;
 class NssUtil;
 class PolicyService;
 class SystemUtils;
 
 // Factory for creating user policy service instances. User policies are stored
 // in the root-owned part of the user's cryptohome.
+//
+// Each user's policy is written on its own sequence of the session_manager's
+// AsyncFileIo, so that a user whose vault is slow doesn't hold up writes for
+// the other users signed in to a multi-profile session.
 class UserPolicyServiceFactory {
  public:
   UserPolicyServiceFactory(
@@ -35,6 +40,19 @@ class UserPolicyServiceFactory {
   // Creates a new user policy service instance.
   virtual PolicyService* Create(const std::string& username);
 
+  // Creates a user policy service instance for an incognito session, which
+  // keeps policy and key in memory only. Unlike Create(), doesn't touch the
+  // disk, so it is cheap enough for the guest login path.
+  virtual PolicyService* CreateEphemeral(const std::string& username);
+
+  // Makes user policy get written in a checksummed container, see
+  // PolicyStore::set_use_container().
+  void set_use_policy_container(bool use) { use_policy_container_ = use; }
+
+  // Makes the services created send their stats to UMA, see
+  // PolicyStats::set_metrics(). Not owned.
+  void set_metrics(LoginMetrics* metrics) { metrics_ = metrics; }
+
  private:
   // UID to check for.
   uid_t uid_;
@@ -42,6 +60,8 @@ class UserPolicyServiceFactory {
   scoped_refptr<base::MessageLoopProxy> main_loop_;
   NssUtil* nss_;
   SystemUtils* system_utils_;
+  bool use_policy_container_;
+  LoginMetrics* metrics_;  // Owned by the caller.
 
   DISALLOW_COPY_AND_ASSIGN(UserPolicyServiceFactory);
 };
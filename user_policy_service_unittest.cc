@@ -26,6 +26,7 @@ namespace em = enterprise_management;
 
 using ::testing::ElementsAre;
 using ::testing::InSequence;
+using ::testing::Pointee;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::Sequence;
@@ -74,7 +75,7 @@ class UserPolicyServiceTest : public ::testing::Test {
   }
 
   void ExpectStorePolicy(const Sequence& sequence) {
-    EXPECT_CALL(*store_, Set(PolicyStrEq(policy_str_)))
+    EXPECT_CALL(*store_, Swap(Pointee(PolicyStrEq(policy_str_))))
         .InSequence(sequence);
     EXPECT_CALL(*store_, Persist())
         .InSequence(sequence)